@@ -51,6 +51,9 @@ namespace dxvk {
   
   void D3D11CommandList::AddQuery(D3D11Query* pQuery) {
     m_queries.emplace_back(pQuery);
+
+    // Query state is shared with the immediate context
+    m_serialExecution = true;
   }
 
 
@@ -79,6 +82,8 @@ namespace dxvk {
       m_resources.push_back(std::move(entry));
     }
 
+    m_serialExecution |= pCommandList->m_serialExecution;
+
     // Return ID of the last chunk added. The command list
     // added can never be empty, so do not handle zero.
     return m_chunks.size() - 1;
@@ -108,6 +113,24 @@ namespace dxvk {
   }
   
   
+  Rc<DxvkCsWorkerJob> D3D11CommandList::CreateWorkerJob() const {
+    std::vector<DxvkCsChunkRef> chunks;
+    chunks.reserve(m_chunks.size());
+
+    for (const auto& entry : m_chunks)
+      chunks.push_back(entry.chunk);
+
+    return new DxvkCsWorkerJob(std::move(chunks));
+  }
+
+
+  void D3D11CommandList::TrackResourceSequenceNumbers(
+          uint64_t            Seq) {
+    for (const auto& resource : m_resources)
+      TrackResourceSequenceNumber(resource.ref, Seq);
+  }
+
+
   void D3D11CommandList::TrackResourceUsage(
           ID3D11Resource*     pResource,
           D3D11_RESOURCE_DIMENSION ResourceType,
@@ -37,6 +37,19 @@ namespace dxvk {
     void EmitToCsThread(
       const D3D11ChunkDispatchProc& DispatchProc);
 
+    Rc<DxvkCsWorkerJob> CreateWorkerJob() const;
+
+    void TrackResourceSequenceNumbers(
+            uint64_t            Seq);
+
+    void RequireSerialExecution() {
+      m_serialExecution = true;
+    }
+
+    bool RequiresSerialExecution() const {
+      return m_serialExecution;
+    }
+
     void TrackResourceUsage(
             ID3D11Resource*     pResource,
             D3D11_RESOURCE_DIMENSION ResourceType,
@@ -60,6 +73,12 @@ namespace dxvk {
 
     UINT m_contextFlags = 0u;
 
+    // Set if any command may change state that other command
+    // lists rely on, e.g. by discarding or relocating resources,
+    // in which case the command list cannot be translated on a
+    // worker context concurrently with other command lists.
+    bool m_serialExecution = false;
+
     std::vector<ChunkEntry>             m_chunks;
     std::vector<Com<D3D11Query, false>> m_queries;
     std::vector<TrackedResource>        m_resources;
@@ -47,7 +47,8 @@ namespace dxvk {
     if (!(cachedDynamic & D3D11_BIND_INDEX_BUFFER))
       bufferUsage |= VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
 
-    m_allocationCache = m_device->createAllocationCache(bufferUsage, memoryFlags);
+    m_allocationCache = m_device->createAllocationCache(bufferUsage, memoryFlags,
+      IsDeferred ? DeferredAllocationCacheRefillCount : 1u);
   }
 
 
@@ -545,6 +546,9 @@ namespace dxvk {
     } else {
       Rc<DxvkImageView> imageView = uav->GetImageView();
 
+      // The image may need to be recreated with storage usage
+      RequireSerialExecution();
+
       // If the clear value is zero, we can use the original view regardless of
       // the format since the bit pattern will not change in any supported format.
       bool isZeroClearValue = !(clearValue.color.uint32[0] | clearValue.color.uint32[1]
@@ -781,6 +785,7 @@ namespace dxvk {
       return;
 
     AddCost(GpuCostEstimate::Transfer);
+    RequireSerialExecution();
 
     EmitCs([cDstImageView = view->GetImageView()]
     (DxvkContext* ctx) {
@@ -875,6 +880,9 @@ namespace dxvk {
       VkFormat format = m_parent->LookupFormat(
         Format, DXGI_VK_FORMAT_MODE_ANY).Format;
 
+      // Resolves may need to recreate the destination image
+      RequireSerialExecution();
+
       EmitCs([
         cDstImage  = dstTextureInfo->GetImage(),
         cSrcImage  = srcTextureInfo->GetImage(),
@@ -2732,6 +2740,8 @@ namespace dxvk {
     if constexpr (!IsDeferred)
       GetTypedContext()->ConsiderFlush(GpuFlushType::ImplicitWeakHint);
 
+    RequireSerialExecution();
+
     DxvkSparseBindInfo bindInfo;
     bindInfo.dstResource = GetPagedResource(pDestTiledResource);
     bindInfo.srcResource = GetPagedResource(pSourceTiledResource);
@@ -2814,6 +2824,8 @@ namespace dxvk {
     if (!buffer->IsTilePool())
       return E_INVALIDARG;
 
+    RequireSerialExecution();
+
     // Perform the resize operation. This is somewhat trivialized
     // since all lifetime tracking is done by the backend.
     EmitCs([
@@ -2869,6 +2881,8 @@ namespace dxvk {
     if constexpr (!IsDeferred)
       GetTypedContext()->ConsiderFlush(GpuFlushType::ImplicitWeakHint);
 
+    RequireSerialExecution();
+
     // Find sparse allocator if the tile pool is defined
     DxvkSparseBindInfo bindInfo;
 
@@ -4957,6 +4971,15 @@ namespace dxvk {
   }
 
 
+  template<typename ContextType>
+  void D3D11CommonContext<ContextType>::RequireSerialExecution() {
+    // Commands that change resource state shared between contexts
+    // prevent the command list from being translated on a worker.
+    if constexpr (IsDeferred)
+      GetTypedContext()->m_commandList->RequireSerialExecution();
+  }
+
+
   template<typename ContextType>
   template<D3D11ShaderType ShaderStage, typename T>
   void D3D11CommonContext<ContextType>::ResolveSrvHazards(
@@ -5643,7 +5666,7 @@ namespace dxvk {
     util::packImageData(stagingSlice.mapPtr(0),
       pSrcData, SrcRowPitch, SrcDepthPitch, 0, 0,
       pDstTexture->GetVkImageType(), extent, 1,
-      formatInfo, formatInfo->aspectMask);
+      formatInfo, formatInfo->aspectMask, true);
 
     UpdateImage(pDstTexture, &subresource,
       offset, extent, std::move(stagingSlice));
@@ -5908,6 +5931,8 @@ namespace dxvk {
       D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT + 1u);
 
     if (NumClassInstances) {
+      RequireSerialExecution();
+
       auto buffer = AllocInstanceDataBuffer(ShaderStage);
       auto slice = buffer->allocateStorage();
 
@@ -76,6 +76,11 @@ namespace dxvk {
     // Use a local staging buffer to handle tiny uploads, most
     // of the time we're fine with hitting the global allocator
     constexpr static VkDeviceSize StagingBufferSize = 256ull << 10;
+
+    // Deferred contexts tend to discard large numbers of small dynamic
+    // buffers per command list, so refill their allocation cache with
+    // several lists at once to keep Map on the lock-free path.
+    constexpr static uint32_t DeferredAllocationCacheRefillCount = 4u;
   protected:
     // Compile-time debug flag to force lazy binding on (True) or off (False)
     constexpr static Tristate DebugLazyBinding = Tristate::Auto;
@@ -1039,6 +1044,8 @@ namespace dxvk {
 
     void ResetStagingBuffer();
 
+    void RequireSerialExecution();
+
     template<D3D11ShaderType ShaderStage, typename T>
     void ResolveSrvHazards(
             T*                                pView);
@@ -1214,6 +1221,10 @@ namespace dxvk {
           GetTypedContext()->ConsiderFlush(GpuFlushType::ImplicitWeakHint);
 
         m_csChunk->push(command);
+      } else if constexpr (!IsDeferred) {
+        // The CS thread is waiting for work, hand off what we have
+        if (unlikely(m_csChunk->commandCount() >= GetTypedContext()->m_csThread.dispatchThreshold()))
+          FlushCsChunk();
       }
     }
 
@@ -286,6 +286,9 @@ namespace dxvk {
     pMappedResource->RowPitch     = pBuffer->Desc()->ByteWidth;
     pMappedResource->DepthPitch   = pBuffer->Desc()->ByteWidth;
 
+    // Buffer invalidation swaps the backing storage of the resource
+    m_commandList->RequireSerialExecution();
+
     EmitCs([
       cDstBuffer = pBuffer->GetBuffer(),
       cDstSlice  = std::move(bufferSlice)
@@ -322,6 +325,8 @@ namespace dxvk {
       auto storage = pTexture->AllocStorage();
       auto mapPtr = storage->mapPtr();
 
+      m_commandList->RequireSerialExecution();
+
       EmitCs([
         cImage = pTexture->GetImage(),
         cStorage = std::move(storage)
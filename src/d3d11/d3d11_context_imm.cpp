@@ -35,7 +35,15 @@ namespace dxvk {
     // Stall here so that external submissions to the
     // CS thread can actually access the command list
     SynchronizeCsThread(DxvkCsThread::SynchronizeAll);
-    
+
+    // Spawn worker threads for command list translation
+    int32_t workerThreads = pParent->GetOptions()->commandListWorkerThreads;
+
+    if (workerThreads > 0) {
+      m_csWorkers = std::make_unique<DxvkCsWorkerPool>(Device,
+        uint32_t(workerThreads), pParent->GetOptionsBarrierControlFlags());
+    }
+
     ClearState();
   }
   
@@ -241,6 +249,17 @@ namespace dxvk {
 
     auto commandList = static_cast<D3D11CommandList*>(pCommandList);
 
+    // Command lists that do not touch any shared resource state can be
+    // translated on worker threads. Consecutive command lists with no
+    // other work in between are batched so that they record in parallel.
+    bool useWorkers = m_csWorkers && !commandList->RequiresSerialExecution();
+
+    if (!useWorkers || !m_csChunk->empty())
+      SubmitWorkerBatch();
+
+    // State changes around the command list do not end the batch
+    m_csWorkerBatchKeepOpen = useWorkers;
+
     // Reset dirty binding tracking before submitting any CS chunks.
     // This is needed so that any submission that might occur during
     // this call does not disrupt bindings set by the deferred context.
@@ -255,31 +274,60 @@ namespace dxvk {
     // Flush any outstanding commands so that
     // we don't mess up the execution order
     FlushCsChunk();
-    
-    // As an optimization, flush everything if the
-    // number of pending draw calls is high enough.
-    ConsiderFlush(GpuFlushType::ImplicitWeakHint);
 
-    // Dispatch command list to the CS thread
-    commandList->EmitToCsThread([this] (DxvkCsChunkRef&& chunk, uint64_t cost, GpuFlushType flushType) {
-      EmitCsChunk(std::move(chunk));
+    if (useWorkers) {
+      if (m_csWorkerBatch == nullptr)
+        m_csWorkerBatch = new DxvkCsWorkerBatch(m_csWorkers.get());
 
-      // Return the sequence number from before the flush since
-      // that is actually going to be needed for resource tracking
-      uint64_t csSeqNum = m_csSeqNum;
+      Rc<DxvkCsWorkerJob> job = commandList->CreateWorkerJob();
+      m_csWorkerBatch->addJob(job);
 
-      // Consider a flush after every chunk in case the app
-      // submits a very large command list or the GPU is idle
-      AddCost(cost);
-      ConsiderFlush(flushType);
-      return csSeqNum;
-    });
+      // The CS thread kicks off all jobs in the batch that have been
+      // added so far, and collects the command list of this one. The
+      // batch is submitted as a whole once any other work is emitted.
+      EmitCs([
+        cBatch  = m_csWorkerBatch,
+        cJob    = std::move(job)
+      ] (DxvkContext* ctx) {
+        cBatch->executeJob(ctx, cJob);
+      });
+
+      FlushCsChunk();
+
+      commandList->TrackResourceSequenceNumbers(m_csSeqNum);
+    } else {
+      // As an optimization, flush everything if the
+      // number of pending draw calls is high enough.
+      ConsiderFlush(GpuFlushType::ImplicitWeakHint);
+
+      // Dispatch command list to the CS thread
+      commandList->EmitToCsThread([this] (DxvkCsChunkRef&& chunk, uint64_t cost, GpuFlushType flushType) {
+        EmitCsChunk(std::move(chunk));
+
+        // Return the sequence number from before the flush since
+        // that is actually going to be needed for resource tracking
+        uint64_t csSeqNum = m_csSeqNum;
+
+        // Consider a flush after every chunk in case the app
+        // submits a very large command list or the GPU is idle
+        AddCost(cost);
+        ConsiderFlush(flushType);
+        return csSeqNum;
+      });
+    }
 
     // Restore the immediate context's state
     if (RestoreContextState)
       RestoreCommandListState();
     else
       ResetContextState();
+
+    // Only state commands were emitted after the job, so
+    // a subsequent command list can still join the batch.
+    if (useWorkers) {
+      FlushCsChunk();
+      m_csWorkerBatchKeepOpen = false;
+    }
   }
   
   
@@ -972,6 +1020,27 @@ namespace dxvk {
     // can processe them before the first use.
     m_parent->FlushInitCommands();
 
+    // Any other work must execute after command lists
+    // that are being translated on worker threads.
+    if (!m_csWorkerBatchKeepOpen)
+      SubmitWorkerBatch();
+
+    m_csSeqNum = m_csThread.dispatchChunk(std::move(chunk));
+  }
+
+
+  void D3D11ImmediateContext::SubmitWorkerBatch() {
+    if (m_csWorkerBatch == nullptr)
+      return;
+
+    DxvkCsChunkRef chunk = AllocCsChunk();
+
+    chunk->push([
+      cBatch = std::move(m_csWorkerBatch)
+    ] (DxvkContext* ctx) {
+      cBatch->submit(ctx);
+    });
+
     m_csSeqNum = m_csThread.dispatchChunk(std::move(chunk));
   }
 
@@ -117,6 +117,10 @@ namespace dxvk {
     DxvkCsThread            m_csThread;
     uint64_t                m_csSeqNum = 0ull;
 
+    std::unique_ptr<DxvkCsWorkerPool> m_csWorkers;
+    Rc<DxvkCsWorkerBatch>   m_csWorkerBatch;
+    bool                    m_csWorkerBatchKeepOpen = false;
+
     uint32_t                m_mappedImageCount = 0u;
 
     Rc<sync::CallbackFence> m_submissionFence;
@@ -186,6 +190,8 @@ namespace dxvk {
     
     void EmitCsChunk(DxvkCsChunkRef&& chunk);
 
+    void SubmitWorkerBatch();
+
     void TrackTextureSequenceNumber(
             D3D11CommonTexture*         pResource,
             UINT                        Subresource);
@@ -155,6 +155,15 @@ namespace dxvk {
   void D3D11Initializer::InitDeviceLocalTexture(
           D3D11CommonTexture*         pTexture,
     const D3D11_SUBRESOURCE_DATA*     pInitialData) {
+    // If the image supports host copies, write the initial data to the
+    // image directly from application memory. This does not need to be
+    // serialized with other initialization commands, so don't take the
+    // lock while copying.
+    if (pInitialData != nullptr && pInitialData->pSysMem != nullptr && pTexture->HasImage()
+     && (pTexture->GetImage()->info().usage & VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT)
+     && InitHostCopyTexture(pTexture, pInitialData))
+      return;
+
     std::lock_guard<dxvk::mutex> lock(m_mutex);
     
     // Image migt be null if this is a staging resource
@@ -196,7 +205,7 @@ namespace dxvk {
 
             util::packImageData(stagingSlice.mapPtr(dataOffset),
               pInitialData[index].pSysMem, pInitialData[index].SysMemPitch, pInitialData[index].SysMemSlicePitch,
-              0, 0, pTexture->GetVkImageType(), mipLevelExtent, 1, formatInfo, formatInfo->aspectMask);
+              0, 0, pTexture->GetVkImageType(), mipLevelExtent, 1, formatInfo, formatInfo->aspectMask, true);
 
             dataOffset += align(mipSizePerLayer, CACHE_LINE_SIZE);
           }
@@ -248,6 +257,109 @@ namespace dxvk {
   }
 
 
+  bool D3D11Initializer::InitHostCopyTexture(
+          D3D11CommonTexture*         pTexture,
+    const D3D11_SUBRESOURCE_DATA*     pInitialData) {
+    Rc<DxvkImage> image = pTexture->GetImage();
+    auto desc = pTexture->Desc();
+    auto vk = m_device->vkd();
+
+    // Host transfer usage is only enabled if the initial data
+    // is in the image format, so there is nothing to convert.
+    auto formatInfo = image->formatInfo();
+
+    // The image may get relocated at any time, in which case the CS
+    // thread will reassign the storage that we write to here.
+    Rc<DxvkResourceAllocation> storage = image->storage();
+    VkImage imageHandle = storage->getImageInfo().image;
+
+    VkHostImageLayoutTransitionInfoEXT transition = { VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT };
+    transition.image = imageHandle;
+    transition.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    transition.newLayout = image->info().layout;
+    transition.subresourceRange = image->getAvailableSubresources();
+
+    if (vk->vkTransitionImageLayoutEXT(vk->device(), 1u, &transition) != VK_SUCCESS)
+      return false;
+
+    // Read subresource data in place if its pitches can be expressed
+    // in texels, and only repack subresources with unusual pitches.
+    small_vector<VkMemoryToImageCopyEXT, 16> regions;
+    std::vector<std::unique_ptr<char[]>> packedData;
+
+    for (uint32_t mip = 0; mip < desc->MipLevels; mip++) {
+      VkExtent3D mipExtent = image->mipLevelExtent(mip);
+      VkExtent3D blockCount = util::computeBlockCount(mipExtent, formatInfo->blockSize);
+
+      for (uint32_t layer = 0; layer < desc->ArraySize; layer++) {
+        const auto& data = pInitialData[D3D11CalcSubresource(mip, layer, desc->MipLevels)];
+
+        auto& region = regions.emplace_back();
+        region = { VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT };
+        region.pHostPointer = data.pSysMem;
+        region.imageSubresource.aspectMask = formatInfo->aspectMask;
+        region.imageSubresource.mipLevel = mip;
+        region.imageSubresource.baseArrayLayer = layer;
+        region.imageSubresource.layerCount = 1u;
+        region.imageExtent = mipExtent;
+
+        VkDeviceSize rowSize = blockCount.width * formatInfo->elementSize;
+        VkDeviceSize rowPitch = data.SysMemPitch;
+        VkDeviceSize slicePitch = data.SysMemSlicePitch;
+
+        bool rowPitchValid = rowPitch >= rowSize
+          && !(rowPitch % formatInfo->elementSize);
+        bool slicePitchValid = rowPitchValid
+          && slicePitch >= rowPitch * blockCount.height
+          && !(slicePitch % rowPitch);
+
+        if ((blockCount.height <= 1u || rowPitchValid)
+         && (blockCount.depth <= 1u || slicePitchValid)) {
+          if (rowPitchValid && (blockCount.height > 1u || blockCount.depth > 1u))
+            region.memoryRowLength = (rowPitch / formatInfo->elementSize) * formatInfo->blockSize.width;
+
+          if (blockCount.depth > 1u)
+            region.memoryImageHeight = (slicePitch / rowPitch) * formatInfo->blockSize.height;
+        } else {
+          VkDeviceSize dataSize = util::computeImageDataSize(
+            image->info().format, mipExtent, formatInfo->aspectMask);
+
+          auto& packed = packedData.emplace_back(new char[dataSize]);
+
+          util::packImageData(packed.get(), data.pSysMem, rowPitch, slicePitch,
+            0, 0, pTexture->GetVkImageType(), mipExtent, 1, formatInfo, formatInfo->aspectMask);
+
+          region.pHostPointer = packed.get();
+        }
+      }
+    }
+
+    VkCopyMemoryToImageInfoEXT copyInfo = { VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT };
+    copyInfo.dstImage = imageHandle;
+    copyInfo.dstImageLayout = image->info().layout;
+    copyInfo.regionCount = regions.size();
+    copyInfo.pRegions = regions.data();
+
+    VkResult vr = vk->vkCopyMemoryToImageEXT(vk->device(), &copyInfo);
+
+    if (vr != VK_SUCCESS) {
+      Logger::warn(str::format("D3D11: Host image copy failed: ", vr));
+      return false;
+    }
+
+    // Let the CS thread mark the image as initialized, so that
+    // this is ordered with resource relocation on that thread.
+    EmitCs([
+      cImage    = std::move(image),
+      cStorage  = std::move(storage)
+    ] (DxvkContext* ctx) mutable {
+      ctx->initImageHost(cImage, std::move(cStorage));
+    });
+
+    return true;
+  }
+
+
   void D3D11Initializer::InitHostVisibleTexture(
           D3D11CommonTexture*         pTexture,
     const D3D11_SUBRESOURCE_DATA*     pInitialData) {
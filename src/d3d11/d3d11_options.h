@@ -102,6 +102,11 @@ namespace dxvk {
     /// Some games are broken and ignore row pitch.
     bool disableDirectImageMapping = false;
 
+    /// Number of worker threads used to translate deferred context
+    /// command lists into Vulkan command buffers in parallel. If 0,
+    /// command lists are executed on the CS thread.
+    int32_t commandListWorkerThreads = 0;
+
     /// Shader dump path
     std::string shaderDumpPath;
   };
@@ -221,6 +221,14 @@ namespace dxvk {
     if (imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL && !isMultiPlane && imageInfo.sharing.mode == DxvkSharedHandleMode::None)
       imageInfo.layout = OptimizeLayout(imageInfo.usage);
 
+    // Initial data for textures that are not mapped can be written directly
+    // from the CPU if the device supports it. Applications create many static
+    // textures with default usage, so don't restrict this to immutable ones.
+    if ((m_desc.Usage == D3D11_USAGE_IMMUTABLE || m_desc.Usage == D3D11_USAGE_DEFAULT)
+     && m_mapMode == D3D11_COMMON_TEXTURE_MAP_MODE_NONE && !(m_desc.MiscFlags & D3D11_RESOURCE_MISC_TILED)
+     && !vkImage && !m_11on12.Resource && !imageInfo.shared && CheckHostImageCopySupport(&imageInfo))
+      imageInfo.usage |= VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+
     // Check if we can actually create the image
     if (!CheckImageSupport(&imageInfo, imageInfo.tiling)) {
       throw DxvkError(str::format(
@@ -544,6 +552,42 @@ namespace dxvk {
         || (support.optimal & Features) == Features;
   }
 
+
+  BOOL D3D11CommonTexture::CheckHostImageCopySupport(
+    const DxvkImageCreateInfo*  pImageInfo) const {
+    Rc<DxvkDevice> device = m_device->GetDXVKDevice();
+
+    if (!device->canUseHostImageCopy(pImageInfo->layout))
+      return FALSE;
+
+    // Initial data is uploaded as-is, so it must be in the image format
+    // and there must not be any depth-stencil packing involved.
+    if (pImageInfo->tiling != VK_IMAGE_TILING_OPTIMAL
+     || pImageInfo->format != m_packedFormat
+     || lookupFormatInfo(pImageInfo->format)->aspectMask != VK_IMAGE_ASPECT_COLOR_BIT)
+      return FALSE;
+
+    if (!(device->getFormatFeatures(pImageInfo->format).optimal & VK_FORMAT_FEATURE_2_HOST_IMAGE_TRANSFER_BIT_EXT))
+      return FALSE;
+
+    DxvkImageCreateInfo imageInfo = *pImageInfo;
+    imageInfo.usage |= VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+
+    if (!CheckImageSupport(&imageInfo, VK_IMAGE_TILING_OPTIMAL))
+      return FALSE;
+
+    // Avoid host copies if the additional usage would affect GPU performance
+    DxvkFormatQuery formatQuery = { };
+    formatQuery.format = imageInfo.format;
+    formatQuery.type = imageInfo.type;
+    formatQuery.tiling = imageInfo.tiling;
+    formatQuery.usage = imageInfo.usage;
+    formatQuery.flags = imageInfo.flags;
+
+    auto properties = device->getFormatLimits(formatQuery);
+    return properties && properties->optimalDeviceAccess;
+  }
+
   
   std::pair<D3D11_COMMON_TEXTURE_MAP_MODE, VkMemoryPropertyFlags> D3D11CommonTexture::DetermineMapMode(
     const D3D11Device*          device,
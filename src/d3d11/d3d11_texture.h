@@ -601,6 +601,9 @@ namespace dxvk {
     BOOL CheckFormatFeatureSupport(
             VkFormat              Format,
             VkFormatFeatureFlags2 Features) const;
+
+    BOOL CheckHostImageCopySupport(
+      const DxvkImageCreateInfo*  pImageInfo) const;
     
     std::pair<D3D11_COMMON_TEXTURE_MAP_MODE, VkMemoryPropertyFlags> DetermineMapMode(
       const D3D11Device*          device,
@@ -194,8 +194,22 @@ namespace dxvk {
 
     m_specInfo.set<SpecDrefScaling, uint32_t>(m_d3d9Options.drefScaling);
 
+    // Shader dumps are written at compile time, so don't use
+    // the shader cache if the user requested a shader dump.
+    if (env::getEnvVar("DXVK_SHADER_CACHE") != "0" && m_d3d9Options.shaderDumpPath.empty())
+      m_shaderCache = D3D9ShaderCache::GetInstance();
+
     BindFFUbershader<DxsoProgramType::VertexShader>();
     BindFFUbershader<DxsoProgramType::PixelShader>();
+
+    if (m_d3d9Options.ffAsyncShaders) {
+      EmitCs([
+        this,
+       &cShaders = m_ffModules
+      ](DxvkContext* ctx) {
+        cShaders.LoadShaderKeys(this);
+      });
+    }
   }
 
 
@@ -3272,6 +3286,32 @@ namespace dxvk {
         return D3DERR_INVALIDCALL;
     }
 
+    if (unlikely(!VertexCount))
+      return D3D_OK;
+
+    D3D9CommonBuffer* dst  = static_cast<D3D9VertexBuffer*>(pDestBuffer)->GetCommonBuffer();
+    D3D9VertexDecl*   decl = static_cast<D3D9VertexDecl*>  (pVertexDecl);
+
+    if (decl == nullptr) {
+      DWORD FVF = dst->Desc()->FVF;
+
+      auto iter = m_fvfTable.find(FVF);
+
+      if (iter == m_fvfTable.end()) {
+        decl = new D3D9VertexDecl(this, FVF);
+        m_fvfTable.insert(std::make_pair(FVF, decl));
+      }
+      else
+        decl = iter->second.ptr();
+    }
+
+    // Process vertices on the CPU if possible, this avoids
+    // a GPU round trip and stalling on the readback when the
+    // application reads the destination buffer.
+    if (m_d3d9Options.cpuProcessVertices
+     && ProcessVerticesCpu(SrcStartIndex, DestIndex, VertexCount, dst, decl))
+      return D3D_OK;
+
     if (!SupportsSWVP()) {
       static bool s_errorShown = false;
 
@@ -3281,12 +3321,6 @@ namespace dxvk {
       return D3D_OK;
     }
 
-    if (unlikely(!VertexCount))
-      return D3D_OK;
-
-    D3D9CommonBuffer* dst  = static_cast<D3D9VertexBuffer*>(pDestBuffer)->GetCommonBuffer();
-    D3D9VertexDecl*   decl = static_cast<D3D9VertexDecl*>  (pVertexDecl);
-
     bool dynamicSysmemVBOs;
     uint32_t firstIndex     = 0;
     int32_t baseVertexIndex = 0;
@@ -3302,19 +3336,6 @@ namespace dxvk {
 
     PrepareDraw(D3DPT_FORCE_DWORD, !dynamicSysmemVBOs, false);
 
-    if (decl == nullptr) {
-      DWORD FVF = dst->Desc()->FVF;
-
-      auto iter = m_fvfTable.find(FVF);
-
-      if (iter == m_fvfTable.end()) {
-        decl = new D3D9VertexDecl(this, FVF);
-        m_fvfTable.insert(std::make_pair(FVF, decl));
-      }
-      else
-        decl = iter->second.ptr();
-    }
-
     uint32_t offset = DestIndex * decl->GetSize(0);
 
     D3D9CompactVertexElements elements;
@@ -3401,6 +3422,237 @@ namespace dxvk {
   }
 
 
+  bool D3D9DeviceEx::ProcessVerticesCpu(
+          UINT                         SrcStartIndex,
+          UINT                         DestIndex,
+          UINT                         VertexCount,
+          D3D9CommonBuffer*            pDestBuffer,
+          D3D9VertexDecl*              pDestDecl) {
+    D3D9VertexDecl* srcDecl = m_state.vertexDecl.ptr();
+
+    if (unlikely(srcDecl == nullptr))
+      return false;
+
+    D3D9SWVPCpuDrawInfo       info;
+    D3D9SWVPCpuFixedFunction  fixedFunction;
+    std::vector<D3D9Light>    lights;
+
+    const D3D9SWVPCpuInterface* iface = nullptr;
+
+    if (UseProgrammableVS()) {
+      info.program = m_state.vertexShader->GetCpuProgram();
+
+      if (!info.program)
+        return false;
+
+      const auto& layout = GetVertexConstantLayout();
+
+      info.constants.floats     = m_state.vsConsts->fConsts;
+      info.constants.ints       = m_state.vsConsts->iConsts;
+      info.constants.bools      = m_state.vsConsts->bConsts;
+      info.constants.floatCount = layout.floatCount;
+      info.constants.intCount   = layout.intCount;
+      info.constants.boolCount  = layout.boolCount;
+
+      iface = &info.program->GetInterface();
+    } else {
+      if (!PrepareProcessVerticesCpuFF(pDestDecl, fixedFunction, lights))
+        return false;
+
+      info.fixedFunction = &fixedFunction;
+      iface = &D3D9SWVPCpuFixedFunction::GetInterface();
+    }
+
+    // Clamp the vertex count to the size of the destination buffer
+    const uint32_t dstStride = pDestDecl->GetSize(0);
+    const uint32_t dstSize   = pDestBuffer->Desc()->Size;
+
+    if (unlikely(!dstStride || DestIndex >= dstSize / dstStride))
+      return true;
+
+    VertexCount = std::min(VertexCount, dstSize / dstStride - DestIndex);
+
+    for (const auto& element : pDestDecl->GetElements()) {
+      if (element.Stream != 0 || element.Type == D3DDECLTYPE_UNUSED)
+        continue;
+
+      D3D9SWVPCpuVertexOutput& output = info.outputs.emplace_back();
+      output.offset = element.Offset;
+      output.type   = D3DDECLTYPE(element.Type);
+      output.slot   = iface->findOutput(DxsoSemantic {
+        DxsoUsage(element.Usage), element.UsageIndex });
+    }
+
+    // Map all source streams that the declaration reads from
+    std::array<D3D9CommonBuffer*, caps::MaxStreams> srcBuffers = { };
+    std::array<const uint8_t*,    caps::MaxStreams> srcData    = { };
+
+    bool success = true;
+
+    for (const auto& element : srcDecl->GetElements()) {
+      uint32_t slot = iface->findInput(DxsoSemantic {
+        DxsoUsage(element.Usage), element.UsageIndex });
+
+      if (slot == ~0u)
+        continue;
+
+      const uint32_t stream = element.Stream;
+      const auto& vbo = m_state.vertexBuffers[stream];
+
+      // Per-instance data always reads the first instance,
+      // since the destination only holds a single instance
+      bool isInstanced = m_state.streamFreq[stream] & D3DSTREAMSOURCE_INSTANCEDATA;
+
+      D3D9CommonBuffer* buffer = GetCommonBuffer(vbo.vertexBuffer);
+
+      if (unlikely(buffer == nullptr)) {
+        success = false;
+        break;
+      }
+
+      // The GPU path relies on robust buffer access for out-of-bounds
+      // reads, so fall back to it if the source stream is too small.
+      uint64_t lastVertex = isInstanced ? 0u : uint64_t(SrcStartIndex) + VertexCount - 1u;
+      uint64_t readEnd = uint64_t(vbo.offset) + element.Offset
+        + lastVertex * vbo.stride + GetDecltypeSize(D3DDECLTYPE(element.Type));
+
+      if (unlikely(readEnd > buffer->Desc()->Size)) {
+        success = false;
+        break;
+      }
+
+      if (!srcData[stream]) {
+        void* data = nullptr;
+
+        if (FAILED(LockBuffer(buffer, 0, 0, &data, D3DLOCK_READONLY))) {
+          success = false;
+          break;
+        }
+
+        srcBuffers[stream] = buffer;
+        srcData[stream]    = reinterpret_cast<const uint8_t*>(data);
+      }
+
+      D3D9SWVPCpuVertexInput& input = info.inputs.emplace_back();
+      input.data   = srcData[stream] + vbo.offset + element.Offset;
+      input.stride = isInstanced ? 0u : vbo.stride;
+      input.type   = D3DDECLTYPE(element.Type);
+      input.slot   = slot;
+
+      if (!isInstanced)
+        input.data += size_t(SrcStartIndex) * vbo.stride;
+    }
+
+    void* dstData = nullptr;
+
+    if (success)
+      success = SUCCEEDED(LockBuffer(pDestBuffer, DestIndex * dstStride, VertexCount * dstStride, &dstData, 0));
+
+    if (success) {
+      info.dstData     = reinterpret_cast<uint8_t*>(dstData);
+      info.dstStride   = dstStride;
+      info.vertexCount = VertexCount;
+
+      m_swvpCpu.ProcessVertices(info);
+
+      UnlockBuffer(pDestBuffer);
+    }
+
+    for (D3D9CommonBuffer* buffer : srcBuffers) {
+      if (buffer)
+        UnlockBuffer(buffer);
+    }
+
+    return success;
+  }
+
+
+  bool D3D9DeviceEx::PrepareProcessVerticesCpuFF(
+          D3D9VertexDecl*              pDestDecl,
+          D3D9SWVPCpuFixedFunction&    FixedFunction,
+          std::vector<D3D9Light>&      Lights) {
+    const D3D9VertexDecl* srcDecl = m_state.vertexDecl.ptr();
+
+    // Pre-transformed vertices and vertex blending
+    // are only implemented by the GPU path
+    if (srcDecl->TestFlag(D3D9VertexDeclFlag::HasPositionT)
+     || m_state.renderStates[D3DRS_VERTEXBLEND] != D3DVBF_DISABLE)
+      return false;
+
+    // Fog and point size outputs are not computed on the CPU
+    uint32_t texcoordMask = 0u;
+
+    for (const auto& element : pDestDecl->GetElements()) {
+      if (element.Usage == D3DDECLUSAGE_FOG || element.Usage == D3DDECLUSAGE_PSIZE)
+        return false;
+
+      if (element.Usage == D3DDECLUSAGE_TEXCOORD && element.UsageIndex < caps::TextureStageCount)
+        texcoordMask |= 1u << element.UsageIndex;
+    }
+
+    D3D9FFShaderKeyVS key = BuildFFKeyVS(D3D9FF_VertexBlendMode_Disabled, false);
+
+    // Texture coordinate generation and texture transforms
+    // are not supported for the texture coordinates we write
+    for (uint32_t i : bit::BitMask(texcoordMask)) {
+      if ((key.Data.Contents.TexcoordFlags  >> (i * 3)) & 0b111)
+        return false;
+
+      if ((key.Data.Contents.TransformFlags >> (i * 3)) & 0b111)
+        return false;
+    }
+
+    const Matrix4& view = m_state.transforms[GetTransformIndex(D3DTS_VIEW)];
+
+    FixedFunction.worldView        = view * m_state.transforms[GetTransformIndex(D3DTS_WORLD)];
+    FixedFunction.normalMatrix     = inverse(FixedFunction.worldView);
+    FixedFunction.projection       = m_state.transforms[GetTransformIndex(D3DTS_PROJECTION)];
+
+    FixedFunction.hasColor0        = key.Data.Contents.VertexHasColor0;
+    FixedFunction.hasColor1        = key.Data.Contents.VertexHasColor1;
+    FixedFunction.lighting         = key.Data.Contents.UseLighting;
+    FixedFunction.normalizeNormals = key.Data.Contents.NormalizeNormals;
+    FixedFunction.localViewer      = key.Data.Contents.LocalViewer;
+    FixedFunction.specularEnable   = key.Data.Contents.SpecularEnabled;
+
+    FixedFunction.diffuseSource    = key.Data.Contents.DiffuseSource;
+    FixedFunction.ambientSource    = key.Data.Contents.AmbientSource;
+    FixedFunction.specularSource   = key.Data.Contents.SpecularSource;
+    FixedFunction.emissiveSource   = key.Data.Contents.EmissiveSource;
+
+    for (uint32_t i = 0; i < FixedFunction.texcoordIndices.size(); i++)
+      FixedFunction.texcoordIndices[i] = (key.Data.Contents.TexcoordIndices >> (i * 3)) & 0b111;
+
+    FixedFunction.texcoordMask = key.Data.Contents.VertexTexcoordDeclMask;
+
+    if (FixedFunction.lighting) {
+      const D3DMATERIAL9& material = m_state.material.get();
+
+      DecodeD3DCOLOR(m_state.renderStates[D3DRS_AMBIENT], FixedFunction.globalAmbient.data);
+
+      FixedFunction.materialDiffuse  = Vector4(material.Diffuse.r,  material.Diffuse.g,  material.Diffuse.b,  material.Diffuse.a);
+      FixedFunction.materialAmbient  = Vector4(material.Ambient.r,  material.Ambient.g,  material.Ambient.b,  material.Ambient.a);
+      FixedFunction.materialSpecular = Vector4(material.Specular.r, material.Specular.g, material.Specular.b, material.Specular.a);
+      FixedFunction.materialEmissive = Vector4(material.Emissive.r, material.Emissive.g, material.Emissive.b, material.Emissive.a);
+      FixedFunction.materialPower    = material.Power;
+
+      for (uint32_t i = 0; i < caps::MaxEnabledLights; i++) {
+        auto idx = m_state.enabledLightIndices[i];
+
+        if (idx == std::numeric_limits<uint32_t>::max())
+          continue;
+
+        Lights.emplace_back(m_state.lights[idx].value(), view);
+      }
+
+      FixedFunction.lights     = Lights.data();
+      FixedFunction.lightCount = uint32_t(Lights.size());
+    }
+
+    return true;
+  }
+
+
   HRESULT STDMETHODCALLTYPE D3D9DeviceEx::CreateVertexDeclaration(
     const D3DVERTEXELEMENT9*            pVertexElements,
           IDirect3DVertexDeclaration9** ppDecl) {
@@ -5365,7 +5617,7 @@ namespace dxvk {
       const void* srcData = reinterpret_cast<const uint8_t*>(mapPtr) + copySrcOffset;
       util::packImageData(
         slice.mapPtr, srcData, extentBlockCount, formatInfo->elementSize,
-        pitch, pitch * srcTexLevelExtentBlockCount.height);
+        pitch, pitch * srcTexLevelExtentBlockCount.height, true);
 
       VkFormat packedDSFormat = GetPackedDepthStencilFormat(pDestTexture->Desc()->Format);
 
@@ -5420,7 +5672,7 @@ namespace dxvk {
 
       util::packImageData(
         slice.mapPtr, mapPtr, srcBlockCount, formatElementSize,
-        pitch, std::min(pSrcTexture->GetPlaneCount(), 2u) * pitch * srcBlockCount.height);
+        pitch, std::min(pSrcTexture->GetPlaneCount(), 2u) * pitch * srcBlockCount.height, true);
 
       EmitCs([this,
         cConvertFormat    = convertFormat,
@@ -6341,6 +6593,18 @@ namespace dxvk {
       if (cTracker && cTracker->needsAutoMarkers())
         ctx->endLatencyTracking(cTracker);
     });
+
+    if (m_d3d9Options.ffAsyncShaders) {
+      // Create a few shaders for keys from previous runs per
+      // frame rather than stalling the first frame on all of them
+      EmitCs<false>([
+        this,
+       &cShaders = m_ffModules
+      ] (DxvkContext* ctx) {
+        if (cShaders.HasQueuedShaderKeys())
+          cShaders.CreateQueuedShaders(this, 4u);
+      });
+    }
   }
 
 
@@ -7823,6 +8087,21 @@ namespace dxvk {
   }
 
 
+  template <DxsoProgramType ShaderStage>
+  void D3D9DeviceEx::BindFFReadyShader() {
+    EmitCs([
+     &cShaders = m_ffModules
+    ](DxvkContext* ctx) {
+      Rc<DxvkShader> shader = cShaders.GetReadyShader(ShaderStage);
+
+      if (shader != nullptr) {
+        constexpr VkShaderStageFlagBits stage = GetShaderStage(ShaderStage);
+        ctx->bindShader<stage>(std::move(shader));
+      }
+    });
+  }
+
+
   void D3D9DeviceEx::BindInputLayout() {
     m_dirty.clr(D3D9DeviceDirtyFlag::InputLayout);
 
@@ -8025,6 +8304,54 @@ namespace dxvk {
   }
 
 
+  template <
+    DxsoProgramType  ProgramType,
+    D3D9ConstantType ConstantType,
+    typename         T>
+  bool D3D9DeviceEx::TrimConstantRange(
+          UINT&       StartRegister,
+    const T*&         pConstantData,
+          UINT&       Count) {
+    constexpr size_t RegisterSize = 4u * sizeof(T);
+
+    const void* current;
+
+    if constexpr (ConstantType == D3D9ConstantType::Float) {
+      current = ProgramType == DxsoProgramType::VertexShader
+        ? static_cast<const void*>(&m_state.vsConsts->fConsts[StartRegister])
+        : static_cast<const void*>(&m_state.psConsts->fConsts[StartRegister]);
+    } else {
+      current = ProgramType == DxsoProgramType::VertexShader
+        ? static_cast<const void*>(&m_state.vsConsts->iConsts[StartRegister])
+        : static_cast<const void*>(&m_state.psConsts->iConsts[StartRegister]);
+    }
+
+    // If float emulation is enabled, the stored values have NaNs replaced.
+    // Since stored values are never NaN in that case, matching data can
+    // not contain NaNs either, so comparing the raw data is still valid.
+    auto src = reinterpret_cast<const char*>(pConstantData);
+    auto dst = reinterpret_cast<const char*>(current);
+
+    uint32_t first = 0u;
+
+    while (first < Count && !std::memcmp(&src[first * RegisterSize], &dst[first * RegisterSize], RegisterSize))
+      first += 1u;
+
+    if (first == Count)
+      return false;
+
+    uint32_t last = Count;
+
+    while (last > first + 1u && !std::memcmp(&src[(last - 1u) * RegisterSize], &dst[(last - 1u) * RegisterSize], RegisterSize))
+      last -= 1u;
+
+    StartRegister += first;
+    pConstantData += first * 4u;
+    Count = last - first;
+    return true;
+  }
+
+
   template <
     DxsoProgramType  ProgramType,
     D3D9ConstantType ConstantType,
@@ -8062,6 +8389,27 @@ namespace dxvk {
 
     D3D9ConstantSets& constSet = m_consts[ProgramType];
 
+    // Applications commonly set entire constant ranges before every draw
+    // even if only a few registers change. Skip leading and trailing
+    // registers whose values are unchanged, and skip the call entirely if
+    // nothing changes, so that redundant calls don't dirty the constant set.
+    // If the set is already dirty and the range does not extend past the
+    // highest changed register, the next upload copies these registers
+    // anyway, so don't bother comparing them.
+    if constexpr (ConstantType != D3D9ConstantType::Bool) {
+      uint32_t maxChanged = ConstantType == D3D9ConstantType::Float
+        ? constSet.maxChangedConstF
+        : constSet.maxChangedConstI;
+
+      if constexpr (ConstantType == D3D9ConstantType::Int && ProgramType != DxsoProgramType::VertexShader)
+        maxChanged = caps::MaxOtherConstants;
+
+      if (!constSet.dirty || StartRegister + Count > maxChanged) {
+        if (!TrimConstantRange<ProgramType, ConstantType>(StartRegister, pConstantData, Count))
+          return D3D_OK;
+      }
+    }
+
     if constexpr (ConstantType == D3D9ConstantType::Float) {
       constSet.maxChangedConstF = std::max(constSet.maxChangedConstF, StartRegister + Count);
     } else if constexpr (ConstantType == D3D9ConstantType::Int && ProgramType == DxsoProgramType::VertexShader) {
@@ -8191,6 +8539,18 @@ namespace dxvk {
     if (useUbershader && m_dirty.test(D3D9DeviceDirtyFlag::FFVertexShader)) {
       m_dirty.clr(D3D9DeviceDirtyFlag::FFVertexShader);
       m_dirty.set(D3D9DeviceDirtyFlag::FFVertexData);
+
+      if (m_d3d9Options.ffAsyncShaders) {
+        D3D9FFShaderKeyVS key = BuildFFKeyVS(vertexBlendMode, indexedVertexBlend);
+
+        EmitCs([
+          this,
+          cKey     = key,
+         &cShaders = m_ffModules
+        ](DxvkContext* ctx) {
+          ctx->bindShader<VK_SHADER_STAGE_VERTEX_BIT>(cShaders.GetShaderModuleAsync(this, cKey));
+        });
+      }
     } else if (m_dirty.test(D3D9DeviceDirtyFlag::FFVertexShader)) {
       m_dirty.clr(D3D9DeviceDirtyFlag::FFVertexShader);
 
@@ -8206,6 +8566,11 @@ namespace dxvk {
       });
     }
 
+    // Switch to the specialized shader once it is ready. The uber
+    // shader data stays valid, so no constant update is needed.
+    if (unlikely(m_ffModules.HasPendingShader(DxsoProgramType::VertexShader)))
+      BindFFReadyShader<DxsoProgramType::VertexShader>();
+
     // Viewport...
     if (hasPositionT && (m_dirty.test(D3D9DeviceDirtyFlag::FFViewport) || m_ffZTest != IsZTestEnabled())) {
       m_dirty.clr(D3D9DeviceDirtyFlag::FFViewport);
@@ -8366,8 +8731,12 @@ namespace dxvk {
 
 
   void D3D9DeviceEx::UpdateFixedFunctionPS() {
-    if (unlikely(!m_dirty.test(D3D9DeviceDirtyFlag::FFPixelShader) && !m_dirty.test(D3D9DeviceDirtyFlag::FFPixelData)))
+    if (unlikely(!m_dirty.test(D3D9DeviceDirtyFlag::FFPixelShader) && !m_dirty.test(D3D9DeviceDirtyFlag::FFPixelData))) {
+      if (unlikely(m_ffModules.HasPendingShader(DxsoProgramType::PixelShader)))
+        BindFFReadyShader<DxsoProgramType::PixelShader>();
+
       return;
+    }
 
     // Shader...
     const bool useUbershader = m_d3d9Options.ffUbershaderFS;
@@ -8416,6 +8785,16 @@ namespace dxvk {
       if (dirty) {
         m_dirty.set(D3D9DeviceDirtyFlag::SpecializationEntries);
       }
+
+      if (m_d3d9Options.ffAsyncShaders) {
+        EmitCs([
+          this,
+          cKey     = key,
+         &cShaders = m_ffModules
+        ](DxvkContext* ctx) {
+          ctx->bindShader<VK_SHADER_STAGE_FRAGMENT_BIT>(cShaders.GetShaderModuleAsync(this, cKey));
+        });
+      }
     } else if (m_dirty.test(D3D9DeviceDirtyFlag::FFPixelShader)) {
       m_dirty.clr(D3D9DeviceDirtyFlag::FFPixelShader);
 
@@ -8429,6 +8808,9 @@ namespace dxvk {
       });
     }
 
+    if (unlikely(m_ffModules.HasPendingShader(DxsoProgramType::PixelShader)))
+      BindFFReadyShader<DxsoProgramType::PixelShader>();
+
     // Constants...
     if (m_dirty.test(D3D9DeviceDirtyFlag::FFPixelData)) {
       m_dirty.clr(D3D9DeviceDirtyFlag::FFPixelData);
@@ -8593,6 +8975,32 @@ namespace dxvk {
   }
 
 
+  Rc<DxvkShader> D3D9DeviceEx::LookupCachedShader(
+    const Sha1Hash&                 Key,
+          D3D9ShaderCacheMetadata*  pMetadata) {
+    auto t0 = dxvk::high_resolution_clock::now();
+
+    Rc<DxvkShader> shader = m_shaderCache->LookupShader(Key, pMetadata);
+
+    auto t1 = dxvk::high_resolution_clock::now();
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0);
+
+    m_dxvkDevice->addStatCtr(shader
+      ? DxvkStatCounter::ShaderCacheHits
+      : DxvkStatCounter::ShaderCacheMisses, 1u);
+    m_dxvkDevice->addStatCtr(DxvkStatCounter::ShaderCacheTicks, us.count());
+    return shader;
+  }
+
+
+  void D3D9DeviceEx::AddCachedShader(
+    const Sha1Hash&                 Key,
+    const Rc<DxvkSpirvShader>&      Shader,
+    const D3D9ShaderCacheMetadata*  pMetadata) {
+    m_shaderCache->AddShader(Key, Shader, pMetadata);
+  }
+
+
   void D3D9DeviceEx::ResetState(D3DPRESENT_PARAMETERS* pPresentationParameters) {
     SetDepthStencilSurface(nullptr);
 
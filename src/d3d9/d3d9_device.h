@@ -23,7 +23,9 @@
 #include "../dxso/dxso_modinfo.h"
 
 #include "d3d9_fixed_function.h"
+#include "d3d9_swvp_cpu.h"
 #include "d3d9_swvp_emu.h"
+#include "d3d9_shader_cache.h"
 
 #include "d3d9_spec_constants.h"
 #include "d3d9_interop.h"
@@ -1092,6 +1094,9 @@ namespace dxvk {
     template <DxsoProgramType ShaderStage>
     void BindFFUbershader();
 
+    template <DxsoProgramType ShaderStage>
+    void BindFFReadyShader();
+
     void BindInputLayout();
 
     void BindVertexBuffer(
@@ -1144,6 +1149,41 @@ namespace dxvk {
     const D3D9ConstantLayout& GetVertexConstantLayout() { return m_consts[DxsoProgramType::VertexShader].layout; }
     const D3D9ConstantLayout& GetPixelConstantLayout()  { return m_consts[DxsoProgramType::PixelShader].layout; }
 
+    /**
+     * \brief Checks whether the on-disk shader cache is enabled
+     *
+     * Used to skip computing cache keys when no cache is used.
+     * \returns \c true if shaders can be looked up and cached
+     */
+    bool HasShaderCache() const {
+      return m_shaderCache != nullptr;
+    }
+
+    /**
+     * \brief Looks up shader in the on-disk shader cache
+     *
+     * May be called from any thread.
+     * \param [in] Key Cache key
+     * \param [out] pMetadata DXSO shader metadata, if any
+     * \returns Cached shader, or \c nullptr on a cache miss
+     */
+    Rc<DxvkShader> LookupCachedShader(
+      const Sha1Hash&                 Key,
+            D3D9ShaderCacheMetadata*  pMetadata);
+
+    /**
+     * \brief Adds newly compiled shader to the on-disk shader cache
+     *
+     * May be called from any thread.
+     * \param [in] Key Cache key
+     * \param [in] Shader Compiled shader
+     * \param [in] pMetadata DXSO shader metadata, if any
+     */
+    void AddCachedShader(
+      const Sha1Hash&                 Key,
+      const Rc<DxvkSpirvShader>&      Shader,
+      const D3D9ShaderCacheMetadata*  pMetadata);
+
     void ResetState(D3DPRESENT_PARAMETERS* pPresentationParameters);
     HRESULT ResetSwapChain(D3DPRESENT_PARAMETERS* pPresentationParameters, D3DDISPLAYMODEEX* pFullscreenDisplayMode);
 
@@ -1287,6 +1327,9 @@ namespace dxvk {
           ConsiderFlush(GpuFlushType::ImplicitWeakHint);
 
         m_csChunk->push(command);
+      } else if (unlikely(m_csChunk->commandCount() >= m_csThread.dispatchThreshold())) {
+        // The CS thread is waiting for work, hand off what we have
+        FlushCsChunk();
       }
     }
 
@@ -1404,6 +1447,26 @@ namespace dxvk {
         const T*    pConstantData,
               UINT  Count);
 
+    /**
+     * \brief Trims constant range to changed registers
+     *
+     * Compares the given constant data against the current state
+     * and narrows the range down to the first and last register
+     * whose value actually changes. This only avoids redundant
+     * updates, constant uploads still copy all registers up to
+     * the highest changed one since previously uploaded buffer
+     * slices may still be read by earlier draws.
+     * \returns \c false if no register changes at all
+     */
+    template <
+      DxsoProgramType  ProgramType,
+      D3D9ConstantType ConstantType,
+      typename         T>
+    bool TrimConstantRange(
+            UINT&       StartRegister,
+      const T*&         pConstantData,
+            UINT&       Count);
+
     template <
       DxsoProgramType  ProgramType,
       D3D9ConstantType ConstantType,
@@ -1490,6 +1553,26 @@ namespace dxvk {
     D3D9FFShaderKeyVS BuildFFKeyVS(D3D9FF_VertexBlendMode vertexBlendMode, bool indexedVertexBlend) const;
     D3D9FFShaderKeyFS BuildFFKeyFS() const;
 
+    /**
+     * \brief Processes vertices on the CPU
+     *
+     * Used for \c ProcessVertices if the current vertex
+     * shader or fixed-function state can be executed on
+     * the CPU. Writes directly to the destination buffer.
+     * \returns \c false if the GPU path must be used
+     */
+    bool ProcessVerticesCpu(
+            UINT                         SrcStartIndex,
+            UINT                         DestIndex,
+            UINT                         VertexCount,
+            D3D9CommonBuffer*            pDestBuffer,
+            D3D9VertexDecl*              pDestDecl);
+
+    bool PrepareProcessVerticesCpuFF(
+            D3D9VertexDecl*              pDestDecl,
+            D3D9SWVPCpuFixedFunction&    FixedFunction,
+            std::vector<D3D9Light>&      Lights);
+
     void BindSpecConstants();
 
     void TrackBufferMappingBufferSequenceNumber(
@@ -1591,10 +1674,12 @@ namespace dxvk {
 
     D3D9FFShaderModuleSet           m_ffModules;
     D3D9SWVPEmulator                m_swvpEmulator;
+    D3D9SWVPCpuProcessor            m_swvpCpu;
 
     Com<D3D9StateBlock, false>      m_recorder;
 
     Rc<D3D9ShaderModuleSet>         m_shaderModules;
+    Rc<D3D9ShaderCache>             m_shaderCache;
 
     D3D9ConstantBuffer              m_vsClipPlanes;
 
@@ -1,3 +1,5 @@
+#include <version.h>
+
 #include "d3d9_fixed_function.h"
 
 #include "d3d9_device.h"
@@ -5,6 +7,7 @@
 #include "d3d9_spec_constants.h"
 
 #include "../dxvk/dxvk_hash.h"
+#include "../dxvk/dxvk_shader_cache.h"
 #include "../dxvk/dxvk_shader_spirv.h"
 
 #include "../util/util_small_vector.h"
@@ -816,7 +819,7 @@ namespace dxvk {
       const std::string&             Name,
             D3D9FixedFunctionOptions Options);
 
-    Rc<DxvkShader> compile();
+    Rc<DxvkSpirvShader> compile();
 
     DxsoIsgn isgn() { return m_isgn; }
 
@@ -923,7 +926,7 @@ namespace dxvk {
   , m_options     ( Options ) { }
 
 
-  Rc<DxvkShader> D3D9FFShaderCompiler::compile() {
+  Rc<DxvkSpirvShader> D3D9FFShaderCompiler::compile() {
     m_floatType  = m_module.defFloatType(32);
     m_uint32Type = m_module.defIntType(32, 0);
     m_vec4Type   = m_module.defVectorType(m_floatType, 4);
@@ -2701,12 +2704,7 @@ namespace dxvk {
 
     std::string name = str::format("FF_", shaderKey.toString());
 
-    D3D9FFShaderCompiler compiler(
-      pDevice->GetDXVKDevice(),
-      Key, name,
-      pDevice->GetOptions());
-
-    m_shader = compiler.compile();
+    m_shader = LoadOrCompile(pDevice, Key, name);
 
     Dump(pDevice, Key, name);
 
@@ -2722,12 +2720,7 @@ namespace dxvk {
 
     std::string name = str::format("FF_", shaderKey.toString());
 
-    D3D9FFShaderCompiler compiler(
-      pDevice->GetDXVKDevice(),
-      Key, name,
-      pDevice->GetOptions());
-
-    m_shader = compiler.compile();
+    m_shader = LoadOrCompile(pDevice, Key, name);
 
     Dump(pDevice, Key, name);
 
@@ -2883,6 +2876,31 @@ namespace dxvk {
   }
 
 
+  template <typename T>
+  Rc<DxvkShader> D3D9FFShader::LoadOrCompile(D3D9DeviceEx* pDevice, const T& Key, const std::string& Name) {
+    D3D9FixedFunctionOptions options(pDevice->GetOptions());
+    Sha1Hash cacheKey;
+
+    if (pDevice->HasShaderCache()) {
+      cacheKey = D3D9ShaderCache::GetFixedFunctionKey(Key, options);
+
+      if (Rc<DxvkShader> shader = pDevice->LookupCachedShader(cacheKey, nullptr))
+        return shader;
+    }
+
+    D3D9FFShaderCompiler compiler(
+      pDevice->GetDXVKDevice(),
+      Key, Name, options);
+
+    Rc<DxvkSpirvShader> shader = compiler.compile();
+
+    if (pDevice->HasShaderCache())
+      pDevice->AddCachedShader(cacheKey, shader, nullptr);
+
+    return shader;
+  }
+
+
   template <typename T>
   void D3D9FFShader::Dump(D3D9DeviceEx* pDevice, const T& Key, const std::string& Name) {
     const std::string& dumpPath = pDevice->GetOptions()->shaderDumpPath;
@@ -2897,6 +2915,24 @@ namespace dxvk {
   }
 
 
+  struct D3D9FFShaderKeyFileHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t vsKeySize;
+    uint32_t fsKeySize;
+  };
+
+  static const D3D9FFShaderKeyFileHeader g_ffKeyFileHeader = {
+    { 'D', '9', 'F', 'F' }, 2u,
+    uint32_t(sizeof(D3D9FFShaderKeyVS)),
+    uint32_t(sizeof(D3D9FFShaderKeyFS)),
+  };
+
+  // Key layouts may change without changing their size,
+  // so keys are only valid for the exact same version.
+  static const char* g_ffKeyFileVersion = DXVK_VERSION;
+
+
   D3D9FFShaderModuleSet::D3D9FFShaderModuleSet(D3D9DeviceEx* pDevice)
     : m_vsUbershader(pDevice, DxsoProgramType::VertexShader)
     , m_fsUbershader(pDevice, DxsoProgramType::PixelShader) {}
@@ -2936,6 +2972,259 @@ namespace dxvk {
   }
 
 
+  Rc<DxvkShader> D3D9FFShaderModuleSet::GetShaderModuleAsync(
+          D3D9DeviceEx*         pDevice,
+    const D3D9FFShaderKeyVS&    ShaderKey) {
+    auto entry = m_vsModules.find(ShaderKey);
+
+    if (entry == m_vsModules.end()) {
+      entry = m_vsModules.insert({ ShaderKey, D3D9FFShader(pDevice, ShaderKey) }).first;
+
+      if (m_vsKnownKeys.insert(ShaderKey).second)
+        WriteShaderKey(DxsoProgramType::VertexShader, ShaderKey);
+    }
+
+    return SelectShader(pDevice, DxsoProgramType::VertexShader, entry->second, m_vsPending);
+  }
+
+
+  Rc<DxvkShader> D3D9FFShaderModuleSet::GetShaderModuleAsync(
+          D3D9DeviceEx*         pDevice,
+    const D3D9FFShaderKeyFS&    ShaderKey) {
+    auto entry = m_fsModules.find(ShaderKey);
+
+    if (entry == m_fsModules.end()) {
+      entry = m_fsModules.insert({ ShaderKey, D3D9FFShader(pDevice, ShaderKey) }).first;
+
+      if (m_fsKnownKeys.insert(ShaderKey).second)
+        WriteShaderKey(DxsoProgramType::PixelShader, ShaderKey);
+    }
+
+    return SelectShader(pDevice, DxsoProgramType::PixelShader, entry->second, m_fsPending);
+  }
+
+
+  Rc<DxvkShader> D3D9FFShaderModuleSet::GetReadyShader(DxsoProgramType ProgramType) {
+    Rc<DxvkShader>& pending = ProgramType == DxsoProgramType::VertexShader
+      ? m_vsPending
+      : m_fsPending;
+
+    if (pending == nullptr || !pending->isLibraryReady())
+      return nullptr;
+
+    m_pendingMask.fetch_and(~(1u << uint32_t(ProgramType)), std::memory_order_relaxed);
+    return std::exchange(pending, nullptr);
+  }
+
+
+  void D3D9FFShaderModuleSet::LoadShaderKeys(D3D9DeviceEx* pDevice) {
+    if (env::getEnvVar("DXVK_STATE_CACHE") == "0")
+      return;
+
+    auto paths = DxvkShaderCache::getDefaultFilePaths();
+
+    if (paths.directory.empty() || paths.baseName.empty())
+      return;
+
+    std::string path = paths.directory + env::PlatformDirSlash + paths.baseName + ".d3d9ff";
+
+    if (m_keyFile.open(path, util::FileFlags(
+          util::FileFlag::AllowRead,
+          util::FileFlag::AllowWrite,
+          util::FileFlag::Exclusive))
+     && ReadShaderKeys()) {
+      Logger::info(str::format("Found fixed function shader key file: ", path));
+      return;
+    }
+
+    auto flags = util::FileFlags(
+      util::FileFlag::AllowWrite,
+      util::FileFlag::Truncate,
+      util::FileFlag::Exclusive);
+
+    if (!m_keyFile.open(path, flags)) {
+      if (!env::createDirectory(paths.directory) || !m_keyFile.open(path, flags)) {
+        Logger::warn(str::format("Failed to create fixed function shader key file: ", path));
+        m_keyFile = util::File();
+        return;
+      }
+    }
+
+    uint16_t versionLength = uint16_t(std::strlen(g_ffKeyFileVersion));
+
+    if (!m_keyFile.append(sizeof(g_ffKeyFileHeader), &g_ffKeyFileHeader)
+     || !m_keyFile.append(sizeof(versionLength), &versionLength)
+     || !m_keyFile.append(versionLength, g_ffKeyFileVersion)) {
+      Logger::warn(str::format("Failed to write fixed function shader key file: ", path));
+      m_keyFile = util::File();
+      return;
+    }
+
+    // Keep any keys that were successfully read from a damaged file
+    for (const auto& key : m_vsKnownKeys)
+      WriteShaderKey(DxsoProgramType::VertexShader, key);
+
+    for (const auto& key : m_fsKnownKeys)
+      WriteShaderKey(DxsoProgramType::PixelShader, key);
+
+    Logger::info(str::format("Created fixed function shader key file: ", path));
+  }
+
+
+  void D3D9FFShaderModuleSet::CreateQueuedShaders(
+          D3D9DeviceEx*         pDevice,
+          uint32_t              MaxCount) {
+    while (MaxCount && !m_vsKeyQueue.empty()) {
+      D3D9FFShaderKeyVS key = m_vsKeyQueue.back();
+      m_vsKeyQueue.pop_back();
+
+      if (m_vsModules.find(key) == m_vsModules.end()) {
+        m_vsModules.insert({ key, D3D9FFShader(pDevice, key) });
+        MaxCount -= 1;
+      }
+    }
+
+    while (MaxCount && !m_fsKeyQueue.empty()) {
+      D3D9FFShaderKeyFS key = m_fsKeyQueue.back();
+      m_fsKeyQueue.pop_back();
+
+      if (m_fsModules.find(key) == m_fsModules.end()) {
+        m_fsModules.insert({ key, D3D9FFShader(pDevice, key) });
+        MaxCount -= 1;
+      }
+    }
+  }
+
+
+  Rc<DxvkShader> D3D9FFShaderModuleSet::SelectShader(
+          D3D9DeviceEx*         pDevice,
+          DxsoProgramType       ProgramType,
+    const D3D9FFShader&         Shader,
+          Rc<DxvkShader>&       Pending) {
+    Rc<DxvkShader> shader = Shader.GetShader();
+    uint32_t stageBit = 1u << uint32_t(ProgramType);
+
+    if (shader->isLibraryReady()) {
+      Pending = nullptr;
+      m_pendingMask.fetch_and(~stageBit, std::memory_order_relaxed);
+      return shader;
+    }
+
+    // Raise the priority of the pipeline library since the
+    // application is actively using the shader at this point.
+    pDevice->GetDXVKDevice()->requestCompileShader(shader);
+
+    Pending = std::move(shader);
+    m_pendingMask.fetch_or(stageBit, std::memory_order_relaxed);
+
+    return ProgramType == DxsoProgramType::VertexShader
+      ? m_vsUbershader.GetShader()
+      : m_fsUbershader.GetShader();
+  }
+
+
+  template <typename T>
+  void D3D9FFShaderModuleSet::WriteShaderKey(
+          DxsoProgramType       ProgramType,
+    const T&                    ShaderKey) {
+    if (!m_keyFile)
+      return;
+
+    uint32_t programType = uint32_t(ProgramType);
+
+    if (!m_keyFile.append(sizeof(programType), &programType)
+     || !m_keyFile.append(sizeof(ShaderKey), &ShaderKey)) {
+      Logger::warn("Failed to write fixed function shader key.");
+      m_keyFile = util::File();
+    }
+  }
+
+
+  bool D3D9FFShaderModuleSet::ReadShaderKeys() {
+    D3D9FFShaderKeyFileHeader header = { };
+    uint16_t versionLength = 0u;
+
+    size_t size = m_keyFile.size();
+    size_t offset = 0u;
+
+    if (!m_keyFile.read(offset, sizeof(header), &header)
+     || std::memcmp(&header, &g_ffKeyFileHeader, sizeof(header))
+     || !m_keyFile.read(offset + sizeof(header), sizeof(versionLength), &versionLength)) {
+      Logger::warn("Invalid fixed function shader key file header. Discarding old keys.");
+      return false;
+    }
+
+    offset += sizeof(header) + sizeof(versionLength);
+
+    std::string version(versionLength, '\0');
+
+    if (!m_keyFile.read(offset, versionLength, version.data())
+     || version != g_ffKeyFileVersion) {
+      Logger::warn("Fixed function shader key file was created with a different DXVK version. Discarding old keys.");
+      return false;
+    }
+
+    offset += versionLength;
+
+    uint32_t vsCount = 0u;
+    uint32_t fsCount = 0u;
+
+    while (offset < size) {
+      uint32_t programType = 0u;
+
+      if (!m_keyFile.read(offset, sizeof(programType), &programType))
+        break;
+
+      offset += sizeof(programType);
+
+      if (programType == uint32_t(DxsoProgramType::VertexShader)) {
+        D3D9FFShaderKeyVS key;
+
+        if (!m_keyFile.read(offset, sizeof(key), &key))
+          break;
+
+        offset += sizeof(key);
+
+        if (m_vsKnownKeys.insert(key).second) {
+          m_vsKeyQueue.push_back(key);
+          vsCount += 1;
+        }
+      } else if (programType == uint32_t(DxsoProgramType::PixelShader)) {
+        D3D9FFShaderKeyFS key;
+
+        if (!m_keyFile.read(offset, sizeof(key), &key))
+          break;
+
+        offset += sizeof(key);
+
+        if (m_fsKnownKeys.insert(key).second) {
+          m_fsKeyQueue.push_back(key);
+          fsCount += 1;
+        }
+      } else {
+        break;
+      }
+    }
+
+    Logger::info(str::format("Read ", vsCount, " vertex and ", fsCount, " fragment fixed function shader keys"));
+
+    // Shaders are created from the back of the queue, but keys
+    // recorded early on are most likely to be needed soon.
+    std::reverse(m_vsKeyQueue.begin(), m_vsKeyQueue.end());
+    std::reverse(m_fsKeyQueue.begin(), m_fsKeyQueue.end());
+
+    // Keys are appended one at a time, so anything that could not
+    // be parsed is most likely a truncated entry at the end of the
+    // file. Rewrite the file with the keys that we could read.
+    if (offset < size) {
+      Logger::warn("Failed to parse fixed function shader key file. Rewriting.");
+      return false;
+    }
+
+    return true;
+  }
+
+
   size_t D3D9FFShaderKeyHash::operator () (const D3D9FFShaderKeyVS& key) const {
     DxvkHashState state;
 
@@ -10,7 +10,12 @@
 
 #include "../dxso/dxso_isgn.h"
 
+#include "../util/util_file.h"
+
+#include <atomic>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 #include <unordered_map>
 
 namespace dxvk {
@@ -155,6 +160,9 @@ namespace dxvk {
 
     Rc<DxvkShader> m_shader;
 
+    template <typename T>
+    static Rc<DxvkShader> LoadOrCompile(D3D9DeviceEx* pDevice, const T& Key, const std::string& Name);
+
   };
 
 
@@ -174,6 +182,79 @@ namespace dxvk {
             D3D9DeviceEx*         pDevice,
       const D3D9FFShaderKeyFS&    ShaderKey);
 
+    /**
+     * \brief Looks up specialized shader without stalling
+     *
+     * Creates the specialized shader for the given key if necessary
+     * and requests compilation of its pipeline library on the pipeline
+     * workers. If the pipeline library is not ready yet, the shader is
+     * remembered as pending and the uber shader is returned instead.
+     * New keys are written to the shader key file.
+     * \param [in] pDevice The device
+     * \param [in] ShaderKey Fixed function shader key
+     * \returns Specialized shader if ready, uber shader otherwise
+     */
+    Rc<DxvkShader> GetShaderModuleAsync(
+            D3D9DeviceEx*         pDevice,
+      const D3D9FFShaderKeyVS&    ShaderKey);
+
+    Rc<DxvkShader> GetShaderModuleAsync(
+            D3D9DeviceEx*         pDevice,
+      const D3D9FFShaderKeyFS&    ShaderKey);
+
+    /**
+     * \brief Checks whether a specialized shader is pending
+     *
+     * May be called from any thread. The result may be out of date,
+     * but a pending shader will eventually be reported as such.
+     * \param [in] ProgramType Shader stage
+     * \returns \c true if a pending shader exists for the stage
+     */
+    bool HasPendingShader(DxsoProgramType ProgramType) const {
+      return m_pendingMask.load(std::memory_order_relaxed) & (1u << uint32_t(ProgramType));
+    }
+
+    /**
+     * \brief Retrieves pending shader once it is ready
+     *
+     * \param [in] ProgramType Shader stage
+     * \returns The specialized shader for the most recently looked
+     *    up key if its pipeline library is now ready, or \c nullptr.
+     */
+    Rc<DxvkShader> GetReadyShader(DxsoProgramType ProgramType);
+
+    /**
+     * \brief Loads shader keys from disk
+     *
+     * Opens the shader key file and queues all keys recorded in
+     * previous runs. No shaders are created here, this is done by
+     * \ref CreateQueuedShaders. Subsequent calls to
+     * \ref GetShaderModuleAsync will append new keys to the file.
+     * \param [in] pDevice The device
+     */
+    void LoadShaderKeys(D3D9DeviceEx* pDevice);
+
+    /**
+     * \brief Creates shaders for queued keys
+     *
+     * Creates specialized shaders for a limited number of keys
+     * from previous runs, so that their pipeline libraries get
+     * compiled in the background without stalling a single frame.
+     * \param [in] pDevice The device
+     * \param [in] MaxCount Maximum number of shaders to create
+     */
+    void CreateQueuedShaders(
+            D3D9DeviceEx*         pDevice,
+            uint32_t              MaxCount);
+
+    /**
+     * \brief Checks whether any keys are queued
+     * \returns \c true if \ref CreateQueuedShaders has work to do
+     */
+    bool HasQueuedShaderKeys() const {
+      return !m_vsKeyQueue.empty() || !m_fsKeyQueue.empty();
+    }
+
     const D3D9FFShader& GetVSUbershaderModule() const {
       return m_vsUbershader;
     }
@@ -205,6 +286,37 @@ namespace dxvk {
     D3D9FFShader m_vsUbershader;
     D3D9FFShader m_fsUbershader;
 
+    Rc<DxvkShader> m_vsPending;
+    Rc<DxvkShader> m_fsPending;
+
+    std::atomic<uint32_t> m_pendingMask = { 0u };
+
+    util::File m_keyFile;
+
+    std::unordered_set<
+      D3D9FFShaderKeyVS,
+      D3D9FFShaderKeyHash, D3D9FFShaderKeyEq> m_vsKnownKeys;
+
+    std::unordered_set<
+      D3D9FFShaderKeyFS,
+      D3D9FFShaderKeyHash, D3D9FFShaderKeyEq> m_fsKnownKeys;
+
+    std::vector<D3D9FFShaderKeyVS> m_vsKeyQueue;
+    std::vector<D3D9FFShaderKeyFS> m_fsKeyQueue;
+
+    Rc<DxvkShader> SelectShader(
+            D3D9DeviceEx*         pDevice,
+            DxsoProgramType       ProgramType,
+      const D3D9FFShader&         Shader,
+            Rc<DxvkShader>&       Pending);
+
+    template <typename T>
+    void WriteShaderKey(
+            DxsoProgramType       ProgramType,
+      const T&                    ShaderKey);
+
+    bool ReadShaderKeys();
+
   };
 
 
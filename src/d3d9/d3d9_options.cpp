@@ -78,6 +78,8 @@ namespace dxvk {
     this->extraFrontbuffer              = config.getOption<bool>        ("d3d9.extraFrontbuffer",              false);
     this->ffUbershaderVS                = config.getOption<bool>        ("d3d9.ffUbershaderVS",                true);
     this->ffUbershaderFS                = config.getOption<bool>        ("d3d9.ffUbershaderFS",                true);
+    this->ffAsyncShaders                = config.getOption<bool>        ("d3d9.ffAsyncShaders",                false);
+    this->cpuProcessVertices            = config.getOption<bool>        ("d3d9.cpuProcessVertices",            true);
 
     // D3D8 options
     this->drefScaling                   = config.getOption<int32_t>     ("d3d8.scaleDref",                     0);
@@ -173,6 +173,15 @@ namespace dxvk {
 
     /// Use the uber shader for fixed function fragment shaders.
     bool ffUbershaderFS;
+
+    /// Compile specialized fixed function shaders in the background
+    /// and use the uber shaders until they are ready. Only has an
+    /// effect on stages that have the uber shader enabled.
+    bool ffAsyncShaders;
+
+    /// Run ProcessVertices on the CPU when the vertex
+    /// shader or fixed function state supports it.
+    bool cpuProcessVertices;
   };
 
 }
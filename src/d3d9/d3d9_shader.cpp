@@ -54,10 +54,40 @@ namespace dxvk {
     const D3D9ConstantLayout& constantLayout = ShaderStage == VK_SHADER_STAGE_VERTEX_BIT
       ? pDevice->GetVertexConstantLayout()
       : pDevice->GetPixelConstantLayout();
-    m_shader       = pModule->compile(*pDxsoModuleInfo, name, AnalysisInfo, constantLayout);
-    m_isgn         = pModule->isgn();
-    m_usedSamplers = pModule->usedSamplers();
-    m_textureTypes = pModule->textureTypes();
+
+    // Everything the DXSO compiler produces can be loaded from
+    // the shader cache, which skips running the compiler entirely.
+    D3D9ShaderCacheMetadata metadata;
+    Sha1Hash cacheKey;
+
+    if (pDevice->HasShaderCache()) {
+      cacheKey = D3D9ShaderCache::GetDxsoKey(ShaderStage,
+        pShaderBytecode, bytecodeLength, *pDxsoModuleInfo, constantLayout);
+      m_shader = pDevice->LookupCachedShader(cacheKey, &metadata);
+    }
+
+    if (m_shader == nullptr) {
+      Rc<DxvkSpirvShader> shader = pModule->compile(*pDxsoModuleInfo, name, AnalysisInfo, constantLayout);
+
+      metadata.isgn                 = pModule->isgn();
+      metadata.usedSamplers         = pModule->usedSamplers();
+      metadata.usedRTs              = pModule->usedRTs();
+      metadata.textureTypes         = pModule->textureTypes();
+      metadata.meta                 = pModule->meta();
+      metadata.constants            = pModule->constants();
+      metadata.maxDefinedFloatConst = pModule->maxDefinedFloatConstant();
+      metadata.maxDefinedIntConst   = pModule->maxDefinedIntConstant();
+      metadata.maxDefinedBoolConst  = pModule->maxDefinedBoolConstant();
+
+      if (pDevice->HasShaderCache())
+        pDevice->AddCachedShader(cacheKey, shader, &metadata);
+
+      m_shader = std::move(shader);
+    }
+
+    m_isgn         = metadata.isgn;
+    m_usedSamplers = metadata.usedSamplers;
+    m_textureTypes = metadata.textureTypes;
 
     // Shift up these sampler bits so we can just
     // do an or per-draw in the device.
@@ -65,14 +95,14 @@ namespace dxvk {
     if (ShaderStage == VK_SHADER_STAGE_VERTEX_BIT)
       m_usedSamplers <<= FirstVSSamplerSlot;
 
-    m_usedRTs              = pModule->usedRTs();
+    m_usedRTs              = metadata.usedRTs;
 
     m_info                 = pModule->info();
-    m_meta                 = pModule->meta();
-    m_constants            = pModule->constants();
-    m_maxDefinedFloatConst = pModule->maxDefinedFloatConstant();
-    m_maxDefinedIntConst   = pModule->maxDefinedIntConstant();
-    m_maxDefinedBoolConst  = pModule->maxDefinedBoolConstant();
+    m_meta                 = metadata.meta;
+    m_constants            = std::move(metadata.constants);
+    m_maxDefinedFloatConst = metadata.maxDefinedFloatConst;
+    m_maxDefinedIntConst   = metadata.maxDefinedIntConst;
+    m_maxDefinedBoolConst  = metadata.maxDefinedBoolConst;
 
     if (dumpPath.size() != 0) {
       std::ofstream dumpStream(
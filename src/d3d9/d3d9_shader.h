@@ -6,10 +6,12 @@
 #include "../dxvk/dxvk_shader_key.h"
 
 #include "d3d9_resource.h"
+#include "d3d9_swvp_cpu.h"
 #include "d3d9_util.h"
 #include "d3d9_mem.h"
 
 #include <array>
+#include <memory>
 
 namespace dxvk {
 
@@ -177,6 +179,31 @@ namespace dxvk {
             uint32_t             BytecodeLength)
       : D3D9Shader<IDirect3DVertexShader9>( pDevice, pAllocator, CommonShader, pShaderBytecode, BytecodeLength ) { }
 
+    /**
+     * \brief Retrieves program for CPU vertex processing
+     *
+     * The program is created on first use.
+     * \returns Program, or \c nullptr if the shader
+     *    cannot be executed on the CPU
+     */
+    const D3D9SWVPCpuProgram* GetCpuProgram() {
+      if (unlikely(m_cpuProgram == nullptr)) {
+        UINT size = 0;
+        GetFunction(nullptr, &size);
+
+        std::vector<uint32_t> bytecode(align(size, sizeof(uint32_t)) / sizeof(uint32_t));
+        GetFunction(bytecode.data(), &size);
+
+        m_cpuProgram = std::make_unique<D3D9SWVPCpuProgram>(bytecode.data());
+      }
+
+      return m_cpuProgram->IsSupported() ? m_cpuProgram.get() : nullptr;
+    }
+
+  private:
+
+    std::unique_ptr<D3D9SWVPCpuProgram> m_cpuProgram;
+
   };
 
   class D3D9PixelShader final : public D3D9Shader<IDirect3DPixelShader9> {
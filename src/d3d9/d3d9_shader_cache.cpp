@@ -0,0 +1,609 @@
+#include <version.h>
+
+#include "d3d9_shader_cache.h"
+
+#include "../dxvk/dxvk_shader_cache.h"
+
+#include "../util/util_compress.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Cache file format revision
+   *
+   * Appended to the version string stored in the file header. Must
+   * be bumped whenever the layout of cache entries changes, or when
+   * any compiler input is added to or removed from the cache keys.
+   */
+  constexpr uint32_t D3D9ShaderCacheRevision = 1u;
+
+  constexpr std::array<char, 4u> D3D9ShaderCacheMagic = { 'D', '9', 'S', 'C' };
+
+  enum class D3D9ShaderCacheKeyType : uint32_t {
+    Dxso            = 0u,
+    FixedFunctionVS = 1u,
+    FixedFunctionFS = 2u,
+    Swvp            = 3u,
+  };
+
+  enum D3D9ShaderCacheEntryFlag : uint32_t {
+    D3D9ShaderCacheEntryHasMetadata = 1u << 0,
+  };
+
+
+  template<typename T>
+  static void WriteData(std::vector<uint8_t>& Data, const T* pValues, size_t Count) {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    size_t offset = Data.size();
+    Data.resize(offset + sizeof(T) * Count);
+
+    if (Count)
+      std::memcpy(&Data[offset], pValues, sizeof(T) * Count);
+  }
+
+
+  template<typename T>
+  static void WriteData(std::vector<uint8_t>& Data, const T& Value) {
+    WriteData(Data, &Value, 1u);
+  }
+
+
+  template<typename T>
+  static bool ReadData(const std::vector<uint8_t>& Data, size_t& Offset, T* pValues, size_t Count) {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    if (Count > (Data.size() - Offset) / sizeof(T))
+      return false;
+
+    if (Count)
+      std::memcpy(pValues, &Data[Offset], sizeof(T) * Count);
+
+    Offset += sizeof(T) * Count;
+    return true;
+  }
+
+
+  template<typename T>
+  static bool ReadData(const std::vector<uint8_t>& Data, size_t& Offset, T& Value) {
+    return ReadData(Data, Offset, &Value, 1u);
+  }
+
+
+  D3D9ShaderCache::Instance D3D9ShaderCache::s_instance;
+
+  D3D9ShaderCache::D3D9ShaderCache()
+  : m_compress(env::getEnvVar("DXVK_SHADER_CACHE_COMPRESS") != "0") {
+    auto paths = DxvkShaderCache::getDefaultFilePaths();
+
+    if (paths.directory.empty() || paths.baseName.empty())
+      return;
+
+    std::string path = paths.directory + env::PlatformDirSlash + paths.baseName + ".d3d9spv";
+
+    if (Open(path)) {
+      Logger::info(str::format("Found D3D9 shader cache file: ", path));
+      return;
+    }
+
+    m_index.clear();
+
+    if (Create(paths.directory, path)) {
+      Logger::info(str::format("Created D3D9 shader cache file: ", path));
+      return;
+    }
+
+    Logger::warn(str::format("Failed to create D3D9 shader cache file: ", path));
+    m_file = util::File();
+  }
+
+
+  D3D9ShaderCache::~D3D9ShaderCache() {
+    if (m_writer.joinable()) {
+      { std::lock_guard lock(m_writeMutex);
+        m_stopped = true;
+        m_writeCond.notify_one();
+      }
+
+      m_writer.join();
+    }
+  }
+
+
+  Rc<DxvkShader> D3D9ShaderCache::LookupShader(
+    const Sha1Hash&                 Key,
+          D3D9ShaderCacheMetadata*  pMetadata) {
+    auto entry = m_index.find(Key);
+
+    if (entry == m_index.end()) {
+      if (Logger::logLevel() <= LogLevel::Debug)
+        Logger::debug(str::format("D3D9 shader cache miss: ", Key.toString()));
+
+      return nullptr;
+    }
+
+    std::vector<uint8_t> data;
+    Rc<DxvkShader> shader;
+
+    if (ReadEntry(entry->second, data))
+      shader = DeserializeShader(data, pMetadata);
+
+    if (!shader) {
+      // The key gets written again once the caller has compiled the
+      // shader, and the most recent entry for any key takes precedence.
+      Logger::warn(str::format("Failed to load cached D3D9 shader ", Key.toString()));
+      return nullptr;
+    }
+
+    if (Logger::logLevel() <= LogLevel::Debug) {
+      Logger::debug(str::format("D3D9 shader cache hit: ", Key.toString(),
+        " (size: ", entry->second.header.binarySize,
+        ", stored: ", entry->second.header.StoredSize(), ")"));
+    }
+
+    return shader;
+  }
+
+
+  void D3D9ShaderCache::AddShader(
+    const Sha1Hash&                 Key,
+    const Rc<DxvkSpirvShader>&      Shader,
+    const D3D9ShaderCacheMetadata*  pMetadata) {
+    if (!m_file)
+      return;
+
+    WriteEntry entry;
+    entry.key = Key;
+
+    { std::lock_guard lock(m_writeMutex);
+
+      if (m_stopped || !m_writeKeys.insert(Key).second)
+        return;
+    }
+
+    // Serialize outside the lock, compression and
+    // file I/O will happen on the writer thread.
+    SerializeShader(entry.data, Shader, pMetadata);
+
+    std::lock_guard lock(m_writeMutex);
+    m_writeQueue.push(std::move(entry));
+    m_writeCond.notify_one();
+
+    if (!m_writer.joinable())
+      m_writer = dxvk::thread([this] { RunWriter(); });
+  }
+
+
+  Sha1Hash D3D9ShaderCache::GetDxsoKey(
+          VkShaderStageFlagBits     ShaderStage,
+    const void*                     pBytecode,
+          size_t                    BytecodeLength,
+    const DxsoModuleInfo&           ModuleInfo,
+    const D3D9ConstantLayout&       Layout) {
+    const DxsoOptions& options = ModuleInfo.options;
+
+    // Hash options member by member since the struct has padding
+    std::array<uint32_t, 15u> inputs = {
+      uint32_t(D3D9ShaderCacheKeyType::Dxso),
+      uint32_t(ShaderStage),
+      uint32_t(options.strictConstantCopies),
+      uint32_t(options.d3d9FloatEmulation),
+      uint32_t(options.strictPow),
+      uint32_t(options.invariantPosition),
+      uint32_t(options.forceSamplerTypeSpecConstants),
+      uint32_t(options.forceSampleRateShading),
+      uint32_t(options.vertexFloatConstantBufferAsSSBO),
+      uint32_t(options.robustness2Supported),
+      uint32_t(options.sincosEmulation),
+      Layout.floatCount,
+      Layout.intCount,
+      Layout.boolCount,
+      Layout.bitmaskCount,
+    };
+
+    std::array<Sha1Data, 2u> chunks = {{
+      { inputs.data(), inputs.size() * sizeof(uint32_t) },
+      { pBytecode, BytecodeLength },
+    }};
+
+    return Sha1Hash::compute(chunks.size(), chunks.data());
+  }
+
+
+  Sha1Hash D3D9ShaderCache::GetFixedFunctionKey(
+    const D3D9FFShaderKeyVS&        ShaderKey,
+    const D3D9FixedFunctionOptions& Options) {
+    std::array<uint32_t, 3u> inputs = {
+      uint32_t(D3D9ShaderCacheKeyType::FixedFunctionVS),
+      uint32_t(Options.invariantPosition),
+      uint32_t(Options.forceSampleRateShading),
+    };
+
+    std::array<Sha1Data, 2u> chunks = {{
+      { inputs.data(), inputs.size() * sizeof(uint32_t) },
+      { &ShaderKey, sizeof(ShaderKey) },
+    }};
+
+    return Sha1Hash::compute(chunks.size(), chunks.data());
+  }
+
+
+  Sha1Hash D3D9ShaderCache::GetFixedFunctionKey(
+    const D3D9FFShaderKeyFS&        ShaderKey,
+    const D3D9FixedFunctionOptions& Options) {
+    std::array<uint32_t, 3u> inputs = {
+      uint32_t(D3D9ShaderCacheKeyType::FixedFunctionFS),
+      uint32_t(Options.invariantPosition),
+      uint32_t(Options.forceSampleRateShading),
+    };
+
+    std::array<Sha1Data, 2u> chunks = {{
+      { inputs.data(), inputs.size() * sizeof(uint32_t) },
+      { &ShaderKey, sizeof(ShaderKey) },
+    }};
+
+    return Sha1Hash::compute(chunks.size(), chunks.data());
+  }
+
+
+  Sha1Hash D3D9ShaderCache::GetSwvpKey(
+    const D3D9CompactVertexElements& Elements) {
+    uint32_t type = uint32_t(D3D9ShaderCacheKeyType::Swvp);
+
+    std::array<Sha1Data, 2u> chunks = {{
+      { &type, sizeof(type) },
+      { Elements.data(), Elements.size() * sizeof(Elements[0]) },
+    }};
+
+    return Sha1Hash::compute(chunks.size(), chunks.data());
+  }
+
+
+  Rc<D3D9ShaderCache> D3D9ShaderCache::GetInstance() {
+    std::lock_guard lock(s_instance.mutex);
+
+    if (!s_instance.instance)
+      s_instance.instance = new D3D9ShaderCache();
+
+    return s_instance.instance;
+  }
+
+
+  bool D3D9ShaderCache::Open(const std::string& Path) {
+    auto flags = util::FileFlags(
+      util::FileFlag::AllowRead,
+      util::FileFlag::AllowWrite,
+      util::FileFlag::Exclusive,
+      util::FileFlag::MapRead);
+
+    if (!m_file.open(Path, flags))
+      return false;
+
+    return ParseFile();
+  }
+
+
+  bool D3D9ShaderCache::Create(const std::string& Directory, const std::string& Path) {
+    auto flags = util::FileFlags(
+      util::FileFlag::AllowWrite,
+      util::FileFlag::Truncate,
+      util::FileFlag::Exclusive);
+
+    if (!m_file.open(Path, flags)) {
+      if (!env::createDirectory(Directory) || !m_file.open(Path, flags))
+        return false;
+    }
+
+    std::string version = GetVersionString();
+    uint16_t versionLength = uint16_t(version.size());
+
+    return m_file.append(D3D9ShaderCacheMagic.size(), D3D9ShaderCacheMagic.data())
+        && m_file.append(sizeof(versionLength), &versionLength)
+        && m_file.append(versionLength, version.data());
+  }
+
+
+  bool D3D9ShaderCache::ParseFile() {
+    std::array<char, 4u> magic = { };
+    uint16_t versionLength = 0u;
+
+    size_t size = m_file.size();
+    size_t offset = 0u;
+
+    if (!m_file.read(offset, magic.size(), magic.data())
+     || !m_file.read(offset + magic.size(), sizeof(versionLength), &versionLength)
+     || magic != D3D9ShaderCacheMagic) {
+      Logger::warn("Invalid D3D9 shader cache file header.");
+      return false;
+    }
+
+    offset += magic.size() + sizeof(versionLength);
+
+    std::string version(versionLength, '\0');
+
+    if (!m_file.read(offset, versionLength, version.data())) {
+      Logger::warn("Invalid D3D9 shader cache file header.");
+      return false;
+    }
+
+    offset += versionLength;
+
+    if (version != GetVersionString()) {
+      Logger::warn(str::format("D3D9 shader cache was created with DXVK version ", version,
+        ", but current version is ", GetVersionString(), ". Discarding old cache."));
+      return false;
+    }
+
+    // Only read entry headers here. If the same key was written more
+    // than once, e.g. after a corrupted entry, the last one wins.
+    while (offset < size) {
+      IndexEntry entry;
+
+      if (!m_file.read(offset, sizeof(entry.header), &entry.header))
+        break;
+
+      entry.offset = offset + sizeof(entry.header);
+
+      if (entry.offset + entry.header.StoredSize() > size)
+        break;
+
+      offset = entry.offset + entry.header.StoredSize();
+      m_index.insert_or_assign(entry.header.key, entry);
+    }
+
+    // Entries are appended one at a time, so an incomplete entry can
+    // only be at the end of the file, most likely because the process
+    // was killed while writing it. Keep all complete entries and cut
+    // off the rest so that new entries get appended after them.
+    if (offset < size) {
+      Logger::warn(str::format("D3D9 shader cache file has an incomplete entry at offset ",
+        offset, ", keeping ", m_index.size(), " entries."));
+
+      if (!m_file.truncate(offset)) {
+        Logger::warn("Failed to truncate D3D9 shader cache file.");
+        return false;
+      }
+
+      size = offset;
+    }
+
+    if (!m_file.getMappedData(0u, size))
+      Logger::warn("Failed to map D3D9 shader cache, falling back to file I/O.");
+
+    return true;
+  }
+
+
+  bool D3D9ShaderCache::ReadEntry(
+    const IndexEntry&               Entry,
+          std::vector<uint8_t>&     Data) {
+    uint32_t storedSize = Entry.header.StoredSize();
+
+    // File reads are positional and safe to perform without
+    // locking, even while the writer thread appends new entries.
+    const uint8_t* stored = reinterpret_cast<const uint8_t*>(
+      m_file.getMappedData(Entry.offset, storedSize));
+
+    std::vector<uint8_t> storage;
+
+    if (!stored) {
+      storage.resize(storedSize);
+
+      if (!m_file.read(Entry.offset, storedSize, storage.data()))
+        return false;
+
+      stored = storage.data();
+    }
+
+    if (Entry.header.checksum != bit::fnv1a_hash(stored, storedSize))
+      return false;
+
+    if (!Entry.header.compressedSize) {
+      Data.assign(stored, stored + storedSize);
+      return true;
+    }
+
+    Data.resize(Entry.header.binarySize);
+    return util::decompressBlock(stored, storedSize, Data.data(), Data.size());
+  }
+
+
+  bool D3D9ShaderCache::WriteEntry(
+    const WriteEntry&               Entry) {
+    EntryHeader header;
+    header.key = Entry.key;
+    header.binarySize = uint32_t(Entry.data.size());
+
+    const uint8_t* stored = Entry.data.data();
+
+    // Only keep the compressed data if it is actually smaller
+    std::vector<uint8_t> compressed;
+
+    if (m_compress) {
+      util::compressBlock(Entry.data.data(), Entry.data.size(), compressed);
+
+      if (compressed.size() < Entry.data.size()) {
+        stored = compressed.data();
+        header.compressedSize = uint32_t(compressed.size());
+      }
+    }
+
+    header.checksum = bit::fnv1a_hash(stored, header.StoredSize());
+
+    return m_file.append(sizeof(header), &header)
+        && m_file.append(header.StoredSize(), stored);
+  }
+
+
+  void D3D9ShaderCache::RunWriter() {
+    env::setThreadName("dxvk-d3d9-cache");
+
+    std::queue<WriteEntry> localQueue;
+    bool stop = false;
+
+    while (!stop) {
+      std::unique_lock lock(m_writeMutex);
+
+      m_writeCond.wait(lock, [this] {
+        return m_stopped || !m_writeQueue.empty();
+      });
+
+      std::swap(localQueue, m_writeQueue);
+      stop = m_stopped;
+
+      lock.unlock();
+
+      if (localQueue.empty())
+        continue;
+
+      while (!localQueue.empty()) {
+        if (!WriteEntry(localQueue.front())) {
+          Logger::err("Failed to write D3D9 shader cache file.");
+
+          // Stop accepting new shaders since nothing would write them
+          lock.lock();
+          m_stopped = true;
+          m_writeQueue = std::queue<WriteEntry>();
+          return;
+        }
+
+        localQueue.pop();
+      }
+
+      m_file.flush();
+    }
+  }
+
+
+  void D3D9ShaderCache::FreeInstance() {
+    std::lock_guard lock(s_instance.mutex);
+
+    // Another thread may have revived the
+    // object while we were waiting for the lock
+    if (m_useCount.load(std::memory_order_relaxed))
+      return;
+
+    if (s_instance.instance == this)
+      s_instance.instance = nullptr;
+
+    delete this;
+  }
+
+
+  void D3D9ShaderCache::SerializeShader(
+          std::vector<uint8_t>&     Data,
+    const Rc<DxvkSpirvShader>&      Shader,
+    const D3D9ShaderCacheMetadata*  pMetadata) {
+    DxvkSpirvShaderCreateInfo info = Shader->getShaderCreateInfo();
+    SpirvCodeBuffer code = Shader->getRawCode();
+
+    uint32_t flags = pMetadata ? D3D9ShaderCacheEntryHasMetadata : 0u;
+    WriteData(Data, flags);
+
+    WriteData(Data, info.bindingCount);
+    WriteData(Data, info.bindings, info.bindingCount);
+    WriteData(Data, info.flatShadingInputs);
+    WriteData(Data, info.sharedPushData);
+    WriteData(Data, info.localPushData);
+    WriteData(Data, info.samplerHeap);
+    WriteData(Data, info.xfbRasterizedStream);
+    WriteData(Data, info.patchVertexCount);
+    WriteData(Data, uint32_t(info.debugName.size()));
+    WriteData(Data, info.debugName.data(), info.debugName.size());
+
+    if (pMetadata) {
+      WriteData(Data, pMetadata->isgn);
+      WriteData(Data, pMetadata->usedSamplers);
+      WriteData(Data, pMetadata->usedRTs);
+      WriteData(Data, pMetadata->textureTypes);
+      WriteData(Data, pMetadata->meta);
+      WriteData(Data, pMetadata->maxDefinedFloatConst);
+      WriteData(Data, pMetadata->maxDefinedIntConst);
+      WriteData(Data, pMetadata->maxDefinedBoolConst);
+      WriteData(Data, uint32_t(pMetadata->constants.size()));
+      WriteData(Data, pMetadata->constants.data(), pMetadata->constants.size());
+    }
+
+    WriteData(Data, code.dwords());
+    WriteData(Data, code.data(), code.dwords());
+  }
+
+
+  Rc<DxvkShader> D3D9ShaderCache::DeserializeShader(
+    const std::vector<uint8_t>&     Data,
+          D3D9ShaderCacheMetadata*  pMetadata) {
+    size_t offset = 0u;
+    uint32_t flags = 0u;
+
+    if (!ReadData(Data, offset, flags)
+     || bool(flags & D3D9ShaderCacheEntryHasMetadata) != bool(pMetadata))
+      return nullptr;
+
+    DxvkSpirvShaderCreateInfo info;
+    std::vector<DxvkBindingInfo> bindings;
+    uint32_t debugNameLength = 0u;
+
+    if (!ReadData(Data, offset, info.bindingCount)
+     || info.bindingCount > (Data.size() - offset) / sizeof(DxvkBindingInfo))
+      return nullptr;
+
+    bindings.resize(info.bindingCount);
+
+    if (!ReadData(Data, offset, bindings.data(), info.bindingCount)
+     || !ReadData(Data, offset, info.flatShadingInputs)
+     || !ReadData(Data, offset, info.sharedPushData)
+     || !ReadData(Data, offset, info.localPushData)
+     || !ReadData(Data, offset, info.samplerHeap)
+     || !ReadData(Data, offset, info.xfbRasterizedStream)
+     || !ReadData(Data, offset, info.patchVertexCount)
+     || !ReadData(Data, offset, debugNameLength)
+     || debugNameLength > Data.size() - offset)
+      return nullptr;
+
+    info.bindings = bindings.data();
+    info.debugName.resize(debugNameLength);
+
+    if (!ReadData(Data, offset, info.debugName.data(), debugNameLength))
+      return nullptr;
+
+    if (pMetadata) {
+      uint32_t constantCount = 0u;
+
+      if (!ReadData(Data, offset, pMetadata->isgn)
+       || !ReadData(Data, offset, pMetadata->usedSamplers)
+       || !ReadData(Data, offset, pMetadata->usedRTs)
+       || !ReadData(Data, offset, pMetadata->textureTypes)
+       || !ReadData(Data, offset, pMetadata->meta)
+       || !ReadData(Data, offset, pMetadata->maxDefinedFloatConst)
+       || !ReadData(Data, offset, pMetadata->maxDefinedIntConst)
+       || !ReadData(Data, offset, pMetadata->maxDefinedBoolConst)
+       || !ReadData(Data, offset, constantCount)
+       || constantCount > (Data.size() - offset) / sizeof(DxsoDefinedConstant))
+        return nullptr;
+
+      pMetadata->constants.resize(constantCount);
+
+      if (!ReadData(Data, offset, pMetadata->constants.data(), constantCount))
+        return nullptr;
+    }
+
+    uint32_t dwordCount = 0u;
+
+    if (!ReadData(Data, offset, dwordCount)
+     || dwordCount > (Data.size() - offset) / sizeof(uint32_t))
+      return nullptr;
+
+    std::vector<uint32_t> code(dwordCount);
+
+    if (!ReadData(Data, offset, code.data(), dwordCount) || offset != Data.size())
+      return nullptr;
+
+    return new DxvkSpirvShader(info, SpirvCodeBuffer(std::move(code)));
+  }
+
+
+  std::string D3D9ShaderCache::GetVersionString() {
+    return str::format(DXVK_VERSION, " (rev ", D3D9ShaderCacheRevision, ")");
+  }
+
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <array>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../dxvk/dxvk_shader_spirv.h"
+
+#include "../dxso/dxso_isgn.h"
+#include "../dxso/dxso_modinfo.h"
+
+#include "../util/sha1/sha1_util.h"
+#include "../util/thread.h"
+#include "../util/util_file.h"
+
+#include "d3d9_constant_layout.h"
+#include "d3d9_fixed_function.h"
+#include "d3d9_swvp_emu.h"
+
+namespace dxvk {
+
+  /**
+   * \brief D3D9 metadata for cached DXSO shaders
+   *
+   * Everything \c D3D9CommonShader takes from the DXSO
+   * compiler, other than the shader object itself.
+   */
+  struct D3D9ShaderCacheMetadata {
+    DxsoIsgn              isgn;
+    uint32_t              usedSamplers          = 0u;
+    uint32_t              usedRTs               = 0u;
+    uint32_t              textureTypes          = 0u;
+    DxsoShaderMetaInfo    meta;
+    int32_t               maxDefinedFloatConst  = -1;
+    int32_t               maxDefinedIntConst    = -1;
+    int32_t               maxDefinedBoolConst   = -1;
+    DxsoDefinedConstants  constants;
+  };
+
+
+  /**
+   * \brief D3D9 shader cache
+   *
+   * On-disk cache for SPIR-V shaders generated by the DXSO compiler,
+   * the fixed function shader generator and the SWVP emulator, which
+   * do not go through the IR-based shader cache of the backend.
+   *
+   * Cache entries are keyed by a SHA-1 hash of all compiler inputs
+   * and are appended to a single file. Only entry headers are read
+   * on startup, so look-ups do not need to lock. The stored data is
+   * compressed and contains the SPIR-V code, the shader create info
+   * and, for DXSO shaders, the metadata the D3D9 frontend needs.
+   */
+  class D3D9ShaderCache {
+
+  public:
+
+    ~D3D9ShaderCache();
+
+    void incRef() {
+      m_useCount.fetch_add(1u, std::memory_order_acquire);
+    }
+
+    void decRef() {
+      if (m_useCount.fetch_sub(1u, std::memory_order_release) == 1u)
+        FreeInstance();
+    }
+
+    /**
+     * \brief Looks up shader
+     *
+     * \param [in] Key Cache key
+     * \param [out] pMetadata DXSO shader metadata. Must be
+     *    \c nullptr for fixed function and SWVP shaders.
+     * \returns Shader object, or \c nullptr if no valid
+     *    cache entry exists for the given key.
+     */
+    Rc<DxvkShader> LookupShader(
+      const Sha1Hash&                 Key,
+            D3D9ShaderCacheMetadata*  pMetadata);
+
+    /**
+     * \brief Adds shader to the cache
+     *
+     * The shader is written to the cache file asynchronously.
+     * \param [in] Key Cache key
+     * \param [in] Shader Shader object
+     * \param [in] pMetadata DXSO shader metadata, if any
+     */
+    void AddShader(
+      const Sha1Hash&                 Key,
+      const Rc<DxvkSpirvShader>&      Shader,
+      const D3D9ShaderCacheMetadata*  pMetadata);
+
+    /**
+     * \brief Computes cache key for a DXSO shader
+     *
+     * \param [in] ShaderStage Shader stage
+     * \param [in] pBytecode Shader bytecode
+     * \param [in] BytecodeLength Bytecode size, in bytes
+     * \param [in] ModuleInfo Compiler options
+     * \param [in] Layout Constant layout
+     * \returns Cache key
+     */
+    static Sha1Hash GetDxsoKey(
+            VkShaderStageFlagBits     ShaderStage,
+      const void*                     pBytecode,
+            size_t                    BytecodeLength,
+      const DxsoModuleInfo&           ModuleInfo,
+      const D3D9ConstantLayout&       Layout);
+
+    /**
+     * \brief Computes cache key for a fixed function shader
+     *
+     * \param [in] ShaderKey Fixed function shader key
+     * \param [in] Options Fixed function compiler options
+     * \returns Cache key
+     */
+    static Sha1Hash GetFixedFunctionKey(
+      const D3D9FFShaderKeyVS&        ShaderKey,
+      const D3D9FixedFunctionOptions& Options);
+
+    static Sha1Hash GetFixedFunctionKey(
+      const D3D9FFShaderKeyFS&        ShaderKey,
+      const D3D9FixedFunctionOptions& Options);
+
+    /**
+     * \brief Computes cache key for a SWVP emulation shader
+     *
+     * \param [in] Elements Compacted vertex declaration
+     * \returns Cache key
+     */
+    static Sha1Hash GetSwvpKey(
+      const D3D9CompactVertexElements& Elements);
+
+    /**
+     * \brief Retrieves shader cache
+     *
+     * Opens the cache file on first use. If the file cannot be
+     * opened, look-ups will fail and new shaders are discarded.
+     * \returns Shader cache instance
+     */
+    static Rc<D3D9ShaderCache> GetInstance();
+
+  private:
+
+    struct Instance {
+      dxvk::mutex       mutex;
+      D3D9ShaderCache*  instance = nullptr;
+    };
+
+    static Instance s_instance;
+
+    struct EntryHeader {
+      Sha1Hash  key;
+      uint32_t  binarySize      = 0u;
+      uint32_t  compressedSize  = 0u;
+      uint32_t  reserved        = 0u;
+      uint64_t  checksum        = 0u;
+
+      uint32_t StoredSize() const {
+        return compressedSize ? compressedSize : binarySize;
+      }
+    };
+
+    struct IndexEntry {
+      uint64_t    offset = 0u;
+      EntryHeader header;
+    };
+
+    struct WriteEntry {
+      Sha1Hash              key;
+      std::vector<uint8_t>  data;
+    };
+
+    struct KeyHash {
+      size_t operator () (const Sha1Hash& key) const {
+        return key.dword(0);
+      }
+    };
+
+    std::atomic<uint32_t>   m_useCount = { 0u };
+
+    util::File              m_file;
+    bool                    m_compress = true;
+
+    std::unordered_map<Sha1Hash, IndexEntry, KeyHash> m_index;
+
+    dxvk::mutex             m_writeMutex;
+    dxvk::condition_variable m_writeCond;
+    std::queue<WriteEntry>  m_writeQueue;
+    std::unordered_set<Sha1Hash, KeyHash> m_writeKeys;
+    bool                    m_stopped = false;
+
+    dxvk::thread            m_writer;
+
+    D3D9ShaderCache();
+
+    bool Open(const std::string& Path);
+
+    bool Create(const std::string& Directory, const std::string& Path);
+
+    bool ParseFile();
+
+    bool ReadEntry(
+      const IndexEntry&               Entry,
+            std::vector<uint8_t>&     Data);
+
+    bool WriteEntry(
+      const WriteEntry&               Entry);
+
+    void RunWriter();
+
+    void FreeInstance();
+
+    static void SerializeShader(
+            std::vector<uint8_t>&     Data,
+      const Rc<DxvkSpirvShader>&      Shader,
+      const D3D9ShaderCacheMetadata*  pMetadata);
+
+    static Rc<DxvkShader> DeserializeShader(
+      const std::vector<uint8_t>&     Data,
+            D3D9ShaderCacheMetadata*  pMetadata);
+
+    static std::string GetVersionString();
+
+  };
+
+}
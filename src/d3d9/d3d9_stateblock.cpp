@@ -71,6 +71,11 @@ namespace dxvk {
     if (m_captures.flags.test(D3D9CapturedStateFlag::VertexDecl) && m_state.vertexDecl != nullptr)
       m_parent->SetVertexDeclaration(m_state.vertexDecl.ptr());
 
+    // Capture masks only change while the state block is being
+    // recorded or created, so the program never needs rebuilding.
+    if (unlikely(!m_programCompiled))
+      CompileProgram();
+
     ApplyOrCapture<D3D9StateFunction::Apply, false>();
 
     return D3D_OK;
@@ -594,4 +599,53 @@ namespace dxvk {
     }
   }
 
+
+  template <size_t Bits>
+  static void CompileConstantRanges(
+          bit::bitset<Bits>&                            Mask,
+          std::vector<D3D9StateProgram::ConstantRange>& Ranges) {
+    for (uint32_t i = 0; i < Mask.dwordCount(); i++) {
+      for (uint32_t reg : bit::BitMask(Mask.dword(i))) {
+        uint32_t idx = i * 32 + reg;
+
+        if (!Ranges.empty() && uint32_t(Ranges.back().start + Ranges.back().count) == idx)
+          Ranges.back().count += 1u;
+        else
+          Ranges.push_back({ uint16_t(idx), uint16_t(1u) });
+      }
+    }
+  }
+
+
+  void D3D9StateBlock::CompileProgram() {
+    m_program = D3D9StateProgram();
+
+    for (uint32_t i = 0; i < m_captures.renderStates.dwordCount(); i++) {
+      for (uint32_t rs : bit::BitMask(m_captures.renderStates.dword(i)))
+        m_program.renderStates.push_back(uint16_t(i * 32 + rs));
+    }
+
+    for (uint32_t samplerIdx : bit::BitMask(m_captures.samplers.dword(0))) {
+      for (uint32_t stateIdx : bit::BitMask(m_captures.samplerStates[samplerIdx].dword(0)))
+        m_program.samplerStates.push_back({ uint8_t(samplerIdx), uint8_t(stateIdx) });
+    }
+
+    for (uint32_t i = 0; i < m_captures.transforms.dwordCount(); i++) {
+      for (uint32_t trans : bit::BitMask(m_captures.transforms.dword(i)))
+        m_program.transforms.push_back(uint16_t(i * 32 + trans));
+    }
+
+    for (uint32_t stageIdx : bit::BitMask(m_captures.textureStages.dword(0))) {
+      for (uint32_t stateIdx : bit::BitMask(m_captures.textureStageStates[stageIdx].dword(0)))
+        m_program.textureStageStates.push_back({ uint8_t(stageIdx), uint8_t(stateIdx) });
+    }
+
+    CompileConstantRanges(m_captures.vsConsts.fConsts, m_program.vsConsts.fConsts);
+    CompileConstantRanges(m_captures.vsConsts.iConsts, m_program.vsConsts.iConsts);
+    CompileConstantRanges(m_captures.psConsts.fConsts, m_program.psConsts.fConsts);
+    CompileConstantRanges(m_captures.psConsts.iConsts, m_program.psConsts.iConsts);
+
+    m_programCompiled = true;
+  }
+
 }
@@ -66,6 +66,42 @@ namespace dxvk {
     bit::bitvector                                      lightEnabledChanges;
   };
 
+  /**
+   * \brief Compiled state block program
+   *
+   * Flat lists of the captured render states, sampler states,
+   * transforms and texture stage states, as well as contiguous
+   * ranges of captured float and integer constants. Built from
+   * the capture masks so that applying a state block does not
+   * need to scan the full bit masks every time.
+   */
+  struct D3D9StateProgram {
+    struct StageState {
+      uint8_t stage;
+      uint8_t type;
+    };
+
+    struct ConstantRange {
+      uint16_t start;
+      uint16_t count;
+    };
+
+    std::vector<uint16_t>                               renderStates;
+    std::vector<StageState>                             samplerStates;
+    std::vector<uint16_t>                               transforms;
+    std::vector<StageState>                             textureStageStates;
+
+    struct {
+      std::vector<ConstantRange>                        fConsts;
+      std::vector<ConstantRange>                        iConsts;
+    } vsConsts;
+
+    struct {
+      std::vector<ConstantRange>                        fConsts;
+      std::vector<ConstantRange>                        iConsts;
+    } psConsts;
+  };
+
   enum class D3D9StateBlockType : uint8_t {
     None,
     All,
@@ -196,19 +232,35 @@ namespace dxvk {
         dst->SetIndices(src->indices.ptr());
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::RenderStates)) {
-        for (uint32_t i = 0; i < m_captures.renderStates.dwordCount(); i++) {
-          for (uint32_t rs : bit::BitMask(m_captures.renderStates.dword(i))) {
-            uint32_t idx = i * 32 + rs;
+        if constexpr (std::is_same_v<Dst, D3D9DeviceEx>) {
+          for (uint32_t idx : m_program.renderStates) {
+            if (src->renderStates[idx] != m_deviceState->renderStates[idx])
+              dst->SetRenderState(D3DRENDERSTATETYPE(idx), src->renderStates[idx]);
+          }
+        } else {
+          for (uint32_t i = 0; i < m_captures.renderStates.dwordCount(); i++) {
+            for (uint32_t rs : bit::BitMask(m_captures.renderStates.dword(i))) {
+              uint32_t idx = i * 32 + rs;
 
-            dst->SetRenderState(D3DRENDERSTATETYPE(idx), src->renderStates[idx]);
+              dst->SetRenderState(D3DRENDERSTATETYPE(idx), src->renderStates[idx]);
+            }
           }
         }
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::SamplerStates)) {
-        for (uint32_t samplerIdx : bit::BitMask(m_captures.samplers.dword(0))) {
-          for (uint32_t stateIdx : bit::BitMask(m_captures.samplerStates[samplerIdx].dword(0)))
-            dst->SetStateSamplerState(samplerIdx, D3DSAMPLERSTATETYPE(stateIdx), src->samplerStates[samplerIdx][stateIdx]);
+        if constexpr (std::is_same_v<Dst, D3D9DeviceEx>) {
+          for (auto state : m_program.samplerStates) {
+            DWORD value = src->samplerStates[state.stage][state.type];
+
+            if (value != m_deviceState->samplerStates[state.stage][state.type])
+              dst->SetStateSamplerState(state.stage, D3DSAMPLERSTATETYPE(state.type), value);
+          }
+        } else {
+          for (uint32_t samplerIdx : bit::BitMask(m_captures.samplers.dword(0))) {
+            for (uint32_t stateIdx : bit::BitMask(m_captures.samplerStates[samplerIdx].dword(0)))
+              dst->SetStateSamplerState(samplerIdx, D3DSAMPLERSTATETYPE(stateIdx), src->samplerStates[samplerIdx][stateIdx]);
+          }
         }
       }
 
@@ -246,19 +298,39 @@ namespace dxvk {
         dst->SetPixelShader(src->pixelShader.ptr());
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::Transforms)) {
-        for (uint32_t i = 0; i < m_captures.transforms.dwordCount(); i++) {
-          for (uint32_t trans : bit::BitMask(m_captures.transforms.dword(i))) {
-            uint32_t idx = i * 32 + trans;
+        if constexpr (std::is_same_v<Dst, D3D9DeviceEx>) {
+          // The device does not check transforms for redundancy
+          // and would invalidate fixed function state every time
+          for (uint32_t idx : m_program.transforms) {
+            const Matrix4& matrix = src->transforms[idx];
+
+            if (std::memcmp(&matrix, &m_deviceState->transforms[idx], sizeof(matrix)))
+              dst->SetStateTransform(idx, reinterpret_cast<const D3DMATRIX*>(&matrix));
+          }
+        } else {
+          for (uint32_t i = 0; i < m_captures.transforms.dwordCount(); i++) {
+            for (uint32_t trans : bit::BitMask(m_captures.transforms.dword(i))) {
+              uint32_t idx = i * 32 + trans;
 
-            dst->SetStateTransform(idx, reinterpret_cast<const D3DMATRIX*>(&src->transforms[idx]));
+              dst->SetStateTransform(idx, reinterpret_cast<const D3DMATRIX*>(&src->transforms[idx]));
+            }
           }
         }
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::TextureStages)) {
-        for (uint32_t stageIdx : bit::BitMask(m_captures.textureStages.dword(0))) {
-          for (uint32_t stateIdx : bit::BitMask(m_captures.textureStageStates[stageIdx].dword(0)))
-            dst->SetStateTextureStageState(stageIdx, D3D9TextureStageStateTypes(stateIdx), src->textureStages[stageIdx][stateIdx]);
+        if constexpr (std::is_same_v<Dst, D3D9DeviceEx>) {
+          for (auto state : m_program.textureStageStates) {
+            DWORD value = src->textureStages[state.stage][state.type];
+
+            if (value != m_deviceState->textureStages[state.stage][state.type])
+              dst->SetStateTextureStageState(state.stage, D3D9TextureStageStateTypes(state.type), value);
+          }
+        } else {
+          for (uint32_t stageIdx : bit::BitMask(m_captures.textureStages.dword(0))) {
+            for (uint32_t stateIdx : bit::BitMask(m_captures.textureStageStates[stageIdx].dword(0)))
+              dst->SetStateTextureStageState(stageIdx, D3D9TextureStageStateTypes(stateIdx), src->textureStages[stageIdx][stateIdx]);
+          }
         }
       }
 
@@ -274,19 +346,29 @@ namespace dxvk {
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::VsConstants)) {
-        for (uint32_t i = 0; i < m_captures.vsConsts.fConsts.dwordCount(); i++) {
-          for (uint32_t consts : bit::BitMask(m_captures.vsConsts.fConsts.dword(i))) {
-            uint32_t idx = i * 32 + consts;
-
-            dst->SetVertexShaderConstantF(idx, reinterpret_cast<const float*>(&src->vsConsts->fConsts[idx]), 1);
+        if constexpr (std::is_same_v<Dst, D3D9DeviceEx>) {
+          // Upload contiguous ranges with one call each, the device
+          // trims unchanged registers at either end of the range
+          for (auto range : m_program.vsConsts.fConsts)
+            dst->SetVertexShaderConstantF(range.start, reinterpret_cast<const float*>(&src->vsConsts->fConsts[range.start]), range.count);
+
+          for (auto range : m_program.vsConsts.iConsts)
+            dst->SetVertexShaderConstantI(range.start, reinterpret_cast<const int*>(&src->vsConsts->iConsts[range.start]), range.count);
+        } else {
+          for (uint32_t i = 0; i < m_captures.vsConsts.fConsts.dwordCount(); i++) {
+            for (uint32_t consts : bit::BitMask(m_captures.vsConsts.fConsts.dword(i))) {
+              uint32_t idx = i * 32 + consts;
+
+              dst->SetVertexShaderConstantF(idx, reinterpret_cast<const float*>(&src->vsConsts->fConsts[idx]), 1);
+            }
           }
-        }
 
-        for (uint32_t i = 0; i < m_captures.vsConsts.iConsts.dwordCount(); i++) {
-          for (uint32_t consts : bit::BitMask(m_captures.vsConsts.iConsts.dword(i))) {
-            uint32_t idx = i * 32 + consts;
+          for (uint32_t i = 0; i < m_captures.vsConsts.iConsts.dwordCount(); i++) {
+            for (uint32_t consts : bit::BitMask(m_captures.vsConsts.iConsts.dword(i))) {
+              uint32_t idx = i * 32 + consts;
 
-            dst->SetVertexShaderConstantI(idx, reinterpret_cast<const int*>(&src->vsConsts->iConsts[idx]), 1);
+              dst->SetVertexShaderConstantI(idx, reinterpret_cast<const int*>(&src->vsConsts->iConsts[idx]), 1);
+            }
           }
         }
 
@@ -297,19 +379,29 @@ namespace dxvk {
       }
 
       if (m_captures.flags.test(D3D9CapturedStateFlag::PsConstants)) {
-        for (uint32_t i = 0; i < m_captures.psConsts.fConsts.dwordCount(); i++) {
-          for (uint32_t consts : bit::BitMask(m_captures.psConsts.fConsts.dword(i))) {
-            uint32_t idx = i * 32 + consts;
-
-            dst->SetPixelShaderConstantF(idx, reinterpret_cast<const float*>(&src->psConsts->fConsts[idx]), 1);
+        if constexpr (std::is_same_v<Dst, D3D9DeviceEx>) {
+          // Upload contiguous ranges with one call each, the device
+          // trims unchanged registers at either end of the range
+          for (auto range : m_program.psConsts.fConsts)
+            dst->SetPixelShaderConstantF(range.start, reinterpret_cast<const float*>(&src->psConsts->fConsts[range.start]), range.count);
+
+          for (auto range : m_program.psConsts.iConsts)
+            dst->SetPixelShaderConstantI(range.start, reinterpret_cast<const int*>(&src->psConsts->iConsts[range.start]), range.count);
+        } else {
+          for (uint32_t i = 0; i < m_captures.psConsts.fConsts.dwordCount(); i++) {
+            for (uint32_t consts : bit::BitMask(m_captures.psConsts.fConsts.dword(i))) {
+              uint32_t idx = i * 32 + consts;
+
+              dst->SetPixelShaderConstantF(idx, reinterpret_cast<const float*>(&src->psConsts->fConsts[idx]), 1);
+            }
           }
-        }
 
-        for (uint32_t i = 0; i < m_captures.psConsts.iConsts.dwordCount(); i++) {
-          for (uint32_t consts : bit::BitMask(m_captures.psConsts.iConsts.dword(i))) {
-            uint32_t idx = i * 32 + consts;
+          for (uint32_t i = 0; i < m_captures.psConsts.iConsts.dwordCount(); i++) {
+            for (uint32_t consts : bit::BitMask(m_captures.psConsts.iConsts.dword(i))) {
+              uint32_t idx = i * 32 + consts;
 
-            dst->SetPixelShaderConstantI(idx, reinterpret_cast<const int*>(&src->psConsts->iConsts[idx]), 1);
+              dst->SetPixelShaderConstantI(idx, reinterpret_cast<const int*>(&src->psConsts->iConsts[idx]), 1);
+            }
           }
         }
 
@@ -401,9 +493,14 @@ namespace dxvk {
 
     void CaptureType(D3D9StateBlockType State);
 
+    void CompileProgram();
+
     D3D9CapturableState  m_state;
     D3D9StateCaptures    m_captures;
 
+    D3D9StateProgram     m_program;
+    bool                 m_programCompiled = false;
+
     D3D9DeviceState*     m_deviceState;
 
   };
@@ -0,0 +1,1947 @@
+#include "d3d9_swvp_cpu.h"
+#include "d3d9_state.h"
+#include "d3d9_util.h"
+
+#include "../dxso/dxso_code.h"
+#include "../dxso/dxso_header.h"
+#include "../dxso/dxso_reader.h"
+
+#include "../util/util_env.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace dxvk {
+
+  constexpr float D3D9SWVPCpuFloatMax = std::numeric_limits<float>::max();
+
+  /**
+   * \brief Control flow stack entry
+   *
+   * Tracks which lanes are active when entering
+   * an \c if or \c loop block, so that the masks
+   * can be restored when leaving the block.
+   */
+  struct D3D9SWVPCpuControlFrame {
+    uint32_t  savedMask;
+    uint32_t  condMask;
+    uint32_t  savedBreak;
+    int32_t   counter;
+    int32_t   savedLoop;
+    int32_t   stride;
+  };
+
+
+  /**
+   * \brief Execution state for one batch of vertices
+   *
+   * Divergent control flow is handled by masking lanes:
+   * only lanes whose bit is set in the execution mask
+   * are written by an instruction.
+   */
+  struct D3D9SWVPCpuExecState {
+    const D3D9SWVPCpuProgram*   program   = nullptr;
+    const D3D9SWVPCpuConstants* consts    = nullptr;
+
+    uint32_t                    laneMask  = 0u;
+    uint32_t                    execMask  = 0u;
+    uint32_t                    breakMask = 0u;
+    uint32_t                    depth     = 0u;
+    int32_t                     aL        = 0;
+
+    uint32_t                    p[4];
+    int32_t                     a[4][D3D9SWVPCpuLaneCount];
+
+    D3D9SWVPCpuRegister         r[DxsoMaxTempRegs];
+    D3D9SWVPCpuRegister         v[DxsoMaxInterfaceRegs];
+    D3D9SWVPCpuRegister         o[DxsoMaxInterfaceRegs];
+    D3D9SWVPCpuRegister         s[3];
+    D3D9SWVPCpuRegister         t;
+
+    std::array<D3D9SWVPCpuControlFrame, D3D9SWVPCpuMaxNesting> frames;
+  };
+
+
+  template<typename Fn>
+  static void ComputeRegister(D3D9SWVPCpuRegister& dst, Fn fn) {
+    for (uint32_t i = 0; i < 4; i++) {
+      for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++)
+        dst.c[i][l] = fn(i, l);
+    }
+  }
+
+
+  static void BroadcastRegister(D3D9SWVPCpuRegister& dst, const Vector4& value) {
+    for (uint32_t i = 0; i < 4; i++) {
+      for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++)
+        dst.c[i][l] = value[i];
+    }
+  }
+
+
+  static Vector4 LoadLane(const D3D9SWVPCpuRegister& reg, uint32_t lane) {
+    return Vector4(reg.c[0][lane], reg.c[1][lane], reg.c[2][lane], reg.c[3][lane]);
+  }
+
+
+  static void StoreLane(D3D9SWVPCpuRegister& reg, uint32_t lane, const Vector4& value) {
+    for (uint32_t i = 0; i < 4; i++)
+      reg.c[i][lane] = value[i];
+  }
+
+
+  static float Saturate(float x) {
+    // fmin and fmax return the non-NaN operand, so
+    // this also flushes NaN to zero like the GPU.
+    return std::fmin(std::fmax(x, 0.0f), 1.0f);
+  }
+
+
+  static bool Compare(DxsoComparison comparison, float a, float b) {
+    switch (comparison) {
+      case DxsoComparison::GreaterThan:  return a >  b;
+      case DxsoComparison::Equal:        return a == b;
+      case DxsoComparison::GreaterEqual: return a >= b;
+      case DxsoComparison::LessThan:     return a <  b;
+      case DxsoComparison::NotEqual:     return a != b;
+      case DxsoComparison::LessEqual:    return a <= b;
+      case DxsoComparison::Always:       return true;
+      default:                           return false;
+    }
+  }
+
+
+  static uint32_t GetLaneMask(const D3D9SWVPCpuRegister& reg) {
+    uint32_t mask = 0u;
+
+    for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++)
+      mask |= (reg.c[0][l] != 0.0f ? 1u : 0u) << l;
+
+    return mask;
+  }
+
+
+  static uint32_t GetPredicateMask(
+    const D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuOperand&     pred,
+          uint32_t                component) {
+    uint32_t mask = state.p[pred.swizzle[component]];
+
+    return pred.modifier == DxsoRegModifier::Not ? ~mask : mask;
+  }
+
+
+  static void ApplyModifier(
+          DxsoRegModifier         modifier,
+          D3D9SWVPCpuRegister&    reg) {
+    switch (modifier) {
+      case DxsoRegModifier::None:
+        return;
+
+      case DxsoRegModifier::Neg:
+        ComputeRegister(reg, [&] (uint32_t i, uint32_t l) { return -reg.c[i][l]; });
+        return;
+
+      case DxsoRegModifier::Bias:
+        ComputeRegister(reg, [&] (uint32_t i, uint32_t l) { return reg.c[i][l] - 0.5f; });
+        return;
+
+      case DxsoRegModifier::BiasNeg:
+        ComputeRegister(reg, [&] (uint32_t i, uint32_t l) { return 0.5f - reg.c[i][l]; });
+        return;
+
+      case DxsoRegModifier::Sign:
+        ComputeRegister(reg, [&] (uint32_t i, uint32_t l) { return reg.c[i][l] * 2.0f - 1.0f; });
+        return;
+
+      case DxsoRegModifier::SignNeg:
+        ComputeRegister(reg, [&] (uint32_t i, uint32_t l) { return 1.0f - reg.c[i][l] * 2.0f; });
+        return;
+
+      case DxsoRegModifier::Comp:
+        ComputeRegister(reg, [&] (uint32_t i, uint32_t l) { return 1.0f - reg.c[i][l]; });
+        return;
+
+      case DxsoRegModifier::X2:
+        ComputeRegister(reg, [&] (uint32_t i, uint32_t l) { return reg.c[i][l] * 2.0f; });
+        return;
+
+      case DxsoRegModifier::X2Neg:
+        ComputeRegister(reg, [&] (uint32_t i, uint32_t l) { return reg.c[i][l] * -2.0f; });
+        return;
+
+      case DxsoRegModifier::Dz:
+      case DxsoRegModifier::Dw: {
+        float divisor[D3D9SWVPCpuLaneCount];
+        std::memcpy(divisor, reg.c[modifier == DxsoRegModifier::Dz ? 2 : 3], sizeof(divisor));
+        ComputeRegister(reg, [&] (uint32_t i, uint32_t l) { return reg.c[i][l] / divisor[l]; });
+      } return;
+
+      case DxsoRegModifier::Abs:
+        ComputeRegister(reg, [&] (uint32_t i, uint32_t l) { return std::fabs(reg.c[i][l]); });
+        return;
+
+      case DxsoRegModifier::AbsNeg:
+        ComputeRegister(reg, [&] (uint32_t i, uint32_t l) { return -std::fabs(reg.c[i][l]); });
+        return;
+
+      case DxsoRegModifier::Not:
+        ComputeRegister(reg, [&] (uint32_t i, uint32_t l) { return reg.c[i][l] != 0.0f ? 0.0f : 1.0f; });
+        return;
+    }
+  }
+
+
+  static void LoadOperand(
+          D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuOperand&     op,
+          D3D9SWVPCpuRegister&    dst) {
+    D3D9SWVPCpuRegister raw;
+    const D3D9SWVPCpuRegister* src = &raw;
+
+    switch (op.file) {
+      case D3D9SWVPCpuRegisterFile::Temp:
+        src = &state.r[op.index];
+        break;
+
+      case D3D9SWVPCpuRegisterFile::Input:
+      case D3D9SWVPCpuRegisterFile::Output: {
+        uint32_t index = op.index + uint32_t(op.relative ? state.aL : 0);
+
+        if (index < DxsoMaxInterfaceRegs) {
+          src = op.file == D3D9SWVPCpuRegisterFile::Input
+            ? &state.v[index]
+            : &state.o[index];
+        } else {
+          BroadcastRegister(raw, Vector4(0.0f));
+        }
+      } break;
+
+      case D3D9SWVPCpuRegisterFile::Const: {
+        if (!op.relative || op.relativeFile == D3D9SWVPCpuRegisterFile::Loop) {
+          int32_t index = int32_t(op.index) + (op.relative ? state.aL : 0);
+          BroadcastRegister(raw, state.program->GetFloatConst(*state.consts, index));
+        } else {
+          // The address register may differ between lanes
+          for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++) {
+            int32_t index = int32_t(op.index) + state.a[op.relativeComponent][l];
+            StoreLane(raw, l, state.program->GetFloatConst(*state.consts, index));
+          }
+        }
+      } break;
+
+      case D3D9SWVPCpuRegisterFile::ConstInt: {
+        Vector4i value = state.program->GetIntConst(*state.consts, op.index);
+        BroadcastRegister(raw, Vector4(float(value.x), float(value.y), float(value.z), float(value.w)));
+      } break;
+
+      case D3D9SWVPCpuRegisterFile::ConstBool: {
+        bool value = state.program->GetBoolConst(*state.consts, op.index);
+        BroadcastRegister(raw, Vector4(value ? 1.0f : 0.0f));
+      } break;
+
+      case D3D9SWVPCpuRegisterFile::Addr:
+        ComputeRegister(raw, [&] (uint32_t i, uint32_t l) { return float(state.a[i][l]); });
+        break;
+
+      case D3D9SWVPCpuRegisterFile::Loop:
+        BroadcastRegister(raw, Vector4(float(state.aL)));
+        break;
+
+      case D3D9SWVPCpuRegisterFile::Predicate:
+        ComputeRegister(raw, [&] (uint32_t i, uint32_t l) { return float((state.p[i] >> l) & 1u); });
+        break;
+    }
+
+    for (uint32_t i = 0; i < 4; i++)
+      std::memcpy(dst.c[i], src->c[op.swizzle[i]], sizeof(dst.c[i]));
+
+    ApplyModifier(op.modifier, dst);
+  }
+
+
+  static void StoreResult(
+          D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuInstruction& ins,
+          D3D9SWVPCpuRegister&    value) {
+    const D3D9SWVPCpuDestination& dst = ins.dst;
+
+    if (dst.scale != 1.0f)
+      ComputeRegister(value, [&] (uint32_t i, uint32_t l) { return value.c[i][l] * dst.scale; });
+
+    if (dst.saturate)
+      ComputeRegister(value, [&] (uint32_t i, uint32_t l) { return Saturate(value.c[i][l]); });
+
+    D3D9SWVPCpuRegister* reg = nullptr;
+
+    switch (dst.file) {
+      case D3D9SWVPCpuRegisterFile::Temp:
+        reg = &state.r[dst.index];
+        break;
+
+      case D3D9SWVPCpuRegisterFile::Output: {
+        uint32_t index = dst.index + uint32_t(dst.relative ? state.aL : 0);
+
+        if (index >= DxsoMaxInterfaceRegs)
+          return;
+
+        reg = &state.o[index];
+      } break;
+
+      case D3D9SWVPCpuRegisterFile::Addr: {
+        // vs_1_1 rounds down, later versions round to nearest
+        bool floor = state.program->FloorAddress();
+
+        for (uint32_t i = 0; i < 4; i++) {
+          if (!(dst.mask & (1u << i)))
+            continue;
+
+          uint32_t lanes = state.execMask;
+
+          if (ins.predicated)
+            lanes &= GetPredicateMask(state, ins.pred, i);
+
+          for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++) {
+            float x = floor ? std::floor(value.c[i][l]) : std::round(value.c[i][l]);
+            x = std::fmin(std::fmax(x, -65536.0f), 65536.0f);
+
+            if (lanes & (1u << l))
+              state.a[i][l] = int32_t(x);
+          }
+        }
+      } return;
+
+      default:
+        return;
+    }
+
+    for (uint32_t i = 0; i < 4; i++) {
+      if (!(dst.mask & (1u << i)))
+        continue;
+
+      uint32_t lanes = state.execMask;
+
+      if (ins.predicated)
+        lanes &= GetPredicateMask(state, ins.pred, i);
+
+      if ((lanes & state.laneMask) == state.laneMask) {
+        std::memcpy(reg->c[i], value.c[i], sizeof(reg->c[i]));
+      } else {
+        for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++)
+          reg->c[i][l] = (lanes & (1u << l)) ? value.c[i][l] : reg->c[i][l];
+      }
+    }
+  }
+
+
+  template<DxsoOpcode Op, uint32_t SrcCount>
+  static uint32_t ExecAlu(
+          D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuInstruction& ins,
+          uint32_t                pc) {
+    for (uint32_t i = 0; i < SrcCount; i++)
+      LoadOperand(state, ins.src[i], state.s[i]);
+
+    const auto& s0 = state.s[0];
+    const auto& s1 = state.s[1];
+    const auto& s2 = state.s[2];
+    auto& d = state.t;
+
+    if constexpr (Op == DxsoOpcode::Mov || Op == DxsoOpcode::Mova) {
+      d = s0;
+    } else if constexpr (Op == DxsoOpcode::Add) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return s0.c[i][l] + s1.c[i][l]; });
+    } else if constexpr (Op == DxsoOpcode::Sub) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return s0.c[i][l] - s1.c[i][l]; });
+    } else if constexpr (Op == DxsoOpcode::Mul) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return s0.c[i][l] * s1.c[i][l]; });
+    } else if constexpr (Op == DxsoOpcode::Mad) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return s0.c[i][l] * s1.c[i][l] + s2.c[i][l]; });
+    } else if constexpr (Op == DxsoOpcode::Rcp) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return std::fmin(1.0f / s0.c[i][l], D3D9SWVPCpuFloatMax); });
+    } else if constexpr (Op == DxsoOpcode::Rsq) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return std::fmin(1.0f / std::sqrt(std::fabs(s0.c[i][l])), D3D9SWVPCpuFloatMax); });
+    } else if constexpr (Op == DxsoOpcode::Dp3 || Op == DxsoOpcode::Dp4) {
+      for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++) {
+        float dot = s0.c[0][l] * s1.c[0][l] + s0.c[1][l] * s1.c[1][l] + s0.c[2][l] * s1.c[2][l];
+
+        if constexpr (Op == DxsoOpcode::Dp4)
+          dot += s0.c[3][l] * s1.c[3][l];
+
+        for (uint32_t i = 0; i < 4; i++)
+          d.c[i][l] = dot;
+      }
+    } else if constexpr (Op == DxsoOpcode::Min) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return std::fmin(s0.c[i][l], s1.c[i][l]); });
+    } else if constexpr (Op == DxsoOpcode::Max) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return std::fmax(s0.c[i][l], s1.c[i][l]); });
+    } else if constexpr (Op == DxsoOpcode::Slt) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return s0.c[i][l] < s1.c[i][l] ? 1.0f : 0.0f; });
+    } else if constexpr (Op == DxsoOpcode::Sge) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return s0.c[i][l] >= s1.c[i][l] ? 1.0f : 0.0f; });
+    } else if constexpr (Op == DxsoOpcode::Exp) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return std::fmin(std::exp2(s0.c[i][l]), D3D9SWVPCpuFloatMax); });
+    } else if constexpr (Op == DxsoOpcode::ExpP) {
+      // Partial precision exp for vs_1_x, see DxsoCompiler
+      for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++) {
+        float x = s0.c[0][l];
+        float f = std::floor(x);
+
+        d.c[0][l] = std::fmin(std::exp2(f), D3D9SWVPCpuFloatMax);
+        d.c[1][l] = x - f;
+        d.c[2][l] = std::fmin(std::exp2(x), D3D9SWVPCpuFloatMax);
+        d.c[3][l] = 1.0f;
+      }
+    } else if constexpr (Op == DxsoOpcode::Log || Op == DxsoOpcode::LogP) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return std::fmax(std::log2(std::fabs(s0.c[i][l])), -D3D9SWVPCpuFloatMax); });
+    } else if constexpr (Op == DxsoOpcode::Lit) {
+      for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++) {
+        float x = s0.c[0][l];
+        float y = s0.c[1][l];
+        float power = std::fmin(std::fmax(s0.c[3][l], -127.9961f), 127.9961f);
+
+        d.c[0][l] = 1.0f;
+        d.c[1][l] = std::fmax(x, 0.0f);
+        d.c[2][l] = (x >= 0.0f && y >= 0.0f) ? std::pow(std::fmax(y, 0.0f), power) : 0.0f;
+        d.c[3][l] = 1.0f;
+      }
+    } else if constexpr (Op == DxsoOpcode::Dst) {
+      for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++) {
+        d.c[0][l] = 1.0f;
+        d.c[1][l] = s0.c[1][l] * s1.c[1][l];
+        d.c[2][l] = s0.c[2][l];
+        d.c[3][l] = s1.c[3][l];
+      }
+    } else if constexpr (Op == DxsoOpcode::Lrp) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return s2.c[i][l] + (s1.c[i][l] - s2.c[i][l]) * s0.c[i][l]; });
+    } else if constexpr (Op == DxsoOpcode::Frc) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return s0.c[i][l] - std::floor(s0.c[i][l]); });
+    } else if constexpr (Op == DxsoOpcode::Pow) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return std::pow(std::fabs(s0.c[i][l]), s1.c[i][l]); });
+    } else if constexpr (Op == DxsoOpcode::Crs) {
+      for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++) {
+        d.c[0][l] = s0.c[1][l] * s1.c[2][l] - s0.c[2][l] * s1.c[1][l];
+        d.c[1][l] = s0.c[2][l] * s1.c[0][l] - s0.c[0][l] * s1.c[2][l];
+        d.c[2][l] = s0.c[0][l] * s1.c[1][l] - s0.c[1][l] * s1.c[0][l];
+        d.c[3][l] = 0.0f;
+      }
+    } else if constexpr (Op == DxsoOpcode::Abs) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return std::fabs(s0.c[i][l]); });
+    } else if constexpr (Op == DxsoOpcode::Sgn) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return float(s0.c[i][l] > 0.0f) - float(s0.c[i][l] < 0.0f); });
+    } else if constexpr (Op == DxsoOpcode::Nrm) {
+      for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++) {
+        float dot = s0.c[0][l] * s0.c[0][l] + s0.c[1][l] * s0.c[1][l] + s0.c[2][l] * s0.c[2][l];
+        float rcpLength = std::fmin(1.0f / std::sqrt(dot), D3D9SWVPCpuFloatMax);
+
+        for (uint32_t i = 0; i < 4; i++)
+          d.c[i][l] = s0.c[i][l] * rcpLength;
+      }
+    } else if constexpr (Op == DxsoOpcode::SinCos) {
+      for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++) {
+        d.c[0][l] = std::cos(s0.c[0][l]);
+        d.c[1][l] = std::sin(s0.c[0][l]);
+        d.c[2][l] = 0.0f;
+        d.c[3][l] = 0.0f;
+      }
+    } else if constexpr (Op == DxsoOpcode::Cmp) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return s0.c[i][l] >= 0.0f ? s1.c[i][l] : s2.c[i][l]; });
+    } else if constexpr (Op == DxsoOpcode::Cnd) {
+      ComputeRegister(d, [&] (uint32_t i, uint32_t l) { return s0.c[i][l] > 0.5f ? s1.c[i][l] : s2.c[i][l]; });
+    } else {
+      static_assert(Op == DxsoOpcode::Nop, "Unhandled opcode");
+    }
+
+    StoreResult(state, ins, d);
+    return pc + 1;
+  }
+
+
+  template<uint32_t DotCount>
+  static uint32_t ExecMatrix(
+          D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuInstruction& ins,
+          uint32_t                pc) {
+    LoadOperand(state, ins.src[0], state.s[0]);
+
+    // The destination mask was limited to the number of
+    // rows at compile time, rows are written in order.
+    D3D9SWVPCpuOperand row = ins.src[1];
+
+    for (uint32_t i = 0; i < 4; i++) {
+      if (!(ins.dst.mask & (1u << i)))
+        continue;
+
+      LoadOperand(state, row, state.s[1]);
+
+      for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++) {
+        float dot = 0.0f;
+
+        for (uint32_t j = 0; j < DotCount; j++)
+          dot += state.s[0].c[j][l] * state.s[1].c[j][l];
+
+        state.t.c[i][l] = dot;
+      }
+
+      row.index++;
+    }
+
+    StoreResult(state, ins, state.t);
+    return pc + 1;
+  }
+
+
+  static uint32_t ExecSetP(
+          D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuInstruction& ins,
+          uint32_t                pc) {
+    LoadOperand(state, ins.src[0], state.s[0]);
+    LoadOperand(state, ins.src[1], state.s[1]);
+
+    for (uint32_t i = 0; i < 4; i++) {
+      if (!(ins.dst.mask & (1u << i)))
+        continue;
+
+      uint32_t result = 0u;
+
+      for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++)
+        result |= (Compare(ins.comparison, state.s[0].c[i][l], state.s[1].c[i][l]) ? 1u : 0u) << l;
+
+      uint32_t lanes = state.execMask;
+
+      if (ins.predicated)
+        lanes &= GetPredicateMask(state, ins.pred, i);
+
+      state.p[i] = (state.p[i] & ~lanes) | (result & lanes);
+    }
+
+    return pc + 1;
+  }
+
+
+  static uint32_t BeginIf(
+          D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuInstruction& ins,
+          uint32_t                pc,
+          uint32_t                cond) {
+    auto& frame = state.frames[state.depth++];
+    frame.savedMask = state.execMask;
+    frame.condMask = cond;
+
+    state.execMask &= cond;
+
+    // Skip the block entirely if no lane takes it
+    return state.execMask ? pc + 1 : ins.target;
+  }
+
+
+  static uint32_t ExecIf(
+          D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuInstruction& ins,
+          uint32_t                pc) {
+    LoadOperand(state, ins.src[0], state.s[0]);
+    return BeginIf(state, ins, pc, GetLaneMask(state.s[0]));
+  }
+
+
+  static uint32_t ExecIfc(
+          D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuInstruction& ins,
+          uint32_t                pc) {
+    LoadOperand(state, ins.src[0], state.s[0]);
+    LoadOperand(state, ins.src[1], state.s[1]);
+
+    uint32_t cond = 0u;
+
+    for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++)
+      cond |= (Compare(ins.comparison, state.s[0].c[0][l], state.s[1].c[0][l]) ? 1u : 0u) << l;
+
+    return BeginIf(state, ins, pc, cond);
+  }
+
+
+  static uint32_t ExecElse(
+          D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuInstruction& ins,
+          uint32_t                pc) {
+    const auto& frame = state.frames[state.depth - 1];
+    state.execMask = frame.savedMask & ~frame.condMask & ~state.breakMask;
+
+    return state.execMask ? pc + 1 : ins.target;
+  }
+
+
+  static uint32_t ExecEndIf(
+          D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuInstruction& ins,
+          uint32_t                pc) {
+    const auto& frame = state.frames[--state.depth];
+    state.execMask = frame.savedMask & ~state.breakMask;
+    return pc + 1;
+  }
+
+
+  template<bool IsLoop>
+  static uint32_t ExecLoop(
+          D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuInstruction& ins,
+          uint32_t                pc) {
+    Vector4i value = state.program->GetIntConst(*state.consts, ins.src[0].index);
+
+    // Iteration counts are limited to 255 by the spec,
+    // loop parameters are uniform across all lanes.
+    int32_t count = std::min(value.x, 255);
+
+    if (count <= 0 || !state.execMask)
+      return ins.target + 1;
+
+    auto& frame = state.frames[state.depth++];
+    frame.savedMask   = state.execMask;
+    frame.savedBreak  = state.breakMask;
+    frame.counter     = count;
+    frame.savedLoop   = state.aL;
+    frame.stride      = IsLoop ? value.z : 0;
+
+    state.breakMask = 0u;
+
+    if (IsLoop)
+      state.aL = value.y;
+
+    return pc + 1;
+  }
+
+
+  static uint32_t ExecEndLoop(
+          D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuInstruction& ins,
+          uint32_t                pc) {
+    auto& frame = state.frames[state.depth - 1];
+
+    state.aL += frame.stride;
+    state.execMask = frame.savedMask & ~state.breakMask;
+
+    if (--frame.counter > 0 && state.execMask)
+      return ins.target + 1;
+
+    state.execMask  = frame.savedMask;
+    state.breakMask = frame.savedBreak;
+    state.aL        = frame.savedLoop;
+    state.depth    -= 1;
+    return pc + 1;
+  }
+
+
+  static uint32_t ExecBreak(
+          D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuInstruction& ins,
+          uint32_t                pc) {
+    state.breakMask |= state.execMask;
+    state.execMask = 0u;
+    return pc + 1;
+  }
+
+
+  static uint32_t ExecBreakC(
+          D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuInstruction& ins,
+          uint32_t                pc) {
+    LoadOperand(state, ins.src[0], state.s[0]);
+    LoadOperand(state, ins.src[1], state.s[1]);
+
+    uint32_t lanes = 0u;
+
+    for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++)
+      lanes |= (Compare(ins.comparison, state.s[0].c[0][l], state.s[1].c[0][l]) ? 1u : 0u) << l;
+
+    lanes &= state.execMask;
+
+    state.breakMask |= lanes;
+    state.execMask &= ~lanes;
+    return pc + 1;
+  }
+
+
+  static uint32_t ExecRet(
+          D3D9SWVPCpuExecState&   state,
+    const D3D9SWVPCpuInstruction& ins,
+          uint32_t                pc) {
+    return ~0u;
+  }
+
+
+  static D3D9SWVPCpuHandler GetAluHandler(
+          DxsoOpcode              opcode,
+          uint32_t                majorVersion,
+          uint32_t&               srcCount) {
+    #define ALU_HANDLER(op, count) \
+      case DxsoOpcode::op: srcCount = count; return &ExecAlu<DxsoOpcode::op, count>
+
+    switch (opcode) {
+      ALU_HANDLER(Mov,    1);
+      ALU_HANDLER(Mova,   1);
+      ALU_HANDLER(Add,    2);
+      ALU_HANDLER(Sub,    2);
+      ALU_HANDLER(Mad,    3);
+      ALU_HANDLER(Mul,    2);
+      ALU_HANDLER(Rcp,    1);
+      ALU_HANDLER(Rsq,    1);
+      ALU_HANDLER(Dp3,    2);
+      ALU_HANDLER(Dp4,    2);
+      ALU_HANDLER(Min,    2);
+      ALU_HANDLER(Max,    2);
+      ALU_HANDLER(Slt,    2);
+      ALU_HANDLER(Sge,    2);
+      ALU_HANDLER(Exp,    1);
+      ALU_HANDLER(Log,    1);
+      ALU_HANDLER(LogP,   1);
+      ALU_HANDLER(Lit,    1);
+      ALU_HANDLER(Dst,    2);
+      ALU_HANDLER(Lrp,    3);
+      ALU_HANDLER(Frc,    1);
+      ALU_HANDLER(Pow,    2);
+      ALU_HANDLER(Crs,    2);
+      ALU_HANDLER(Sgn,    1);
+      ALU_HANDLER(Abs,    1);
+      ALU_HANDLER(Nrm,    1);
+      ALU_HANDLER(SinCos, 1);
+      ALU_HANDLER(Cmp,    3);
+      ALU_HANDLER(Cnd,    3);
+
+      case DxsoOpcode::ExpP:
+        srcCount = 1;
+        return majorVersion < 2
+          ? &ExecAlu<DxsoOpcode::ExpP, 1>
+          : &ExecAlu<DxsoOpcode::Exp,  1>;
+
+      case DxsoOpcode::M4x4:
+      case DxsoOpcode::M4x3:
+        srcCount = 2;
+        return &ExecMatrix<4>;
+
+      case DxsoOpcode::M3x4:
+      case DxsoOpcode::M3x3:
+      case DxsoOpcode::M3x2:
+        srcCount = 2;
+        return &ExecMatrix<3>;
+
+      case DxsoOpcode::SetP:
+        srcCount = 2;
+        return &ExecSetP;
+
+      default:
+        return nullptr;
+    }
+
+    #undef ALU_HANDLER
+  }
+
+
+  static uint32_t GetMatrixRowCount(DxsoOpcode opcode) {
+    switch (opcode) {
+      case DxsoOpcode::M4x4: return 4;
+      case DxsoOpcode::M4x3: return 3;
+      case DxsoOpcode::M3x4: return 4;
+      case DxsoOpcode::M3x3: return 3;
+      case DxsoOpcode::M3x2: return 2;
+      default:               return 0;
+    }
+  }
+
+
+  uint32_t D3D9SWVPCpuInterface::findInput(DxsoSemantic semantic) const {
+    for (uint32_t i = 0; i < DxsoMaxInterfaceRegs; i++) {
+      if ((inputMask & (1u << i)) && inputs[i] == semantic)
+        return i;
+    }
+
+    return ~0u;
+  }
+
+
+  uint32_t D3D9SWVPCpuInterface::findOutput(DxsoSemantic semantic) const {
+    // Pre-transformed positions in the destination
+    // declaration receive the regular position output
+    if (semantic.usage == DxsoUsage::PositionT)
+      semantic = DxsoSemantic { DxsoUsage::Position, semantic.usageIndex };
+
+    for (uint32_t i = 0; i < DxsoMaxInterfaceRegs; i++) {
+      if ((outputMask & (1u << i)) && outputs[i] == semantic)
+        return i;
+    }
+
+    return ~0u;
+  }
+
+
+  D3D9SWVPCpuProgram::D3D9SWVPCpuProgram(const void* pShaderBytecode) {
+    DxsoReader reader(reinterpret_cast<const char*>(pShaderBytecode));
+    DxsoHeader header(reader);
+    DxsoCode   code(reader);
+
+    const DxsoProgramInfo& info = header.info();
+
+    m_majorVersion = info.majorVersion();
+    m_floorAddress = info.majorVersion() < 2 && info.minorVersion() < 2;
+
+    DxsoDecodeContext decoder(info);
+    DxsoCodeIter iter = code.iter();
+
+    while (m_supported && decoder.decodeInstruction(iter))
+      this->CompileInstruction(decoder.getInstructionContext());
+
+    if (m_supported && !m_blocks.empty())
+      this->MarkUnsupported("Unterminated block", m_blocks.back().opcode);
+
+    if (!m_supported)
+      m_instructions.clear();
+
+    m_blocks.clear();
+  }
+
+
+  D3D9SWVPCpuProgram::~D3D9SWVPCpuProgram() {
+
+  }
+
+
+  void D3D9SWVPCpuProgram::Execute(D3D9SWVPCpuExecState& state) const {
+    const D3D9SWVPCpuInstruction* instructions = m_instructions.data();
+    const uint32_t count = uint32_t(m_instructions.size());
+
+    uint32_t pc = 0u;
+
+    while (pc < count)
+      pc = instructions[pc].handler(state, instructions[pc], pc);
+  }
+
+
+  Vector4 D3D9SWVPCpuProgram::GetFloatConst(const D3D9SWVPCpuConstants& consts, int32_t index) const {
+    if (unlikely(index < 0))
+      return Vector4(0.0f);
+
+    if (uint32_t(index) < m_floatDefined.size() && m_floatDefined[index])
+      return m_floatDefs[index];
+
+    if (uint32_t(index) < consts.floatCount)
+      return consts.floats[index];
+
+    return Vector4(0.0f);
+  }
+
+
+  Vector4i D3D9SWVPCpuProgram::GetIntConst(const D3D9SWVPCpuConstants& consts, uint32_t index) const {
+    if (index < m_intDefined.size() && m_intDefined[index])
+      return m_intDefs[index];
+
+    if (index < consts.intCount)
+      return consts.ints[index];
+
+    return Vector4i(0);
+  }
+
+
+  bool D3D9SWVPCpuProgram::GetBoolConst(const D3D9SWVPCpuConstants& consts, uint32_t index) const {
+    if (index < m_boolDefined.size() && m_boolDefined[index])
+      return m_boolDefs[index];
+
+    if (index < consts.boolCount)
+      return consts.bools[index / 32u] & (1u << (index % 32u));
+
+    return false;
+  }
+
+
+  void D3D9SWVPCpuProgram::CompileInstruction(
+    const DxsoInstructionContext&     ctx) {
+    const DxsoOpcode opcode = ctx.instruction.opcode;
+
+    switch (opcode) {
+      case DxsoOpcode::Nop:
+      case DxsoOpcode::Comment:
+      case DxsoOpcode::End:
+        return;
+
+      case DxsoOpcode::Dcl:
+        this->CompileDeclaration(ctx);
+        return;
+
+      case DxsoOpcode::Def:
+      case DxsoOpcode::DefI:
+      case DxsoOpcode::DefB:
+        this->CompileDefinition(ctx);
+        return;
+
+      case DxsoOpcode::If:
+      case DxsoOpcode::Ifc:
+      case DxsoOpcode::Else:
+      case DxsoOpcode::EndIf:
+      case DxsoOpcode::Loop:
+      case DxsoOpcode::EndLoop:
+      case DxsoOpcode::Rep:
+      case DxsoOpcode::EndRep:
+      case DxsoOpcode::Break:
+      case DxsoOpcode::BreakC:
+      case DxsoOpcode::Ret: {
+        D3D9SWVPCpuInstruction ins;
+
+        if (this->CompileControlFlow(ctx, ins))
+          m_instructions.push_back(ins);
+      } return;
+
+      default:
+        break;
+    }
+
+    D3D9SWVPCpuInstruction ins;
+    uint32_t srcCount = 0u;
+
+    ins.handler = GetAluHandler(opcode, m_majorVersion, srcCount);
+
+    if (!ins.handler) {
+      this->MarkUnsupported("Unsupported instruction", opcode);
+      return;
+    }
+
+    ins.comparison = ctx.instruction.specificData.comparison;
+    ins.predicated = ctx.instruction.predicated;
+
+    if (ins.predicated) {
+      ins.pred.file = D3D9SWVPCpuRegisterFile::Predicate;
+      ins.pred.modifier = ctx.pred.modifier;
+
+      for (uint32_t i = 0; i < 4; i++)
+        ins.pred.swizzle[i] = ctx.pred.swizzle[i];
+    }
+
+    if (!this->CompileDestination(ctx.dst, ins.dst)) {
+      this->MarkUnsupported("Unsupported destination", opcode);
+      return;
+    }
+
+    bool isSetP = opcode == DxsoOpcode::SetP;
+
+    if (isSetP != (ins.dst.file == D3D9SWVPCpuRegisterFile::Predicate)) {
+      this->MarkUnsupported("Unsupported destination", opcode);
+      return;
+    }
+
+    for (uint32_t i = 0; i < srcCount; i++) {
+      if (!this->CompileSource(ctx.src[i], ins.src[i])) {
+        this->MarkUnsupported("Unsupported source", opcode);
+        return;
+      }
+    }
+
+    // Matrix instructions only write as many components
+    // as the matrix has rows, see DxsoCompiler::emitMatrixAlu
+    uint32_t rowCount = GetMatrixRowCount(opcode);
+
+    if (rowCount) {
+      uint8_t mask = 0u;
+
+      for (uint32_t i = 0, n = 0; i < 4 && n < rowCount; i++) {
+        if (ins.dst.mask & (1u << i)) {
+          mask |= 1u << i;
+          n++;
+        }
+      }
+
+      ins.dst.mask = mask;
+
+      const D3D9SWVPCpuOperand& row = ins.src[1];
+
+      if (row.file != D3D9SWVPCpuRegisterFile::Const
+       && row.index + rowCount > (row.file == D3D9SWVPCpuRegisterFile::Temp ? DxsoMaxTempRegs : DxsoMaxInterfaceRegs)) {
+        this->MarkUnsupported("Unsupported source", opcode);
+        return;
+      }
+    }
+
+    m_instructions.push_back(ins);
+  }
+
+
+  void D3D9SWVPCpuProgram::CompileDeclaration(
+    const DxsoInstructionContext&     ctx) {
+    const DxsoRegisterId& id = ctx.dst.id;
+
+    if (id.num >= DxsoMaxInterfaceRegs)
+      return;
+
+    if (id.type == DxsoRegisterType::Input) {
+      m_interface.inputMask |= 1u << id.num;
+      m_interface.inputs[id.num] = ctx.dcl.semantic;
+    } else if (id.type == DxsoRegisterType::Output && m_majorVersion >= 3) {
+      m_interface.outputMask |= 1u << id.num;
+      m_interface.outputs[id.num] = ctx.dcl.semantic;
+    }
+  }
+
+
+  void D3D9SWVPCpuProgram::CompileDefinition(
+    const DxsoInstructionContext&     ctx) {
+    D3D9SWVPCpuRegisterFile file;
+    uint32_t index;
+
+    if (!this->MapRegister(ctx.dst.id, file, index)) {
+      this->MarkUnsupported("Unsupported definition", ctx.instruction.opcode);
+      return;
+    }
+
+    switch (file) {
+      case D3D9SWVPCpuRegisterFile::Const:
+        if (index >= m_floatDefs.size()) {
+          m_floatDefs.resize(index + 1);
+          m_floatDefined.resize(index + 1);
+        }
+
+        m_floatDefs[index] = Vector4(ctx.def.float32);
+        m_floatDefined[index] = true;
+        break;
+
+      case D3D9SWVPCpuRegisterFile::ConstInt:
+        if (index >= m_intDefs.size()) {
+          m_intDefs.resize(index + 1);
+          m_intDefined.resize(index + 1);
+        }
+
+        m_intDefs[index] = Vector4i(ctx.def.int32);
+        m_intDefined[index] = true;
+        break;
+
+      case D3D9SWVPCpuRegisterFile::ConstBool:
+        if (index >= m_boolDefs.size()) {
+          m_boolDefs.resize(index + 1);
+          m_boolDefined.resize(index + 1);
+        }
+
+        m_boolDefs[index] = ctx.def.uint32[0] != 0u;
+        m_boolDefined[index] = true;
+        break;
+
+      default:
+        this->MarkUnsupported("Unsupported definition", ctx.instruction.opcode);
+    }
+  }
+
+
+  bool D3D9SWVPCpuProgram::CompileControlFlow(
+    const DxsoInstructionContext&     ctx,
+          D3D9SWVPCpuInstruction&     ins) {
+    const DxsoOpcode opcode = ctx.instruction.opcode;
+    const uint32_t pc = uint32_t(m_instructions.size());
+
+    if (ctx.instruction.predicated) {
+      this->MarkUnsupported("Predicated control flow", opcode);
+      return false;
+    }
+
+    auto findBlock = [this] (DxsoOpcode a, DxsoOpcode b) {
+      return !m_blocks.empty()
+        && (m_blocks.back().opcode == a || m_blocks.back().opcode == b);
+    };
+
+    ins.comparison = ctx.instruction.specificData.comparison;
+
+    switch (opcode) {
+      case DxsoOpcode::If:
+      case DxsoOpcode::Ifc:
+      case DxsoOpcode::Loop:
+      case DxsoOpcode::Rep: {
+        if (m_blocks.size() >= D3D9SWVPCpuMaxNesting) {
+          this->MarkUnsupported("Nesting too deep", opcode);
+          return false;
+        }
+
+        bool valid = true;
+
+        if (opcode == DxsoOpcode::If) {
+          ins.handler = &ExecIf;
+          valid = this->CompileSource(ctx.src[0], ins.src[0]);
+        } else if (opcode == DxsoOpcode::Ifc) {
+          ins.handler = &ExecIfc;
+          valid = this->CompileSource(ctx.src[0], ins.src[0])
+               && this->CompileSource(ctx.src[1], ins.src[1]);
+        } else {
+          // Loop takes aL as its first operand, the
+          // loop parameters are always an integer constant
+          ins.handler = opcode == DxsoOpcode::Loop ? &ExecLoop<true> : &ExecLoop<false>;
+          valid = this->CompileSource(ctx.src[opcode == DxsoOpcode::Loop ? 1 : 0], ins.src[0])
+               && ins.src[0].file == D3D9SWVPCpuRegisterFile::ConstInt
+               && !ins.src[0].relative;
+        }
+
+        if (!valid) {
+          this->MarkUnsupported("Unsupported source", opcode);
+          return false;
+        }
+
+        m_blocks.push_back({ opcode, pc });
+        m_maxNesting = std::max(m_maxNesting, uint32_t(m_blocks.size()));
+      } return true;
+
+      case DxsoOpcode::Else:
+        if (!findBlock(DxsoOpcode::If, DxsoOpcode::Ifc)) {
+          this->MarkUnsupported("Unbalanced block", opcode);
+          return false;
+        }
+
+        m_instructions[m_blocks.back().pc].target = pc;
+        m_blocks.back() = { opcode, pc };
+
+        ins.handler = &ExecElse;
+        return true;
+
+      case DxsoOpcode::EndIf:
+        if (!findBlock(DxsoOpcode::If, DxsoOpcode::Ifc)
+         && !findBlock(DxsoOpcode::Else, DxsoOpcode::Else)) {
+          this->MarkUnsupported("Unbalanced block", opcode);
+          return false;
+        }
+
+        m_instructions[m_blocks.back().pc].target = pc;
+        m_blocks.pop_back();
+
+        ins.handler = &ExecEndIf;
+        return true;
+
+      case DxsoOpcode::EndLoop:
+      case DxsoOpcode::EndRep: {
+        DxsoOpcode begin = opcode == DxsoOpcode::EndLoop
+          ? DxsoOpcode::Loop
+          : DxsoOpcode::Rep;
+
+        if (!findBlock(begin, begin)) {
+          this->MarkUnsupported("Unbalanced block", opcode);
+          return false;
+        }
+
+        m_instructions[m_blocks.back().pc].target = pc;
+        ins.target = m_blocks.back().pc;
+        m_blocks.pop_back();
+
+        ins.handler = &ExecEndLoop;
+      } return true;
+
+      case DxsoOpcode::Break:
+      case DxsoOpcode::BreakC: {
+        bool inLoop = false;
+
+        for (const auto& block : m_blocks)
+          inLoop |= block.opcode == DxsoOpcode::Loop || block.opcode == DxsoOpcode::Rep;
+
+        if (!inLoop) {
+          this->MarkUnsupported("Break outside of loop", opcode);
+          return false;
+        }
+
+        if (opcode == DxsoOpcode::BreakC) {
+          if (!this->CompileSource(ctx.src[0], ins.src[0])
+           || !this->CompileSource(ctx.src[1], ins.src[1])) {
+            this->MarkUnsupported("Unsupported source", opcode);
+            return false;
+          }
+        }
+
+        ins.handler = opcode == DxsoOpcode::Break ? &ExecBreak : &ExecBreakC;
+      } return true;
+
+      case DxsoOpcode::Ret:
+        // Only a return from the main function is supported,
+        // subroutines require Call and Label which we reject
+        if (!m_blocks.empty()) {
+          this->MarkUnsupported("Return inside block", opcode);
+          return false;
+        }
+
+        ins.handler = &ExecRet;
+        return true;
+
+      default:
+        this->MarkUnsupported("Unsupported instruction", opcode);
+        return false;
+    }
+  }
+
+
+  bool D3D9SWVPCpuProgram::CompileSource(
+    const DxsoRegister&               reg,
+          D3D9SWVPCpuOperand&         op) {
+    if (!this->MapRegister(reg.id, op.file, op.index))
+      return false;
+
+    op.modifier = reg.modifier;
+
+    for (uint32_t i = 0; i < 4; i++)
+      op.swizzle[i] = reg.swizzle[i];
+
+    if (reg.hasRelative) {
+      op.relative = true;
+
+      if (reg.relative.id.type == DxsoRegisterType::Loop) {
+        op.relativeFile = D3D9SWVPCpuRegisterFile::Loop;
+      } else if (reg.relative.id.type == DxsoRegisterType::Addr) {
+        op.relativeFile = D3D9SWVPCpuRegisterFile::Addr;
+        op.relativeComponent = uint8_t(reg.relative.swizzle[0]);
+      } else {
+        return false;
+      }
+
+      // Only constants can be indexed with a0, interface
+      // registers in vs_3_0 can be indexed with aL
+      bool isConst = op.file == D3D9SWVPCpuRegisterFile::Const;
+      bool isInterface = op.file == D3D9SWVPCpuRegisterFile::Input
+                      || op.file == D3D9SWVPCpuRegisterFile::Output;
+
+      if (!isConst && !(isInterface && op.relativeFile == D3D9SWVPCpuRegisterFile::Loop))
+        return false;
+    }
+
+    return true;
+  }
+
+
+  bool D3D9SWVPCpuProgram::CompileDestination(
+    const DxsoRegister&               reg,
+          D3D9SWVPCpuDestination&     dst) {
+    if (!this->MapRegister(reg.id, dst.file, dst.index))
+      return false;
+
+    if (dst.file != D3D9SWVPCpuRegisterFile::Temp
+     && dst.file != D3D9SWVPCpuRegisterFile::Output
+     && dst.file != D3D9SWVPCpuRegisterFile::Addr
+     && dst.file != D3D9SWVPCpuRegisterFile::Predicate)
+      return false;
+
+    dst.mask = 0u;
+
+    for (uint32_t i = 0; i < 4; i++)
+      dst.mask |= reg.mask[i] ? (1u << i) : 0u;
+
+    dst.saturate = reg.saturate;
+    dst.scale = std::ldexp(1.0f, reg.shift);
+
+    if (reg.hasRelative) {
+      if (dst.file != D3D9SWVPCpuRegisterFile::Output
+       || reg.relative.id.type != DxsoRegisterType::Loop)
+        return false;
+
+      dst.relative = true;
+    }
+
+    // Older shader models write to fixed output registers,
+    // so the output semantics are derived from the register
+    if (m_majorVersion < 3) {
+      DxsoSemantic semantic = { };
+
+      switch (reg.id.type) {
+        case DxsoRegisterType::RasterizerOut:
+          if (reg.id.num == RasterOutPosition)
+            semantic = { DxsoUsage::Position, 0u };
+          else if (reg.id.num == RasterOutFog)
+            semantic = { DxsoUsage::Fog, 0u };
+          else
+            semantic = { DxsoUsage::PointSize, 0u };
+
+          // Fog and point size are scalar
+          if (reg.id.num != RasterOutPosition)
+            dst.mask &= 0x1u;
+          break;
+
+        case DxsoRegisterType::AttributeOut:
+          semantic = { DxsoUsage::Color, reg.id.num };
+          break;
+
+        case DxsoRegisterType::TexcoordOut:
+          semantic = { DxsoUsage::Texcoord, reg.id.num };
+          break;
+
+        default:
+          return true;
+      }
+
+      m_interface.outputMask |= 1u << dst.index;
+      m_interface.outputs[dst.index] = semantic;
+    }
+
+    return true;
+  }
+
+
+  bool D3D9SWVPCpuProgram::MapRegister(
+    const DxsoRegisterId&             id,
+          D3D9SWVPCpuRegisterFile&    file,
+          uint32_t&                   index) {
+    switch (id.type) {
+      case DxsoRegisterType::Temp:
+        file = D3D9SWVPCpuRegisterFile::Temp;
+        index = id.num;
+        return index < DxsoMaxTempRegs;
+
+      case DxsoRegisterType::Input:
+        file = D3D9SWVPCpuRegisterFile::Input;
+        index = id.num;
+        return index < DxsoMaxInterfaceRegs;
+
+      case DxsoRegisterType::Const:
+      case DxsoRegisterType::Const2:
+      case DxsoRegisterType::Const3:
+      case DxsoRegisterType::Const4: {
+        static const std::array<uint32_t, 4> offsets = { 0u, 2048u, 4096u, 6144u };
+        uint32_t bank = id.type == DxsoRegisterType::Const ? 0u
+          : uint32_t(id.type) - uint32_t(DxsoRegisterType::Const2) + 1u;
+
+        file = D3D9SWVPCpuRegisterFile::Const;
+        index = id.num + offsets[bank];
+      } return true;
+
+      case DxsoRegisterType::ConstInt:
+        file = D3D9SWVPCpuRegisterFile::ConstInt;
+        index = id.num;
+        return true;
+
+      case DxsoRegisterType::ConstBool:
+        file = D3D9SWVPCpuRegisterFile::ConstBool;
+        index = id.num;
+        return true;
+
+      case DxsoRegisterType::Addr:
+        file = D3D9SWVPCpuRegisterFile::Addr;
+        index = 0u;
+        return id.num == 0u;
+
+      case DxsoRegisterType::Loop:
+        file = D3D9SWVPCpuRegisterFile::Loop;
+        index = 0u;
+        return true;
+
+      case DxsoRegisterType::Predicate:
+        file = D3D9SWVPCpuRegisterFile::Predicate;
+        index = 0u;
+        return true;
+
+      case DxsoRegisterType::RasterizerOut:
+        // Position, fog and point size
+        file = D3D9SWVPCpuRegisterFile::Output;
+        index = 10u + id.num;
+        return id.num < 3u;
+
+      case DxsoRegisterType::AttributeOut:
+        // Diffuse and specular colors
+        file = D3D9SWVPCpuRegisterFile::Output;
+        index = 8u + id.num;
+        return id.num < 2u;
+
+      case DxsoRegisterType::Output:
+        // Texture coordinates in vs_2_x and older, output
+        // registers with declared semantics in vs_3_0
+        file = D3D9SWVPCpuRegisterFile::Output;
+        index = id.num;
+        return index < (m_majorVersion < 3 ? 8u : DxsoMaxInterfaceRegs);
+
+      default:
+        return false;
+    }
+  }
+
+
+  void D3D9SWVPCpuProgram::MarkUnsupported(
+    const char*                       reason,
+          DxsoOpcode                  opcode) {
+    if (m_supported)
+      Logger::debug(str::format("D3D9SWVPCpuProgram: ", reason, ": ", opcode));
+
+    m_supported = false;
+  }
+
+
+  const D3D9SWVPCpuInterface& D3D9SWVPCpuFixedFunction::GetInterface() {
+    static const D3D9SWVPCpuInterface s_interface = [] {
+      D3D9SWVPCpuInterface result;
+      result.inputMask = 0xfffu;
+      result.inputs[0] = { DxsoUsage::Position, 0u };
+      result.inputs[1] = { DxsoUsage::Normal,   0u };
+      result.inputs[2] = { DxsoUsage::Color,    0u };
+      result.inputs[3] = { DxsoUsage::Color,    1u };
+
+      result.outputMask = 0x7ffu;
+      result.outputs[0] = { DxsoUsage::Position, 0u };
+      result.outputs[1] = { DxsoUsage::Color,    0u };
+      result.outputs[2] = { DxsoUsage::Color,    1u };
+
+      for (uint32_t i = 0; i < 8; i++) {
+        result.inputs[4 + i]  = { DxsoUsage::Texcoord, i };
+        result.outputs[3 + i] = { DxsoUsage::Texcoord, i };
+      }
+
+      return result;
+    } ();
+
+    return s_interface;
+  }
+
+
+  void D3D9SWVPCpuFixedFunction::Execute(D3D9SWVPCpuExecState& state) const {
+    auto dot3 = [] (const Vector4& a, const Vector4& b) {
+      return a.x * b.x + a.y * b.y + a.z * b.z;
+    };
+
+    auto normalize3 = [&dot3] (const Vector4& a) {
+      float rcpLength = 1.0f / std::sqrt(dot3(a, a));
+      return Vector4(a.x * rcpLength, a.y * rcpLength, a.z * rcpLength, 0.0f);
+    };
+
+    auto saturate = [] (const Vector4& a) {
+      return Vector4(Saturate(a.x), Saturate(a.y), Saturate(a.z), Saturate(a.w));
+    };
+
+    for (uint32_t l = 0; l < D3D9SWVPCpuLaneCount; l++) {
+      if (!(state.laneMask & (1u << l)))
+        continue;
+
+      // Row vector convention, see D3D9FFShaderCompiler
+      Vector4 vtx = worldView * LoadLane(state.v[0], l);
+      StoreLane(state.o[0], l, projection * vtx);
+
+      Vector4 color0 = hasColor0 ? LoadLane(state.v[2], l) : Vector4(1.0f);
+      Vector4 color1 = hasColor1 ? LoadLane(state.v[3], l) : Vector4(0.0f, 0.0f, 0.0f, 1.0f);
+
+      if (lighting) {
+        Vector4 n = LoadLane(state.v[1], l);
+        Vector4 normal;
+
+        for (uint32_t i = 0; i < 3; i++)
+          normal[i] = dot3(normalMatrix[i], n);
+
+        normal.w = 0.0f;
+
+        if (normalizeNormals && dot3(normal, normal) != 0.0f)
+          normal = normalize3(normal);
+
+        Vector4 ambient  = Vector4(0.0f);
+        Vector4 diffuse  = Vector4(0.0f);
+        Vector4 specular = Vector4(0.0f);
+
+        for (uint32_t i = 0; i < lightCount; i++) {
+          const D3D9Light& light = lights[i];
+
+          bool isDirectional = light.Type == D3DLIGHT_DIRECTIONAL;
+
+          Vector4 delta = light.Position - vtx;
+          delta.w = 0.0f;
+
+          float d = std::sqrt(dot3(delta, delta));
+
+          Vector4 hitDir = normalize3(isDirectional ? -light.Direction : delta);
+
+          float atten = 1.0f;
+
+          if (!isDirectional) {
+            atten = 1.0f / (light.Attenuation0 + d * (light.Attenuation1 + d * light.Attenuation2));
+            atten = std::fmin(atten, D3D9SWVPCpuFloatMax);
+            atten = d > light.Range ? 0.0f : atten;
+          }
+
+          if (light.Type == D3DLIGHT_SPOT) {
+            float rho = -dot3(hitDir, light.Direction);
+            float spotAtten = std::pow((rho - light.Phi) / (light.Theta - light.Phi), light.Falloff);
+            spotAtten = rho > light.Phi ? spotAtten : 0.0f;
+            spotAtten = rho <= light.Theta ? spotAtten : 1.0f;
+            atten *= Saturate(spotAtten);
+          }
+
+          float hitDot = Saturate(dot3(normal, hitDir));
+          float diffuseness = hitDot * atten;
+
+          Vector4 mid = localViewer
+            ? hitDir - normalize3(vtx)
+            : hitDir - Vector4(0.0f, 0.0f, 1.0f, 0.0f);
+          mid = normalize3(mid);
+
+          float midDot = Saturate(dot3(normal, mid));
+          float specularness = (midDot > 0.0f && hitDot > 0.0f)
+            ? std::pow(midDot, materialPower) * atten
+            : 0.0f;
+
+          ambient  += light.Ambient  * atten;
+          diffuse  += light.Diffuse  * diffuseness;
+          specular += light.Specular * specularness;
+        }
+
+        auto pickSource = [&] (uint32_t source, const Vector4& material) {
+          if (source == D3DMCS_MATERIAL)
+            return material;
+          else if (source == D3DMCS_COLOR1)
+            return color0;
+          else
+            return color1;
+        };
+
+        Vector4 matDiffuse  = pickSource(diffuseSource,  materialDiffuse);
+        Vector4 matAmbient  = pickSource(ambientSource,  materialAmbient);
+        Vector4 matEmissive = pickSource(emissiveSource, materialEmissive);
+        Vector4 matSpecular = pickSource(specularSource, materialSpecular);
+
+        Vector4 finalColor0 = matAmbient * globalAmbient + matEmissive
+                            + matAmbient * ambient + matDiffuse * diffuse;
+        finalColor0.w = matDiffuse.w;
+
+        color0 = saturate(finalColor0);
+
+        if (specularEnable)
+          color1 = saturate(matSpecular * specular);
+      }
+
+      StoreLane(state.o[1], l, color0);
+      StoreLane(state.o[2], l, color1);
+
+      for (uint32_t i = 0; i < texcoordIndices.size(); i++) {
+        uint32_t index = texcoordIndices[i];
+        uint32_t count = (texcoordMask >> (index * 3u)) & 0x7u;
+
+        // Components not backed by the vertex buffer are zero
+        Vector4 texcoord = LoadLane(state.v[4 + index], l);
+
+        for (uint32_t c = count; c < 4; c++)
+          texcoord[c] = 0.0f;
+
+        StoreLane(state.o[3 + i], l, texcoord);
+      }
+    }
+  }
+
+
+  static float HalfToFloat(uint16_t h) {
+    uint32_t sign = uint32_t(h & 0x8000u) << 16;
+    uint32_t exp  = (h >> 10) & 0x1fu;
+    uint32_t mant = h & 0x3ffu;
+
+    if (exp == 0u) {
+      float value = std::ldexp(float(mant), -24);
+      return sign ? -value : value;
+    }
+
+    uint32_t bits = exp == 0x1fu
+      ? (sign | 0x7f800000u | (mant << 13))
+      : (sign | ((exp + 112u) << 23) | (mant << 13));
+
+    return bit::cast<float>(bits);
+  }
+
+
+  static uint16_t FloatToHalf(float f) {
+    uint32_t bits = bit::cast<uint32_t>(f);
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t exp  = (bits >> 23) & 0xffu;
+    uint32_t mant = bits & 0x7fffffu;
+
+    if (exp == 0xffu)
+      return uint16_t(sign | 0x7c00u | (mant ? 0x200u : 0u));
+
+    int32_t e = int32_t(exp) - 127 + 15;
+
+    if (e >= 0x1f)
+      return uint16_t(sign | 0x7c00u);
+
+    if (e <= 0) {
+      if (e < -10)
+        return uint16_t(sign);
+
+      // Denormal result, round to nearest even
+      mant |= 0x800000u;
+      uint32_t shift = uint32_t(14 - e);
+      uint32_t half = mant >> shift;
+      uint32_t rem  = mant & ((1u << shift) - 1u);
+      uint32_t mid  = 1u << (shift - 1u);
+
+      if (rem > mid || (rem == mid && (half & 1u)))
+        half += 1u;
+
+      return uint16_t(sign | half);
+    }
+
+    uint32_t half = (uint32_t(e) << 10) | (mant >> 13);
+    uint32_t rem  = mant & 0x1fffu;
+
+    // Rounding may carry into the exponent, which
+    // correctly produces infinity on overflow
+    if (rem > 0x1000u || (rem == 0x1000u && (half & 1u)))
+      half += 1u;
+
+    return uint16_t(sign | half);
+  }
+
+
+  template<typename T>
+  static T ReadUnaligned(const uint8_t* src, uint32_t index) {
+    T result;
+    std::memcpy(&result, src + index * sizeof(T), sizeof(T));
+    return result;
+  }
+
+
+  template<typename T>
+  static void WriteUnaligned(uint8_t* dst, uint32_t index, T value) {
+    std::memcpy(dst + index * sizeof(T), &value, sizeof(T));
+  }
+
+
+  static void DecodeVertexElement(
+    const uint8_t*                    src,
+          D3DDECLTYPE                 type,
+          D3D9SWVPCpuRegister&        reg,
+          uint32_t                    lane) {
+    // Components not present in the vertex data
+    // are filled in with (0, 0, 0, 1)
+    float v[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+    switch (type) {
+      case D3DDECLTYPE_FLOAT4: v[3] = ReadUnaligned<float>(src, 3); [[fallthrough]];
+      case D3DDECLTYPE_FLOAT3: v[2] = ReadUnaligned<float>(src, 2); [[fallthrough]];
+      case D3DDECLTYPE_FLOAT2: v[1] = ReadUnaligned<float>(src, 1); [[fallthrough]];
+      case D3DDECLTYPE_FLOAT1: v[0] = ReadUnaligned<float>(src, 0); break;
+
+      case D3DDECLTYPE_D3DCOLOR:
+        v[0] = float(src[2]) / 255.0f;
+        v[1] = float(src[1]) / 255.0f;
+        v[2] = float(src[0]) / 255.0f;
+        v[3] = float(src[3]) / 255.0f;
+        break;
+
+      case D3DDECLTYPE_UBYTE4:
+        for (uint32_t i = 0; i < 4; i++)
+          v[i] = float(src[i]);
+        break;
+
+      case D3DDECLTYPE_UBYTE4N:
+        for (uint32_t i = 0; i < 4; i++)
+          v[i] = float(src[i]) / 255.0f;
+        break;
+
+      case D3DDECLTYPE_SHORT4:
+        v[2] = float(ReadUnaligned<int16_t>(src, 2));
+        v[3] = float(ReadUnaligned<int16_t>(src, 3));
+        [[fallthrough]];
+      case D3DDECLTYPE_SHORT2:
+        v[0] = float(ReadUnaligned<int16_t>(src, 0));
+        v[1] = float(ReadUnaligned<int16_t>(src, 1));
+        break;
+
+      case D3DDECLTYPE_SHORT4N:
+        v[2] = std::fmax(float(ReadUnaligned<int16_t>(src, 2)) / 32767.0f, -1.0f);
+        v[3] = std::fmax(float(ReadUnaligned<int16_t>(src, 3)) / 32767.0f, -1.0f);
+        [[fallthrough]];
+      case D3DDECLTYPE_SHORT2N:
+        v[0] = std::fmax(float(ReadUnaligned<int16_t>(src, 0)) / 32767.0f, -1.0f);
+        v[1] = std::fmax(float(ReadUnaligned<int16_t>(src, 1)) / 32767.0f, -1.0f);
+        break;
+
+      case D3DDECLTYPE_USHORT4N:
+        v[2] = float(ReadUnaligned<uint16_t>(src, 2)) / 65535.0f;
+        v[3] = float(ReadUnaligned<uint16_t>(src, 3)) / 65535.0f;
+        [[fallthrough]];
+      case D3DDECLTYPE_USHORT2N:
+        v[0] = float(ReadUnaligned<uint16_t>(src, 0)) / 65535.0f;
+        v[1] = float(ReadUnaligned<uint16_t>(src, 1)) / 65535.0f;
+        break;
+
+      case D3DDECLTYPE_UDEC3: {
+        uint32_t packed = ReadUnaligned<uint32_t>(src, 0);
+
+        for (uint32_t i = 0; i < 3; i++)
+          v[i] = float((packed >> (10u * i)) & 0x3ffu);
+      } break;
+
+      case D3DDECLTYPE_DEC3N: {
+        uint32_t packed = ReadUnaligned<uint32_t>(src, 0);
+
+        for (uint32_t i = 0; i < 3; i++) {
+          int32_t value = int32_t(packed << (22u - 10u * i)) >> 22;
+          v[i] = std::fmax(float(value) / 511.0f, -1.0f);
+        }
+      } break;
+
+      case D3DDECLTYPE_FLOAT16_4:
+        v[2] = HalfToFloat(ReadUnaligned<uint16_t>(src, 2));
+        v[3] = HalfToFloat(ReadUnaligned<uint16_t>(src, 3));
+        [[fallthrough]];
+      case D3DDECLTYPE_FLOAT16_2:
+        v[0] = HalfToFloat(ReadUnaligned<uint16_t>(src, 0));
+        v[1] = HalfToFloat(ReadUnaligned<uint16_t>(src, 1));
+        break;
+
+      default:
+        break;
+    }
+
+    for (uint32_t i = 0; i < 4; i++)
+      reg.c[i][lane] = v[i];
+  }
+
+
+  static void EncodeVertexElement(
+          uint8_t*                    dst,
+          D3DDECLTYPE                 type,
+    const D3D9SWVPCpuRegister*        reg,
+          uint32_t                    lane) {
+    float v[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    if (reg) {
+      for (uint32_t i = 0; i < 4; i++)
+        v[i] = reg->c[i][lane];
+    }
+
+    auto unorm = [] (float x, float scale) {
+      return uint32_t(Saturate(x) * scale + 0.5f);
+    };
+
+    auto snorm = [] (float x, float scale) {
+      return int32_t(std::round(std::fmin(std::fmax(x, -1.0f), 1.0f) * scale));
+    };
+
+    auto clampInt = [] (float x, float lo, float hi) {
+      return std::fmin(std::fmax(x, lo), hi);
+    };
+
+    switch (type) {
+      case D3DDECLTYPE_FLOAT4: WriteUnaligned<float>(dst, 3, v[3]); [[fallthrough]];
+      case D3DDECLTYPE_FLOAT3: WriteUnaligned<float>(dst, 2, v[2]); [[fallthrough]];
+      case D3DDECLTYPE_FLOAT2: WriteUnaligned<float>(dst, 1, v[1]); [[fallthrough]];
+      case D3DDECLTYPE_FLOAT1: WriteUnaligned<float>(dst, 0, v[0]); break;
+
+      case D3DDECLTYPE_D3DCOLOR:
+        dst[0] = uint8_t(unorm(v[2], 255.0f));
+        dst[1] = uint8_t(unorm(v[1], 255.0f));
+        dst[2] = uint8_t(unorm(v[0], 255.0f));
+        dst[3] = uint8_t(unorm(v[3], 255.0f));
+        break;
+
+      case D3DDECLTYPE_UBYTE4:
+        for (uint32_t i = 0; i < 4; i++)
+          dst[i] = uint8_t(clampInt(v[i], 0.0f, 255.0f));
+        break;
+
+      case D3DDECLTYPE_UBYTE4N:
+        for (uint32_t i = 0; i < 4; i++)
+          dst[i] = uint8_t(unorm(v[i], 255.0f));
+        break;
+
+      case D3DDECLTYPE_SHORT4:
+      case D3DDECLTYPE_SHORT2: {
+        uint32_t count = type == D3DDECLTYPE_SHORT4 ? 4u : 2u;
+
+        for (uint32_t i = 0; i < count; i++)
+          WriteUnaligned<int16_t>(dst, i, int16_t(clampInt(v[i], -32768.0f, 32767.0f)));
+      } break;
+
+      case D3DDECLTYPE_SHORT4N:
+      case D3DDECLTYPE_SHORT2N: {
+        uint32_t count = type == D3DDECLTYPE_SHORT4N ? 4u : 2u;
+
+        for (uint32_t i = 0; i < count; i++)
+          WriteUnaligned<int16_t>(dst, i, int16_t(snorm(v[i], 32767.0f)));
+      } break;
+
+      case D3DDECLTYPE_USHORT4N:
+      case D3DDECLTYPE_USHORT2N: {
+        uint32_t count = type == D3DDECLTYPE_USHORT4N ? 4u : 2u;
+
+        for (uint32_t i = 0; i < count; i++)
+          WriteUnaligned<uint16_t>(dst, i, uint16_t(unorm(v[i], 65535.0f)));
+      } break;
+
+      case D3DDECLTYPE_UDEC3: {
+        uint32_t packed = 0u;
+
+        for (uint32_t i = 0; i < 3; i++)
+          packed |= uint32_t(clampInt(v[i], 0.0f, 1023.0f)) << (10u * i);
+
+        WriteUnaligned<uint32_t>(dst, 0, packed);
+      } break;
+
+      case D3DDECLTYPE_DEC3N: {
+        uint32_t packed = 0u;
+
+        for (uint32_t i = 0; i < 3; i++)
+          packed |= (uint32_t(snorm(v[i], 511.0f)) & 0x3ffu) << (10u * i);
+
+        WriteUnaligned<uint32_t>(dst, 0, packed);
+      } break;
+
+      case D3DDECLTYPE_FLOAT16_4:
+      case D3DDECLTYPE_FLOAT16_2: {
+        uint32_t count = type == D3DDECLTYPE_FLOAT16_4 ? 4u : 2u;
+
+        for (uint32_t i = 0; i < count; i++)
+          WriteUnaligned<uint16_t>(dst, i, FloatToHalf(v[i]));
+      } break;
+
+      default:
+        break;
+    }
+  }
+
+
+  D3D9SWVPCpuProcessor::D3D9SWVPCpuProcessor() {
+
+  }
+
+
+  D3D9SWVPCpuProcessor::~D3D9SWVPCpuProcessor() {
+    { std::unique_lock<dxvk::mutex> lock(m_mutex);
+      m_stopped = true;
+    }
+
+    m_workCond.notify_all();
+
+    for (auto& worker : m_workers)
+      worker.join();
+  }
+
+
+  void D3D9SWVPCpuProcessor::ProcessVertices(const D3D9SWVPCpuDrawInfo& info) {
+    const uint32_t chunkCount = (info.vertexCount + ChunkSize - 1u) / ChunkSize;
+
+    if (chunkCount <= 1u) {
+      this->ProcessChunk(info, 0u, info.vertexCount);
+      return;
+    }
+
+    std::function<void (uint32_t)> job = [this, &info] (uint32_t chunk) {
+      uint32_t first = chunk * ChunkSize;
+      this->ProcessChunk(info, first, std::min(ChunkSize, info.vertexCount - first));
+    };
+
+    this->RunJob(job, chunkCount);
+  }
+
+
+  void D3D9SWVPCpuProcessor::ProcessChunk(
+    const D3D9SWVPCpuDrawInfo&  info,
+          uint32_t              first,
+          uint32_t              count) {
+    D3D9SWVPCpuExecState state;
+    state.program = info.program;
+    state.consts = &info.constants;
+
+    // Inputs that are not provided by any stream read as zero
+    std::memset(state.v, 0, sizeof(state.v));
+
+    for (uint32_t base = first; base < first + count; base += D3D9SWVPCpuLaneCount) {
+      uint32_t laneCount = std::min(D3D9SWVPCpuLaneCount, first + count - base);
+
+      state.laneMask  = (1u << laneCount) - 1u;
+      state.execMask  = state.laneMask;
+      state.breakMask = 0u;
+      state.depth     = 0u;
+      state.aL        = 0;
+
+      std::memset(state.p, 0, sizeof(state.p));
+      std::memset(state.a, 0, sizeof(state.a));
+      std::memset(state.r, 0, sizeof(state.r));
+      std::memset(state.o, 0, sizeof(state.o));
+
+      for (const auto& input : info.inputs) {
+        for (uint32_t l = 0; l < laneCount; l++) {
+          const uint8_t* src = input.data + size_t(base + l) * input.stride;
+          DecodeVertexElement(src, input.type, state.v[input.slot], l);
+        }
+      }
+
+      if (info.program)
+        info.program->Execute(state);
+      else
+        info.fixedFunction->Execute(state);
+
+      for (const auto& output : info.outputs) {
+        const D3D9SWVPCpuRegister* reg = output.slot < DxsoMaxInterfaceRegs
+          ? &state.o[output.slot]
+          : nullptr;
+
+        for (uint32_t l = 0; l < laneCount; l++) {
+          uint8_t* dst = info.dstData + size_t(base + l) * info.dstStride + output.offset;
+          EncodeVertexElement(dst, output.type, reg, l);
+        }
+      }
+    }
+  }
+
+
+  void D3D9SWVPCpuProcessor::RunJob(
+    const std::function<void (uint32_t)>& job,
+          uint32_t              count) {
+    { std::unique_lock<dxvk::mutex> lock(m_mutex);
+
+      // Spawn workers on first use so that applications
+      // which never process vertices on the CPU don't pay
+      // for idle threads. The calling thread helps out.
+      if (m_workers.empty()) {
+        uint32_t workerCount = std::min(dxvk::thread::hardware_concurrency(), MaxWorkers + 1u);
+
+        for (uint32_t i = 1; i < workerCount; i++)
+          m_workers.emplace_back([this] { RunWorker(); });
+      }
+
+      m_job       = &job;
+      m_jobCount  = count;
+      m_jobId    += 1u;
+      m_jobNext.store(0u);
+    }
+
+    m_workCond.notify_all();
+
+    uint32_t chunk;
+
+    while ((chunk = m_jobNext.fetch_add(1u)) < count)
+      job(chunk);
+
+    std::unique_lock<dxvk::mutex> lock(m_mutex);
+
+    m_doneCond.wait(lock, [this] {
+      return !m_jobBusy;
+    });
+
+    m_job = nullptr;
+  }
+
+
+  void D3D9SWVPCpuProcessor::RunWorker() {
+    env::setThreadName("dxvk-swvp");
+
+    uint64_t lastJobId = 0u;
+
+    while (true) {
+      const std::function<void (uint32_t)>* job = nullptr;
+      uint32_t count = 0u;
+
+      { std::unique_lock<dxvk::mutex> lock(m_mutex);
+
+        m_workCond.wait(lock, [this, lastJobId] {
+          return m_stopped || (m_job && m_jobId != lastJobId);
+        });
+
+        if (m_stopped)
+          return;
+
+        lastJobId = m_jobId;
+        job = m_job;
+        count = m_jobCount;
+
+        m_jobBusy += 1u;
+      }
+
+      uint32_t chunk;
+
+      while ((chunk = m_jobNext.fetch_add(1u)) < count)
+        (*job)(chunk);
+
+      { std::unique_lock<dxvk::mutex> lock(m_mutex);
+
+        if (!(--m_jobBusy))
+          m_doneCond.notify_one();
+      }
+    }
+  }
+
+}
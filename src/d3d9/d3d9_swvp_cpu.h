@@ -0,0 +1,435 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "d3d9_include.h"
+
+#include "../dxso/dxso_decoder.h"
+
+#include "../util/thread.h"
+#include "../util/util_matrix.h"
+#include "../util/util_small_vector.h"
+
+namespace dxvk {
+
+  struct D3D9Light;
+
+  /**
+   * \brief Number of vertices processed at once
+   *
+   * Registers store one value per vertex and component,
+   * so that every operation is a plain loop over lanes
+   * which the compiler can map to SIMD instructions.
+   */
+  constexpr uint32_t D3D9SWVPCpuLaneCount = 8u;
+
+  /**
+   * \brief Maximum nesting depth of control flow blocks
+   */
+  constexpr uint32_t D3D9SWVPCpuMaxNesting = 64u;
+
+  /**
+   * \brief Vector register for a batch of vertices
+   */
+  struct alignas(32) D3D9SWVPCpuRegister {
+    float c[4][D3D9SWVPCpuLaneCount];
+  };
+
+  /**
+   * \brief Register file
+   */
+  enum class D3D9SWVPCpuRegisterFile : uint8_t {
+    Temp,
+    Input,
+    Output,
+    Const,
+    ConstInt,
+    ConstBool,
+    Addr,
+    Loop,
+    Predicate,
+  };
+
+  /**
+   * \brief Pre-decoded source operand
+   */
+  struct D3D9SWVPCpuOperand {
+    D3D9SWVPCpuRegisterFile file          = D3D9SWVPCpuRegisterFile::Temp;
+    D3D9SWVPCpuRegisterFile relativeFile  = D3D9SWVPCpuRegisterFile::Addr;
+    bool                    relative      = false;
+    uint8_t                 relativeComponent = 0u;
+    DxsoRegModifier         modifier      = DxsoRegModifier::None;
+    std::array<uint8_t, 4>  swizzle       = { 0u, 1u, 2u, 3u };
+    uint32_t                index         = 0u;
+  };
+
+  /**
+   * \brief Pre-decoded destination operand
+   */
+  struct D3D9SWVPCpuDestination {
+    D3D9SWVPCpuRegisterFile file          = D3D9SWVPCpuRegisterFile::Temp;
+    bool                    relative      = false;
+    bool                    saturate      = false;
+    uint8_t                 mask          = 0xfu;
+    float                   scale         = 1.0f;
+    uint32_t                index         = 0u;
+  };
+
+  struct D3D9SWVPCpuExecState;
+  struct D3D9SWVPCpuInstruction;
+
+  /**
+   * \brief Instruction handler
+   *
+   * Executes one instruction for the current batch.
+   * \returns Index of the next instruction to execute
+   */
+  using D3D9SWVPCpuHandler = uint32_t (*)(
+          D3D9SWVPCpuExecState&     state,
+    const D3D9SWVPCpuInstruction&   ins,
+          uint32_t                  pc);
+
+  /**
+   * \brief Compiled instruction
+   *
+   * Operands are resolved when the program is built, so
+   * that executing an instruction only needs to call the
+   * handler specialized for the instruction's opcode.
+   */
+  struct D3D9SWVPCpuInstruction {
+    D3D9SWVPCpuHandler                handler     = nullptr;
+    DxsoComparison                    comparison  = DxsoComparison::Never;
+    bool                              predicated  = false;
+    D3D9SWVPCpuOperand                pred;
+    D3D9SWVPCpuDestination            dst;
+    std::array<D3D9SWVPCpuOperand, 3> src;
+    uint32_t                          target      = 0u;
+  };
+
+  /**
+   * \brief Input and output semantics of a vertex program
+   *
+   * Maps input and output register slots to vertex
+   * declaration semantics. Only slots whose bit is
+   * set in the respective mask are valid.
+   */
+  struct D3D9SWVPCpuInterface {
+    uint32_t                                      inputMask   = 0u;
+    uint32_t                                      outputMask  = 0u;
+    std::array<DxsoSemantic, DxsoMaxInterfaceRegs> inputs  = { };
+    std::array<DxsoSemantic, DxsoMaxInterfaceRegs> outputs = { };
+
+    /**
+     * \brief Looks up input slot for a semantic
+     *
+     * \param [in] semantic Input semantic
+     * \returns Slot index, or \c ~0u if not read
+     */
+    uint32_t findInput(DxsoSemantic semantic) const;
+
+    /**
+     * \brief Looks up output slot for a semantic
+     *
+     * \param [in] semantic Output semantic
+     * \returns Slot index, or \c ~0u if not written
+     */
+    uint32_t findOutput(DxsoSemantic semantic) const;
+  };
+
+  /**
+   * \brief Shader constants for vertex processing
+   */
+  struct D3D9SWVPCpuConstants {
+    const Vector4*            floats      = nullptr;
+    const Vector4i*           ints        = nullptr;
+    const uint32_t*           bools       = nullptr;
+    uint32_t                  floatCount  = 0u;
+    uint32_t                  intCount    = 0u;
+    uint32_t                  boolCount   = 0u;
+  };
+
+  /**
+   * \brief Vertex shader compiled for CPU execution
+   *
+   * Decodes DXSO bytecode into a flat list of instructions
+   * with pre-resolved operands and jump targets. Programs
+   * using instructions that cannot be executed on the CPU,
+   * such as texture fetches or subroutine calls, are marked
+   * as unsupported.
+   */
+  class D3D9SWVPCpuProgram {
+
+  public:
+
+    D3D9SWVPCpuProgram(const void* pShaderBytecode);
+
+    ~D3D9SWVPCpuProgram();
+
+    /**
+     * \brief Checks whether the program can run on the CPU
+     * \returns \c true if all instructions are supported
+     */
+    bool IsSupported() const {
+      return m_supported;
+    }
+
+    /**
+     * \brief Queries program interface
+     * \returns Input and output semantics
+     */
+    const D3D9SWVPCpuInterface& GetInterface() const {
+      return m_interface;
+    }
+
+    /**
+     * \brief Runs program for one batch of vertices
+     *
+     * Inputs must already be written to the state, outputs
+     * are written back to the state's output registers.
+     * \param [in] state Execution state
+     */
+    void Execute(D3D9SWVPCpuExecState& state) const;
+
+    /**
+     * \brief Loads float constant
+     *
+     * Takes constants defined in the shader into account.
+     * \param [in] consts Application-provided constants
+     * \param [in] index Constant index
+     * \returns Constant value, or zero if out of bounds
+     */
+    Vector4 GetFloatConst(const D3D9SWVPCpuConstants& consts, int32_t index) const;
+
+    /**
+     * \brief Loads integer constant
+     *
+     * \param [in] consts Application-provided constants
+     * \param [in] index Constant index
+     * \returns Constant value
+     */
+    Vector4i GetIntConst(const D3D9SWVPCpuConstants& consts, uint32_t index) const;
+
+    /**
+     * \brief Loads boolean constant
+     *
+     * \param [in] consts Application-provided constants
+     * \param [in] index Constant index
+     * \returns Constant value
+     */
+    bool GetBoolConst(const D3D9SWVPCpuConstants& consts, uint32_t index) const;
+
+    /**
+     * \brief Checks whether \c mova rounds down
+     * \returns \c true for vs_1_1 and older
+     */
+    bool FloorAddress() const {
+      return m_floorAddress;
+    }
+
+  private:
+
+    struct BlockInfo {
+      DxsoOpcode  opcode;
+      uint32_t    pc;
+    };
+
+    bool                                m_supported    = true;
+    bool                                m_floorAddress = false;
+    uint32_t                            m_majorVersion = 0u;
+
+    D3D9SWVPCpuInterface                m_interface;
+    std::vector<D3D9SWVPCpuInstruction> m_instructions;
+
+    std::vector<Vector4>                m_floatDefs;
+    std::vector<Vector4i>               m_intDefs;
+    std::vector<bool>                   m_boolDefs;
+    std::vector<bool>                   m_floatDefined;
+    std::vector<bool>                   m_intDefined;
+    std::vector<bool>                   m_boolDefined;
+
+    std::vector<BlockInfo>              m_blocks;
+    uint32_t                            m_maxNesting   = 0u;
+
+    void CompileInstruction(
+      const DxsoInstructionContext&     ctx);
+
+    void CompileDeclaration(
+      const DxsoInstructionContext&     ctx);
+
+    void CompileDefinition(
+      const DxsoInstructionContext&     ctx);
+
+    bool CompileControlFlow(
+      const DxsoInstructionContext&     ctx,
+            D3D9SWVPCpuInstruction&     ins);
+
+    bool CompileSource(
+      const DxsoRegister&               reg,
+            D3D9SWVPCpuOperand&         op);
+
+    bool CompileDestination(
+      const DxsoRegister&               reg,
+            D3D9SWVPCpuDestination&     dst);
+
+    bool MapRegister(
+      const DxsoRegisterId&             id,
+            D3D9SWVPCpuRegisterFile&    file,
+            uint32_t&                   index);
+
+    void MarkUnsupported(
+      const char*                       reason,
+            DxsoOpcode                  opcode);
+
+  };
+
+  /**
+   * \brief Fixed-function vertex pipeline state
+   *
+   * Subset of the fixed-function state that the CPU path
+   * implements: world-view-projection transform, lighting
+   * and texture coordinate pass-through. Vertex blending,
+   * texture coordinate generation and texture transforms
+   * are left to the GPU path. The texture coordinate mask
+   * stores the component count of each input texture
+   * coordinate set, using three bits per set.
+   */
+  struct D3D9SWVPCpuFixedFunction {
+    Matrix4                   worldView;
+    Matrix4                   normalMatrix;
+    Matrix4                   projection;
+
+    bool                      hasColor0         = false;
+    bool                      hasColor1         = false;
+    bool                      lighting          = false;
+    bool                      normalizeNormals  = false;
+    bool                      localViewer       = false;
+    bool                      specularEnable    = false;
+
+    uint32_t                  diffuseSource     = D3DMCS_MATERIAL;
+    uint32_t                  ambientSource     = D3DMCS_MATERIAL;
+    uint32_t                  specularSource    = D3DMCS_MATERIAL;
+    uint32_t                  emissiveSource    = D3DMCS_MATERIAL;
+
+    Vector4                   globalAmbient;
+    Vector4                   materialDiffuse;
+    Vector4                   materialAmbient;
+    Vector4                   materialSpecular;
+    Vector4                   materialEmissive;
+    float                     materialPower     = 0.0f;
+
+    const D3D9Light*          lights            = nullptr;
+    uint32_t                  lightCount        = 0u;
+
+    std::array<uint32_t, 8>   texcoordIndices   = { };
+    uint32_t                  texcoordMask      = 0u;
+
+    /**
+     * \brief Interface of the fixed-function pipeline
+     * \returns Fixed input and output semantics
+     */
+    static const D3D9SWVPCpuInterface& GetInterface();
+
+    /**
+     * \brief Processes one batch of vertices
+     * \param [in] state Execution state
+     */
+    void Execute(D3D9SWVPCpuExecState& state) const;
+  };
+
+  /**
+   * \brief Vertex element to read from a source stream
+   */
+  struct D3D9SWVPCpuVertexInput {
+    const uint8_t*            data    = nullptr;
+    uint32_t                  stride  = 0u;
+    D3DDECLTYPE               type    = D3DDECLTYPE_UNUSED;
+    uint32_t                  slot    = 0u;
+  };
+
+  /**
+   * \brief Vertex element to write to the destination
+   */
+  struct D3D9SWVPCpuVertexOutput {
+    uint32_t                  offset  = 0u;
+    D3DDECLTYPE               type    = D3DDECLTYPE_UNUSED;
+    uint32_t                  slot    = ~0u;
+  };
+
+  /**
+   * \brief Parameters for one \c ProcessVertices call
+   *
+   * Exactly one of \c program and \c fixedFunction must be
+   * set. Input pointers must point to the first vertex to
+   * process, per-instance inputs use a stride of zero.
+   */
+  struct D3D9SWVPCpuDrawInfo {
+    const D3D9SWVPCpuProgram*       program       = nullptr;
+    const D3D9SWVPCpuFixedFunction* fixedFunction = nullptr;
+    D3D9SWVPCpuConstants            constants;
+
+    small_vector<D3D9SWVPCpuVertexInput,  16>  inputs;
+    small_vector<D3D9SWVPCpuVertexOutput, 16>  outputs;
+
+    uint8_t*                        dstData       = nullptr;
+    uint32_t                        dstStride     = 0u;
+    uint32_t                        vertexCount   = 0u;
+  };
+
+  /**
+   * \brief CPU vertex processor
+   *
+   * Runs vertex programs or the fixed-function pipeline on
+   * the CPU and writes the results directly to the mapped
+   * destination buffer. Large draws are split into chunks
+   * which are processed by a small pool of worker threads
+   * as well as the calling thread.
+   */
+  class D3D9SWVPCpuProcessor {
+    constexpr static uint32_t ChunkSize   = 256u;
+    constexpr static uint32_t MaxWorkers  = 7u;
+  public:
+
+    D3D9SWVPCpuProcessor();
+
+    ~D3D9SWVPCpuProcessor();
+
+    /**
+     * \brief Processes vertices
+     *
+     * Returns once all vertices have been written.
+     * \param [in] info Draw parameters
+     */
+    void ProcessVertices(const D3D9SWVPCpuDrawInfo& info);
+
+  private:
+
+    dxvk::mutex                 m_mutex;
+    dxvk::condition_variable    m_workCond;
+    dxvk::condition_variable    m_doneCond;
+
+    std::vector<dxvk::thread>   m_workers;
+    bool                        m_stopped     = false;
+
+    const std::function<void (uint32_t)>* m_job = nullptr;
+    uint64_t                    m_jobId       = 0u;
+    uint32_t                    m_jobBusy     = 0u;
+    uint32_t                    m_jobCount    = 0u;
+    std::atomic<uint32_t>       m_jobNext     = { 0u };
+
+    void ProcessChunk(
+      const D3D9SWVPCpuDrawInfo&  info,
+            uint32_t              first,
+            uint32_t              count);
+
+    void RunJob(
+      const std::function<void (uint32_t)>& job,
+            uint32_t              count);
+
+    void RunWorker();
+
+  };
+
+}
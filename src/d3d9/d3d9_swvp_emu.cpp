@@ -300,7 +300,7 @@ namespace dxvk {
       }
     }
 
-    Rc<DxvkShader> finalize() {
+    Rc<DxvkSpirvShader> finalize() {
       m_module.opReturn();
       m_module.functionEnd();
 
@@ -341,11 +341,27 @@ namespace dxvk {
     DxvkShaderKey key = { VK_SHADER_STAGE_GEOMETRY_BIT , hash };
     std::string name = str::format("SWVP_", key.toString());
     
+    Rc<DxvkShader> shader;
+    Sha1Hash cacheKey;
+
+    if (pDevice->HasShaderCache()) {
+      cacheKey = D3D9ShaderCache::GetSwvpKey(elements);
+      shader = pDevice->LookupCachedShader(cacheKey, nullptr);
+    }
+
     // This shader has not been compiled yet, so we have to create a
     // new module. This takes a while, so we won't lock the structure.
-    D3D9SWVPEmulatorGenerator generator(name);
-    generator.compile(elements);
-    Rc<DxvkShader> shader = generator.finalize();
+    if (shader == nullptr) {
+      D3D9SWVPEmulatorGenerator generator(name);
+      generator.compile(elements);
+
+      Rc<DxvkSpirvShader> spirvShader = generator.finalize();
+
+      if (pDevice->HasShaderCache())
+        pDevice->AddCachedShader(cacheKey, spirvShader, nullptr);
+
+      shader = std::move(spirvShader);
+    }
 
     pDevice->GetDXVKDevice()->registerShader(shader);
 
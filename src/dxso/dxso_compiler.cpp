@@ -223,7 +223,7 @@ namespace dxvk {
   }
 
 
-  Rc<DxvkShader> DxsoCompiler::compile() {
+  Rc<DxvkSpirvShader> DxsoCompiler::compile() {
     DxvkSpirvShaderCreateInfo info;
     info.bindingCount = m_bindings.size();
     info.bindings = m_bindings.data();
@@ -12,6 +12,8 @@
 
 namespace dxvk {
 
+  class DxvkSpirvShader;
+
   /**
    * \brief Scalar value type
    * 
@@ -239,7 +241,7 @@ namespace dxvk {
      * \brief Compiles the shader
      * \returns The final shader objects
      */
-    Rc<DxvkShader> compile();
+    Rc<DxvkSpirvShader> compile();
 
     const DxsoIsgn& isgn() { return m_isgn; }
     const DxsoIsgn& osgn() { return m_osgn; }
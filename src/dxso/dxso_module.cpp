@@ -21,7 +21,7 @@ namespace dxvk {
     return info;
   }
 
-  Rc<DxvkShader> DxsoModule::compile(
+  Rc<DxvkSpirvShader> DxsoModule::compile(
     const DxsoModuleInfo&     moduleInfo,
     const std::string&        fileName,
     const DxsoAnalysisInfo&   analysis,
@@ -10,6 +10,8 @@
 
 #include "../d3d9/d3d9_constant_layout.h"
 
+#include "../dxvk/dxvk_shader_spirv.h"
+
 #include <vector>
 
 namespace dxvk {
@@ -41,7 +43,7 @@ namespace dxvk {
      *        the compiled SPIR-V for debugging purposes.
      * \returns The compiled shader object
      */
-    Rc<DxvkShader> compile(
+    Rc<DxvkSpirvShader> compile(
       const DxsoModuleInfo&     moduleInfo,
       const std::string&        fileName,
       const DxsoAnalysisInfo&   analysis,
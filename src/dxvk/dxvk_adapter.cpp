@@ -119,11 +119,17 @@ namespace dxvk {
       externalInfo.pNext = std::exchange(info.pNext, &externalInfo);
 
     VkExternalImageFormatProperties externalProperties = { VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES };
+    VkHostImageCopyDevicePerformanceQueryEXT hostCopyProperties = { VK_STRUCTURE_TYPE_HOST_IMAGE_COPY_DEVICE_PERFORMANCE_QUERY_EXT };
     VkImageFormatProperties2 properties = { VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2 };
 
     if (externalInfo.handleType)
       externalProperties.pNext = std::exchange(properties.pNext, &externalProperties);
 
+    if (query.usage & VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT)
+      hostCopyProperties.pNext = std::exchange(properties.pNext, &hostCopyProperties);
+    else
+      hostCopyProperties.optimalDeviceAccess = VK_TRUE;
+
     VkResult vr = vk->vkGetPhysicalDeviceImageFormatProperties2(m_handle, &info, &properties);
 
     if (vr != VK_SUCCESS)
@@ -136,6 +142,7 @@ namespace dxvk {
     result.sampleCounts     = properties.imageFormatProperties.sampleCounts;
     result.maxResourceSize  = properties.imageFormatProperties.maxResourceSize;
     result.externalFeatures = externalProperties.externalMemoryProperties.externalMemoryFeatures;
+    result.optimalDeviceAccess = hostCopyProperties.optimalDeviceAccess;
     return result;
   }
 
@@ -248,6 +248,9 @@ namespace dxvk {
     // Wait for pending descriptor copies to finish
     m_descriptorSync.synchronize();
 
+    for (const auto& cmdList : m_appendedLists)
+      cmdList->m_descriptorSync.synchronize();
+
     VkResult status = VK_SUCCESS;
 
     static const std::array<DxvkCmdBuffer, 2> SdmaCmdBuffers =
@@ -261,6 +264,9 @@ namespace dxvk {
 
     m_commandSubmission.reset();
 
+    // Set if command buffers of a previous iteration are still pending
+    bool folded = false;
+
     for (size_t i = 0; i < m_cmdSubmissions.size(); i++) {
       bool isFirst = i == 0;
       bool isLast  = i == m_cmdSubmissions.size() - 1;
@@ -302,7 +308,7 @@ namespace dxvk {
 
       // If we had either a transfer command or a semaphore wait, submit to the
       // transfer queue so that all subsequent commands get stalled as necessary.
-      if (m_device->hasDedicatedTransferQueue() && !m_commandSubmission.isEmpty()) {
+      if (m_device->hasDedicatedTransferQueue() && !m_commandSubmission.isEmpty() && !folded) {
         m_commandSubmission.signalSemaphore(semaphores.transfer,
           ++timelines.transfer, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT);
 
@@ -344,6 +350,13 @@ namespace dxvk {
         }
       }
 
+      // Fold appended command lists into the same submission if
+      // they do not need to synchronize with any other queue.
+      folded = !isLast && !cmd.syncSdma && canFoldSubmission(m_cmdSubmissions[i + 1]);
+
+      if (folded)
+        continue;
+
       m_commandSubmission.signalSemaphore(semaphores.graphics,
         ++timelines.graphics, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT);
 
@@ -449,6 +462,34 @@ namespace dxvk {
   }
 
   
+  void DxvkCommandList::appendCommandList(
+          Rc<DxvkCommandList>&&   cmdList) {
+    size_t sparseIndex = m_cmdSparseBinds.size();
+
+    for (const auto& sparseBind : cmdList->m_cmdSparseBinds)
+      m_cmdSparseBinds.push_back(sparseBind);
+
+    for (const auto& submission : cmdList->m_cmdSubmissions) {
+      auto& entry = m_cmdSubmissions.emplace_back(submission);
+      entry.sparseCmd += sparseIndex;
+      entry.appended = true;
+    }
+
+    // Waits are moved to the start of the combined submission
+    // and signals to the end, which is still correct.
+    for (const auto& fence : cmdList->m_waitSemaphores)
+      m_waitSemaphores.push_back(fence);
+
+    for (const auto& fence : cmdList->m_signalSemaphores)
+      m_signalSemaphores.push_back(fence);
+
+    m_statCounters.merge(cmdList->m_statCounters);
+    cmdList->m_statCounters.reset();
+
+    m_appendedLists.push_back(std::move(cmdList));
+  }
+
+
   void DxvkCommandList::reset() {
     // Free resources and other objects
     // that are no longer in use
@@ -476,6 +517,8 @@ namespace dxvk {
     m_cmdSubmissions.clear();
     m_cmdSparseBinds.clear();
 
+    m_appendedLists.clear();
+
     m_wsiSemaphores = PresenterSync();
 
     // Reset actual command buffers and pools
@@ -165,7 +165,7 @@ namespace dxvk {
     bool                execCommands = false;
     bool                syncSdma    = false;
     bool                sparseBind  = false;
-    bool                reserved    = false;
+    bool                appended    = false;
     uint32_t            sparseCmd   = 0;
 
     std::array<VkCommandBuffer, uint32_t(DxvkCmdBuffer::Count)> cmdBuffers = { };
@@ -306,6 +306,30 @@ namespace dxvk {
      * to split the command list into multiple submissions.
      */
     void next();
+
+    /**
+     * \brief Appends another command list
+     *
+     * Adds all submissions of the given command list after the ones
+     * of this command list, so that both get submitted in one go, and
+     * keeps the command list alive until this one has completed. Both
+     * command lists must be finalized, and the appended command list
+     * must not use any WSI semaphores.
+     * \param [in] cmdList Command list to append
+     */
+    void appendCommandList(
+            Rc<DxvkCommandList>&&   cmdList);
+
+    /**
+     * \brief Retrieves appended command lists
+     *
+     * Used to recycle appended command lists once
+     * this command list has completed execution.
+     * \returns Appended command lists
+     */
+    std::vector<Rc<DxvkCommandList>> takeAppendedCommandLists() {
+      return std::move(m_appendedLists);
+    }
     
     /**
      * \brief Tracks an object
@@ -390,6 +414,9 @@ namespace dxvk {
      * \brief Notifies resources and signals
      */
     void notifyObjects() {
+      for (const auto& cmdList : m_appendedLists)
+        cmdList->notifyObjects();
+
       m_objectTracker.clear();
       m_signalTracker.notify();
     }
@@ -1273,6 +1300,8 @@ namespace dxvk {
     small_vector<DxvkCommandSubmissionInfo, 4> m_cmdSubmissions;
     small_vector<DxvkSparseBindSubmission, 4>  m_cmdSparseBinds;
     
+    std::vector<Rc<DxvkCommandList>>    m_appendedLists;
+
     std::vector<Rc<DxvkDescriptorPool>> m_descriptorPools;
 
     Rc<DxvkDescriptorPool>    m_descriptorPool;
@@ -1284,6 +1313,12 @@ namespace dxvk {
 
     std::vector<DxvkGraphicsPipeline*> m_pipelines;
 
+    static bool canFoldSubmission(const DxvkCommandSubmissionInfo& next) {
+      return next.appended && !next.sparseBind
+        && !next.cmdBuffers[uint32_t(DxvkCmdBuffer::SdmaBarriers)]
+        && !next.cmdBuffers[uint32_t(DxvkCmdBuffer::SdmaBuffer)];
+    }
+
     force_inline VkCommandBuffer getCmdBuffer() const {
       // Allocation logic will always provide an execution buffer
       return m_cmd.cmdBuffers[uint32_t(DxvkCmdBuffer::ExecBuffer)];
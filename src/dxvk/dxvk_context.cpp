@@ -10,7 +10,9 @@
 
 namespace dxvk {
   
-  DxvkContext::DxvkContext(const Rc<DxvkDevice>& device)
+  DxvkContext::DxvkContext(
+    const Rc<DxvkDevice>&             device,
+          DxvkContextType             type)
   : m_device      (device),
     m_common      (&device->m_objects),
     m_sdmaAcquires(DxvkCmdBuffer::SdmaBarriers),
@@ -67,6 +69,9 @@ namespace dxvk {
     // Add a fast path to query debug utils support
     if (m_device->debugFlags().test(DxvkDebugFlag::Capture))
       m_features.set(DxvkContextFeature::DebugUtils);
+
+    if (type == DxvkContextType::Worker)
+      m_features.set(DxvkContextFeature::ConcurrentRecording);
   }
   
   
@@ -86,7 +91,13 @@ namespace dxvk {
   Rc<DxvkCommandList> DxvkContext::endRecording(
     const VkDebugUtilsLabelEXT*       reason) {
     this->endCurrentCommands();
-    this->relocateQueuedResources();
+
+    // Relocation changes resource storage, which other contexts
+    // may be using while we are recording. Relocations remain
+    // queued until no worker contexts are recording anymore.
+    if (!m_features.test(DxvkContextFeature::ConcurrentRecording)
+     && !m_device->hasConcurrentRecording())
+      this->relocateQueuedResources();
 
     m_implicitResolves.cleanup(m_trackingId);
 
@@ -161,6 +172,41 @@ namespace dxvk {
   }
 
 
+  Rc<DxvkCommandList> DxvkContext::finishCommandList() {
+    if (m_features.test(DxvkContextFeature::DescriptorBuffer))
+      m_cmd->setDescriptorSyncHandle(m_descriptorWorker.getSyncHandle());
+
+    Rc<DxvkCommandList> cmdList = this->endRecording(nullptr);
+
+    freeZeroBuffer();
+
+    this->beginRecording(
+      m_device->createCommandList());
+
+    return cmdList;
+  }
+
+
+  void DxvkContext::submitCommandLists(
+          std::vector<Rc<DxvkCommandList>>&& cmdLists) {
+    if (m_features.test(DxvkContextFeature::DescriptorBuffer))
+      m_cmd->setDescriptorSyncHandle(m_descriptorWorker.getSyncHandle());
+
+    Rc<DxvkCommandList> cmdList = this->endRecording(nullptr);
+
+    for (auto& appended : cmdLists)
+      cmdList->appendCommandList(std::move(appended));
+
+    m_device->submitCommandList(cmdList,
+      m_latencyTracker, m_latencyFrameId, nullptr);
+
+    freeZeroBuffer();
+
+    this->beginRecording(
+      m_device->createCommandList());
+  }
+
+
   Rc<DxvkCommandList> DxvkContext::beginExternalRendering() {
     // Flush and invalidate everything
     endCurrentCommands();
@@ -2747,6 +2793,19 @@ namespace dxvk {
   }
 
 
+  void DxvkContext::initImageHost(
+    const Rc<DxvkImage>&            image,
+          Rc<DxvkResourceAllocation>&& storage) {
+    // If the image got relocated after the host copy, its current storage
+    // does not contain any data since the image was not yet initialized.
+    // Move it back to the storage that was written on the host.
+    if (image->storage() != storage)
+      invalidateImage(image, std::move(storage));
+
+    image->trackInitialization(image->getAvailableSubresources());
+  }
+
+
   void DxvkContext::setViewports(
           uint32_t            viewportCount,
     const DxvkViewport*       viewports) {
@@ -8356,7 +8415,8 @@ namespace dxvk {
     m_state.gp.pipeline = nullptr;
     m_state.cp.pipeline = nullptr;
 
-    m_cmd->setTrackingId(++m_trackingId);
+    m_trackingId = m_device->allocTrackingId();
+    m_cmd->setTrackingId(m_trackingId);
 
     if (m_features.test(DxvkContextFeature::DescriptorBuffer)) {
       m_cmd->setDescriptorHeap(m_descriptorHeap);
@@ -9174,6 +9234,11 @@ namespace dxvk {
           VkDeviceSize              offset,
           VkDeviceSize              size,
           DxvkAccess                access) {
+    // Worker contexts cannot rely on tracking IDs since other
+    // contexts may overwrite them, and must not discard buffers
+    if (m_features.test(DxvkContextFeature::ConcurrentRecording))
+      return false;
+
     // If the resource hasn't been used yet or both uses are reads,
     // we can use this buffer in the init command buffer
     if (!buffer->isTracked(m_trackingId, access))
@@ -9238,6 +9303,9 @@ namespace dxvk {
     if (image->info().usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT))
       return false;
 
+    if (m_features.test(DxvkContextFeature::ConcurrentRecording))
+      return false;
+
     // If the image hasn't been used yet or all uses are
     // reads, we can use it in the init command buffer
     return !image->isTracked(m_trackingId, access);
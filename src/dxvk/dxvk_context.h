@@ -28,7 +28,10 @@ namespace dxvk {
     constexpr static uint32_t DirectMultiDrawBatchSize = 256u;
   public:
     
-    DxvkContext(const Rc<DxvkDevice>& device);
+    DxvkContext(
+      const Rc<DxvkDevice>&             device,
+            DxvkContextType             type);
+
     ~DxvkContext();
 
     /**
@@ -101,6 +104,30 @@ namespace dxvk {
       const VkDebugUtilsLabelEXT*       reason,
             DxvkSubmitStatus*           status);
 
+    /**
+     * \brief Finishes command buffer for external submission
+     *
+     * Ends the current command list so that it can be submitted
+     * by another context via \ref submitCommandList, and begins
+     * recording a new one. Used by worker contexts.
+     * \returns Recorded command list
+     */
+    Rc<DxvkCommandList> finishCommandList();
+
+    /**
+     * \brief Submits command lists recorded on other contexts
+     *
+     * Flushes the current command list and appends the given command
+     * lists to it, so that they execute after all previously recorded
+     * commands and are submitted to the device in one go. Command lists
+     * always begin and end with all resources in their default layout
+     * and all memory accesses made visible, so no further
+     * synchronization is required at the seams.
+     * \param [in] cmdLists Command lists from \ref finishCommandList
+     */
+    void submitCommandLists(
+            std::vector<Rc<DxvkCommandList>>&& cmdLists);
+
     /**
      * \brief Synchronizes command list with WSI
      *
@@ -1081,6 +1108,20 @@ namespace dxvk {
             VkDeviceSize              subresourceAlignment,
             VkFormat                  format);
 
+    /**
+     * \brief Finishes host initialization of an image
+     *
+     * Must be called after writing all subresources of an image via host
+     * image copies, which requires the image to not be in use by the GPU.
+     * Marks the image as initialized, and restores the given backing
+     * storage if the image got relocated in the meantime.
+     * \param [in] image The image that was initialized
+     * \param [in] storage Backing storage written on the host
+     */
+    void initImageHost(
+      const Rc<DxvkImage>&            image,
+            Rc<DxvkResourceAllocation>&& storage);
+
     /**
      * \brief Sets viewports
      * 
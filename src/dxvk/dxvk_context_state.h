@@ -82,10 +82,24 @@ namespace dxvk {
     DebugUtils,
     DirectMultiDraw,
     DescriptorBuffer,
+    ConcurrentRecording,
     FeatureCount
   };
 
   using DxvkContextFeatures = Flags<DxvkContextFeature>;
+
+
+  /**
+   * \brief Context type
+   *
+   * Worker contexts record command lists concurrently with
+   * other worker contexts of the same device, and must not
+   * modify any resource state that other contexts rely on.
+   */
+  enum class DxvkContextType : uint32_t {
+    Primary,
+    Worker,
+  };
   
 
   /**
@@ -32,6 +32,8 @@ namespace dxvk {
 
       m_head = nullptr;
       m_next = &m_head;
+
+      m_commandCount = 0;
     } else {
       while (cmd != nullptr) {
         cmd->exec(ctx);
@@ -54,6 +56,7 @@ namespace dxvk {
     m_next = &m_head;
 
     m_commandOffset = 0;
+    m_commandCount = 0;
   }
   
   
@@ -95,6 +98,75 @@ namespace dxvk {
   }
   
   
+  DxvkCsChunkQueue::DxvkCsChunkQueue() {
+    for (uint32_t i = 0u; i < Capacity; i++)
+      m_slots[i].marker.store(i, std::memory_order_relaxed);
+  }
+
+
+  DxvkCsChunkQueue::~DxvkCsChunkQueue() {
+
+  }
+
+
+  bool DxvkCsChunkQueue::tryPush(
+          DxvkCsChunkRef&&  chunk,
+          bool              sequenced,
+          uint64_t&         seq) {
+    uint64_t state = m_state.load(std::memory_order_relaxed);
+
+    while (true) {
+      uint32_t pos = uint32_t(state & PosMask);
+
+      auto& slot = m_slots[pos % Capacity];
+
+      // If the marker matches the current position, the slot is free.
+      // If it lags behind, the consumer has not yet processed the chunk
+      // that was written to this slot one iteration ago, so the queue
+      // is full. Otherwise, another producer has already claimed it.
+      int32_t diff = posDiff(slot.marker.load(std::memory_order_acquire), pos);
+
+      if (diff < 0)
+        return false;
+
+      if (diff > 0) {
+        state = m_state.load(std::memory_order_relaxed);
+        continue;
+      }
+
+      uint64_t newSeq = (state >> PosBits) + (sequenced ? 1u : 0u);
+      uint64_t newState = (newSeq << PosBits) | ((pos + 1u) & PosMask);
+
+      if (m_state.compare_exchange_weak(state, newState, std::memory_order_relaxed)) {
+        slot.entry.chunk = std::move(chunk);
+        slot.entry.seq = sequenced ? newSeq : 0u;
+        slot.marker.store((pos + 1u) & PosMask, std::memory_order_release);
+
+        seq = newSeq;
+        return true;
+      }
+    }
+  }
+
+
+  bool DxvkCsChunkQueue::tryPop(
+          DxvkCsQueuedChunk& entry) {
+    auto& slot = m_slots[m_readPos % Capacity];
+
+    if (slot.marker.load(std::memory_order_acquire) != ((m_readPos + 1u) & PosMask))
+      return false;
+
+    entry.chunk = std::move(slot.entry.chunk);
+    entry.seq = slot.entry.seq;
+
+    // Release the slot for producers writing one iteration ahead
+    slot.marker.store((m_readPos + Capacity) & PosMask, std::memory_order_release);
+
+    m_readPos = (m_readPos + 1u) & PosMask;
+    return true;
+  }
+
+
   DxvkCsThread::DxvkCsThread(
     const Rc<DxvkDevice>&   device,
     const Rc<DxvkContext>&  context)
@@ -107,59 +179,23 @@ namespace dxvk {
   DxvkCsThread::~DxvkCsThread() {
     { std::unique_lock<dxvk::mutex> lock(m_mutex);
       m_stopped.store(true);
+      m_condOnAdd.notify_one();
     }
     
-    m_condOnAdd.notify_one();
     m_thread.join();
   }
   
   
   uint64_t DxvkCsThread::dispatchChunk(DxvkCsChunkRef&& chunk) {
-    uint64_t seq;
-
-    { std::unique_lock<dxvk::mutex> lock(m_mutex);
-      seq = ++m_queueOrdered.seqDispatch;
-
-      auto& entry = m_queueOrdered.queue.emplace_back();
-      entry.chunk = std::move(chunk);
-      entry.seq = seq;
-
-      m_condOnAdd.notify_one();
-    }
-    
-    return seq;
+    return enqueueChunk(DxvkCsQueue::Ordered, std::move(chunk), true);
   }
 
 
   void DxvkCsThread::injectChunk(DxvkCsQueue queue, DxvkCsChunkRef&& chunk, bool synchronize) {
-    uint64_t timeline = 0u;
-
-    { std::unique_lock<dxvk::mutex> lock(m_mutex);
-      auto& q = getQueue(queue);
-
-      if (synchronize)
-        timeline = ++q.seqDispatch;
+    uint64_t timeline = enqueueChunk(queue, std::move(chunk), synchronize);
 
-      auto& entry = q.queue.emplace_back();
-      entry.chunk = std::move(chunk);
-      entry.seq = timeline;
-
-      m_condOnAdd.notify_one();
-
-      if (queue == DxvkCsQueue::HighPriority) {
-        // Worker will check this flag after executing any
-        // chunk without causing additional lock contention
-        m_hasHighPrio.store(true, std::memory_order_release);
-      }
-    }
-
-    if (synchronize) {
-      std::unique_lock<dxvk::mutex> lock(m_counterMutex);
-
-      m_condOnSync.wait(lock, [this, queue, timeline] {
-        return getCounter(queue).load(std::memory_order_acquire) >= timeline;
-      });
-    }
+    if (synchronize)
+      waitForCounter(queue, timeline);
   }
 
 
@@ -171,15 +207,11 @@ namespace dxvk {
       // happens while another thread is submitting then there is
       // an inherent race anyway
       if (seq == SynchronizeAll)
-        seq = m_queueOrdered.seqDispatch;
+        seq = m_queueOrdered.seqDispatch();
 
       auto t0 = dxvk::high_resolution_clock::now();
 
-      { std::unique_lock<dxvk::mutex> lock(m_counterMutex);
-        m_condOnSync.wait(lock, [this, seq] {
-          return m_seqOrdered.load(std::memory_order_acquire) >= seq;
-        });
-      }
+      waitForCounter(DxvkCsQueue::Ordered, seq);
 
       auto t1 = dxvk::high_resolution_clock::now();
       auto ticks = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0);
@@ -188,90 +220,370 @@ namespace dxvk {
       m_device->addStatCtr(DxvkStatCounter::CsSyncTicks, ticks.count());
     }
   }
-  
-  
+
+
+  uint64_t DxvkCsThread::enqueueChunk(
+          DxvkCsQueue       queue,
+          DxvkCsChunkRef&&  chunk,
+          bool              sequenced) {
+    auto t0 = dxvk::high_resolution_clock::now();
+
+    auto& q = getQueue(queue);
+    uint64_t seq = 0u;
+
+    if (unlikely(!q.tryPush(std::move(chunk), sequenced, seq))) {
+      // Queue is full, wait for the worker to consume some chunks.
+      // Increment the waiter count before re-checking the queue so
+      // that the consumer cannot miss the wake-up.
+      std::unique_lock<dxvk::mutex> lock(m_mutex);
+      m_producerWaiters.fetch_add(1u);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      m_condOnSpace.wait(lock, [&] {
+        return q.tryPush(std::move(chunk), sequenced, seq);
+      });
+
+      m_producerWaiters.fetch_sub(1u);
+    }
+
+    // Only wake up the worker if it is actually sleeping. The fence
+    // pairs with the one in the worker, so that either the worker
+    // sees the chunk, or we see that the worker is waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (m_consumerWaiting.load(std::memory_order_relaxed)) {
+      std::unique_lock<dxvk::mutex> lock(m_mutex);
+      m_consumerWaiting.store(false, std::memory_order_relaxed);
+      m_dispatchThreshold.store(NoEarlyDispatch, std::memory_order_relaxed);
+      m_condOnAdd.notify_one();
+    }
+
+    auto t1 = dxvk::high_resolution_clock::now();
+    m_enqueueNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count(), std::memory_order_relaxed);
+    return seq;
+  }
+
+
+  void DxvkCsThread::waitForCounter(
+          DxvkCsQueue       queue,
+          uint64_t          seq) {
+    auto& counter = getCounter(queue);
+
+    if (counter.load(std::memory_order_acquire) >= seq)
+      return;
+
+    std::unique_lock<dxvk::mutex> lock(m_counterMutex);
+    m_syncWaiters.fetch_add(1u);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    m_condOnSync.wait(lock, [&counter, seq] {
+      return counter.load(std::memory_order_acquire) >= seq;
+    });
+
+    m_syncWaiters.fetch_sub(1u);
+  }
+
+
+  void DxvkCsThread::signalCounter(
+          DxvkCsQueue       queue,
+          uint64_t          seq) {
+    getCounter(queue).store(seq, std::memory_order_release);
+
+    // Only take the lock if any thread is waiting
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (m_syncWaiters.load(std::memory_order_relaxed)) {
+      std::lock_guard lock(m_counterMutex);
+      m_condOnSync.notify_all();
+    }
+  }
+
+
+  bool DxvkCsThread::tryPopChunk(
+          DxvkCsQueuedChunk& entry,
+          DxvkCsQueue&      queue) {
+    // Always drain the high-priority queue first
+    queue = DxvkCsQueue::HighPriority;
+
+    if (!m_queueHighPrio.tryPop(entry)) {
+      queue = DxvkCsQueue::Ordered;
+
+      if (!m_queueOrdered.tryPop(entry))
+        return false;
+    }
+
+    // Wake up any producers waiting for the queue to drain
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (m_producerWaiters.load(std::memory_order_relaxed)) {
+      std::lock_guard lock(m_mutex);
+      m_condOnSpace.notify_all();
+    }
+
+    return true;
+  }
+
+
   void DxvkCsThread::threadFunc() {
     env::setThreadName("dxvk-cs");
 
-    // Local chunk queues, we use two queues and swap between
-    // them in order to potentially reduce lock contention.
-    std::vector<DxvkCsQueuedChunk> ordered;
-    std::vector<DxvkCsQueuedChunk> highPrio;
+    DxvkCsQueuedChunk entry = { };
+    DxvkCsQueue queue = DxvkCsQueue::Ordered;
 
-    try {
-      while (!m_stopped.load()) {
-        { std::unique_lock<dxvk::mutex> lock(m_mutex);
+    // Moving average of the idle time fraction, in units of 1/256.
+    // Used to determine the early dispatch threshold for producers.
+    uint32_t idleFraction = 0u;
 
-          auto pred = [this] { return
-              !m_queueOrdered.queue.empty()
-              || !m_queueHighPrio.queue.empty()
-              || m_stopped.load();
-          };
+    auto busyStart = dxvk::high_resolution_clock::now();
 
-          if (unlikely(!pred())) {
+    try {
+      while (!m_stopped.load()) {
+        if (unlikely(!tryPopChunk(entry, queue))) {
+          std::unique_lock<dxvk::mutex> lock(m_mutex);
+
+          // If we have been idle a lot recently, ask producers to
+          // dispatch small chunks so that we can start working
+          // early. Otherwise, only dispatch when chunks are full
+          // since waking up the worker has a cost as well.
+          uint32_t threshold = MaxEarlyDispatch - ((MaxEarlyDispatch - MinEarlyDispatch) * idleFraction) / 256u;
+          m_dispatchThreshold.store(threshold, std::memory_order_relaxed);
+
+          // Announce that we are about to sleep, then check the
+          // queues again so that no producer can miss the flag.
+          m_consumerWaiting.store(true, std::memory_order_relaxed);
+          std::atomic_thread_fence(std::memory_order_seq_cst);
+
+          if (tryPopChunk(entry, queue)) {
+            m_consumerWaiting.store(false, std::memory_order_relaxed);
+            m_dispatchThreshold.store(NoEarlyDispatch, std::memory_order_relaxed);
+          } else {
             auto t0 = dxvk::high_resolution_clock::now();
 
-            m_condOnAdd.wait(lock, [&] {
-              return pred();
+            m_condOnAdd.wait(lock, [this] {
+              return !m_consumerWaiting.load(std::memory_order_relaxed)
+                  || m_stopped.load();
             });
 
+            m_consumerWaiting.store(false, std::memory_order_relaxed);
+            m_dispatchThreshold.store(NoEarlyDispatch, std::memory_order_relaxed);
+
             auto t1 = dxvk::high_resolution_clock::now();
-            m_device->addStatCtr(DxvkStatCounter::CsIdleTicks, std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count());
+
+            auto busyUs = std::chrono::duration_cast<std::chrono::microseconds>(t0 - busyStart).count();
+            auto idleUs = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+
+            if (busyUs + idleUs > 0) {
+              uint32_t sample = uint32_t((256u * uint64_t(idleUs)) / uint64_t(busyUs + idleUs));
+              idleFraction = (7u * idleFraction + sample) / 8u;
+            }
+
+            busyStart = t1;
+
+            m_device->addStatCtr(DxvkStatCounter::CsIdleTicks, idleUs);
+            continue;
           }
+        }
+
+        m_context->addStatCtr(DxvkStatCounter::CsChunkCount, 1);
+
+        entry.chunk->executeAll(m_context.ptr());
 
-          std::swap(ordered, m_queueOrdered.queue);
-          std::swap(highPrio, m_queueHighPrio.queue);
+        if (entry.seq)
+          signalCounter(queue, entry.seq);
 
-          m_hasHighPrio.store(false, std::memory_order_release);
+        // Immediately free the chunk to release
+        // references to any resources held by it
+        entry.chunk = DxvkCsChunkRef();
+
+        // Forward accumulated enqueue latency to the context, this
+        // avoids having producers contend on the device stat lock.
+        // Only forward whole microseconds and keep the remainder.
+        uint64_t enqueueUs = m_enqueueNs.load(std::memory_order_relaxed) / 1000u;
+
+        if (enqueueUs) {
+          m_enqueueNs.fetch_sub(enqueueUs * 1000u, std::memory_order_relaxed);
+          m_context->addStatCtr(DxvkStatCounter::CsEnqueueTicks, enqueueUs);
         }
+      }
+    } catch (const DxvkError& e) {
+      Logger::err("Exception on CS thread!");
+      Logger::err(e.message());
+    }
+  }
 
-        size_t orderedIndex = 0u;
-        size_t highPrioIndex = 0u;
 
-        while (highPrioIndex < highPrio.size() || orderedIndex < ordered.size()) {
-          // Re-fill local high-priority queue if the app has queued anything up
-          // in the meantime, we want to reduce possible synchronization delays.
-          if (highPrioIndex >= highPrio.size() && m_hasHighPrio.load(std::memory_order_acquire)) {
-            highPrio.clear();
-            highPrioIndex = 0u;
+  DxvkCsWorkerJob::DxvkCsWorkerJob(
+          std::vector<DxvkCsChunkRef>&& chunks)
+  : m_chunks(std::move(chunks)) {
 
-            std::unique_lock<dxvk::mutex> lock(m_mutex);
-            std::swap(highPrio, m_queueHighPrio.queue);
+  }
 
-            m_hasHighPrio.store(false, std::memory_order_release);
-          }
 
-          // Drain high-priority queue first
-          bool isHighPrio = highPrioIndex < highPrio.size();
-          auto& entry = isHighPrio ? highPrio[highPrioIndex++] : ordered[orderedIndex++];
+  DxvkCsWorkerJob::~DxvkCsWorkerJob() {
 
-          m_context->addStatCtr(DxvkStatCounter::CsChunkCount, 1);
+  }
 
-          entry.chunk->executeAll(m_context.ptr());
 
-          if (entry.seq) {
-            // Use a separate mutex for the chunk counter, this will only
-            // ever be contested if synchronization is actually necessary.
-            std::lock_guard lock(m_counterMutex);
+  void DxvkCsWorkerJob::execute(DxvkContext* ctx) {
+    for (const auto& chunk : m_chunks)
+      chunk->executeAll(ctx);
+  }
 
-            auto& counter = isHighPrio ? m_seqHighPrio : m_seqOrdered;
-            counter.store(entry.seq, std::memory_order_release);
 
-            m_condOnSync.notify_one();
-          }
+  void DxvkCsWorkerJob::complete(Rc<DxvkCommandList>&& cmdList) {
+    std::lock_guard lock(m_mutex);
+    m_cmdList = std::move(cmdList);
+    m_complete = true;
+    m_cond.notify_one();
+  }
+
+
+  Rc<DxvkCommandList> DxvkCsWorkerJob::wait() {
+    std::unique_lock lock(m_mutex);
+    m_cond.wait(lock, [this] { return m_complete; });
+    return std::move(m_cmdList);
+  }
+
+
+  DxvkCsWorkerBatch::DxvkCsWorkerBatch(DxvkCsWorkerPool* pool)
+  : m_pool(pool) {
+
+  }
+
+
+  DxvkCsWorkerBatch::~DxvkCsWorkerBatch() {
+
+  }
+
+
+  void DxvkCsWorkerBatch::addJob(const Rc<DxvkCsWorkerJob>& job) {
+    std::lock_guard lock(m_mutex);
+    m_jobs.push_back(job);
+  }
+
+
+  void DxvkCsWorkerBatch::executeJob(
+          DxvkContext*              ctx,
+    const Rc<DxvkCsWorkerJob>&      job) {
+    // Prevent relocations until all command lists
+    // recorded by workers have been submitted
+    if (!m_recording) {
+      m_pool->device()->beginConcurrentRecording();
+      m_recording = true;
+    }
 
-          // Immediately free the chunk to release
-          // references to any resources held by it
-          entry.chunk = DxvkCsChunkRef();
+    dispatch();
+
+    Rc<DxvkCommandList> cmdList = job->wait();
+
+    if (likely(cmdList != nullptr)) {
+      m_cmdLists.push_back(std::move(cmdList));
+    } else {
+      // Submit everything recorded so far in order to
+      // preserve ordering, then replay the job locally
+      ctx->submitCommandLists(std::move(m_cmdLists));
+      m_cmdLists.clear();
+
+      job->execute(ctx);
+    }
+  }
+
+
+  void DxvkCsWorkerBatch::submit(
+          DxvkContext*              ctx) {
+    ctx->submitCommandLists(std::move(m_cmdLists));
+    m_cmdLists.clear();
+
+    // Any deferred relocations will be recorded into the
+    // next command list, which executes after the batch
+    if (m_recording) {
+      m_pool->device()->endConcurrentRecording();
+      m_recording = false;
+    }
+  }
+
+
+  void DxvkCsWorkerBatch::dispatch() {
+    std::lock_guard lock(m_mutex);
+
+    while (m_dispatched < m_jobs.size())
+      m_pool->dispatchJob(std::move(m_jobs[m_dispatched++]));
+  }
+
+
+  DxvkCsWorkerPool::DxvkCsWorkerPool(
+    const Rc<DxvkDevice>&           device,
+          uint32_t                  threadCount,
+          DxvkBarrierControlFlags   barrierControl)
+  : m_device(device), m_barrierControl(barrierControl) {
+    Logger::info(str::format("DXVK: Using ", threadCount, " command list worker threads"));
+
+    for (uint32_t i = 0; i < threadCount; i++)
+      m_threads.emplace_back([this] { threadFunc(); });
+  }
+
+
+  DxvkCsWorkerPool::~DxvkCsWorkerPool() {
+    { std::lock_guard lock(m_mutex);
+      m_stopped = true;
+      m_cond.notify_all();
+    }
+
+    for (auto& thread : m_threads)
+      thread.join();
+  }
+
+
+  void DxvkCsWorkerPool::dispatchJob(Rc<DxvkCsWorkerJob>&& job) {
+    std::lock_guard lock(m_mutex);
+    m_jobs.push(std::move(job));
+    m_cond.notify_one();
+  }
+
+
+  void DxvkCsWorkerPool::threadFunc() {
+    env::setThreadName("dxvk-cs-worker");
+
+    Rc<DxvkContext> context;
+
+    while (true) {
+      Rc<DxvkCsWorkerJob> job;
+
+      { std::unique_lock lock(m_mutex);
+
+        m_cond.wait(lock, [this] {
+          return m_stopped || !m_jobs.empty();
+        });
+
+        if (m_stopped)
+          break;
+
+        job = std::move(m_jobs.front());
+        m_jobs.pop();
+      }
+
+      try {
+        if (context == nullptr) {
+          context = m_device->createContext(DxvkContextType::Worker);
+          context->beginRecording(m_device->createCommandList());
         }
 
-        ordered.clear();
-        highPrio.clear();
+        // Command lists start with a clean binding state, but barrier
+        // control may have been changed by a previous job.
+        context->setBarrierControl(m_barrierControl);
+
+        job->execute(context.ptr());
+        job->complete(context->finishCommandList());
+      } catch (const DxvkError& e) {
+        Logger::err("Exception on CS worker thread!");
+        Logger::err(e.message());
+
+        // The context may be in an inconsistent state, so discard
+        // it and let the CS thread execute the job instead.
+        context = nullptr;
+        job->complete(nullptr);
       }
-    } catch (const DxvkError& e) {
-      Logger::err("Exception on CS thread!");
-      Logger::err(e.message());
     }
   }
-  
+
 }
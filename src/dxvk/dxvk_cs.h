@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
@@ -208,6 +209,14 @@ namespace dxvk {
       return m_commandOffset == 0;
     }
 
+    /**
+     * \brief Queries number of recorded commands
+     * \returns Number of commands in the chunk
+     */
+    uint32_t commandCount() const {
+      return m_commandCount;
+    }
+
     /**
      * \brief Tries to add a command to the chunk
      * 
@@ -321,6 +330,7 @@ namespace dxvk {
   private:
     
     size_t m_commandOffset = 0;
+    uint32_t m_commandCount = 0;
     
     DxvkCsCmd*  m_head = nullptr;
     DxvkCsCmd** m_next = &m_head;
@@ -346,6 +356,8 @@ namespace dxvk {
     void append(DxvkCsCmd* cmd) {
       *m_next = cmd;
       m_next = cmd->chain();
+
+      m_commandCount += 1u;
     }
     
   };
@@ -495,12 +507,87 @@ namespace dxvk {
   /**
    * \brief Chunk queue
    *
-   * Stores queued chunks as well as the sequence
-   * counters for synchronization.
+   * Bounded lock-free ring buffer that supports any number of
+   * producers, but only a single consumer. Each slot stores a
+   * marker that indicates whether the slot is free or holds a
+   * chunk for the current ring position, so that producers only
+   * need to contend on a single atomic when reserving a slot.
+   *
+   * The write position is packed together with the sequence
+   * counter, so that sequence numbers are assigned in the same
+   * order in which chunks will be consumed.
    */
-  struct DxvkCsChunkQueue {
-    std::vector<DxvkCsQueuedChunk> queue;
-    uint64_t                       seqDispatch = 0u;
+  class DxvkCsChunkQueue {
+    constexpr static uint32_t PosBits = 24u;
+    constexpr static uint64_t PosMask = (1ull << PosBits) - 1u;
+  public:
+
+    /// Maximum number of chunks that can be queued at any given time.
+    /// Must be a power of two that is smaller than the position range.
+    constexpr static uint32_t Capacity = 1024u;
+
+    DxvkCsChunkQueue();
+
+    ~DxvkCsChunkQueue();
+
+    /**
+     * \brief Tries to add a chunk to the queue
+     *
+     * Safe to call from multiple threads concurrently.
+     * \param [in] chunk The chunk to add. Will only be consumed
+     *    if the function succeeds.
+     * \param [in] sequenced Whether to assign a new sequence number
+     *    to the chunk. Otherwise, the chunk will not increment the
+     *    sequence counter when executed.
+     * \param [out] seq Sequence number of the chunk if sequenced,
+     *    otherwise the current sequence number.
+     * \returns \c false if the queue is full
+     */
+    bool tryPush(
+            DxvkCsChunkRef&&  chunk,
+            bool              sequenced,
+            uint64_t&         seq);
+
+    /**
+     * \brief Tries to remove the oldest chunk from the queue
+     *
+     * Must only be called from the consumer thread.
+     * \param [out] entry Chunk and sequence number
+     * \returns \c false if the queue is empty
+     */
+    bool tryPop(
+            DxvkCsQueuedChunk& entry);
+
+    /**
+     * \brief Queries sequence number of last queued chunk
+     *
+     * Chunks may still be in the process of being written to
+     * the queue, but will be available for the consumer soon.
+     * \returns Most recently assigned sequence number
+     */
+    uint64_t seqDispatch() const {
+      return m_state.load(std::memory_order_acquire) >> PosBits;
+    }
+
+  private:
+
+    struct Slot {
+      std::atomic<uint32_t> marker = { 0u };
+      DxvkCsQueuedChunk     entry = { };
+    };
+
+    alignas(CACHE_LINE_SIZE)
+    std::atomic<uint64_t>   m_state = { 0u };
+
+    alignas(CACHE_LINE_SIZE)
+    uint32_t                m_readPos = 0u;
+
+    std::array<Slot, Capacity> m_slots;
+
+    static int32_t posDiff(uint32_t a, uint32_t b) {
+      return int32_t((a - b) << (32u - PosBits)) >> (32u - PosBits);
+    }
+
   };
 
 
@@ -511,7 +598,11 @@ namespace dxvk {
    * commands on a DXVK context. 
    */
   class DxvkCsThread {
-
+    /// Early dispatch thresholds, in commands per chunk. The
+    /// maximum is reached when the worker is never idle.
+    constexpr static uint32_t MinEarlyDispatch = 16u;
+    constexpr static uint32_t MaxEarlyDispatch = 256u;
+    constexpr static uint32_t NoEarlyDispatch = ~0u;
   public:
 
     constexpr static uint64_t SynchronizeAll = ~0ull;
@@ -569,6 +660,21 @@ namespace dxvk {
       return m_seqOrdered.load(std::memory_order_acquire);
     }
 
+    /**
+     * \brief Queries early dispatch threshold
+     *
+     * While the worker is waiting for work, callers should dispatch
+     * partially filled chunks as soon as they contain this many
+     * commands, so that the worker can start executing them early.
+     * The threshold adapts to the share of time the worker spent idle
+     * recently. While the worker is busy, this returns a value that no
+     * chunk can reach, so that chunks are only dispatched when full.
+     * \returns Minimum command count for early dispatch
+     */
+    uint32_t dispatchThreshold() const {
+      return m_dispatchThreshold.load(std::memory_order_relaxed);
+    }
+
   private:
 
     Rc<DxvkDevice>              m_device;
@@ -576,17 +682,28 @@ namespace dxvk {
 
     alignas(CACHE_LINE_SIZE)
     dxvk::mutex                 m_counterMutex;
+    dxvk::condition_variable    m_condOnSync;
 
     std::atomic<uint64_t>       m_seqHighPrio = { 0u };
     std::atomic<uint64_t>       m_seqOrdered  = { 0u };
+    std::atomic<uint32_t>       m_syncWaiters = { 0u };
 
     std::atomic<bool>           m_stopped     = { false };
-    std::atomic<bool>           m_hasHighPrio = { false };
 
+    // Wake-ups are only signaled through the mutex and
+    // condition variables if the respective flag or wait
+    // counter indicates that any thread is actually waiting.
     alignas(CACHE_LINE_SIZE)
     dxvk::mutex                 m_mutex;
     dxvk::condition_variable    m_condOnAdd;
-    dxvk::condition_variable    m_condOnSync;
+    dxvk::condition_variable    m_condOnSpace;
+
+    std::atomic<bool>           m_consumerWaiting = { false };
+    std::atomic<uint32_t>       m_producerWaiters = { 0u };
+    std::atomic<uint32_t>       m_dispatchThreshold = { NoEarlyDispatch };
+
+    alignas(CACHE_LINE_SIZE)
+    std::atomic<uint64_t>       m_enqueueNs = { 0u };
 
     DxvkCsChunkQueue            m_queueOrdered;
     DxvkCsChunkQueue            m_queueHighPrio;
@@ -603,8 +720,199 @@ namespace dxvk {
         ? m_seqOrdered : m_seqHighPrio;
     }
 
+    uint64_t enqueueChunk(
+            DxvkCsQueue       queue,
+            DxvkCsChunkRef&&  chunk,
+            bool              sequenced);
+
+    void waitForCounter(
+            DxvkCsQueue       queue,
+            uint64_t          seq);
+
+    void signalCounter(
+            DxvkCsQueue       queue,
+            uint64_t          seq);
+
+    bool tryPopChunk(
+            DxvkCsQueuedChunk& entry,
+            DxvkCsQueue&      queue);
+
     void threadFunc();
     
   };
 
+
+  class DxvkCsWorkerPool;
+
+  /**
+   * \brief CS worker job
+   *
+   * Stores a list of chunks to be executed on a worker
+   * context, and the command list recorded from them.
+   */
+  class DxvkCsWorkerJob : public RcObject {
+
+  public:
+
+    DxvkCsWorkerJob(
+            std::vector<DxvkCsChunkRef>&& chunks);
+
+    ~DxvkCsWorkerJob();
+
+    /**
+     * \brief Executes all chunks
+     *
+     * Called on the worker thread. The caller must
+     * have begun recording a command list.
+     * \param [in] ctx Worker context
+     */
+    void execute(DxvkContext* ctx);
+
+    /**
+     * \brief Stores recorded command list
+     *
+     * Wakes up any thread that is waiting for the job to
+     * complete. Chunks are kept alive until the job is
+     * destroyed so that they can be replayed on failure.
+     * \param [in] cmdList Recorded command list, or
+     *    \c nullptr if recording the commands failed
+     */
+    void complete(Rc<DxvkCommandList>&& cmdList);
+
+    /**
+     * \brief Waits for the job to complete
+     * \returns Recorded command list, or \c nullptr
+     *    if the job failed on the worker thread
+     */
+    Rc<DxvkCommandList> wait();
+
+  private:
+
+    std::vector<DxvkCsChunkRef> m_chunks;
+
+    dxvk::mutex                 m_mutex;
+    dxvk::condition_variable    m_cond;
+    Rc<DxvkCommandList>         m_cmdList;
+    bool                        m_complete = false;
+
+  };
+
+
+  /**
+   * \brief CS worker batch
+   *
+   * Groups jobs that do not depend on any commands executed
+   * between them on the main context. Once the main context
+   * reaches the first job of a batch, all jobs added to the
+   * batch so far can be executed concurrently. The resulting
+   * command lists are submitted together with the main context's
+   * command list once the batch is complete.
+   */
+  class DxvkCsWorkerBatch : public RcObject {
+
+  public:
+
+    DxvkCsWorkerBatch(DxvkCsWorkerPool* pool);
+
+    ~DxvkCsWorkerBatch();
+
+    /**
+     * \brief Adds a job to the batch
+     *
+     * Jobs can be added even after the batch has been
+     * dispatched, as long as the main context has not
+     * executed any other commands since the last job.
+     * \param [in] job Job to add
+     */
+    void addJob(const Rc<DxvkCsWorkerJob>& job);
+
+    /**
+     * \brief Waits for a job and collects its command list
+     *
+     * Called on the CS thread. Hands all jobs that have not been
+     * dispatched yet over to the worker pool, then waits for the
+     * given job. If the job failed on the worker, its commands
+     * are executed on the main context instead.
+     * \param [in] ctx Main context
+     * \param [in] job Job to wait for
+     */
+    void executeJob(
+            DxvkContext*              ctx,
+      const Rc<DxvkCsWorkerJob>&      job);
+
+    /**
+     * \brief Submits collected command lists
+     *
+     * Called on the CS thread after the last job of the batch
+     * has been executed. Submits the main context's command list
+     * together with all command lists recorded by workers.
+     * \param [in] ctx Main context
+     */
+    void submit(
+            DxvkContext*              ctx);
+
+  private:
+
+    DxvkCsWorkerPool*                 m_pool;
+
+    dxvk::mutex                       m_mutex;
+    std::vector<Rc<DxvkCsWorkerJob>>  m_jobs;
+    size_t                            m_dispatched = 0u;
+
+    bool                              m_recording = false;
+    std::vector<Rc<DxvkCommandList>>  m_cmdLists;
+
+    void dispatch();
+
+  };
+
+
+  /**
+   * \brief CS worker pool
+   *
+   * Spawns threads with their own worker contexts, which
+   * translate CS chunks into command lists that the main
+   * context then submits in order.
+   */
+  class DxvkCsWorkerPool {
+
+  public:
+
+    DxvkCsWorkerPool(
+      const Rc<DxvkDevice>&           device,
+            uint32_t                  threadCount,
+            DxvkBarrierControlFlags   barrierControl);
+
+    ~DxvkCsWorkerPool();
+
+    /**
+     * \brief Queries device
+     * \returns Device
+     */
+    const Rc<DxvkDevice>& device() const {
+      return m_device;
+    }
+
+    /**
+     * \brief Queues a job for execution
+     * \param [in] job The job to execute
+     */
+    void dispatchJob(Rc<DxvkCsWorkerJob>&& job);
+
+  private:
+
+    Rc<DxvkDevice>                    m_device;
+    DxvkBarrierControlFlags           m_barrierControl;
+
+    dxvk::mutex                       m_mutex;
+    dxvk::condition_variable          m_cond;
+    std::queue<Rc<DxvkCsWorkerJob>>   m_jobs;
+    bool                              m_stopped = false;
+
+    std::vector<dxvk::thread>         m_threads;
+
+    void threadFunc();
+
+  };
+
 }
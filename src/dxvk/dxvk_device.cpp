@@ -4,6 +4,7 @@
 #include "dxvk_latency_reflex.h"
 #include "dxvk_shader_cache.h"
 #include "dxvk_shader_ir.h"
+#include "dxvk_telemetry.h"
 
 namespace dxvk {
   
@@ -29,6 +30,15 @@ namespace dxvk {
 
     if (env::getEnvVar("DXVK_SHADER_CACHE") != "0" && DxvkShader::getShaderDumpPath().empty())
       m_shaderCache = DxvkShaderCache::getInstance();
+
+    std::string telemetryPath = DxvkTelemetryWriter::getFilePath();
+
+    if (!telemetryPath.empty()) {
+      m_telemetry = std::make_unique<DxvkTelemetryWriter>(telemetryPath);
+
+      if (!m_telemetry->isValid())
+        m_telemetry = nullptr;
+    }
   }
   
   
@@ -113,6 +123,21 @@ namespace dxvk {
   }
 
 
+  bool DxvkDevice::canUseHostImageCopy(VkImageLayout layout) const {
+    if (!m_features.extHostImageCopy.hostImageCopy)
+      return false;
+
+    const auto& properties = m_properties.extHostImageCopy;
+
+    for (uint32_t i = 0; i < properties.copyDstLayoutCount; i++) {
+      if (properties.pCopyDstLayouts[i] == layout)
+        return true;
+    }
+
+    return false;
+  }
+
+
   bool DxvkDevice::mustTrackPipelineLifetime() const {
     switch (m_options.trackPipelineLifetime) {
       case Tristate::True:
@@ -171,8 +196,9 @@ namespace dxvk {
   }
 
 
-  Rc<DxvkContext> DxvkDevice::createContext() {
-    return new DxvkContext(this);
+  Rc<DxvkContext> DxvkDevice::createContext(
+          DxvkContextType           type) {
+    return new DxvkContext(this, type);
   }
 
 
@@ -223,8 +249,9 @@ namespace dxvk {
 
   DxvkLocalAllocationCache DxvkDevice::createAllocationCache(
           VkBufferUsageFlags    bufferUsage,
-          VkMemoryPropertyFlags propertyFlags) {
-    return m_objects.memoryManager().createAllocationCache(bufferUsage, propertyFlags);
+          VkMemoryPropertyFlags propertyFlags,
+          uint32_t              refillCount) {
+    return m_objects.memoryManager().createAllocationCache(bufferUsage, propertyFlags, refillCount);
   }
 
 
@@ -484,9 +511,19 @@ namespace dxvk {
     const Rc<DxvkIrShaderConverter>&      converter) {
     Rc<DxvkIrShader> shader = nullptr;
 
-    if (m_shaderCache && !converter)
+    if (m_shaderCache && !converter) {
+      auto t0 = dxvk::high_resolution_clock::now();
+
       shader = m_shaderCache->lookupShader(name, createInfo);
 
+      auto t1 = dxvk::high_resolution_clock::now();
+      auto us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0);
+
+      std::lock_guard<sync::Spinlock> lock(m_statLock);
+      m_statCounters.addCtr(shader ? DxvkStatCounter::ShaderCacheHits : DxvkStatCounter::ShaderCacheMisses, 1u);
+      m_statCounters.addCtr(DxvkStatCounter::ShaderCacheTicks, us.count());
+    }
+
     if (!shader && converter) {
       shader = new DxvkIrShader(createInfo, converter);
 
@@ -575,8 +612,12 @@ namespace dxvk {
 
     m_submissionQueue.present(presentInfo, latencyInfo, status);
     
-    std::lock_guard<sync::Spinlock> statLock(m_statLock);
-    m_statCounters.addCtr(DxvkStatCounter::QueuePresentCount, 1);
+    { std::lock_guard<sync::Spinlock> statLock(m_statLock);
+      m_statCounters.addCtr(DxvkStatCounter::QueuePresentCount, 1);
+    }
+
+    if (unlikely(m_telemetry))
+      recordTelemetry(tracker, frameId);
   }
 
 
@@ -656,6 +697,41 @@ namespace dxvk {
   }
   
   
+  void DxvkDevice::recordTelemetry(
+    const Rc<DxvkLatencyTracker>&   tracker,
+          uint64_t                  frameId) {
+    DxvkStatCounters counters = getStatCounters();
+
+    DxvkTelemetryFrame frame = { };
+    frame.frameId = frameId;
+
+    for (uint32_t i = 0; i < uint32_t(DxvkStatCounter::NumCounters); i++)
+      frame.counters[i] = counters.getCtr(DxvkStatCounter(i));
+
+    if (tracker != nullptr) {
+      DxvkLatencyStats latency = tracker->getStatistics(frameId);
+      frame.frameLatency = latency.frameLatency.count();
+      frame.sleepDuration = latency.sleepDuration.count();
+    }
+
+    DxvkSharedAllocationCacheStats cache = m_objects.memoryManager().getAllocationCacheStats();
+    frame.cacheRequests = cache.requestCount;
+    frame.cacheMisses = cache.missCount;
+    frame.cacheSize = cache.size;
+
+    frame.heapCount = m_adapter->memoryProperties().memoryHeapCount;
+
+    for (uint32_t i = 0; i < frame.heapCount; i++) {
+      DxvkMemoryStats stats = getMemoryStats(i);
+      frame.heaps[i].allocated = stats.memoryAllocated;
+      frame.heaps[i].used = stats.memoryUsed;
+      frame.heaps[i].budget = stats.memoryBudget;
+    }
+
+    m_telemetry->record(frame);
+  }
+
+
   DxvkDevicePerfHints DxvkDevice::getPerfHints() {
     DxvkDevicePerfHints hints;
 
@@ -29,6 +29,7 @@ namespace dxvk {
   
   class DxvkInstance;
   class DxvkShaderCache;
+  class DxvkTelemetryWriter;
 
   class DxvkIrShader;
   class DxvkIrShaderConverter;
@@ -290,6 +291,15 @@ namespace dxvk {
       return m_features.extDescriptorBuffer.descriptorBuffer;
     }
 
+    /**
+     * \brief Checks whether host image copies can be used
+     *
+     * \param [in] layout Layout that the image will be copied in
+     * \returns \c true if host image copy is enabled and the given
+     *    layout is supported as a destination layout for host copies.
+     */
+    bool canUseHostImageCopy(VkImageLayout layout) const;
+
     /**
      * \brief Queries default framebuffer size
      * \returns Default framebuffer size
@@ -321,9 +331,54 @@ namespace dxvk {
      * 
      * Creates a context object that can
      * be used to record command buffers.
+     * \param [in] type Context type
      * \returns The context object
      */
-    Rc<DxvkContext> createContext();
+    Rc<DxvkContext> createContext(
+            DxvkContextType           type = DxvkContextType::Primary);
+
+    /**
+     * \brief Allocates a command list tracking ID
+     *
+     * Tracking IDs are unique across all contexts created
+     * from this device, so that resources used by command
+     * lists recorded on different contexts can never be
+     * mistaken for being tracked by the wrong command list.
+     * \returns New tracking ID
+     */
+    uint64_t allocTrackingId() {
+      return m_trackingId.fetch_add(1u, std::memory_order_relaxed) + 1u;
+    }
+
+    /**
+     * \brief Marks start of concurrent command recording
+     *
+     * While worker contexts are recording, no context may relocate
+     * resources, since that would change resource storage that the
+     * workers may already have recorded commands for.
+     */
+    void beginConcurrentRecording() {
+      m_concurrentRecordings.fetch_add(1u, std::memory_order_acquire);
+    }
+
+    /**
+     * \brief Marks end of concurrent command recording
+     *
+     * Must only be called once all command lists recorded on
+     * worker contexts have been submitted. Deferred relocations
+     * will then be performed on the next submission.
+     */
+    void endConcurrentRecording() {
+      m_concurrentRecordings.fetch_sub(1u, std::memory_order_release);
+    }
+
+    /**
+     * \brief Checks whether worker contexts are recording
+     * \returns \c true if relocations must be deferred
+     */
+    bool hasConcurrentRecording() const {
+      return m_concurrentRecordings.load(std::memory_order_acquire) != 0u;
+    }
 
     /**
      * \brief Creates a GPU event
@@ -398,11 +453,13 @@ namespace dxvk {
      *
      * \param [in] bufferUsage Required buffer usage
      * \param [in] propertyFlags Memory properties
+     * \param [in] refillCount Number of allocation lists per refill
      * \returns Allocation cache object
      */
     DxvkLocalAllocationCache createAllocationCache(
             VkBufferUsageFlags    bufferUsage,
-            VkMemoryPropertyFlags propertyFlags);
+            VkMemoryPropertyFlags propertyFlags,
+            uint32_t              refillCount);
 
     /**
      * \brief Creates a sparse page allocator
@@ -719,12 +776,21 @@ namespace dxvk {
 
     DxvkRecycler<DxvkCommandList, 16> m_recycledCommandLists;
 
+    std::atomic<uint64_t>       m_trackingId = { 0u };
+    std::atomic<uint32_t>       m_concurrentRecordings = { 0u };
+
     DxvkSubmissionQueue         m_submissionQueue;
 
     Rc<DxvkShaderCache>         m_shaderCache;
 
+    std::unique_ptr<DxvkTelemetryWriter> m_telemetry;
+
     DxvkDevicePerfHints getPerfHints();
 
+    void recordTelemetry(
+      const Rc<DxvkLatencyTracker>&   tracker,
+            uint64_t                  frameId);
+
     void recycleCommandList(
       const Rc<DxvkCommandList>& cmdList);
 
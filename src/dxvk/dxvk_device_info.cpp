@@ -27,6 +27,7 @@ namespace dxvk {
     HANDLE_EXT(extFullScreenExclusive);            \
     HANDLE_EXT(extGraphicsPipelineLibrary);        \
     HANDLE_EXT(extHdrMetadata);                    \
+    HANDLE_EXT(extHostImageCopy);                  \
     HANDLE_EXT(extLineRasterization);              \
     HANDLE_EXT(extMemoryBudget);                   \
     HANDLE_EXT(extMemoryPriority);                 \
@@ -64,6 +65,7 @@ namespace dxvk {
     HANDLE_EXT(extDescriptorBuffer);               \
     HANDLE_EXT(extExtendedDynamicState3);          \
     HANDLE_EXT(extGraphicsPipelineLibrary);        \
+    HANDLE_EXT(extHostImageCopy);                  \
     HANDLE_EXT(extLineRasterization);              \
     HANDLE_EXT(extMultiDraw);                      \
     HANDLE_EXT(extRobustness2);                    \
@@ -382,6 +384,30 @@ namespace dxvk {
 
     m_properties.driverVersion = decodeDriverVersion(
       m_properties.vk12.driverID, m_properties.core.properties.driverVersion);
+
+    // The first query only returns the number of supported host image
+    // copy layouts, so query the actual layout arrays separately.
+    if (m_extensionsSupported.extHostImageCopy.specVersion) {
+      m_hostImageCopySrcLayouts.resize(m_properties.extHostImageCopy.copySrcLayoutCount);
+      m_hostImageCopyDstLayouts.resize(m_properties.extHostImageCopy.copyDstLayoutCount);
+
+      VkPhysicalDeviceHostImageCopyPropertiesEXT hostImageCopy = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT };
+      hostImageCopy.copySrcLayoutCount = m_hostImageCopySrcLayouts.size();
+      hostImageCopy.pCopySrcLayouts = m_hostImageCopySrcLayouts.data();
+      hostImageCopy.copyDstLayoutCount = m_hostImageCopyDstLayouts.size();
+      hostImageCopy.pCopyDstLayouts = m_hostImageCopyDstLayouts.data();
+
+      VkPhysicalDeviceProperties2 properties = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &hostImageCopy };
+      vk->vkGetPhysicalDeviceProperties2(adapter, &properties);
+
+      m_hostImageCopySrcLayouts.resize(hostImageCopy.copySrcLayoutCount);
+      m_hostImageCopyDstLayouts.resize(hostImageCopy.copyDstLayoutCount);
+
+      m_properties.extHostImageCopy.copySrcLayoutCount = m_hostImageCopySrcLayouts.size();
+      m_properties.extHostImageCopy.pCopySrcLayouts = m_hostImageCopySrcLayouts.data();
+      m_properties.extHostImageCopy.copyDstLayoutCount = m_hostImageCopyDstLayouts.size();
+      m_properties.extHostImageCopy.pCopyDstLayouts = m_hostImageCopyDstLayouts.data();
+    }
   }
 
 
@@ -459,6 +485,16 @@ namespace dxvk {
       m_featuresSupported.nvLowLatency2 = VK_FALSE;
     }
 
+    // Host image copy requires images to be created with an additional usage
+    // flag, only use it if that does not affect memory type selection.
+    if (m_featuresSupported.extHostImageCopy.hostImageCopy) {
+      bool enableHostImageCopy = m_properties.extHostImageCopy.identicalMemoryTypeRequirements;
+      applyTristate(enableHostImageCopy, instance.options().enableHostImageCopy);
+
+      if (!enableHostImageCopy)
+        m_featuresSupported.extHostImageCopy.hostImageCopy = VK_FALSE;
+    }
+
     // EXT_multi_draw is broken on proprietary qcom on some devices
     if (m_properties.vk12.driverID == VK_DRIVER_ID_QUALCOMM_PROPRIETARY)
       m_featuresSupported.extMultiDraw.multiDraw = VK_FALSE;
@@ -825,6 +861,9 @@ namespace dxvk {
       /* HDR metadata */
       ENABLE_EXT(extHdrMetadata, false),
 
+      /* Host image copy, used to upload initial texture data from the CPU */
+      ENABLE_EXT_FEATURE(extHostImageCopy, hostImageCopy, false),
+
       /* Line rasterization features for client APIs */
       ENABLE_EXT_FEATURE(extLineRasterization, rectangularLines,  false),
       ENABLE_EXT_FEATURE(extLineRasterization, smoothLines, false),
@@ -996,6 +996,7 @@ namespace dxvk {
     m_manager       (pipeMgr),
     m_workers       (&pipeMgr->m_workers),
     m_stats         (&pipeMgr->m_stats),
+    m_stateCache    (&pipeMgr->m_stateCache),
     m_shaders       (std::move(shaders)),
     m_layout        (device, pipeMgr, buildPipelineLayout()),
     m_barrier       (m_layout.getGlobalBarrier()),
@@ -1081,6 +1082,11 @@ namespace dxvk {
         // If necessary, compile an optimized pipeline variant
         if (!instance->fastHandle.load())
           m_workers->compileGraphicsPipeline(this, state, DxvkPipelinePriority::Low);
+
+        // Only store pipelines in the state cache that cannot benefit
+        // from pipeline libraries, or if that feature is disabled.
+        if (!canCreateBasePipeline)
+          m_stateCache->addGraphicsPipeline(m_shaders, state);
       }
     }
 
@@ -15,6 +15,7 @@ namespace dxvk {
   class DxvkDevice;
   class DxvkPipelineManager;
   class DxvkPipelineWorkers;
+  class DxvkStateCache;
 
   struct DxvkGraphicsPipelineShaders;
   struct DxvkPipelineStats;
@@ -594,6 +595,7 @@ namespace dxvk {
     DxvkPipelineManager*        m_manager;
     DxvkPipelineWorkers*        m_workers;
     DxvkPipelineStats*          m_stats;
+    DxvkStateCache*             m_stateCache;
 
     DxvkGraphicsPipelineShaders m_shaders;
     DxvkPipelineBindings        m_layout;
@@ -46,7 +46,7 @@ namespace dxvk {
 
 
   DxvkResourceBufferViewMap::~DxvkResourceBufferViewMap() {
-    auto vk = m_device->vkd();
+    auto vk = m_vkd;
 
     for (const auto& view : m_views) {
       if (view.first.format)
@@ -65,7 +65,7 @@ namespace dxvk {
     if (entry != m_views.end())
       return &entry->second;
 
-    auto vk = m_device->vkd();
+    auto vk = m_vkd;
 
     auto& descriptor = m_views.emplace(std::piecewise_construct,
       std::tuple(key), std::tuple()).first->second;
@@ -147,7 +147,7 @@ namespace dxvk {
 
 
   DxvkResourceImageViewMap::~DxvkResourceImageViewMap() {
-    auto vk = m_device->vkd();
+    auto vk = m_vkd;
 
     for (const auto& view : m_views)
       vk->vkDestroyImageView(vk->device(), view.second.legacy.image.imageView, nullptr);
@@ -163,7 +163,7 @@ namespace dxvk {
     if (entry != m_views.end())
       return &entry->second;
 
-    auto vk = m_device->vkd();
+    auto vk = m_vkd;
 
     auto& descriptor = m_views.emplace(std::piecewise_construct,
       std::tuple(key), std::tuple()).first->second;
@@ -220,7 +220,7 @@ namespace dxvk {
         delete m_bufferViews;
 
       if (unlikely(m_flags.test(DxvkAllocationFlag::OwnsBuffer))) {
-        auto vk = m_allocator->device()->vkd();
+        auto vk = m_allocator->m_vkd;
         vk->vkDestroyBuffer(vk->device(), m_buffer, nullptr);
       }
     }
@@ -230,13 +230,13 @@ namespace dxvk {
         delete m_imageViews;
 
       if (likely(m_flags.test(DxvkAllocationFlag::OwnsImage))) {
-        auto vk = m_allocator->device()->vkd();
+        auto vk = m_allocator->m_vkd;
         vk->vkDestroyImage(vk->device(), m_image, nullptr);
       }
     }
 
     if (unlikely(m_flags.test(DxvkAllocationFlag::OwnsMemory))) {
-      auto vk = m_allocator->device()->vkd();
+      auto vk = m_allocator->m_vkd;
       vk->vkFreeMemory(vk->device(), m_memory, nullptr);
 
       if (unlikely(m_sparsePageTable))
@@ -395,7 +395,7 @@ namespace dxvk {
     }
 
     if (!(--pool.listCount))
-      pool.drainTime = high_resolution_clock::now();
+      pool.drainTime = m_allocator->m_backend->getCurrentTime();
 
     // Extract allocations and mark list as free
     DxvkResourceAllocation* allocation = m_lists[listIndex].head;
@@ -596,9 +596,99 @@ namespace dxvk {
 
 
 
-  DxvkMemoryAllocator::DxvkMemoryAllocator(DxvkDevice* device)
-  : m_device(device), m_sharingModeInfo(m_device->getSharingMode()) {
-    VkPhysicalDeviceMemoryProperties memInfo = m_device->adapter()->memoryProperties();
+  DxvkMemoryBackend::~DxvkMemoryBackend() {
+
+  }
+
+
+
+
+  DxvkDeviceMemoryBackend::DxvkDeviceMemoryBackend(DxvkDevice* device)
+  : m_device(device) {
+
+  }
+
+
+  DxvkDeviceMemoryBackend::~DxvkDeviceMemoryBackend() {
+
+  }
+
+
+  Rc<vk::DeviceFn> DxvkDeviceMemoryBackend::vkd() const {
+    return m_device->vkd();
+  }
+
+
+  DxvkMemoryDeviceProperties DxvkDeviceMemoryBackend::getProperties() const {
+    DxvkMemoryDeviceProperties result = { };
+    result.memory = m_device->adapter()->memoryProperties();
+    result.sharingMode = m_device->getSharingMode();
+    result.bufferImageGranularity = m_device->properties().core.properties.limits.bufferImageGranularity;
+    result.maxMemoryBudget = m_device->config().maxMemoryBudget;
+    result.enforceBudget = !m_device->isUnifiedMemoryArchitecture()
+      && m_device->properties().core.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
+    result.memoryBudget = m_device->features().extMemoryBudget;
+    result.memoryPriority = m_device->features().extMemoryPriority.memoryPriority;
+    result.pageableDeviceLocalMemory = m_device->features().extPageableDeviceLocalMemory.pageableDeviceLocalMemory;
+    result.sparseBinding = m_device->features().core.features.sparseBinding;
+    result.transformFeedback = m_device->features().extTransformFeedback.transformFeedback;
+    result.descriptorBuffer = m_device->canUseDescriptorBuffer();
+    result.debugNames = m_device->debugFlags().test(DxvkDebugFlag::Capture);
+    result.zeroMappedMemory = m_device->config().zeroMappedMemory;
+    result.enableDefrag = enableDefrag();
+    return result;
+  }
+
+
+  void DxvkDeviceMemoryBackend::getMemoryBudget(
+          VkPhysicalDeviceMemoryBudgetPropertiesEXT& budget) const {
+    VkPhysicalDeviceMemoryProperties2 memInfo = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2, &budget };
+
+    auto vki = m_device->adapter()->vki();
+    vki->vkGetPhysicalDeviceMemoryProperties2(m_device->adapter()->handle(), &memInfo);
+  }
+
+
+  void DxvkDeviceMemoryBackend::notifyMemoryStats(
+          uint32_t            heap,
+          int64_t             allocated,
+          int64_t             used) {
+    m_device->notifyMemoryStats(heap, allocated, used);
+  }
+
+
+  high_resolution_clock::time_point DxvkDeviceMemoryBackend::getCurrentTime() const {
+    return high_resolution_clock::now();
+  }
+
+
+  bool DxvkDeviceMemoryBackend::enableDefrag() const {
+    auto option = m_device->config().enableMemoryDefrag;
+
+    if (option == Tristate::Auto) {
+      // For unknown reasons, defragmentation seems to break Genshin Impact and
+      // possibly other games on ANV while working fine on other drivers even in
+      // a stress-test scenario, see https://github.com/doitsujin/dxvk/issues/4395.
+      // This issue does not seem to affect Battlemage GPUs, which have a minimum
+      // reported subgroup size of 16 as opposed to 8.
+      if (m_device->adapter()->matchesDriver(VK_DRIVER_ID_INTEL_OPEN_SOURCE_MESA))
+        return m_device->properties().vk13.minSubgroupSize >= 16u;
+
+      return true;
+    } else {
+      return option == Tristate::True;
+    }
+  }
+
+
+
+
+  DxvkMemoryAllocator::DxvkMemoryAllocator(
+          DxvkDevice*                         device,
+          std::unique_ptr<DxvkMemoryBackend>&& backend)
+  : m_device(device), m_backend(std::move(backend)),
+    m_vkd(m_backend->vkd()), m_properties(m_backend->getProperties()) {
+    const VkPhysicalDeviceMemoryProperties& memInfo = m_properties.memory;
 
     m_memTypeCount = memInfo.memoryTypeCount;
     m_memHeapCount = memInfo.memoryHeapCount;
@@ -609,8 +699,7 @@ namespace dxvk {
       heap.index = i;
       heap.memoryBudget = memInfo.memoryHeaps[i].size;
       heap.properties = memInfo.memoryHeaps[i];
-      heap.enforceBudget = !m_device->isUnifiedMemoryArchitecture()
-        && m_device->properties().core.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
+      heap.enforceBudget = m_properties.enforceBudget;
     }
 
     for (uint32_t i = 0; i < m_memTypeCount; i++) {
@@ -624,6 +713,9 @@ namespace dxvk {
       type.devicePool.maxChunkSize = determineMaxChunkSize(type, false);
       type.mappedPool.maxChunkSize = determineMaxChunkSize(type, true);
 
+      if (m_properties.measureLockTime)
+        type.mutex.enableTiming();
+
       // Uncached system memory is going to be used for large temporary allocations
       // during resource creation. Account for that by always using full-sized chunks.
       if ((type.properties.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
@@ -633,18 +725,26 @@ namespace dxvk {
 
     determineMemoryTypesWithPropertyFlags();
 
-    if (device->features().core.features.sparseBinding)
-      m_sparseMemoryTypes = determineSparseMemoryTypes(device);
+    if (m_properties.sparseBinding)
+      m_sparseMemoryTypes = determineSparseMemoryTypes();
 
     determineBufferUsageFlagsPerMemoryType();
 
     updateMemoryHeapBudgets();
+
+    std::string tracePath = DxvkMemoryTraceWriter::getFilePath();
+
+    if (!tracePath.empty()) {
+      m_trace = std::make_unique<DxvkMemoryTraceWriter>(tracePath, memInfo,
+        m_properties.bufferImageGranularity);
+
+      if (!m_trace->isValid())
+        m_trace = nullptr;
+    }
   }
   
   
   DxvkMemoryAllocator::~DxvkMemoryAllocator() {
-    auto vk = m_device->vkd();
-
     // Free all resources that are still queued up for relocation
     // before destroying any allocator structures
     m_relocations.clear();
@@ -658,12 +758,12 @@ namespace dxvk {
 
     // Now that no allocations are alive, we can free chunks
     for (uint32_t i = 0; i < m_memHeapCount; i++)
-      freeEmptyChunksInHeap(m_memHeaps[i], VkDeviceSize(-1), high_resolution_clock::time_point());
+      freeEmptyChunksInHeap(m_memHeaps[i], VkDeviceSize(-1), high_resolution_clock::time_point(), nullptr);
 
     // Ensure adapter allocation statistics are consistent
     // when the deivce is being destroyed
     for (uint32_t i = 0; i < m_memHeapCount; i++) {
-      m_device->notifyMemoryStats(i,
+      m_backend->notifyMemoryStats(i,
         -m_adapterHeapStats[i].memoryAllocated,
         -m_adapterHeapStats[i].memoryUsed);
     }
@@ -673,8 +773,6 @@ namespace dxvk {
   Rc<DxvkResourceAllocation> DxvkMemoryAllocator::allocateMemory(
     const VkMemoryRequirements&             requirements,
     const DxvkAllocationInfo&               allocationInfo) {
-    std::lock_guard<dxvk::mutex> lock(m_mutex);
-
     // If we're allocating device-local memory, only consider memory types from
     // the first reported heap. This way, we avoid falling back to HVV on systems
     // without resizeable BAR by accident.
@@ -689,6 +787,8 @@ namespace dxvk {
     for (auto typeIndex : bit::BitMask(memoryTypeMask)) {
       auto& type = m_memTypes[typeIndex];
 
+      std::lock_guard lock(type.mutex);
+
       // Use correct memory pool depending on property flags. This way we avoid
       // wasting address space on fallback allocations, or on UMA devices that
       // only expose one memory type.
@@ -776,12 +876,12 @@ namespace dxvk {
     const VkMemoryRequirements&             requirements,
     const DxvkAllocationInfo&               allocationInfo,
     const void*                             next) {
-    std::lock_guard<dxvk::mutex> lock(m_mutex);
-
     DxvkDeviceMemory memory = { };
 
     for (auto typeIndex : bit::BitMask(requirements.memoryTypeBits & getMemoryTypeMask(allocationInfo.properties))) {
       auto& type = m_memTypes[typeIndex];
+
+      std::lock_guard lock(type.mutex);
       memory = allocateDeviceMemory(type, requirements.size, next);
 
       if (likely(memory.memory != VK_NULL_HANDLE)) {
@@ -798,6 +898,39 @@ namespace dxvk {
     const VkBufferCreateInfo&         createInfo,
     const DxvkAllocationInfo&         allocationInfo,
           DxvkLocalAllocationCache*   allocationCache) {
+    if (likely(!m_trace))
+      return createBufferResourceInternal(createInfo, allocationInfo, allocationCache, nullptr);
+
+    DxvkMemoryTraceEvent event = beginTraceEvent(DxvkMemoryTraceEventType::Buffer, allocationInfo);
+    event.usage = createInfo.usage;
+
+    auto allocation = createBufferResourceInternal(createInfo, allocationInfo, allocationCache, &event);
+    recordTraceEvent(event, allocation.ptr());
+    return allocation;
+  }
+
+
+  Rc<DxvkResourceAllocation> DxvkMemoryAllocator::createImageResource(
+    const VkImageCreateInfo&          createInfo,
+    const DxvkAllocationInfo&         allocationInfo,
+    const void*                       next) {
+    if (likely(!m_trace))
+      return createImageResourceInternal(createInfo, allocationInfo, next, nullptr);
+
+    DxvkMemoryTraceEvent event = beginTraceEvent(DxvkMemoryTraceEventType::Image, allocationInfo);
+    event.usage = createInfo.usage;
+
+    auto allocation = createImageResourceInternal(createInfo, allocationInfo, next, &event);
+    recordTraceEvent(event, allocation.ptr());
+    return allocation;
+  }
+
+
+  Rc<DxvkResourceAllocation> DxvkMemoryAllocator::createBufferResourceInternal(
+    const VkBufferCreateInfo&         createInfo,
+    const DxvkAllocationInfo&         allocationInfo,
+          DxvkLocalAllocationCache*   allocationCache,
+          DxvkMemoryTraceEvent*       event) {
     Rc<DxvkResourceAllocation> allocation;
 
     if (likely(!createInfo.flags)) {
@@ -812,6 +945,9 @@ namespace dxvk {
       if (unlikely(allocationInfo.mode.test(DxvkAllocationMode::NoDeviceMemory)))
         memoryRequirements.memoryTypeBits &= ~getMemoryTypeMask(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
+      if (unlikely(event))
+        event->setRequirements(memoryRequirements);
+
       if (likely(memoryRequirements.memoryTypeBits)) {
         bool allowSuballocation = true;
 
@@ -822,6 +958,9 @@ namespace dxvk {
         if (allocationCache && createInfo.size <= DxvkLocalAllocationCache::MaxSize
          && allocationCache->m_memoryTypes && !(allocationCache->m_memoryTypes & ~memoryRequirements.memoryTypeBits)
          && (allocationInfo.properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+          if (unlikely(event))
+            event->setFlag(DxvkMemoryTraceFlag::Cached);
+
           allocation = allocationCache->allocateFromCache(createInfo.size);
 
           if (likely(allocation))
@@ -832,10 +971,13 @@ namespace dxvk {
           // for any relevant memory pools as necessary.
           if (refillAllocationCache(allocationCache, memoryRequirements, allocationInfo.properties))
             return allocationCache->allocateFromCache(createInfo.size);
+
+          if (unlikely(event))
+            event->clrFlag(DxvkMemoryTraceFlag::Cached);
         } else {
           // Do not suballocate buffers if debug mode is enabled in order
           // to allow the application to set meaningful debug names.
-          allowSuballocation = !m_device->debugFlags().test(DxvkDebugFlag::Capture);
+          allowSuballocation = !m_properties.debugNames;
         }
 
         // If there is at least one memory type that supports the required
@@ -882,7 +1024,7 @@ namespace dxvk {
 
     // If we can't suballocate from an existing global buffer
     // for any reason, create a dedicated buffer resource.
-    auto vk = m_device->vkd();
+    auto vk = m_vkd;
 
     VkBuffer buffer = VK_NULL_HANDLE;
     VkResult vr = vk->vkCreateBuffer(vk->device(),
@@ -905,6 +1047,13 @@ namespace dxvk {
       if (unlikely(allocationInfo.mode.test(DxvkAllocationMode::NoDeviceMemory)))
         requirements.memoryRequirements.memoryTypeBits &= ~getMemoryTypeMask(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
+      if (unlikely(event)) {
+        event->setRequirements(requirements.memoryRequirements);
+
+        if (createInfo.usage & DescriptorBufferUsage)
+          event->setFlag(DxvkMemoryTraceFlag::RequireDedicated);
+      }
+
       // When allocating memory for a descriptor heap, use a dedicated allocation. We
       // ca expect these to be long-lived and mapped, and potentially use a dedicated
       // memory type that may have unexpected size restrictions. Also make sure not
@@ -936,6 +1085,11 @@ namespace dxvk {
         logMemoryStats();
       }
     } else {
+      if (unlikely(event)) {
+        event->setRequirements(VkMemoryRequirements());
+        event->setFlag(DxvkMemoryTraceFlag::Sparse);
+      }
+
       allocation = createAllocation(
         new DxvkSparsePageTable(m_device, createInfo, buffer),
         allocationInfo);
@@ -974,11 +1128,12 @@ namespace dxvk {
   }
 
 
-  Rc<DxvkResourceAllocation> DxvkMemoryAllocator::createImageResource(
+  Rc<DxvkResourceAllocation> DxvkMemoryAllocator::createImageResourceInternal(
     const VkImageCreateInfo&          createInfo,
     const DxvkAllocationInfo&         allocationInfo,
-    const void*                       next) {
-    auto vk = m_device->vkd();
+    const void*                       next,
+          DxvkMemoryTraceEvent*       event) {
+    auto vk = m_vkd;
 
     VkImage image = VK_NULL_HANDLE;
     VkResult vr = vk->vkCreateImage(vk->device(), &createInfo, nullptr, &image);
@@ -1011,6 +1166,19 @@ namespace dxvk {
     if (!dedicatedRequirements.requiresDedicatedAllocation && allocationInfo.mode.test(DxvkAllocationMode::NoDedicated))
       dedicatedRequirements.prefersDedicatedAllocation = VK_FALSE;
 
+    if (unlikely(event)) {
+      event->setRequirements(requirements.memoryRequirements);
+
+      if (dedicatedRequirements.prefersDedicatedAllocation)
+        event->setFlag(DxvkMemoryTraceFlag::PreferDedicated);
+
+      if (dedicatedRequirements.requiresDedicatedAllocation)
+        event->setFlag(DxvkMemoryTraceFlag::RequireDedicated);
+
+      if (createInfo.tiling == VK_IMAGE_TILING_OPTIMAL)
+        event->setFlag(DxvkMemoryTraceFlag::OptimalTiling);
+    }
+
     Rc<DxvkResourceAllocation> allocation;
 
     if (!(createInfo.flags & VK_IMAGE_CREATE_SPARSE_BINDING_BIT)) {
@@ -1045,7 +1213,7 @@ namespace dxvk {
         if (createInfo.tiling == VK_IMAGE_TILING_OPTIMAL) {
           requirements.memoryRequirements.alignment = std::max(
             requirements.memoryRequirements.alignment,
-            m_device->properties().core.properties.limits.bufferImageGranularity);
+            m_properties.bufferImageGranularity);
         }
 
         // Try to suballocate memory and fall back to system memory on error.
@@ -1065,6 +1233,12 @@ namespace dxvk {
       auto pageTable = std::make_unique<DxvkSparsePageTable>(m_device, createInfo, image);
       auto pageProperties = pageTable->getProperties();
 
+      if (unlikely(event)) {
+        event->size = SparseMemoryPageSize * pageProperties.metadataPageCount;
+        event->alignment = SparseMemoryPageSize;
+        event->setFlag(DxvkMemoryTraceFlag::Sparse);
+      }
+
       if (pageProperties.metadataPageCount) {
         VkMemoryRequirements metadataRequirements = { };
         metadataRequirements.size = SparseMemoryPageSize * pageProperties.metadataPageCount;
@@ -1134,6 +1308,13 @@ namespace dxvk {
     DxvkAllocationInfo allocationInfo = { };
     allocationInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
+    DxvkMemoryTraceEvent event = { };
+
+    if (unlikely(m_trace)) {
+      event = beginTraceEvent(DxvkMemoryTraceEventType::Memory, allocationInfo);
+      event.setRequirements(requirements);
+    }
+
     auto allocation = allocateMemory(requirements, allocationInfo);
 
     if (!allocation) {
@@ -1141,6 +1322,9 @@ namespace dxvk {
       allocation = allocateMemory(requirements, allocationInfo);
     }
 
+    if (unlikely(m_trace))
+      recordTraceEvent(event, allocation.ptr());
+
     if (!allocation)
       return nullptr;
 
@@ -1150,14 +1334,15 @@ namespace dxvk {
 
   DxvkLocalAllocationCache DxvkMemoryAllocator::createAllocationCache(
           VkBufferUsageFlags          bufferUsage,
-          VkMemoryPropertyFlags       properties) {
+          VkMemoryPropertyFlags       properties,
+          uint32_t                    refillCount) {
     uint32_t memoryTypeMask = m_globalBufferMemoryTypes;
 
     if (bufferUsage & ~m_globalBufferUsageFlags)
       memoryTypeMask = findGlobalBufferMemoryTypeMask(bufferUsage);
 
     memoryTypeMask &= getMemoryTypeMask(properties);
-    return DxvkLocalAllocationCache(this, memoryTypeMask);
+    return DxvkLocalAllocationCache(this, memoryTypeMask, std::max(refillCount, 1u));
   }
 
 
@@ -1165,7 +1350,7 @@ namespace dxvk {
     const VkBufferCreateInfo&         createInfo,
     const DxvkAllocationInfo&         allocationInfo,
     const DxvkBufferImportInfo&       importInfo) {
-    Rc<DxvkResourceAllocation> allocation = m_allocationPool.create(this, nullptr);
+    Rc<DxvkResourceAllocation> allocation = createUntypedAllocation();
     allocation->m_flags.set(DxvkAllocationFlag::Imported);
     allocation->m_resourceCookie = allocation->m_resourceCookie;
     allocation->m_size = createInfo.size;
@@ -1184,7 +1369,7 @@ namespace dxvk {
     const VkImageCreateInfo&          createInfo,
     const DxvkAllocationInfo&         allocationInfo,
           VkImage                     imageHandle) {
-    Rc<DxvkResourceAllocation> allocation = m_allocationPool.create(this, nullptr);
+    Rc<DxvkResourceAllocation> allocation = createUntypedAllocation();
     allocation->m_flags.set(DxvkAllocationFlag::Imported);
     allocation->m_resourceCookie = allocation->m_resourceCookie;
     allocation->m_image = imageHandle;
@@ -1197,7 +1382,7 @@ namespace dxvk {
           DxvkMemoryType&       type,
           VkDeviceSize          size,
     const void*                 next) {
-    auto vk = m_device->vkd();
+    auto vk = m_vkd;
 
     // If global buffers are enabled for this allocation, pad the allocation size
     // to a multiple of the global buffer alignment. This can happen when we create
@@ -1206,7 +1391,7 @@ namespace dxvk {
       size = align(size, GlobalBufferAlignment);
 
     // Preemptively free some unused allocations to reduce memory waste
-    freeEmptyChunksInHeap(*type.heap, size, high_resolution_clock::now());
+    freeEmptyChunksInHeap(*type.heap, size, m_backend->getCurrentTime(), &type);
 
     // If we're exceeding vram budget on a dedicated GPU, fall back to system memory.
     if (!next && type.heap->enforceBudget && (getMemoryStats(type.heap->index).memoryAllocated + size > type.heap->memoryBudget)) {
@@ -1236,7 +1421,7 @@ namespace dxvk {
         priorityInfo.priority = 0.5f;
       }
 
-      if (m_device->features().extMemoryPriority.memoryPriority)
+      if (m_properties.memoryPriority)
         priorityInfo.pNext = std::exchange(memoryInfo.pNext, &priorityInfo);
     }
 
@@ -1254,14 +1439,14 @@ namespace dxvk {
     result.size = size;
 
     if (vk->vkAllocateMemory(vk->device(), &memoryInfo, nullptr, &result.memory)) {
-      freeEmptyChunksInHeap(*type.heap, VkDeviceSize(-1), high_resolution_clock::time_point());
+      freeEmptyChunksInHeap(*type.heap, VkDeviceSize(-1), high_resolution_clock::time_point(), &type);
 
       if (vk->vkAllocateMemory(vk->device(), &memoryInfo, nullptr, &result.memory))
         return DxvkDeviceMemory();
     }
 
     // Technically redundant if EXT_memory_priority is also supported, but this shouldn't hurt
-    if (m_device->features().extPageableDeviceLocalMemory.pageableDeviceLocalMemory)
+    if (m_properties.pageableDeviceLocalMemory)
       vk->vkSetDeviceMemoryPriorityEXT(vk->device(), result.memory, priorityInfo.priority);
 
     // Create global buffer if the allocation supports it
@@ -1271,7 +1456,7 @@ namespace dxvk {
       VkBufferCreateInfo bufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
       bufferInfo.size = size;
       bufferInfo.usage = type.bufferUsage;
-      m_sharingModeInfo.fill(bufferInfo);
+      m_properties.sharingMode.fill(bufferInfo);
 
       VkResult status = vk->vkCreateBuffer(vk->device(), &bufferInfo, nullptr, &buffer);
 
@@ -1308,7 +1493,7 @@ namespace dxvk {
 
     result.cookie = ++m_nextCookie;
 
-    if (unlikely(m_device->debugFlags().test(DxvkDebugFlag::Capture)))
+    if (unlikely(m_properties.debugNames))
       assignMemoryDebugName(result, type);
 
     type.stats.memoryAllocated += size;
@@ -1319,7 +1504,7 @@ namespace dxvk {
   void DxvkMemoryAllocator::assignMemoryDebugName(
     const DxvkDeviceMemory&     memory,
     const DxvkMemoryType&       type) {
-    auto vk = m_device->vkd();
+    auto vk = m_vkd;
 
     const char* memoryType = "Unspecified memory";
 
@@ -1407,7 +1592,7 @@ namespace dxvk {
     auto& chunk = pool.chunks[chunkIndex];
     chunk.unusedTime = high_resolution_clock::time_point();
 
-    auto allocation = m_allocationPool.create(this, &type);
+    auto allocation = m_allocationPools[type.index].create(this, &type);
 
     if (!(allocationInfo.properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && allocationInfo.resourceCookie)
       allocation->m_flags.set(DxvkAllocationFlag::CanMove);
@@ -1420,7 +1605,7 @@ namespace dxvk {
     if (chunk.memory.mapPtr) {
       allocation->m_mapPtr = reinterpret_cast<char*>(chunk.memory.mapPtr) + offset;
 
-      if (unlikely(m_device->config().zeroMappedMemory)) {
+      if (unlikely(m_properties.zeroMappedMemory)) {
         // Some games will not write mapped buffers and will break if
         // there is any stale data stored within. Clear when the allocation is
         // freed, so that subsequent allocations will receive cleared buffers.
@@ -1445,7 +1630,7 @@ namespace dxvk {
   DxvkResourceAllocation* DxvkMemoryAllocator::createAllocation(
           DxvkSparsePageTable*  sparsePageTable,
     const DxvkAllocationInfo&   allocationInfo) {
-    auto allocation = m_allocationPool.create(this, nullptr);
+    auto allocation = createUntypedAllocation();
     allocation->m_resourceCookie = allocationInfo.resourceCookie;
     allocation->m_sparsePageTable = sparsePageTable;
 
@@ -1453,13 +1638,21 @@ namespace dxvk {
   }
 
 
+  DxvkResourceAllocation* DxvkMemoryAllocator::createUntypedAllocation() {
+    // Imported and sparse allocations are not associated with
+    // any memory type, so they use a separately locked pool.
+    std::lock_guard lock(m_untypedMutex);
+    return m_untypedAllocationPool.create(this, nullptr);
+  }
+
+
   DxvkResourceAllocation* DxvkMemoryAllocator::createAllocation(
           DxvkMemoryType&       type,
     const DxvkDeviceMemory&     memory,
     const DxvkAllocationInfo&   allocationInfo) {
     type.stats.memoryUsed += memory.size;
 
-    auto allocation = m_allocationPool.create(this, &type);
+    auto allocation = m_allocationPools[type.index].create(this, &type);
     allocation->m_flags.set(DxvkAllocationFlag::OwnsMemory);
 
     if (memory.buffer)
@@ -1483,7 +1676,7 @@ namespace dxvk {
   void DxvkMemoryAllocator::freeDeviceMemory(
           DxvkMemoryType&       type,
           DxvkDeviceMemory      memory) {
-    auto vk = m_device->vkd();
+    auto vk = m_vkd;
     vk->vkDestroyBuffer(vk->device(), memory.buffer, nullptr);
     vk->vkFreeMemory(vk->device(), memory.memory, nullptr);
 
@@ -1493,6 +1686,9 @@ namespace dxvk {
 
   void DxvkMemoryAllocator::freeAllocation(
           DxvkResourceAllocation* allocation) {
+    if (unlikely(allocation->m_flags.test(DxvkAllocationFlag::Traced)))
+      recordTraceFree(allocation);
+
     if (allocation->m_flags.test(DxvkAllocationFlag::ClearOnFree)) {
       if (allocation->m_mapPtr)
         bit::bclear(allocation->m_mapPtr, allocation->m_size);
@@ -1508,54 +1704,65 @@ namespace dxvk {
       // If we get a list of allocations back from the
       // shared cache, free all of them in one go
       freeCachedAllocations(allocation);
-    } else {
-      std::unique_lock lock(m_mutex);
+    } else if (likely(allocation->m_type)) {
+      DxvkMemoryType& type = *allocation->m_type;
 
-      if (likely(allocation->m_type)) {
-        allocation->m_type->stats.memoryUsed -= allocation->m_size;
+      std::unique_lock lock(type.mutex);
+      type.stats.memoryUsed -= allocation->m_size;
 
-        if (unlikely(allocation->m_flags.test(DxvkAllocationFlag::OwnsMemory))) {
-          // We free the actual allocation later, just update stats here.
-          allocation->m_type->stats.memoryAllocated -= allocation->m_size;
-        } else {
-          DxvkMemoryPool& pool = allocation->m_mapPtr
-            ? allocation->m_type->mappedPool
-            : allocation->m_type->devicePool;
+      if (unlikely(allocation->m_flags.test(DxvkAllocationFlag::OwnsMemory))) {
+        // We free the actual allocation later, just update stats here.
+        type.stats.memoryAllocated -= allocation->m_size;
+      } else {
+        DxvkMemoryPool& pool = allocation->m_mapPtr
+          ? type.mappedPool
+          : type.devicePool;
 
-          if (!allocation->m_mapPtr) {
-            uint32_t chunkIndex = allocation->m_address >> DxvkPageAllocator::ChunkAddressBits;
-            pool.chunks[chunkIndex].removeAllocation(allocation);
-          }
+        if (!allocation->m_mapPtr) {
+          uint32_t chunkIndex = allocation->m_address >> DxvkPageAllocator::ChunkAddressBits;
+          pool.chunks[chunkIndex].removeAllocation(allocation);
+        }
 
-          if (unlikely(pool.free(allocation->m_address, allocation->m_size))) {
-            uint32_t chunkIndex = allocation->m_address >> DxvkPageAllocator::ChunkAddressBits;
-            pool.chunks[chunkIndex].canMove = true;
+        if (unlikely(pool.free(allocation->m_address, allocation->m_size))) {
+          uint32_t chunkIndex = allocation->m_address >> DxvkPageAllocator::ChunkAddressBits;
+          pool.chunks[chunkIndex].canMove = true;
 
-            if (freeEmptyChunksInPool(*allocation->m_type, pool, 0, high_resolution_clock::now()))
-              updateMemoryHeapStats(allocation->m_type->properties.heapIndex);
-          }
+          if (freeEmptyChunksInPool(type, pool, 0, m_backend->getCurrentTime()))
+            updateMemoryHeapStats(type.properties.heapIndex);
         }
       }
 
-      m_allocationPool.free(allocation);
+      m_allocationPools[type.index].free(allocation);
+    } else {
+      std::unique_lock lock(m_untypedMutex);
+      m_untypedAllocationPool.free(allocation);
     }
   }
 
 
   void DxvkMemoryAllocator::freeLocalCache(
           DxvkLocalAllocationCache* cache) {
-    std::unique_lock lock(m_mutex);
-
     for (size_t i = 0; i < cache->m_pools.size(); i++)
-      freeCachedAllocationsLocked(std::exchange(cache->m_pools[i], nullptr));
+      freeCachedAllocations(std::exchange(cache->m_pools[i], nullptr));
   }
 
 
   void DxvkMemoryAllocator::freeCachedAllocations(
           DxvkResourceAllocation* allocation) {
-    if (allocation) {
-      std::unique_lock lock(m_mutex);
-      freeCachedAllocationsLocked(allocation);
+    // Lists are usually homogeneous, but local caches can hold allocations
+    // from multiple memory types, so lock each run of allocations that use
+    // the same memory type separately.
+    while (allocation) {
+      DxvkResourceAllocation* head = allocation;
+      DxvkResourceAllocation* tail = allocation;
+
+      while (tail->m_nextCached && tail->m_nextCached->m_type == head->m_type)
+        tail = tail->m_nextCached;
+
+      allocation = std::exchange(tail->m_nextCached, nullptr);
+
+      std::unique_lock lock(head->m_type->mutex);
+      freeCachedAllocationsLocked(head);
     }
   }
 
@@ -1563,20 +1770,22 @@ namespace dxvk {
   void DxvkMemoryAllocator::freeCachedAllocationsLocked(
           DxvkResourceAllocation* allocation) {
     while (allocation) {
+      auto& type = *allocation->m_type;
+
       auto& pool = allocation->m_mapPtr
-        ? allocation->m_type->mappedPool
-        : allocation->m_type->devicePool;
+        ? type.mappedPool
+        : type.devicePool;
 
       // Cached allocations may have a reference count of 0, but they
       // still own the memory, so make sure to release it here.
-      allocation->m_type->stats.memoryUsed -= allocation->m_size;
+      type.stats.memoryUsed -= allocation->m_size;
 
       if (unlikely(pool.free(allocation->m_address, allocation->m_size))) {
-        if (freeEmptyChunksInPool(*allocation->m_type, pool, 0, high_resolution_clock::now()))
-          updateMemoryHeapStats(allocation->m_type->properties.heapIndex);
+        if (freeEmptyChunksInPool(type, pool, 0, m_backend->getCurrentTime()))
+          updateMemoryHeapStats(type.properties.heapIndex);
       }
 
-      m_allocationPool.free(std::exchange(allocation, allocation->m_nextCached));
+      m_allocationPools[type.index].free(std::exchange(allocation, allocation->m_nextCached));
     }
   }
 
@@ -1584,12 +1793,28 @@ namespace dxvk {
   void DxvkMemoryAllocator::freeEmptyChunksInHeap(
     const DxvkMemoryHeap&       heap,
           VkDeviceSize          allocationSize,
-          high_resolution_clock::time_point time) {
+          high_resolution_clock::time_point time,
+    const DxvkMemoryType*       lockedType) {
     bool freed = false;
 
     for (auto typeIndex : bit::BitMask(heap.memoryTypes)) {
       auto& type = m_memTypes[typeIndex];
 
+      // If the caller already holds a memory type lock, only try to lock
+      // other memory types since we might otherwise deadlock with another
+      // thread allocating memory on the same heap. Skipping a type here
+      // only means that its empty chunks get freed a bit later.
+      std::unique_lock<DxvkMemoryTypeMutex> lock;
+
+      if (&type != lockedType) {
+        lock = std::unique_lock(type.mutex, std::defer_lock);
+
+        if (!lockedType)
+          lock.lock();
+        else if (!lock.try_lock())
+          continue;
+      }
+
       freed |= freeEmptyChunksInPool(type, type.devicePool, allocationSize, time);
       freed |= freeEmptyChunksInPool(type, type.mappedPool, allocationSize, time);
     }
@@ -1689,7 +1914,7 @@ namespace dxvk {
       if (memory.mapPtr)
         return;
 
-      auto vk = m_device->vkd();
+      auto vk = m_vkd;
 
       VkResult vr = vk->vkMapMemory(vk->device(),
         memory.memory, 0, memory.size, 0, &memory.mapPtr);
@@ -1699,7 +1924,7 @@ namespace dxvk {
           "\n  size: ", memory.size, " bytes"));
       }
 
-      if (m_device->config().zeroMappedMemory)
+      if (m_properties.zeroMappedMemory)
         bit::bclear(memory.mapPtr, memory.size);
 
       Logger::debug(str::format("Mapped memory region 0x", std::hex,
@@ -1709,7 +1934,7 @@ namespace dxvk {
       if (!memory.mapPtr)
         return;
 
-      auto vk = m_device->vkd();
+      auto vk = m_vkd;
       vk->vkUnmapMemory(vk->device(), memory.memory);
 
       Logger::debug(str::format("Unmapped memory region 0x", std::hex,
@@ -1731,14 +1956,15 @@ namespace dxvk {
     allocationSize = std::max(allocationSize, DxvkLocalAllocationCache::MinSize);
 
     // Maximum number of allocations when we miss in the shared cache
-    uint32_t allocationCount = DxvkLocalAllocationCache::computePreferredAllocationCount(allocationSize);
+    uint32_t allocationCount = DxvkLocalAllocationCache::computePreferredAllocationCount(allocationSize)
+                             * cache->m_refillCount;
 
     for (auto typeIndex : bit::BitMask(cache->m_memoryTypes)) {
       auto& memoryType = m_memTypes[typeIndex];
 
       // Initialize shared cache on demand only
       if (unlikely(!memoryType.sharedCache)) {
-        std::unique_lock lock(m_mutex);
+        std::unique_lock lock(memoryType.mutex);
 
         if (!memoryType.sharedCache)
           memoryType.sharedCache = new DxvkSharedAllocationCache(this);
@@ -1749,6 +1975,23 @@ namespace dxvk {
       DxvkResourceAllocation* allocation = memoryType.sharedCache->getAllocationList(allocationSize);
 
       if (likely(allocation)) {
+        // Caches that expect bursts of allocations take multiple lists
+        // at once so that they do not hit the shared cache every time.
+        for (uint32_t i = 1u; i < cache->m_refillCount; i++) {
+          DxvkResourceAllocation* list = memoryType.sharedCache->getAllocationList(allocationSize);
+
+          if (!list)
+            break;
+
+          DxvkResourceAllocation* tail = list;
+
+          while (tail->m_nextCached)
+            tail = tail->m_nextCached;
+
+          tail->m_nextCached = allocation;
+          allocation = list;
+        }
+
         allocation = cache->assignCache(allocationSize, allocation);
         freeCachedAllocations(allocation);
         return true;
@@ -1759,7 +2002,7 @@ namespace dxvk {
       DxvkResourceAllocation* head = nullptr;
       DxvkResourceAllocation* tail = nullptr;
 
-      std::unique_lock lock(m_mutex);
+      std::unique_lock lock(memoryType.mutex);
       auto& memoryPool = memoryType.mappedPool;
 
       while (allocationCount) {
@@ -1855,9 +2098,8 @@ namespace dxvk {
   }
 
 
-  uint32_t DxvkMemoryAllocator::determineSparseMemoryTypes(
-          DxvkDevice*           device) const {
-    auto vk = device->vkd();
+  uint32_t DxvkMemoryAllocator::determineSparseMemoryTypes() const {
+    auto vk = m_vkd;
 
     VkMemoryRequirements2 requirements = { VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2 };
     uint32_t typeMask = ~0u;
@@ -1877,7 +2119,7 @@ namespace dxvk {
                             | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT
                             | VK_BUFFER_USAGE_TRANSFER_DST_BIT
                             | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    m_sharingModeInfo.fill(bufferInfo);
+    m_properties.sharingMode.fill(bufferInfo);
 
     if (getBufferMemoryRequirements(bufferInfo, requirements))
       typeMask &= requirements.memoryRequirements.memoryTypeBits;
@@ -1920,7 +2162,7 @@ namespace dxvk {
                              | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT
                              | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
 
-    if (m_device->features().extTransformFeedback.transformFeedback) {
+    if (m_properties.transformFeedback) {
       flags |= VK_BUFFER_USAGE_TRANSFORM_FEEDBACK_BUFFER_BIT_EXT
             |  VK_BUFFER_USAGE_TRANSFORM_FEEDBACK_COUNTER_BUFFER_BIT_EXT;
     }
@@ -1930,7 +2172,7 @@ namespace dxvk {
     // to be supported, but we need to be robust around buffer creation anyway.
     VkBufferCreateInfo bufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
     bufferInfo.size = 65536;
-    m_sharingModeInfo.fill(bufferInfo);
+    m_properties.sharingMode.fill(bufferInfo);
 
     VkMemoryRequirements2 requirements = { VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2 };
 
@@ -1959,7 +2201,7 @@ namespace dxvk {
     // non-descriptor allocation to enable those bits.
     VkBufferUsageFlags descriptorHeapUsage = 0u;
 
-    if (m_device->canUseDescriptorBuffer())
+    if (m_properties.descriptorBuffer)
       descriptorHeapUsage |= DescriptorBufferUsage;
 
     while (descriptorHeapUsage) {
@@ -2066,20 +2308,21 @@ namespace dxvk {
 
 
   void DxvkMemoryAllocator::getAllocationStats(DxvkMemoryAllocationStats& stats) {
-    std::lock_guard<dxvk::mutex> lock(m_mutex);
-
     stats.chunks.clear();
     stats.pageMasks.clear();
 
     for (uint32_t i = 0; i < m_memTypeCount; i++) {
-      const auto& typeInfo = m_memTypes[i];
+      auto& typeInfo = m_memTypes[i];
       auto& typeStats = stats.memoryTypes[i];
 
+      std::lock_guard lock(typeInfo.mutex);
+
       typeStats.properties = typeInfo.properties;
       typeStats.allocated = typeInfo.stats.memoryAllocated;
       typeStats.used = typeInfo.stats.memoryUsed;
       typeStats.chunkIndex = stats.chunks.size();
       typeStats.chunkCount = 0u;
+      typeStats.lockTime = typeInfo.mutex.getHoldTime();
 
       getAllocationStatsForPool(typeInfo, typeInfo.devicePool, stats);
       getAllocationStatsForPool(typeInfo, typeInfo.mappedPool, stats);
@@ -2108,7 +2351,7 @@ namespace dxvk {
   bool DxvkMemoryAllocator::getBufferMemoryRequirements(
     const VkBufferCreateInfo&     createInfo,
           VkMemoryRequirements2&  memoryRequirements) const {
-    auto vk = m_device->vkd();
+    auto vk = m_vkd;
 
     VkDeviceBufferMemoryRequirements info = { VK_STRUCTURE_TYPE_DEVICE_BUFFER_MEMORY_REQUIREMENTS };
     info.pCreateInfo = &createInfo;
@@ -2121,7 +2364,7 @@ namespace dxvk {
   bool DxvkMemoryAllocator::getImageMemoryRequirements(
     const VkImageCreateInfo&      createInfo,
           VkMemoryRequirements2&  memoryRequirements) const {
-    auto vk = m_device->vkd();
+    auto vk = m_vkd;
 
     VkDeviceImageMemoryRequirements info = { VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS };
     info.pCreateInfo = &createInfo;
@@ -2147,6 +2390,12 @@ namespace dxvk {
 
   void DxvkMemoryAllocator::requestMakeResident(
           DxvkPagedResource*          resource) {
+    // Promoting resources while video memory is oversubscribed would only
+    // force other resources out, leading to thrashing. The resource will
+    // request residency again the next time the GPU is done using it.
+    if (!canPromoteResources())
+      return;
+
     std::lock_guard lock(m_resourceMutex);
 
     m_relocations.addResource(resource, nullptr,
@@ -2157,6 +2406,9 @@ namespace dxvk {
   void DxvkMemoryAllocator::lockResourceGpuAddress(
     const Rc<DxvkResourceAllocation>& allocation) {
     if (allocation->m_flags.test(DxvkAllocationFlag::CanMove)) {
+      // Lock the memory type first to protect the chunk array, and
+      // to maintain the same lock order as defragmentation.
+      std::lock_guard typeLock(allocation->m_type->mutex);
       std::lock_guard lock(m_resourceMutex);
       allocation->m_flags.clr(DxvkAllocationFlag::CanMove);
 
@@ -2169,7 +2421,7 @@ namespace dxvk {
 
 
   VkDeviceAddress DxvkMemoryAllocator::getBufferDeviceAddress(VkBuffer buffer) const {
-    auto vk = m_device->vkd();
+    auto vk = m_vkd;
 
     VkBufferDeviceAddressInfo bdaInfo = { VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO };
     bdaInfo.buffer = buffer;
@@ -2202,7 +2454,10 @@ namespace dxvk {
 
 
   void DxvkMemoryAllocator::logMemoryStats() const {
-    DxvkAdapterMemoryInfo memHeapInfo = m_device->adapter()->getMemoryHeapInfo();
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT memBudget = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT };
+
+    if (m_properties.memoryBudget)
+      m_backend->getMemoryBudget(memBudget);
 
     std::stringstream sstr;
     sstr << "Heap  Size (MiB)  Allocated   Used        Reserved    Budget" << std::endl;
@@ -2215,9 +2470,13 @@ namespace dxvk {
            << std::setw(6) << (stats.memoryAllocated >> 20) << "      "
            << std::setw(6) << (stats.memoryUsed >> 20) << "      ";
 
-      if (m_device->features().extMemoryBudget) {
-        sstr << std::setw(6) << (memHeapInfo.heaps[i].memoryAllocated >> 20) << "      "
-             << std::setw(6) << (memHeapInfo.heaps[i].memoryBudget >> 20) << "      " << std::endl;
+      if (m_properties.memoryBudget) {
+        // Count our own allocations as used memory only, same as the adapter
+        VkDeviceSize reserved = std::max(memBudget.heapUsage[i], stats.memoryAllocated)
+          - stats.memoryAllocated + stats.memoryUsed;
+
+        sstr << std::setw(6) << (reserved >> 20) << "      "
+             << std::setw(6) << (memBudget.heapBudget[i] >> 20) << "      " << std::endl;
       } else {
         sstr << " n/a         n/a" << std::endl;
       }
@@ -2249,16 +2508,13 @@ namespace dxvk {
 
 
   void DxvkMemoryAllocator::updateMemoryHeapBudgets() {
-    if (!m_device->features().extMemoryBudget)
+    if (!m_properties.memoryBudget)
       return;
 
-    VkDeviceSize maxBudget = m_device->config().maxMemoryBudget;
+    VkDeviceSize maxBudget = m_properties.maxMemoryBudget;
 
     VkPhysicalDeviceMemoryBudgetPropertiesEXT memBudget = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT };
-    VkPhysicalDeviceMemoryProperties2 memInfo = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2, &memBudget };
-
-    auto vki = m_device->adapter()->vki();
-    vki->vkGetPhysicalDeviceMemoryProperties2(m_device->adapter()->handle(), &memInfo);
+    m_backend->getMemoryBudget(memBudget);
 
     for (uint32_t i = 0; i < m_memHeapCount; i++) {
       if (memBudget.heapBudget[i]) {
@@ -2268,27 +2524,33 @@ namespace dxvk {
         VkDeviceSize internal = std::max(memBudget.heapUsage[i], allocated) - allocated;
                      internal = std::min(memBudget.heapBudget[i], internal);
 
-        m_memHeaps[i].memoryBudget = std::min(memBudget.heapBudget[i] - internal, m_memHeaps[i].properties.size);
+        VkDeviceSize budget = std::min(memBudget.heapBudget[i] - internal, m_memHeaps[i].properties.size);
 
         if (m_memHeaps[i].properties.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
           // Keep a small amount of the budget unused. This avoids problematic behaviour
           // in some drivers when maxing out the budget, and allows small driver-internal
           // allocations to succeed while giving us time to evict more resources.
           VkDeviceSize reservedSize = std::clamp<VkDeviceSize>(m_memHeaps[i].properties.size / 100u, MinChunkSize, MaxChunkSize);
-          m_memHeaps[i].memoryBudget -= std::min(reservedSize, m_memHeaps[i].memoryBudget);
+          budget -= std::min(reservedSize, budget);
 
           if (maxBudget)
-            m_memHeaps[i].memoryBudget = std::min(m_memHeaps[i].memoryBudget, maxBudget);
+            budget = std::min(budget, maxBudget);
         }
+
+        // Allocating threads read the budget without locking,
+        // so only ever publish the final value.
+        m_memHeaps[i].memoryBudget = budget;
       }
     }
   }
 
 
   void DxvkMemoryAllocator::updateMemoryHeapStats(uint32_t heapIndex) {
+    std::lock_guard lock(m_memHeaps[heapIndex].statsMutex);
+
     DxvkMemoryStats stats = getMemoryStats(heapIndex);
 
-    m_device->notifyMemoryStats(heapIndex,
+    m_backend->notifyMemoryStats(heapIndex,
       stats.memoryAllocated - m_adapterHeapStats[heapIndex].memoryAllocated,
       stats.memoryUsed - m_adapterHeapStats[heapIndex].memoryUsed);
 
@@ -2455,6 +2717,10 @@ namespace dxvk {
 
   void DxvkMemoryAllocator::evictResources(
           DxvkMemoryType&       type) {
+    // Resources that have been used within this many submissions
+    // are considered part of the working set and never evicted.
+    constexpr static uint64_t MinIdleSubmissions = 64u;
+
     auto& pool = type.devicePool;
 
     // Doing this on integrated graphics would be harmful, so don't'
@@ -2491,6 +2757,10 @@ namespace dxvk {
 
     chunkIndices[1u] = pool.nextEvictChunk;
 
+    uint64_t submissionId = getSubmissionId();
+
+    std::unique_lock lock(m_resourceMutex);
+
     for (auto chunkIndex : chunkIndices) {
       // Ensure we actually have a valid, live chunk to work with
       if (chunkIndex >= pool.chunks.size() || !pool.pageAllocator.chunkIsAvailable(chunkIndex))
@@ -2498,9 +2768,10 @@ namespace dxvk {
 
       auto& chunk = pool.chunks[chunkIndex];
 
-      // Scan resources and mark everything for eviction. If a demoted
-      // resource hasn't been reactivated, evict it to system memory.
-      VkDeviceSize memoryEvicted = 0u;
+      // Gather movable resources in the chunk and process the least
+      // recently used ones first, so that resources that have not been
+      // used in a long time are evicted before more recent ones.
+      m_evictionCandidates.clear();
 
       for (auto a = chunk.allocationList; a; a = a->m_nextInChunk) {
         if (!a->flags().test(DxvkAllocationFlag::CanMove))
@@ -2512,22 +2783,44 @@ namespace dxvk {
         if (entry == m_resourceMap.end())
           continue;
 
-        // Try to acquire resource and request its eviction
-        auto resource = entry->second->tryAcquire();
+        m_evictionCandidates.push_back({ entry->second->getLastUse(), a, entry->second });
+      }
 
-        if (!resource)
+      std::sort(m_evictionCandidates.begin(), m_evictionCandidates.end(),
+        [] (const EvictionCandidate& a, const EvictionCandidate& b) {
+          return a.lastUse < b.lastUse;
+        });
+
+      // Mark idle resources for eviction. If a demoted resource hasn't
+      // been reactivated, evict it to system memory. Resources that are
+      // part of the current working set are never demoted.
+      VkDeviceSize memoryEvicted = 0u;
+
+      for (const auto& c : m_evictionCandidates) {
+        bool isIdle = c.lastUse + MinIdleSubmissions <= submissionId
+          && !c.resource->isInUse(DxvkAccess::Read);
+
+        bool evicted = isIdle && c.resource->requestEviction()
+          && (heapUsage + minUnusedMemory > heapBudget + memoryEvicted);
+
+        // Relocate other resources within the chunk to reduce fragmentation
+        if (!evicted && !memoryEvicted)
           continue;
 
-        bool evicted = resource->requestEviction();
+        // Try to acquire resource. If this fails, the resource is being
+        // destroyed and its memory will be freed soon anyway. Acquired
+        // references must not be dropped while holding the resource lock
+        // since the resource destructor would take the same lock.
+        auto resource = c.resource->tryAcquire();
 
-        if (evicted && (heapUsage + minUnusedMemory > heapBudget + memoryEvicted)) {
-          m_relocations.addResource(std::move(resource), a, DxvkAllocationMode::NoDeviceMemory);
-          memoryEvicted += a->getMemoryInfo().size;
-        }
+        if (!resource)
+          continue;
 
-        if (!evicted && memoryEvicted) {
-          // Relocate other resources within the chunk to reduce fragmentation
-          m_relocations.addResource(std::move(resource), a, DxvkAllocationModes(
+        if (evicted) {
+          m_relocations.addResource(std::move(resource), c.allocation, DxvkAllocationMode::NoDeviceMemory);
+          memoryEvicted += c.allocation->getMemoryInfo().size;
+        } else {
+          m_relocations.addResource(std::move(resource), c.allocation, DxvkAllocationModes(
             DxvkAllocationMode::NoFallback, DxvkAllocationMode::NoAllocation));
         }
       }
@@ -2547,12 +2840,34 @@ namespace dxvk {
   }
 
 
+  bool DxvkMemoryAllocator::canPromoteResources() const {
+    uint32_t typeMask = getMemoryTypeMask(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if (!typeMask)
+      return true;
+
+    const auto& type = m_memTypes[bit::tzcnt(typeMask)];
+
+    if (!type.heap->enableEviction)
+      return true;
+
+    // Require more headroom than eviction does in order to not
+    // immediately evict the resource again on the next pass.
+    DxvkMemoryStats stats = getMemoryStats(type.heap->index);
+    return stats.memoryUsed + 4u * type.devicePool.maxChunkSize <= stats.memoryBudget;
+  }
+
+
   void DxvkMemoryAllocator::performTimedTasks() {
     static constexpr auto Interval = std::chrono::milliseconds(500u);
 
+    // Advance submission ID so that resources used by the current
+    // submission will be considered more recent than older ones
+    m_submissionId.fetch_add(1u, std::memory_order_relaxed);
+
     // This function shouldn't be called concurrently, so checking and
-    // updating the deadline is fine without taking the global lock
-    auto currentTime = high_resolution_clock::now();
+    // updating the deadline is fine without taking any locks
+    auto currentTime = m_backend->getCurrentTime();
 
     if (m_taskDeadline != high_resolution_clock::time_point()
      && m_taskDeadline > currentTime)
@@ -2564,57 +2879,87 @@ namespace dxvk {
     else
       m_taskDeadline = m_taskDeadline + Interval;
 
-    std::unique_lock lock(m_mutex);
-    performTimedTasksLocked(currentTime);
-  }
-
-
-  void DxvkMemoryAllocator::performTimedTasksLocked(high_resolution_clock::time_point currentTime) {
     // Re-query current memory budgets
     updateMemoryHeapBudgets();
 
     // Periodically free unused memory chunks and update
     // memory allocation statistics for the adapter.
     for (uint32_t i = 0; i < m_memHeapCount; i++)
-      freeEmptyChunksInHeap(m_memHeaps[i], 0, currentTime);
+      freeEmptyChunksInHeap(m_memHeaps[i], 0, currentTime, nullptr);
+
+    // Process one memory type at a time so that allocations
+    // on other memory types can proceed in the meantime.
+    bool defrag = m_properties.enableDefrag;
 
-    // Periodically clean up unused cached allocations
     for (uint32_t i = 0; i < m_memTypeCount; i++) {
-      if (m_memTypes[i].sharedCache)
-        m_memTypes[i].sharedCache->cleanupUnusedFromLockedAllocator(currentTime);
-    }
+      auto& type = m_memTypes[i];
+
+      std::unique_lock lock(type.mutex);
+
+      // Periodically clean up unused cached allocations
+      if (type.sharedCache)
+        type.sharedCache->cleanupUnusedFromLockedAllocator(currentTime);
 
-    if (enableDefrag()) {
       // Periodically defragment device-local memory types. We cannot
       // do anything about mapped allocations since we rely on pointer
       // stability there.
-      for (uint32_t i = 0; i < m_memTypeCount; i++) {
-        moveDefragChunk(m_memTypes[i]);
-        pickDefragChunk(m_memTypes[i]);
+      if (defrag) {
+        moveDefragChunk(type);
+        pickDefragChunk(type);
 
-        if (m_memTypes[i].properties.propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-          evictResources(m_memTypes[i]);
+        if (type.properties.propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+          evictResources(type);
       }
     }
   }
 
 
-  bool DxvkMemoryAllocator::enableDefrag() const {
-    auto option = m_device->config().enableMemoryDefrag;
+  DxvkMemoryTraceEvent DxvkMemoryAllocator::beginTraceEvent(
+          DxvkMemoryTraceEventType    type,
+    const DxvkAllocationInfo&         allocationInfo) const {
+    DxvkMemoryTraceEvent event = { };
+    event.timestamp = m_trace->getTimestamp();
+    event.type = type;
+    event.cookie = allocationInfo.resourceCookie;
+    event.properties = allocationInfo.properties;
+    event.mode = allocationInfo.mode.raw();
+    return event;
+  }
 
-    if (option == Tristate::Auto) {
-      // For unknown reasons, defragmentation seems to break Genshin Impact and
-      // possibly other games on ANV while working fine on other drivers even in
-      // a stress-test scenario, see https://github.com/doitsujin/dxvk/issues/4395.
-      // This issue does not seem to affect Battlemage GPUs, which have a minimum
-      // reported subgroup size of 16 as opposed to 8.
-      if (m_device->adapter()->matchesDriver(VK_DRIVER_ID_INTEL_OPEN_SOURCE_MESA))
-        return m_device->properties().vk13.minSubgroupSize >= 16u;
 
-      return true;
+  void DxvkMemoryAllocator::recordTraceEvent(
+          DxvkMemoryTraceEvent&       event,
+          DxvkResourceAllocation*     allocation) {
+    if (allocation) {
+      // Allocation objects are recycled, but only after the
+      // free event has been recorded, so IDs are unambiguous
+      event.id = reinterpret_cast<uintptr_t>(allocation);
+
+      if (allocation->m_type)
+        event.memoryType = allocation->m_type->index;
+
+      if (allocation->m_flags.test(DxvkAllocationFlag::OwnsMemory))
+        event.setFlag(DxvkMemoryTraceFlag::Dedicated);
+
+      allocation->m_flags.set(DxvkAllocationFlag::Traced);
     } else {
-      return option == Tristate::True;
+      event.setFlag(DxvkMemoryTraceFlag::Failed);
     }
+
+    m_trace->record(event);
+  }
+
+
+  void DxvkMemoryAllocator::recordTraceFree(
+          DxvkResourceAllocation*     allocation) {
+    allocation->m_flags.clr(DxvkAllocationFlag::Traced);
+
+    DxvkMemoryTraceEvent event = { };
+    event.timestamp = m_trace->getTimestamp();
+    event.type = DxvkMemoryTraceEventType::Free;
+    event.id = reinterpret_cast<uintptr_t>(allocation);
+
+    m_trace->record(event);
   }
 
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <map>
 #include <memory>
 
@@ -8,6 +9,7 @@
 #include "dxvk_allocator.h"
 #include "dxvk_descriptor.h"
 #include "dxvk_hash.h"
+#include "dxvk_memory_trace.h"
 
 #include "../util/util_time.h"
 
@@ -145,10 +147,95 @@ namespace dxvk {
   struct DxvkMemoryHeap {
     uint32_t          index         = 0u;
     uint32_t          memoryTypes   = 0u;
-    VkDeviceSize      memoryBudget  = 0u;
     VkMemoryHeap      properties    = { };
     bool              enforceBudget = false;
-    bool              enableEviction = false;
+
+    /// Current budget, updated periodically. Read
+    /// without locking from any memory type.
+    std::atomic<VkDeviceSize> memoryBudget = { 0u };
+    /// Whether resources should be evicted from this heap
+    std::atomic<bool> enableEviction = { false };
+
+    /// Protects adapter statistics updates for this heap.
+    /// May be taken while holding a memory type lock, but
+    /// not the other way around.
+    dxvk::mutex       statsMutex;
+  };
+
+
+  /**
+   * \brief Memory type lock
+   *
+   * Mutex that can optionally measure how long it is held in
+   * total. Lock timing is meant for offline analysis only, since
+   * querying the time on every lock and unlock is not free.
+   */
+  class DxvkMemoryTypeMutex {
+
+  public:
+
+    void lock() {
+      m_mutex.lock();
+
+      if (unlikely(m_measure))
+        m_lockTime = high_resolution_clock::now();
+    }
+
+    void unlock() {
+      if (unlikely(m_measure))
+        m_holdTime += high_resolution_clock::now() - m_lockTime;
+
+      m_mutex.unlock();
+    }
+
+    bool try_lock() {
+      if (!m_mutex.try_lock())
+        return false;
+
+      if (unlikely(m_measure))
+        m_lockTime = high_resolution_clock::now();
+
+      return true;
+    }
+
+    /**
+     * \brief Enables lock timing
+     *
+     * Must be called before the lock is first used.
+     */
+    void enableTiming() {
+      m_measure = true;
+    }
+
+    /**
+     * \brief Queries total time the lock was held
+     *
+     * Must be called while holding the lock.
+     * \returns Total hold time, in nanoseconds
+     */
+    uint64_t getHoldTime() const {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(m_holdTime).count();
+    }
+
+  private:
+
+    dxvk::mutex                       m_mutex;
+    bool                              m_measure = false;
+    high_resolution_clock::time_point m_lockTime = { };
+    high_resolution_clock::duration   m_holdTime = { };
+
+  };
+
+
+  /**
+   * \brief Memory type counters
+   *
+   * Updated while holding the memory type lock, but may
+   * be read at any time in order to compute heap stats.
+   */
+  struct DxvkMemoryTypeCounters {
+    std::atomic<VkDeviceSize> memoryAllocated = { 0u };
+    std::atomic<VkDeviceSize> memoryUsed      = { 0u };
   };
 
 
@@ -160,12 +247,18 @@ namespace dxvk {
    * this memory type.
    */
   struct DxvkMemoryType {
+    /// Protects the memory pools of this memory type. Memory
+    /// types are locked independently so that allocations on
+    /// different types do not contend with each other.
+    alignas(CACHE_LINE_SIZE)
+    DxvkMemoryTypeMutex mutex;
+
     uint32_t          index         = 0u;
     VkMemoryType      properties    = { };
 
     DxvkMemoryHeap*   heap          = nullptr;
 
-    DxvkMemoryStats   stats         = { };
+    DxvkMemoryTypeCounters stats;
 
     VkBufferUsageFlags bufferUsage  = 0u;
 
@@ -190,6 +283,9 @@ namespace dxvk {
     size_t chunkIndex = 0u;
     /// Number of chunks allocated
     size_t chunkCount = 0u;
+    /// Total time the memory type lock was held, in
+    /// nanoseconds. Only measured if enabled on creation.
+    uint64_t lockTime = 0u;
   };
 
 
@@ -491,6 +587,9 @@ namespace dxvk {
     /// Memory must be cleared to zero when the allocation
     /// is freed. Only used to work around app bugs.
     ClearOnFree = 6,
+    /// Allocation was recorded in the memory trace
+    /// and its release must be recorded as well.
+    Traced      = 7,
   };
 
   using DxvkAllocationFlags = Flags<DxvkAllocationFlag>;
@@ -755,12 +854,14 @@ namespace dxvk {
 
     DxvkLocalAllocationCache(
             DxvkMemoryAllocator*        allocator,
-            uint32_t                    memoryTypes)
-    : m_allocator(allocator), m_memoryTypes(memoryTypes) { }
+            uint32_t                    memoryTypes,
+            uint32_t                    refillCount)
+    : m_allocator(allocator), m_memoryTypes(memoryTypes),
+      m_refillCount(refillCount) { }
 
     DxvkLocalAllocationCache(DxvkLocalAllocationCache&& other)
     : m_allocator(other.m_allocator), m_memoryTypes(other.m_memoryTypes),
-      m_pools(other.m_pools) {
+      m_refillCount(other.m_refillCount), m_pools(other.m_pools) {
       other.m_allocator = nullptr;
       other.m_memoryTypes = 0u;
       other.m_pools = { };
@@ -771,6 +872,7 @@ namespace dxvk {
 
       m_allocator = other.m_allocator;
       m_memoryTypes = other.m_memoryTypes;
+      m_refillCount = other.m_refillCount;
       m_pools = other.m_pools;
 
       other.m_allocator = nullptr;
@@ -816,6 +918,7 @@ namespace dxvk {
 
     DxvkMemoryAllocator*  m_allocator   = nullptr;
     uint32_t              m_memoryTypes = 0u;
+    uint32_t              m_refillCount = 1u;
 
     std::array<DxvkResourceAllocation*, PoolCount> m_pools = { };
 
@@ -897,7 +1000,8 @@ namespace dxvk {
      * \brief Frees unused memory
      *
      * Periodically called from the worker to free some
-     * memory that has not been used in some time.
+     * memory that has not been used in some time. The
+     * memory type that owns the cache must be locked.
      * \param [in] time Current time
      */
     void cleanupUnusedFromLockedAllocator(
@@ -1083,6 +1187,146 @@ namespace dxvk {
   };
 
 
+  /**
+   * \brief Memory allocator device properties
+   *
+   * Device features and options that affect allocator
+   * behaviour. Queried once when creating the allocator.
+   */
+  struct DxvkMemoryDeviceProperties {
+    /// Memory types and heaps
+    VkPhysicalDeviceMemoryProperties memory = { };
+    /// Queue families that global buffers are shared with
+    DxvkSharingModeInfo sharingMode = { };
+    /// Buffer-image granularity
+    VkDeviceSize bufferImageGranularity = 0u;
+    /// Budget limit for device-local heaps, or 0
+    VkDeviceSize maxMemoryBudget = 0u;
+    /// Whether to enforce heap budgets. Only
+    /// useful on dedicated GPUs.
+    bool enforceBudget = false;
+    /// Whether heap budgets can be queried
+    bool memoryBudget = false;
+    /// Whether memory priorities are supported
+    bool memoryPriority = false;
+    /// Whether device-local memory is pageable
+    bool pageableDeviceLocalMemory = false;
+    /// Whether sparse binding is supported
+    bool sparseBinding = false;
+    /// Whether transform feedback is supported
+    bool transformFeedback = false;
+    /// Whether descriptor buffers are used
+    bool descriptorBuffer = false;
+    /// Whether to assign debug names to memory objects
+    bool debugNames = false;
+    /// Whether to clear newly mapped memory
+    bool zeroMappedMemory = false;
+    /// Whether to defragment device memory
+    bool enableDefrag = false;
+    /// Whether to measure memory type lock hold times
+    bool measureLockTime = false;
+  };
+
+
+  /**
+   * \brief Memory allocator backend
+   *
+   * Provides device functionality that the allocator needs in
+   * order to manage memory. The memory replay tool implements
+   * this with a mock Vulkan device in order to run the allocator
+   * without a GPU.
+   */
+  class DxvkMemoryBackend {
+
+  public:
+
+    virtual ~DxvkMemoryBackend();
+
+    /**
+     * \brief Queries device functions
+     *
+     * Used to allocate, map and bind memory, and
+     * to create buffer and image objects.
+     * \returns Device functions
+     */
+    virtual Rc<vk::DeviceFn> vkd() const = 0;
+
+    /**
+     * \brief Queries device properties
+     * \returns Device properties
+     */
+    virtual DxvkMemoryDeviceProperties getProperties() const = 0;
+
+    /**
+     * \brief Queries current heap budgets
+     *
+     * Only called if heap budgets are supported.
+     * \param [out] budget Heap budget and usage
+     */
+    virtual void getMemoryBudget(
+            VkPhysicalDeviceMemoryBudgetPropertiesEXT& budget) const = 0;
+
+    /**
+     * \brief Reports changes to memory statistics
+     *
+     * \param [in] heap Heap index
+     * \param [in] allocated Change in allocated memory
+     * \param [in] used Change in used memory
+     */
+    virtual void notifyMemoryStats(
+            uint32_t            heap,
+            int64_t             allocated,
+            int64_t             used) = 0;
+
+    /**
+     * \brief Queries current time
+     *
+     * Used for time-based clean-up tasks, so
+     * that replays can run faster than real time.
+     * \returns Current time
+     */
+    virtual high_resolution_clock::time_point getCurrentTime() const = 0;
+
+  };
+
+
+  /**
+   * \brief Device memory backend
+   *
+   * Default memory allocator backend
+   * that forwards calls to the device.
+   */
+  class DxvkDeviceMemoryBackend : public DxvkMemoryBackend {
+
+  public:
+
+    DxvkDeviceMemoryBackend(DxvkDevice* device);
+
+    ~DxvkDeviceMemoryBackend();
+
+    Rc<vk::DeviceFn> vkd() const;
+
+    DxvkMemoryDeviceProperties getProperties() const;
+
+    void getMemoryBudget(
+            VkPhysicalDeviceMemoryBudgetPropertiesEXT& budget) const;
+
+    void notifyMemoryStats(
+            uint32_t            heap,
+            int64_t             allocated,
+            int64_t             used);
+
+    high_resolution_clock::time_point getCurrentTime() const;
+
+  private:
+
+    DxvkDevice* m_device;
+
+    bool enableDefrag() const;
+
+  };
+
+
   /**
    * \brief Memory allocator
    * 
@@ -1117,8 +1361,19 @@ namespace dxvk {
       VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT |
       VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT;
   public:
-    
-    DxvkMemoryAllocator(DxvkDevice* device);
+
+    /**
+     * \brief Creates memory allocator
+     *
+     * \param [in] device Device. May be \c nullptr, in which case
+     *    views and sparse resources cannot be created, but memory
+     *    allocation and resource creation work as usual.
+     * \param [in] backend Memory backend
+     */
+    DxvkMemoryAllocator(
+            DxvkDevice*                         device,
+            std::unique_ptr<DxvkMemoryBackend>&& backend);
+
     ~DxvkMemoryAllocator();
     
     DxvkDevice* device() const {
@@ -1194,13 +1449,18 @@ namespace dxvk {
     /**
      * \brief Creates local allocation cache for buffer resources
      *
+     * The refill count determines how many lists of allocations
+     * the cache will acquire at once when it runs empty, which
+     * is useful for callers that allocate in large bursts.
      * \param [in] bufferUsage Required buffer usage flags
      * \param [in] properties Required memory properties
+     * \param [in] refillCount Number of allocation lists per refill
      * \returns Local allocation cache
      */
     DxvkLocalAllocationCache createAllocationCache(
             VkBufferUsageFlags          bufferUsage,
-            VkMemoryPropertyFlags       properties);
+            VkMemoryPropertyFlags       properties,
+            uint32_t                    refillCount);
 
     /**
      * \brief Imports existing buffer resource
@@ -1296,7 +1556,9 @@ namespace dxvk {
     /**
      * \brief Requests to make a resource resident
      *
-     * Attempts to move an evicted resource back to VRAM.
+     * Attempts to move an evicted resource back to VRAM. If
+     * video memory is under pressure, the request is ignored
+     * in order to avoid evicting other resources in turn.
      * \param [in] resource Resource to relocate
      */
     void requestMakeResident(
@@ -1316,10 +1578,23 @@ namespace dxvk {
      *
      * Intended to be called periodically by a worker thread in order
      * to initiate defragmentation, clean up the allocation cache and
-     * free unused memory.
+     * free unused memory. Must be called once per submission, since
+     * resource recency is tracked in terms of submissions.
      */
     void performTimedTasks();
 
+    /**
+     * \brief Queries current submission ID
+     *
+     * Used to track when a resource has last been used
+     * by the GPU, in order to evict unused resources
+     * first when video memory is oversubscribed.
+     * \returns Current submission ID
+     */
+    uint64_t getSubmissionId() const {
+      return m_submissionId.load(std::memory_order_relaxed);
+    }
+
     /**
      * \brief Polls relocation list
      *
@@ -1333,11 +1608,20 @@ namespace dxvk {
 
   private:
 
+    struct EvictionCandidate {
+      uint64_t                lastUse;
+      DxvkResourceAllocation* allocation;
+      DxvkPagedResource*      resource;
+    };
+
     DxvkDevice* m_device;
 
-    DxvkSharingModeInfo       m_sharingModeInfo;
+    std::unique_ptr<DxvkMemoryBackend> m_backend;
+    Rc<vk::DeviceFn>          m_vkd;
+
+    DxvkMemoryDeviceProperties m_properties;
 
-    dxvk::mutex               m_mutex;
+    std::unique_ptr<DxvkMemoryTraceWriter> m_trace;
 
     uint32_t m_memTypeCount = 0u;
     uint32_t m_memHeapCount = 0u;
@@ -1352,17 +1636,24 @@ namespace dxvk {
 
     std::array<uint32_t, 16> m_memTypesByPropertyFlags = { };
 
-    DxvkResourceAllocationPool  m_allocationPool;
+    std::array<DxvkResourceAllocationPool, VK_MAX_MEMORY_TYPES> m_allocationPools;
 
-    uint64_t            m_nextCookie = 0u;
+    std::atomic<uint64_t> m_nextCookie = { 0u };
+
+    alignas(CACHE_LINE_SIZE)
+    dxvk::mutex                 m_untypedMutex;
+    DxvkResourceAllocationPool  m_untypedAllocationPool;
 
     alignas(CACHE_LINE_SIZE)
+    std::atomic<uint64_t> m_submissionId = { 0u };
+
     high_resolution_clock::time_point m_taskDeadline = { };
     std::array<DxvkMemoryStats, VK_MAX_MEMORY_HEAPS> m_adapterHeapStats = { };
 
     alignas(CACHE_LINE_SIZE)
     dxvk::mutex               m_resourceMutex;
     std::unordered_map<uint64_t, DxvkPagedResource*> m_resourceMap;
+    std::vector<EvictionCandidate> m_evictionCandidates;
 
     alignas(CACHE_LINE_SIZE)
     DxvkRelocationList        m_relocations;
@@ -1405,7 +1696,8 @@ namespace dxvk {
     void freeEmptyChunksInHeap(
       const DxvkMemoryHeap&       heap,
             VkDeviceSize          allocationSize,
-            high_resolution_clock::time_point time);
+            high_resolution_clock::time_point time,
+      const DxvkMemoryType*       lockedType);
 
     bool freeEmptyChunksInPool(
             DxvkMemoryType&       type,
@@ -1438,6 +1730,8 @@ namespace dxvk {
             DxvkSparsePageTable*  sparsePageTable,
       const DxvkAllocationInfo&   allocationInfo);
 
+    DxvkResourceAllocation* createUntypedAllocation();
+
     bool refillAllocationCache(
             DxvkLocalAllocationCache* cache,
       const VkMemoryRequirements& requirements,
@@ -1452,8 +1746,30 @@ namespace dxvk {
       const DxvkMemoryType&       type,
             bool                  mappable) const;
 
-    uint32_t determineSparseMemoryTypes(
-            DxvkDevice*           device) const;
+    Rc<DxvkResourceAllocation> createBufferResourceInternal(
+      const VkBufferCreateInfo&         createInfo,
+      const DxvkAllocationInfo&         allocationInfo,
+            DxvkLocalAllocationCache*   allocationCache,
+            DxvkMemoryTraceEvent*       event);
+
+    Rc<DxvkResourceAllocation> createImageResourceInternal(
+      const VkImageCreateInfo&          createInfo,
+      const DxvkAllocationInfo&         allocationInfo,
+      const void*                       next,
+            DxvkMemoryTraceEvent*       event);
+
+    DxvkMemoryTraceEvent beginTraceEvent(
+            DxvkMemoryTraceEventType    type,
+      const DxvkAllocationInfo&         allocationInfo) const;
+
+    void recordTraceEvent(
+            DxvkMemoryTraceEvent&       event,
+            DxvkResourceAllocation*     allocation);
+
+    void recordTraceFree(
+            DxvkResourceAllocation*     allocation);
+
+    uint32_t determineSparseMemoryTypes() const;
 
     void determineBufferUsageFlagsPerMemoryType();
 
@@ -1487,10 +1803,7 @@ namespace dxvk {
     void evictResources(
             DxvkMemoryType&       type);
 
-    void performTimedTasksLocked(
-            high_resolution_clock::time_point currentTime);
-
-    bool enableDefrag() const;
+    bool canPromoteResources() const;
 
   };
   
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cstring>
+
+#include "dxvk_memory_trace.h"
+
+#include "../util/log/log.h"
+
+#include "../util/util_env.h"
+#include "../util/util_string.h"
+
+namespace dxvk {
+
+  constexpr static std::array<char, 4u> MemoryTraceMagic = { 'D', 'X', 'M', 'T' };
+  constexpr static uint32_t MemoryTraceVersion = 2u;
+
+
+  DxvkMemoryTraceWriter::DxvkMemoryTraceWriter(
+    const std::string&                      path,
+    const VkPhysicalDeviceMemoryProperties& memoryProperties,
+          VkDeviceSize                      granularity)
+  : m_startTime(high_resolution_clock::now()) {
+    m_file = util::File(path, util::FileFlags(
+      util::FileFlag::AllowWrite, util::FileFlag::Truncate));
+
+    DxvkMemoryTraceHeader header = { };
+    header.magic = MemoryTraceMagic;
+    header.version = MemoryTraceVersion;
+    header.granularity = granularity;
+    header.memoryProperties = memoryProperties;
+
+    if (!m_file || !m_file.append(sizeof(header), &header)) {
+      Logger::err(str::format("Memory: Failed to create trace file ", path));
+      m_file = util::File();
+      return;
+    }
+
+    Logger::info(str::format("Memory: Recording allocator trace to ", path));
+    m_events.reserve(BatchSize);
+  }
+
+
+  DxvkMemoryTraceWriter::~DxvkMemoryTraceWriter() {
+    std::lock_guard lock(m_mutex);
+    flushEvents();
+
+    if (m_file)
+      m_file.flush();
+  }
+
+
+  uint64_t DxvkMemoryTraceWriter::getTimestamp() const {
+    auto t = high_resolution_clock::now() - m_startTime;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+  }
+
+
+  void DxvkMemoryTraceWriter::record(DxvkMemoryTraceEvent event) {
+    uint64_t duration = getTimestamp() - event.timestamp;
+    event.durationNs = uint32_t(std::min<uint64_t>(duration, ~0u));
+
+    std::lock_guard lock(m_mutex);
+    m_events.push_back(event);
+
+    if (m_events.size() >= BatchSize)
+      flushEvents();
+  }
+
+
+  std::string DxvkMemoryTraceWriter::getFilePath() {
+    std::string path = env::getEnvVar("DXVK_MEMORY_TRACE");
+
+    if (path.empty())
+      return path;
+
+    return str::format(path, env::PlatformDirSlash, env::getExeBaseName(), ".dxvk-memtrace");
+  }
+
+
+  void DxvkMemoryTraceWriter::flushEvents() {
+    if (m_events.empty())
+      return;
+
+    if (m_file && !m_file.append(m_events.size() * sizeof(DxvkMemoryTraceEvent), m_events.data())) {
+      Logger::err("Memory: Failed to write trace file, stopping trace");
+      m_file = util::File();
+    }
+
+    m_events.clear();
+  }
+
+
+
+
+  DxvkMemoryTraceReader::DxvkMemoryTraceReader() {
+
+  }
+
+
+  DxvkMemoryTraceReader::~DxvkMemoryTraceReader() {
+
+  }
+
+
+  bool DxvkMemoryTraceReader::open(const std::string& path) {
+    m_file = util::File(path, util::FileFlags(
+      util::FileFlag::AllowRead, util::FileFlag::MapRead));
+
+    if (!m_file)
+      return false;
+
+    m_size = m_file.size();
+    m_offset = sizeof(m_header);
+
+    if (m_size < m_offset || !m_file.read(0u, sizeof(m_header), &m_header))
+      return false;
+
+    return m_header.magic == MemoryTraceMagic
+        && m_header.version == MemoryTraceVersion
+        && m_header.memoryProperties.memoryTypeCount <= VK_MAX_MEMORY_TYPES
+        && m_header.memoryProperties.memoryHeapCount <= VK_MAX_MEMORY_HEAPS;
+  }
+
+
+  bool DxvkMemoryTraceReader::readEvent(DxvkMemoryTraceEvent& event) {
+    if (m_offset + sizeof(event) > m_size)
+      return false;
+
+    if (auto data = m_file.getMappedData(m_offset, sizeof(event)))
+      std::memcpy(&event, data, sizeof(event));
+    else if (!m_file.read(m_offset, sizeof(event), &event))
+      return false;
+
+    m_offset += sizeof(event);
+    return true;
+  }
+
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "../util/thread.h"
+#include "../util/util_file.h"
+#include "../util/util_time.h"
+
+#include "../vulkan/vulkan_loader.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Memory trace event type
+   */
+  enum class DxvkMemoryTraceEventType : uint32_t {
+    /// Buffer resource created
+    Buffer  = 0,
+    /// Image resource created
+    Image   = 1,
+    /// Raw memory allocated, e.g. for sparse pages
+    Memory  = 2,
+    /// Previously recorded allocation freed
+    Free    = 3,
+  };
+
+
+  /**
+   * \brief Memory trace event flags
+   */
+  enum class DxvkMemoryTraceFlag : uint32_t {
+    /// Allocation failed
+    Failed            = 0,
+    /// Allocation ended up in dedicated memory
+    Dedicated         = 1,
+    /// Resource prefers a dedicated allocation
+    PreferDedicated   = 2,
+    /// Resource requires a dedicated allocation
+    RequireDedicated  = 3,
+    /// Allocation was served from an allocation cache
+    Cached            = 4,
+    /// Image uses optimal tiling, so the allocator pads
+    /// alignment to the buffer-image granularity
+    OptimalTiling     = 5,
+    /// Sparse resource, only metadata is allocated
+    Sparse            = 6,
+  };
+
+
+  /**
+   * \brief Memory trace event
+   *
+   * Fixed-size record as stored in the trace file. For allocation
+   * events, the memory requirements are the ones the allocator
+   * used to make its decision, and the memory type is the one
+   * the resource ended up in. Free events only store the ID.
+   */
+  struct DxvkMemoryTraceEvent {
+    /// Time since trace start, in nanoseconds
+    uint64_t timestamp      = 0u;
+    /// Allocation ID. Unique among live allocations only.
+    uint64_t id             = 0u;
+    /// Cookie of the resource that owns the allocation, if
+    /// any. Used to follow resources that get relocated.
+    uint64_t cookie         = 0u;
+    /// Required size, in bytes
+    uint64_t size           = 0u;
+    /// Required alignment, in bytes
+    uint64_t alignment      = 0u;
+    /// Event type
+    DxvkMemoryTraceEventType type = DxvkMemoryTraceEventType::Free;
+    /// Supported memory types
+    uint32_t memoryTypeBits = 0u;
+    /// Requested memory property flags
+    uint32_t properties     = 0u;
+    /// Allocation mode flags, see \c DxvkAllocationMode
+    uint32_t mode           = 0u;
+    /// Buffer or image usage flags
+    uint32_t usage          = 0u;
+    /// Event flags, see \c DxvkMemoryTraceFlag
+    uint32_t flags          = 0u;
+    /// Memory type index the allocation was made
+    /// from, or \c ~0u if the allocation failed
+    uint32_t memoryType     = ~0u;
+    /// Time spent in the allocator, in nanoseconds
+    uint32_t durationNs     = 0u;
+
+    void setRequirements(const VkMemoryRequirements& requirements) {
+      size = requirements.size;
+      alignment = requirements.alignment;
+      memoryTypeBits = requirements.memoryTypeBits;
+    }
+
+    void setFlag(DxvkMemoryTraceFlag flag) {
+      flags |= 1u << uint32_t(flag);
+    }
+
+    void clrFlag(DxvkMemoryTraceFlag flag) {
+      flags &= ~(1u << uint32_t(flag));
+    }
+
+    bool testFlag(DxvkMemoryTraceFlag flag) const {
+      return flags & (1u << uint32_t(flag));
+    }
+  };
+
+  static_assert(sizeof(DxvkMemoryTraceEvent) == 72u);
+
+
+  /**
+   * \brief Memory trace header
+   *
+   * Stores the memory layout of the device the trace
+   * was recorded on so that replays can use the same
+   * layout by default.
+   */
+  struct DxvkMemoryTraceHeader {
+    std::array<char, 4u>  magic         = { };
+    uint32_t              version       = 0u;
+    uint64_t              granularity   = 0u;
+    VkPhysicalDeviceMemoryProperties memoryProperties = { };
+  };
+
+
+  /**
+   * \brief Memory trace writer
+   *
+   * Records allocator calls to a binary file for offline replay.
+   * Events are buffered in memory and written in large batches,
+   * so the overhead on the allocator is small, but non-zero.
+   */
+  class DxvkMemoryTraceWriter {
+    constexpr static size_t BatchSize = 4096u;
+  public:
+
+    DxvkMemoryTraceWriter(
+      const std::string&                      path,
+      const VkPhysicalDeviceMemoryProperties& memoryProperties,
+            VkDeviceSize                      granularity);
+
+    ~DxvkMemoryTraceWriter();
+
+    /**
+     * \brief Checks whether the trace file could be created
+     * \returns \c true if events can be recorded
+     */
+    bool isValid() const {
+      return bool(m_file);
+    }
+
+    /**
+     * \brief Queries current time stamp
+     *
+     * Used to measure the time spent in an allocator call.
+     * \returns Time stamp, relative to the start of the trace
+     */
+    uint64_t getTimestamp() const;
+
+    /**
+     * \brief Records event
+     *
+     * Sets the duration of the event based on its start
+     * time stamp, and appends the event to the trace.
+     * \param [in] event Event with start time stamp
+     */
+    void record(DxvkMemoryTraceEvent event);
+
+    /**
+     * \brief Queries trace file path
+     *
+     * Uses the \c DXVK_MEMORY_TRACE environment variable
+     * as a directory and the executable name as file name.
+     * \returns Trace file path, or empty string if disabled
+     */
+    static std::string getFilePath();
+
+  private:
+
+    dxvk::mutex                       m_mutex;
+    util::File                        m_file;
+    std::vector<DxvkMemoryTraceEvent> m_events;
+
+    high_resolution_clock::time_point m_startTime;
+
+    void flushEvents();
+
+  };
+
+
+  /**
+   * \brief Memory trace reader
+   */
+  class DxvkMemoryTraceReader {
+
+  public:
+
+    DxvkMemoryTraceReader();
+
+    ~DxvkMemoryTraceReader();
+
+    /**
+     * \brief Opens trace file and reads header
+     *
+     * \param [in] path Trace file path
+     * \returns \c true if the header is valid
+     */
+    bool open(const std::string& path);
+
+    /**
+     * \brief Queries trace header
+     * \returns Trace header
+     */
+    const DxvkMemoryTraceHeader& header() const {
+      return m_header;
+    }
+
+    /**
+     * \brief Reads next event
+     *
+     * \param [out] event Event
+     * \returns \c false at the end of the trace
+     */
+    bool readEvent(DxvkMemoryTraceEvent& event);
+
+  private:
+
+    util::File            m_file;
+    size_t                m_offset = 0u;
+    size_t                m_size = 0u;
+
+    DxvkMemoryTraceHeader m_header;
+
+  };
+
+}
@@ -25,7 +25,7 @@ namespace dxvk {
     DxvkObjects(DxvkDevice* device)
     : m_device          (device),
       m_descriptorInfo  (device),
-      m_memoryManager   (device),
+      m_memoryManager   (device, std::make_unique<DxvkDeviceMemoryBackend>(device)),
       m_samplerPool     (device),
       m_pipelineManager (device),
       m_eventPool       (device),
@@ -26,6 +26,9 @@ namespace dxvk {
     /// Enable descriptor buffer
     Tristate enableDescriptorBuffer = Tristate::Auto;
 
+    /// Enable host image copy
+    Tristate enableHostImageCopy = Tristate::Auto;
+
     /// Enables pipeline lifetime tracking
     Tristate trackPipelineLifetime = Tristate::Auto;
 
@@ -20,13 +20,7 @@ namespace dxvk {
   void DxvkPipelineWorkers::compilePipelineLibrary(
           DxvkShaderPipelineLibrary*      library,
           DxvkPipelinePriority            priority) {
-    std::unique_lock lock(m_lock);
-    this->startWorkers();
-
-    m_tasksTotal += 1;
-
-    m_buckets[uint32_t(priority)].queue.emplace(library);
-    notifyWorkers(priority);
+    enqueueTask(PipelineEntry(library), priority);
   }
 
 
@@ -34,53 +28,189 @@ namespace dxvk {
           DxvkGraphicsPipeline*           pipeline,
     const DxvkGraphicsPipelineStateInfo&  state,
           DxvkPipelinePriority            priority) {
-    std::unique_lock lock(m_lock);
-    this->startWorkers();
-
     pipeline->acquirePipeline();
-    m_tasksTotal += 1;
 
-    m_buckets[uint32_t(priority)].queue.emplace(pipeline, state);
-    notifyWorkers(priority);
+    enqueueTask(PipelineEntry(pipeline, state), priority);
   }
 
 
   void DxvkPipelineWorkers::stopWorkers() {
+    uint32_t workerCount = 0u;
+
     { std::unique_lock lock(m_lock);
 
-      if (!m_workersRunning)
+      if (!m_workersRunning.load())
         return;
 
-      m_workersRunning = false;
+      m_workersRunning.store(false);
+      m_cond.notify_all();
+
+      workerCount = m_workerCount.load();
+    }
+
+    for (uint32_t i = 0; i < workerCount; i++)
+      m_workers[i].thread.join();
 
-      for (uint32_t i = 0; i < m_buckets.size(); i++)
-        m_buckets[i].cond.notify_all();
+    // Discard pending work, workers may get restarted later
+    for (uint32_t i = 0; i < workerCount; i++) {
+      for (auto& queue : m_workers[i].queues)
+        queue.clear();
     }
 
-    for (auto& worker : m_workers)
-      worker.join();
+    for (auto& stats : m_priorityStats)
+      stats.tasksQueued.store(0u);
 
-    m_workers.clear();
+    m_backgroundTasks.store(0u);
+
+    m_workerCount.store(0u);
+
+    if (Logger::logLevel() <= LogLevel::Debug) {
+      static const std::array<const char*, DxvkPipelinePriorityCount> names = { "high", "normal", "low" };
+
+      for (uint32_t i = 0; i < DxvkPipelinePriorityCount; i++) {
+        uint64_t count = m_priorityStats[i].tasksStarted.load();
+        uint64_t waitUs = m_priorityStats[i].waitTimeUs.load();
+
+        Logger::debug(str::format("Pipeline workers: ", count, " ", names[i], " priority tasks, ",
+          "average wait time: ", count ? waitUs / count : 0u, " us"));
+      }
+    }
   }
 
 
-  void DxvkPipelineWorkers::notifyWorkers(DxvkPipelinePriority priority) {
-    uint32_t index = uint32_t(priority);
+  void DxvkPipelineWorkers::enqueueTask(
+          PipelineEntry&&                 entry,
+          DxvkPipelinePriority            priority) {
+    uint32_t workerCount = m_workerCount.load(std::memory_order_acquire);
 
-    // If any workers are idle in a suitable set, notify the corresponding
-    // condition variable. If all workers are busy anyway, we know that the
-    // job is going to be picked up at some point anyway.
-    for (uint32_t i = index; i < m_buckets.size(); i++) {
-      if (m_buckets[i].idleWorkers) {
-        m_buckets[i].cond.notify_one();
-        break;
+    if (unlikely(!workerCount))
+      workerCount = startWorkers();
+
+    uint32_t priorityIndex = uint32_t(priority);
+    entry.queueTime = high_resolution_clock::now();
+
+    m_tasksTotal += 1;
+
+    uint64_t queuedTasks = m_priorityStats[priorityIndex].tasksQueued.fetch_add(1u) + 1u;
+
+    // Distribute tasks evenly among workers, idle workers
+    // will steal tasks from busy workers as necessary.
+    auto& worker = m_workers[m_nextWorker.fetch_add(1u, std::memory_order_relaxed) % workerCount];
+
+    { std::lock_guard lock(worker.lock);
+      worker.queues[priorityIndex].push_back(std::move(entry));
+    }
+
+    // Spawn more workers if the queue keeps growing
+    if (unlikely(queuedTasks > workerCount && workerCount < m_maxWorkerCount))
+      growWorkers(workerCount);
+
+    notifyWorkers();
+  }
+
+
+  bool DxvkPipelineWorkers::dequeueTask(
+          uint32_t                        workerIndex,
+          PipelineEntry&                  entry,
+          DxvkPipelinePriority&           priority) {
+    uint32_t workerCount = m_workerCount.load(std::memory_order_acquire);
+
+    for (uint32_t i = 0; i < DxvkPipelinePriorityCount; i++) {
+      if (!m_priorityStats[i].tasksQueued.load(std::memory_order_relaxed))
+        continue;
+
+      // Normal and low priority tasks are background work,
+      // only process them if enough workers are available
+      bool isBackground = i != uint32_t(DxvkPipelinePriority::High);
+
+      if (isBackground && !reserveBackgroundSlot(workerCount))
+        return false;
+
+      // Prefer our own queue, then steal from other workers
+      bool found = dequeueTaskFrom(workerIndex, i, entry);
+
+      for (uint32_t j = 1; j < workerCount && !found; j++)
+        found = dequeueTaskFrom((workerIndex + j) % workerCount, i, entry);
+
+      if (found) {
+        auto waitTime = high_resolution_clock::now() - entry.queueTime;
+
+        auto& stats = m_priorityStats[i];
+        stats.tasksQueued -= 1u;
+        stats.tasksStarted += 1u;
+        stats.waitTimeUs += std::chrono::duration_cast<std::chrono::microseconds>(waitTime).count();
+
+        priority = DxvkPipelinePriority(i);
+        return true;
       }
+
+      if (isBackground)
+        m_backgroundTasks -= 1u;
+    }
+
+    return false;
+  }
+
+
+  bool DxvkPipelineWorkers::dequeueTaskFrom(
+          uint32_t                        workerIndex,
+          uint32_t                        priorityIndex,
+          PipelineEntry&                  entry) {
+    auto& worker = m_workers[workerIndex];
+
+    std::lock_guard lock(worker.lock);
+    auto& queue = worker.queues[priorityIndex];
+
+    if (queue.empty())
+      return false;
+
+    entry = std::move(queue.front());
+    queue.pop_front();
+    return true;
+  }
+
+
+  bool DxvkPipelineWorkers::reserveBackgroundSlot(
+          uint32_t                        workerCount) {
+    // Keep roughly one in eight workers available for
+    // high-priority work, as long as there is more than
+    // one worker thread in the first place.
+    uint32_t limit = workerCount > 1u
+      ? workerCount - std::max(workerCount / 8u, 1u)
+      : 1u;
+
+    uint32_t count = m_backgroundTasks.load();
+
+    do {
+      if (count >= limit)
+        return false;
+    } while (!m_backgroundTasks.compare_exchange_weak(count, count + 1u));
+
+    return true;
+  }
+
+
+  void DxvkPipelineWorkers::notifyWorkers() {
+    // If all workers are busy, we know that the task will be picked
+    // up at some point anyway. The fence pairs with the one in the
+    // worker so that either the worker sees the task, or we see the
+    // idle worker.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (m_idleWorkers.load(std::memory_order_relaxed)) {
+      std::unique_lock lock(m_lock);
+      m_cond.notify_one();
     }
   }
 
 
-  void DxvkPipelineWorkers::startWorkers() {
-    if (!std::exchange(m_workersRunning, true)) {
+  uint32_t DxvkPipelineWorkers::startWorkers() {
+    std::unique_lock lock(m_lock);
+
+    if (m_workersRunning.load())
+      return m_workerCount.load();
+
+    if (!m_workers) {
       // Use all available cores by default
       uint32_t workerCount = dxvk::thread::hardware_concurrency();
 
@@ -94,68 +224,74 @@ namespace dxvk {
       if (m_device->config().numCompilerThreads > 0)
         workerCount = m_device->config().numCompilerThreads;
 
-      // Number of workers that can process pipeline pipelines with normal
-      // priority. Any other workers can only build high-priority pipelines.
-      uint32_t npWorkerCount = std::max(((workerCount - 1) * 5) / 7, 1u);
-      uint32_t lpWorkerCount = std::max(((workerCount - 1) * 2) / 7, 1u);
+      m_maxWorkerCount = workerCount;
+      m_workers = std::make_unique<PipelineWorker[]>(workerCount);
 
-      m_workers.reserve(workerCount);
+      Logger::info(str::format("DXVK: Using up to ", workerCount, " compiler threads"));
+    }
 
-      for (size_t i = 0; i < workerCount; i++) {
-        DxvkPipelinePriority priority = DxvkPipelinePriority::Normal;
+    m_workersRunning.store(true);
 
-        if (i >= npWorkerCount)
-          priority = DxvkPipelinePriority::High;
-        else if (i < lpWorkerCount)
-          priority = DxvkPipelinePriority::Low;
+    // Start out with a fraction of the workers, more will
+    // be spawned as soon as there is enough work to do.
+    spawnWorkersLocked(std::max(m_maxWorkerCount / 4u, 1u));
+    return m_workerCount.load();
+  }
 
-        auto& worker = m_workers.emplace_back([this, priority] {
-          runWorker(priority);
-        });
-        
-        worker.set_priority(ThreadPriority::Lowest);
-      }
 
-      Logger::info(str::format("DXVK: Using ", workerCount, " compiler threads"));
-    }
+  void DxvkPipelineWorkers::growWorkers(
+          uint32_t                        workerCount) {
+    std::unique_lock lock(m_lock);
+
+    if (m_workersRunning.load() && m_workerCount.load() == workerCount)
+      spawnWorkersLocked(std::min(workerCount * 2u, m_maxWorkerCount));
   }
 
 
-  void DxvkPipelineWorkers::runWorker(DxvkPipelinePriority maxPriority) {
-    static const std::array<char, 3> suffixes = { 'h', 'n', 'l' };
+  void DxvkPipelineWorkers::spawnWorkersLocked(
+          uint32_t                        workerCount) {
+    for (uint32_t i = m_workerCount.load(); i < workerCount; i++) {
+      auto& worker = m_workers[i];
+
+      worker.thread = dxvk::thread([this, i] {
+        runWorker(i);
+      });
+
+      worker.thread.set_priority(ThreadPriority::Lowest);
+    }
+
+    m_workerCount.store(workerCount, std::memory_order_release);
+  }
+
 
-    const uint32_t maxPriorityIndex = uint32_t(maxPriority);
-    env::setThreadName(str::format("dxvk-shader-", suffixes.at(maxPriorityIndex)));
+  void DxvkPipelineWorkers::runWorker(uint32_t workerIndex) {
+    env::setThreadName("dxvk-shader");
 
     while (true) {
       PipelineEntry entry;
+      DxvkPipelinePriority priority = DxvkPipelinePriority::High;
 
-      { std::unique_lock lock(m_lock);
-        auto& bucket = m_buckets[maxPriorityIndex];
-
-        bucket.idleWorkers += 1;
-        bucket.cond.wait(lock, [this, maxPriorityIndex, &entry] {
-          // Attempt to fetch a work item from the
-          // highest-priority queue that is not empty
-          for (uint32_t i = 0; i <= maxPriorityIndex; i++) {
-            if (!m_buckets[i].queue.empty()) {
-              entry = m_buckets[i].queue.front();
-              m_buckets[i].queue.pop();
-              return true;
-            }
-          }
-
-          return !m_workersRunning;
-        });
+      if (!dequeueTask(workerIndex, entry, priority)) {
+        std::unique_lock lock(m_lock);
 
-        bucket.idleWorkers -= 1;
+        // Announce that we are going to sleep before checking
+        // the queues again so that wake-ups cannot get lost.
+        m_idleWorkers += 1u;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        m_cond.wait(lock, [&] {
+          return !m_workersRunning.load()
+              || dequeueTask(workerIndex, entry, priority);
+        });
 
-        // Skip pending work, exiting early is
-        // more important in this case.
-        if (!m_workersRunning)
-          break;
+        m_idleWorkers -= 1u;
       }
 
+      // Skip pending work, exiting early is
+      // more important in this case.
+      if (!m_workersRunning.load())
+        break;
+
       if (entry.pipelineLibrary) {
         entry.pipelineLibrary->compilePipeline();
       } else if (entry.graphicsPipeline) {
@@ -164,6 +300,13 @@ namespace dxvk {
       }
 
       m_tasksCompleted += 1;
+
+      if (priority != DxvkPipelinePriority::High) {
+        // Background slot got freed up, wake up a worker
+        // in case it went to sleep because of the limit.
+        m_backgroundTasks -= 1u;
+        notifyWorkers();
+      }
     }
   }
 
@@ -171,7 +314,8 @@ namespace dxvk {
   DxvkPipelineManager::DxvkPipelineManager(
           DxvkDevice*         device)
   : m_device    (device),
-    m_workers   (device) {
+    m_workers   (device),
+    m_stateCache(device, this, &m_workers) {
     Logger::info(str::format("DXVK: Graphics pipeline libraries ",
       (m_device->canUseGraphicsPipelineLibrary() ? "supported" : "not supported")));
 
@@ -297,6 +441,8 @@ namespace dxvk {
 
     auto library = createShaderPipelineLibrary(key);
     m_workers.compilePipelineLibrary(library, DxvkPipelinePriority::Normal);
+
+    m_stateCache.registerShader(shader);
   }
 
 
@@ -328,6 +474,7 @@ namespace dxvk {
 
 
   void DxvkPipelineManager::stopWorkerThreads() {
+    m_stateCache.stopWorkers();
     m_workers.stopWorkers();
   }
 
@@ -1,12 +1,16 @@
 
 #pragma once
 
+#include <deque>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <unordered_map>
 
+#include "../util/util_time.h"
+
 #include "dxvk_compute.h"
 #include "dxvk_graphics.h"
+#include "dxvk_state_cache.h"
 
 namespace dxvk {
 
@@ -33,11 +37,6 @@ namespace dxvk {
     std::atomic<uint32_t> numComputePipelines   = { 0u };
   };
 
-  struct DxvkPipelineWorkerStats {
-    uint64_t tasksCompleted;
-    uint64_t tasksTotal;
-  };
-
   /**
    * \brief Pipeline priority
    */
@@ -47,11 +46,41 @@ namespace dxvk {
     Low     = 2,
   };
 
+  constexpr uint32_t DxvkPipelinePriorityCount = 3u;
+
+  /**
+   * \brief Pipeline worker stats
+   *
+   * Queue depth and wait times are tracked per priority,
+   * indexed by \ref DxvkPipelinePriority. Wait time is
+   * the accumulated time between submitting a task and
+   * a worker starting to process it, in microseconds.
+   */
+  struct DxvkPipelineWorkerStats {
+    uint64_t tasksCompleted;
+    uint64_t tasksTotal;
+    uint32_t workerCount;
+    std::array<uint64_t, DxvkPipelinePriorityCount> queueDepth;
+    std::array<uint64_t, DxvkPipelinePriorityCount> tasksStarted;
+    std::array<uint64_t, DxvkPipelinePriorityCount> waitTimeUs;
+  };
+
   /**
    * \brief Pipeline manager worker threads
    *
    * Spawns worker threads to compile shader pipeline
    * libraries and optimized pipelines asynchronously.
+   *
+   * Each worker owns one queue per priority, and tasks are
+   * distributed among workers in a round-robin fashion. Idle
+   * workers steal tasks from other workers, always picking
+   * the highest-priority task available. A small number of
+   * workers is kept free of normal- and low-priority work
+   * so that high-priority tasks can start immediately.
+   *
+   * Worker threads are spawned on demand as the number of
+   * queued tasks grows, up to the number of available cores
+   * or the configured number of compiler threads.
    */
   class DxvkPipelineWorkers {
 
@@ -72,6 +101,14 @@ namespace dxvk {
       DxvkPipelineWorkerStats result;
       result.tasksCompleted = m_tasksCompleted.load(std::memory_order_acquire);
       result.tasksTotal = m_tasksTotal.load(std::memory_order_relaxed);
+      result.workerCount = m_workerCount.load(std::memory_order_relaxed);
+
+      for (uint32_t i = 0; i < DxvkPipelinePriorityCount; i++) {
+        result.queueDepth[i] = m_priorityStats[i].tasksQueued.load(std::memory_order_relaxed);
+        result.tasksStarted[i] = m_priorityStats[i].tasksStarted.load(std::memory_order_relaxed);
+        result.waitTimeUs[i] = m_priorityStats[i].waitTimeUs.load(std::memory_order_relaxed);
+      }
+
       return result;
     }
 
@@ -122,12 +159,20 @@ namespace dxvk {
       DxvkShaderPipelineLibrary*    pipelineLibrary;
       DxvkGraphicsPipeline*         graphicsPipeline;
       DxvkGraphicsPipelineStateInfo graphicsState;
+
+      high_resolution_clock::time_point queueTime = { };
+    };
+
+    struct PipelineWorker {
+      dxvk::mutex               lock;
+      std::array<std::deque<PipelineEntry>, DxvkPipelinePriorityCount> queues;
+      dxvk::thread              thread;
     };
 
-    struct PipelineBucket {
-      dxvk::condition_variable  cond;
-      std::queue<PipelineEntry> queue;
-      uint32_t                  idleWorkers = 0;
+    struct PriorityStats {
+      std::atomic<uint64_t>     tasksQueued  = { 0ull };
+      std::atomic<uint64_t>     tasksStarted = { 0ull };
+      std::atomic<uint64_t>     waitTimeUs   = { 0ull };
     };
 
     DxvkDevice*                       m_device;
@@ -135,17 +180,49 @@ namespace dxvk {
     std::atomic<uint64_t>             m_tasksTotal     = { 0ull };
     std::atomic<uint64_t>             m_tasksCompleted = { 0ull };
 
+    std::array<PriorityStats, DxvkPipelinePriorityCount> m_priorityStats;
+
     dxvk::mutex                       m_lock;
-    std::array<PipelineBucket, 3>     m_buckets;
+    dxvk::condition_variable          m_cond;
+
+    std::atomic<bool>                 m_workersRunning = { false };
+    std::atomic<uint32_t>             m_idleWorkers = { 0u };
+    std::atomic<uint32_t>             m_backgroundTasks = { 0u };
+    std::atomic<uint32_t>             m_nextWorker = { 0u };
+
+    std::atomic<uint32_t>             m_workerCount = { 0u };
+    uint32_t                          m_maxWorkerCount = 0u;
 
-    bool                              m_workersRunning = false;
-    std::vector<dxvk::thread>         m_workers;
+    std::unique_ptr<PipelineWorker[]> m_workers;
 
-    void notifyWorkers(DxvkPipelinePriority priority);
+    void enqueueTask(
+            PipelineEntry&&                 entry,
+            DxvkPipelinePriority            priority);
+
+    bool dequeueTask(
+            uint32_t                        workerIndex,
+            PipelineEntry&                  entry,
+            DxvkPipelinePriority&           priority);
+
+    bool dequeueTaskFrom(
+            uint32_t                        workerIndex,
+            uint32_t                        priorityIndex,
+            PipelineEntry&                  entry);
+
+    bool reserveBackgroundSlot(
+            uint32_t                        workerCount);
 
-    void startWorkers();
+    void notifyWorkers();
 
-    void runWorker(DxvkPipelinePriority maxPriority);
+    uint32_t startWorkers();
+
+    void growWorkers(
+            uint32_t                        workerCount);
+
+    void spawnWorkersLocked(
+            uint32_t                        workerCount);
+
+    void runWorker(uint32_t workerIndex);
 
   };
 
@@ -326,6 +403,8 @@ namespace dxvk {
       DxvkGraphicsPipeline,
       DxvkHash, DxvkEq> m_graphicsPipelines;
 
+    DxvkStateCache            m_stateCache;
+
     DxvkShaderPipelineLibrary* createPipelineLibraryLocked(
       const DxvkShaderPipelineLibraryKey& key);
 
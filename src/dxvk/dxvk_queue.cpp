@@ -292,6 +292,11 @@ namespace dxvk {
 
       // Free the command list and associated objects now
       if (entry.submit.cmdList != nullptr) {
+        for (const auto& cmdList : entry.submit.cmdList->takeAppendedCommandLists()) {
+          cmdList->reset();
+          m_device->recycleCommandList(cmdList);
+        }
+
         entry.submit.cmdList->reset();
         m_device->recycleCommandList(entry.submit.cmdList);
       }
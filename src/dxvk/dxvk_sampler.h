@@ -178,10 +178,10 @@ namespace dxvk {
      *    \c false if the sampler was already tracked with this ID.
      */
     bool trackId(uint64_t trackingId) {
-      if (trackingId <= m_trackingId)
+      if (trackingId == m_trackingId.load(std::memory_order_relaxed))
         return false;
 
-      m_trackingId = trackingId;
+      m_trackingId.store(trackingId, std::memory_order_relaxed);
       return true;
     }
 
@@ -204,7 +204,7 @@ namespace dxvk {
   private:
     
     std::atomic<uint64_t> m_refCount  = { 0u };
-    uint64_t              m_trackingId = 0u;
+    std::atomic<uint64_t> m_trackingId = { 0u };
 
     DxvkSamplerPool*      m_pool      = nullptr;
     DxvkSamplerKey        m_key       = { };
@@ -211,6 +211,7 @@ namespace dxvk {
       return *m_pipeline;
 
     m_pipeline = compileShaderPipelineLocked();
+    this->notifyLibraryReady();
     return *m_pipeline;
   }
 
@@ -234,6 +235,7 @@ namespace dxvk {
 
     // Compile the pipeline with default args
     DxvkShaderPipelineLibraryHandle pipeline = compileShaderPipelineLocked();
+    this->notifyLibraryReady();
 
     if (!pipeline.handle)
       return;
@@ -744,6 +746,12 @@ namespace dxvk {
   }
 
 
+  void DxvkShaderPipelineLibrary::notifyLibraryReady() const {
+    if (m_shaders.getShaderCount() == 1u)
+      m_shaders.getShader(0u)->notifyLibraryReady();
+  }
+
+
   bool DxvkShaderPipelineLibrary::canUsePipelineCacheControl() const {
     const auto& features = m_device->features();
 
@@ -283,6 +283,28 @@ namespace dxvk {
       return m_needsCompile.exchange(false);
     }
 
+    /**
+     * \brief Tests whether the pipeline library is ready
+     *
+     * Set once the standalone pipeline library for this shader
+     * has been compiled, or once the shader code has been processed
+     * if pipeline libraries are not supported. Binding the shader
+     * afterwards will not stall on shader compilation.
+     * \returns \c true if the pipeline library is ready
+     */
+    bool isLibraryReady() const {
+      return m_libraryReady.load(std::memory_order_acquire);
+    }
+
+    /**
+     * \brief Notifies library readiness
+     *
+     * Called automatically when pipeline compilation completes.
+     */
+    void notifyLibraryReady() {
+      m_libraryReady.store(true, std::memory_order_release);
+    }
+
     /**
      * \brief Queries shader binding layout
      * \returns Pipeline layout builder
@@ -358,6 +380,7 @@ namespace dxvk {
     uint32_t                      m_cookie = 0;
 
     std::atomic<bool>             m_needsCompile = { true };
+    std::atomic<bool>             m_libraryReady = { false };
 
     std::optional<DxvkShaderMetadata> m_metadata;
 
@@ -669,6 +692,8 @@ namespace dxvk {
 
     void notifyLibraryCompile() const;
 
+    void notifyLibraryReady() const;
+
     void compileShaders();
 
     bool canCreatePipelineLibrary() const;
@@ -1,16 +1,33 @@
+#include <algorithm>
 #include <iomanip>
 #include <version.h>
 
 #include "dxvk_shader_cache.h"
 
+#include "../util/util_compress.h"
 #include "../util/util_time.h"
 
 namespace dxvk {
 
+  /**
+   * \brief Cache file format revision
+   *
+   * Appended to the version string stored in the look-up
+   * table header. Must be bumped whenever the layout of
+   * look-up table entries or binary data changes.
+   */
+  constexpr uint32_t LutFormatRevision = 2u;
+
+  /**
+   * \brief Look-up table file magic
+   */
+  constexpr std::array<char, 4u> LutMagic = { 'D', 'X', 'V', 'K' };
+
   DxvkShaderCache::Instance DxvkShaderCache::s_instance;
 
   DxvkShaderCache::DxvkShaderCache()
-  : m_filePaths(getDefaultFilePaths()) {
+  : m_filePaths(getDefaultFilePaths()),
+    m_compress(env::getEnvVar("DXVK_SHADER_CACHE_COMPRESS") != "0") {
 
   }
 
@@ -37,9 +54,9 @@ namespace dxvk {
     k.name = name;
     k.createInfo = options;
 
-    auto entry = m_lut.find(k);
+    auto entry = findLutEntry(k);
 
-    if (entry == m_lut.end()) {
+    if (!entry) {
       if (Logger::logLevel() <= LogLevel::Debug)
         Logger::debug(str::format("Shader cache miss: ", name));
 
@@ -48,21 +65,21 @@ namespace dxvk {
 
     if (Logger::logLevel() <= LogLevel::Debug) {
       Logger::debug(str::format("Shader cache hit: ", name,
-        " (offset: ", entry->second.offset,
-        ", size: ", entry->second.binarySize,
-        ", metadata: ", entry->second.metadataSize, ")"));
+        " (offset: ", entry->entry.offset,
+        ", size: ", entry->entry.binarySize,
+        ", stored: ", entry->entry.storedSize(),
+        ", metadata: ", entry->entry.metadataSize, ")"));
     }
 
-    std::unique_lock lock(m_fileMutex);
-    auto shader = loadCachedShaderLocked(entry->first, entry->second);
+    auto shader = loadCachedShader(k, entry->entry);
 
     if (!shader) {
       Logger::warn(str::format("Failed to load cached shader ", name));
 
-      if (!openWriteOnlyLocked())
-        Logger::warn(str::format("Failed to re-initialize shader cache ", name));
-
-      m_status.store(Status::OpenWriteOnly, std::memory_order_release);
+      // Ignore the broken entry so that the shader gets written to the
+      // cache again. Since the most recently written entry for any given
+      // key takes precedence, this will fix up the cache for future runs.
+      invalidateLutEntry(entry);
     }
 
     return shader;
@@ -77,7 +94,7 @@ namespace dxvk {
     k.name = shader->debugName();
     k.createInfo = shader->getShaderCreateInfo();
 
-    if (m_lut.find(k) == m_lut.end()) {
+    if (!findLutEntry(k)) {
       std::unique_lock lock(m_writeMutex);
       m_writeQueue.push(std::move(shader));
       m_writeCond.notify_one();
@@ -138,7 +155,8 @@ namespace dxvk {
     auto flags = util::FileFlags(
       util::FileFlag::AllowRead,
       util::FileFlag::AllowWrite,
-      util::FileFlag::Exclusive);
+      util::FileFlag::Exclusive,
+      util::FileFlag::MapRead);
 
     m_binFile.open(path + m_filePaths.binFile, flags);
     m_lutFile.open(path + m_filePaths.lutFile, flags);
@@ -185,8 +203,8 @@ namespace dxvk {
     Logger::info(str::format("Created cache file: ", path + m_filePaths.binFile));
 
     LutHeader header = { };
-    header.magic = { 'D', 'X', 'V', 'K' };
-    header.versionString = DXVK_VERSION;
+    header.magic = LutMagic;
+    header.versionString = getVersionString();
 
     if (!writeHeader(m_lutFile, header)) {
       Logger::warn(str::format("Failed to write cache header: ", path + m_filePaths.lutFile));
@@ -203,34 +221,97 @@ namespace dxvk {
     size_t size = m_lutFile.size();
     size_t offset = 0u;
 
-    if (!readBytes(m_lutFile, header.magic.data(), offset, header.magic.size())
-     || !readString(m_lutFile, offset, header.versionString)) {
+    if (!readHeader(m_lutFile, offset, header) || header.magic != LutMagic) {
       Logger::warn("Failed to parse cache file header.");
       return false;
     }
 
-    if (header.versionString != DXVK_VERSION) {
+    if (header.versionString != getVersionString()) {
       Logger::warn(str::format("Cache was created with DXVK version ", header.versionString,
-        ", but current version is ", DXVK_VERSION, ". Discarding old cache."));
+        ", but current version is ", getVersionString(), ". Discarding old cache."));
       return false;
     }
 
+    // Only store key hashes and file offsets in the index. Keys are
+    // compared in place on look-up, which avoids having to copy all
+    // shader names and xfb infos into a hash map on startup.
+    LutKey k;
+
     while (offset < size) {
-      LutKey k;
-      LutEntry e;
+      LutIndexEntry e;
+      e.keyOffset = offset;
 
-      if (!readShaderLutEntry(k, e, offset)) {
+      if (!readShaderLutEntry(k, e.entry, offset)) {
         Logger::warn("Failed to parse cache look-up table.");
+        m_lutIndex.clear();
         return false;
       }
 
-      m_lut.insert_or_assign(k, e);
+      e.hash = k.hash();
+      m_lutIndex.push_back(e);
     }
 
+    // Keep file order for identical hashes so that look-ups
+    // can find the most recently written entry for a key.
+    std::sort(m_lutIndex.begin(), m_lutIndex.end(),
+      [] (const LutIndexEntry& a, const LutIndexEntry& b) {
+        return a.hash < b.hash || (a.hash == b.hash && a.keyOffset < b.keyOffset);
+      });
+
+    if (!m_lutFile.getMappedData(0u, size) || !m_binFile.getMappedData(0u, m_binFile.size()))
+      Logger::warn("Failed to map shader cache, falling back to file I/O.");
+
     return true;
   }
 
 
+  const DxvkShaderCache::LutIndexEntry* DxvkShaderCache::findLutEntry(const LutKey& key) {
+    size_t hash = key.hash();
+
+    auto lower = std::lower_bound(m_lutIndex.begin(), m_lutIndex.end(), hash,
+      [] (const LutIndexEntry& e, size_t h) { return e.hash < h; });
+
+    auto upper = std::upper_bound(lower, m_lutIndex.end(), hash,
+      [] (size_t h, const LutIndexEntry& e) { return h < e.hash; });
+
+    if (lower == upper)
+      return nullptr;
+
+    // File reads are positional and thus safe to perform without
+    // locking, even while the writer thread is appending data.
+    LutKey k;
+
+    for (auto i = upper; i != lower; ) {
+      size_t offset = (--i)->keyOffset;
+
+      if (!readShaderLutKey(m_lutFile, offset, k))
+        return nullptr;
+
+      if (k.eq(key))
+        return isLutEntryValid(&(*i)) ? &(*i) : nullptr;
+    }
+
+    return nullptr;
+  }
+
+
+  bool DxvkShaderCache::isLutEntryValid(const LutIndexEntry* entry) {
+    if (likely(!m_lutInvalidCount.load(std::memory_order_acquire)))
+      return true;
+
+    std::unique_lock lock(m_lutMutex);
+    return m_lutInvalid.find(size_t(entry - m_lutIndex.data())) == m_lutInvalid.end();
+  }
+
+
+  void DxvkShaderCache::invalidateLutEntry(const LutIndexEntry* entry) {
+    std::unique_lock lock(m_lutMutex);
+
+    if (m_lutInvalid.insert(size_t(entry - m_lutIndex.data())).second)
+      m_lutInvalidCount.fetch_add(1u, std::memory_order_release);
+  }
+
+
   bool DxvkShaderCache::writeShaderXfbInfo(util::File& stream, const dxbc_spv::ir::IoXfbInfo& xfb) {
     return writeString(stream, xfb.semanticName)
         && write(stream, xfb.semanticIndex)
@@ -256,21 +337,44 @@ namespace dxvk {
   }
 
 
-  Rc<DxvkIrShader> DxvkShaderCache::loadCachedShaderLocked(const LutKey& key, const LutEntry& entry) {
-    std::vector<uint8_t> ir(entry.binarySize);
+  Rc<DxvkIrShader> DxvkShaderCache::loadCachedShader(const LutKey& key, const LutEntry& entry) {
+    // If the entire entry is mapped, we can verify the checksum in place
+    // and avoid a copy. Otherwise, fall back to positional file reads.
+    // Neither requires locking, so multiple threads can load cached
+    // shaders in parallel.
+    auto mappedData = m_binFile.getMappedData(entry.offset,
+      size_t(entry.storedSize()) + size_t(entry.metadataSize));
+
+    std::vector<uint8_t> ir;
+    std::vector<uint8_t> stored;
 
     size_t offset = entry.offset;
 
-    if (!readBytes(m_binFile, ir.data(), offset, entry.binarySize)) {
-      Logger::warn("Failed to read cached shader binary");
-      return nullptr;
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(mappedData);
+
+    if (data) {
+      offset += entry.storedSize();
+    } else {
+      stored.resize(entry.storedSize());
+
+      if (!readBytes(m_binFile, stored.data(), offset, stored.size())) {
+        Logger::warn("Failed to read cached shader binary");
+        return nullptr;
+      }
+
+      data = stored.data();
     }
 
-    if (entry.checksum != bit::fnv1a_hash(ir.data(), ir.size())) {
+    if (entry.checksum != bit::fnv1a_hash(data, entry.storedSize())) {
       Logger::warn("Checksum mismatch for cached shader");
       return nullptr;
     }
 
+    if (!decodeShaderBinary(entry, data, ir)) {
+      Logger::warn("Failed to decompress cached shader binary");
+      return nullptr;
+    }
+
     DxvkShaderMetadata metadata;
 
     if (!readShaderMetadata(m_binFile, offset, metadata)) {
@@ -297,7 +401,7 @@ namespace dxvk {
 
 
   bool DxvkShaderCache::writeShaderToCache(DxvkIrShader& shader) {
-    auto entry = writeShaderBinary(m_binFile, shader);
+    auto entry = writeShaderBinary(m_binFile, shader, m_compress);
 
     if (!entry)
       return false;
@@ -533,21 +637,33 @@ namespace dxvk {
   }
 
 
-  std::optional<DxvkShaderCache::LutEntry> DxvkShaderCache::writeShaderBinary(util::File& stream, DxvkIrShader& shader) {
+  std::optional<DxvkShaderCache::LutEntry> DxvkShaderCache::writeShaderBinary(util::File& stream, DxvkIrShader& shader, bool compress) {
     auto [data, size] = shader.getSerializedIr();
 
     LutEntry entry = { };
     entry.offset = stream.size();
     entry.binarySize = size;
 
-    if (!writeBytes(stream, data, size)
+    // Only keep the compressed blob if it is actually smaller, so
+    // that incompressible data does not cost any decode time.
+    std::vector<uint8_t> compressed;
+
+    if (compress) {
+      util::compressBlock(data, size, compressed);
+
+      if (compressed.size() < size) {
+        data = compressed.data();
+        entry.compressedSize = uint32_t(compressed.size());
+      }
+    }
+
+    if (!writeBytes(stream, data, entry.storedSize())
      || !writeShaderMetadata(stream, shader.getShaderMetadata())
      || !writeShaderLayout(stream, shader.getLayout()))
       return std::nullopt;
 
-
-    entry.metadataSize = uint32_t(uint64_t(stream.size()) - (entry.offset + entry.binarySize));
-    entry.checksum = bit::fnv1a_hash(data, size);
+    entry.metadataSize = uint32_t(uint64_t(stream.size()) - (entry.offset + entry.storedSize()));
+    entry.checksum = bit::fnv1a_hash(data, entry.storedSize());
     return std::make_optional(entry);
   }
 
@@ -558,6 +674,205 @@ namespace dxvk {
   }
 
 
+  bool DxvkShaderCache::readHeader(util::File& stream, size_t& offset, LutHeader& header) {
+    return readBytes(stream, header.magic.data(), offset, header.magic.size())
+        && readString(stream, offset, header.versionString);
+  }
+
+
+  bool DxvkShaderCache::validateShaderBinary(util::File& stream, const LutEntry& entry, std::vector<uint8_t>& data, CompactStats* stats) {
+    size_t totalSize = size_t(entry.storedSize()) + size_t(entry.metadataSize);
+
+    if (entry.offset + totalSize > stream.size())
+      return false;
+
+    data.resize(totalSize);
+
+    size_t offset = entry.offset;
+
+    if (!readBytes(stream, data.data(), offset, totalSize))
+      return false;
+
+    if (entry.checksum != bit::fnv1a_hash(data.data(), entry.storedSize()))
+      return false;
+
+    std::vector<uint8_t> ir;
+
+    auto t0 = dxvk::high_resolution_clock::now();
+
+    if (!decodeShaderBinary(entry, data.data(), ir))
+      return false;
+
+    auto t1 = dxvk::high_resolution_clock::now();
+
+    if (stats) {
+      stats->irSizeStored += entry.storedSize();
+      stats->irSizeDecoded += entry.binarySize;
+      stats->irDecodeTimeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    }
+
+    // Make sure that metadata can be parsed and ends exactly where
+    // the look-up table entry says it does
+    DxvkShaderMetadata metadata;
+    DxvkPipelineLayoutBuilder layout;
+
+    offset = entry.offset + entry.storedSize();
+
+    if (!readShaderMetadata(stream, offset, metadata)
+     || !readShaderLayout(stream, offset, layout))
+      return false;
+
+    return offset == entry.offset + totalSize;
+  }
+
+
+  bool DxvkShaderCache::decodeShaderBinary(const LutEntry& entry, const uint8_t* data, std::vector<uint8_t>& ir) {
+    if (!entry.compressedSize) {
+      ir.assign(data, data + entry.binarySize);
+      return true;
+    }
+
+    ir.resize(entry.binarySize);
+    return util::decompressBlock(data, entry.compressedSize, ir.data(), ir.size());
+  }
+
+
+  std::string DxvkShaderCache::getVersionString() {
+    return str::format(DXVK_VERSION, " (rev ", LutFormatRevision, ")");
+  }
+
+
+  bool DxvkShaderCache::compactCacheFiles(
+    const std::string&                srcLut,
+    const std::string&                srcBin,
+    const std::string&                dstLut,
+    const std::string&                dstBin,
+          CompactStats&               stats) {
+    stats = CompactStats();
+
+    auto readFlags = util::FileFlags(
+      util::FileFlag::AllowRead,
+      util::FileFlag::MapRead);
+
+    util::File lutFile(srcLut, readFlags);
+    util::File binFile(srcBin, readFlags);
+
+    if (!lutFile || !binFile) {
+      Logger::err(str::format("Failed to open ", srcLut, " or ", srcBin));
+      return false;
+    }
+
+    stats.lutSizeBefore = lutFile.size();
+    stats.binSizeBefore = binFile.size();
+
+    LutHeader header;
+    size_t offset = 0u;
+
+    if (!readHeader(lutFile, offset, header) || header.magic != LutMagic) {
+      Logger::err(str::format("Failed to parse cache header: ", srcLut));
+      return false;
+    }
+
+    if (header.versionString != getVersionString()) {
+      Logger::err(str::format("Cache was created with DXVK version ", header.versionString,
+        ", but current version is ", getVersionString()));
+      return false;
+    }
+
+    // Parse look-up table, later entries override earlier ones
+    // with the same key, which is consistent with the runtime.
+    std::vector<std::pair<LutKey, LutEntry>> entries;
+    std::unordered_map<LutKey, size_t, DxvkHash, DxvkEq> entryMap;
+
+    while (offset < stats.lutSizeBefore) {
+      LutKey k;
+      LutEntry e;
+
+      if (!readShaderLutKey(lutFile, offset, k) || !read(lutFile, offset, e)) {
+        Logger::warn(str::format("Truncated look-up table entry at offset ", offset));
+        stats.entriesCorrupt += 1u;
+        break;
+      }
+
+      stats.entriesTotal += 1u;
+
+      auto pair = entryMap.emplace(k, entries.size());
+
+      if (!pair.second) {
+        stats.entriesDuplicate += 1u;
+        entries[pair.first->second].second = e;
+      } else {
+        entries.emplace_back(std::move(k), e);
+      }
+    }
+
+    // Validate all remaining entries and drop broken ones
+    std::vector<uint8_t> data;
+    std::vector<std::pair<LutKey, LutEntry>> validEntries;
+
+    for (auto& e : entries) {
+      if (!validateShaderBinary(binFile, e.second, data, &stats)) {
+        Logger::warn(str::format("Invalid cache entry: ", e.first.name));
+        stats.entriesCorrupt += 1u;
+      } else {
+        validEntries.push_back(std::move(e));
+      }
+    }
+
+    stats.entriesKept = validEntries.size();
+
+    if (dstLut.empty() || dstBin.empty())
+      return true;
+
+    // Store binaries in the order in which they were originally
+    // written. Shaders created together are likely to be looked
+    // up together again, so this keeps disk reads sequential.
+    std::sort(validEntries.begin(), validEntries.end(),
+      [] (const std::pair<LutKey, LutEntry>& a, const std::pair<LutKey, LutEntry>& b) {
+        return a.second.offset < b.second.offset;
+      });
+
+    auto writeFlags = util::FileFlags(
+      util::FileFlag::AllowWrite,
+      util::FileFlag::Truncate,
+      util::FileFlag::Exclusive);
+
+    util::File dstLutFile(dstLut, writeFlags);
+    util::File dstBinFile(dstBin, writeFlags);
+
+    if (!dstLutFile || !dstBinFile) {
+      Logger::err(str::format("Failed to create ", dstLut, " or ", dstBin));
+      return false;
+    }
+
+    if (!writeHeader(dstLutFile, header))
+      return false;
+
+    for (const auto& e : validEntries) {
+      if (!validateShaderBinary(binFile, e.second, data, nullptr))
+        return false;
+
+      LutEntry entry = e.second;
+      entry.offset = dstBinFile.size();
+
+      if (!writeBytes(dstBinFile, data.data(), data.size())
+       || !writeString(dstLutFile, e.first.name)
+       || !writeShaderCreateInfo(dstLutFile, e.first.createInfo)
+       || !write(dstLutFile, entry)) {
+        Logger::err("Failed to write cache entry");
+        return false;
+      }
+    }
+
+    if (!dstLutFile.flush() || !dstBinFile.flush())
+      return false;
+
+    stats.lutSizeAfter = dstLutFile.size();
+    stats.binSizeAfter = dstBinFile.size();
+    return true;
+  }
+
+
   DxvkShaderCache::FilePaths DxvkShaderCache::getDefaultFilePaths() {
     std::string cachePath = env::getEnvVar("DXVK_SHADER_CACHE_PATH");
 
@@ -611,8 +926,10 @@ namespace dxvk {
 
     FilePaths paths;
     paths.directory = cachePath;
+    paths.baseName = baseName;
     paths.lutFile = baseName + ".dxvk.lut";
     paths.binFile = baseName + ".dxvk.bin";
+    paths.stateFile = baseName + ".dxvk.state";
     return paths;
   }
 
@@ -6,6 +6,7 @@
 #include <queue>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "../util/thread.h"
@@ -24,6 +25,14 @@ namespace dxvk {
    * The implementation creates two files that can trivially grow by appending
    * data to them: A binary blob that contains the actual serialized IR as well
    * as shader metadata, and a look-up table
+   *
+   * Existing cache files are memory-mapped where possible. The look-up table
+   * is only indexed by key hash on startup, keys themselves are compared in
+   * place. Since the index is immutable afterwards and file reads are
+   * positional, look-ups do not need to lock and can run in parallel.
+   *
+   * Serialized IR is stored compressed unless compression does not reduce
+   * its size, or if compression is disabled via DXVK_SHADER_CACHE_COMPRESS.
    */
   class DxvkShaderCache {
 
@@ -31,8 +40,24 @@ namespace dxvk {
 
     struct FilePaths {
       std::string directory;
+      std::string baseName;
       std::string lutFile;
       std::string binFile;
+      std::string stateFile;
+    };
+
+    struct CompactStats {
+      uint32_t entriesTotal = 0u;
+      uint32_t entriesKept = 0u;
+      uint32_t entriesDuplicate = 0u;
+      uint32_t entriesCorrupt = 0u;
+      uint64_t lutSizeBefore = 0u;
+      uint64_t lutSizeAfter = 0u;
+      uint64_t binSizeBefore = 0u;
+      uint64_t binSizeAfter = 0u;
+      uint64_t irSizeStored = 0u;
+      uint64_t irSizeDecoded = 0u;
+      uint64_t irDecodeTimeNs = 0u;
     };
 
     ~DxvkShaderCache();
@@ -78,6 +103,33 @@ namespace dxvk {
      */
     static Rc<DxvkShaderCache> getInstance();
 
+    /**
+     * \brief Validates and compacts cache files
+     *
+     * Verifies checksums and metadata of all look-up table entries,
+     * and drops corrupt entries as well as entries that have been
+     * superseded by a later entry with the same key. Binary data
+     * that is not referenced by any remaining entry is discarded.
+     *
+     * Remaining entries are written in their original order, so
+     * that shaders that were created together are stored together.
+     * Must not be used while the cache files are in use.
+     * \param [in] srcLut Source look-up table file path
+     * \param [in] srcBin Source binary file path
+     * \param [in] dstLut Output look-up table path, or empty string
+     *    to only validate the source files
+     * \param [in] dstBin Output binary file path, or empty string
+     * \param [out] stats Entry statistics
+     * \returns \c true if the source files could be parsed and, if
+     *    requested, the output files were written successfully.
+     */
+    static bool compactCacheFiles(
+      const std::string&                srcLut,
+      const std::string&                srcBin,
+      const std::string&                dstLut,
+      const std::string&                dstBin,
+            CompactStats&               stats);
+
   private:
 
     struct Instance {
@@ -106,6 +158,18 @@ namespace dxvk {
       uint32_t binarySize = 0u;
       uint32_t metadataSize = 0u;
       uint64_t checksum = 0u;
+      uint32_t compressedSize = 0u;
+      uint32_t reserved = 0u;
+
+      uint32_t storedSize() const {
+        return compressedSize ? compressedSize : binarySize;
+      }
+    };
+
+    struct LutIndexEntry {
+      size_t   hash = 0u;
+      uint64_t keyOffset = 0u;
+      LutEntry entry = { };
     };
 
     enum class Status : uint32_t {
@@ -118,6 +182,7 @@ namespace dxvk {
     std::atomic<uint32_t>         m_useCount = { 0u };
 
     FilePaths                     m_filePaths;
+    bool                          m_compress = true;
     dxvk::mutex                   m_fileMutex;
 
     util::File                    m_lutFile;
@@ -125,7 +190,11 @@ namespace dxvk {
 
     std::atomic<Status>           m_status = { Status::Uninitialized };
 
-    std::unordered_map<LutKey, LutEntry, DxvkHash, DxvkEq> m_lut;
+    std::vector<LutIndexEntry>    m_lutIndex;
+
+    dxvk::mutex                   m_lutMutex;
+    std::atomic<uint32_t>         m_lutInvalidCount = { 0u };
+    std::unordered_set<size_t>    m_lutInvalid;
 
     dxvk::mutex                   m_writeMutex;
     dxvk::condition_variable      m_writeCond;
@@ -147,7 +216,13 @@ namespace dxvk {
 
     bool parseLut();
 
-    Rc<DxvkIrShader> loadCachedShaderLocked(const LutKey& key, const LutEntry& entry);
+    const LutIndexEntry* findLutEntry(const LutKey& key);
+
+    bool isLutEntryValid(const LutIndexEntry* entry);
+
+    void invalidateLutEntry(const LutIndexEntry* entry);
+
+    Rc<DxvkIrShader> loadCachedShader(const LutKey& key, const LutEntry& entry);
 
     bool writeShaderLutEntry(DxvkIrShader& shader, const LutEntry& entry);
 
@@ -169,10 +244,18 @@ namespace dxvk {
 
     static bool writeShaderMetadata(util::File& stream, const DxvkShaderMetadata& metadata);
 
-    static std::optional<LutEntry> writeShaderBinary(util::File& stream, DxvkIrShader& shader);
+    static std::optional<LutEntry> writeShaderBinary(util::File& stream, DxvkIrShader& shader, bool compress);
 
     static bool writeHeader(util::File& stream, const LutHeader& header);
 
+    static bool readHeader(util::File& stream, size_t& offset, LutHeader& header);
+
+    static bool validateShaderBinary(util::File& stream, const LutEntry& entry, std::vector<uint8_t>& data, CompactStats* stats);
+
+    static bool decodeShaderBinary(const LutEntry& entry, const uint8_t* data, std::vector<uint8_t>& ir);
+
+    static std::string getVersionString();
+
     static bool readShaderIo(util::File& stream, size_t& offset, DxvkShaderIo& io);
 
     static bool readShaderXfbInfo(util::File& stream, size_t& offset, dxbc_spv::ir::IoXfbInfo& xfb);
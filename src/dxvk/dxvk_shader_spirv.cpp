@@ -10,7 +10,8 @@ namespace dxvk {
   DxvkSpirvShader::DxvkSpirvShader(
     const DxvkSpirvShaderCreateInfo&  info,
           SpirvCodeBuffer&&           spirv)
-  : m_info(info), m_layout(getShaderStage(spirv)) {
+  : m_info(info), m_bindings(info.bindings, info.bindings + info.bindingCount),
+    m_layout(getShaderStage(spirv)) {
     m_info.bindings = nullptr;
 
     SpirvCodeBuffer code = std::move(spirv);
@@ -50,6 +51,19 @@ namespace dxvk {
   }
 
 
+  DxvkSpirvShaderCreateInfo DxvkSpirvShader::getShaderCreateInfo() const {
+    DxvkSpirvShaderCreateInfo info = m_info;
+    info.bindingCount = m_bindings.size();
+    info.bindings = m_bindings.data();
+    return info;
+  }
+
+
+  SpirvCodeBuffer DxvkSpirvShader::getRawCode() const {
+    return m_code.decompress();
+  }
+
+
   DxvkShaderMetadata DxvkSpirvShader::getShaderMetadata() {
     return m_metadata;
   }
@@ -104,9 +104,27 @@ namespace dxvk {
      */
     std::string debugName();
 
+    /**
+     * \brief Queries create info
+     *
+     * Binding infos remain owned by the shader.
+     * \returns Create info the shader was created with
+     */
+    DxvkSpirvShaderCreateInfo getShaderCreateInfo() const;
+
+    /**
+     * \brief Retrieves unpatched SPIR-V code
+     *
+     * Returns the code exactly as it was passed to the
+     * constructor, e.g. for writing it to a cache file.
+     * \returns Uncompressed SPIR-V code buffer
+     */
+    SpirvCodeBuffer getRawCode() const;
+
   private:
 
     DxvkSpirvShaderCreateInfo     m_info  = { };
+    std::vector<DxvkBindingInfo>  m_bindings;
 
     SpirvCompressedBuffer         m_code;
     DxvkPipelineLayoutBuilder     m_layout;
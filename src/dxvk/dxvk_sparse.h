@@ -446,7 +446,8 @@ namespace dxvk {
   public:
 
     DxvkPagedResource(DxvkMemoryAllocator& allocator)
-    : m_allocator(&allocator), m_cookie(++s_cookie) { }
+    : m_allocator(&allocator), m_cookie(++s_cookie),
+      m_lastUse(allocator.getSubmissionId()) { }
 
     virtual ~DxvkPagedResource();
 
@@ -552,7 +553,7 @@ namespace dxvk {
      * \returns Tracking ID
      */
     uint64_t getTrackId() const {
-      return m_trackId >> 1u;
+      return m_trackId.load(std::memory_order_relaxed) >> 1u;
     }
 
     /**
@@ -568,11 +569,15 @@ namespace dxvk {
     bool trackId(uint64_t trackingId, DxvkAccess access) {
       // Encode write access in the least significant bit
       uint64_t trackId = (trackingId << 1u) + uint64_t(access == DxvkAccess::Write);
+      uint64_t lastId = m_trackId.load(std::memory_order_relaxed);
 
-      if (trackId <= m_trackId)
+      // Tracking IDs are unique per device, but worker contexts may record
+      // command lists concurrently, so only skip tracking if the resource
+      // was last tracked by the same command list.
+      if ((lastId >> 1u) == trackingId && trackId <= lastId)
         return false;
 
-      m_trackId = trackId;
+      m_trackId.store(trackId, std::memory_order_relaxed);
       return true;
     }
 
@@ -587,7 +592,7 @@ namespace dxvk {
     bool isTracked(uint64_t trackingId, DxvkAccess access) const {
       // We actually want to check for read access here so that this check only
       // fails if the resource hasn't been used or if both accesses are read-only.
-      return m_trackId >= (trackingId << 1u) + uint64_t(access != DxvkAccess::Write);
+      return m_trackId.load(std::memory_order_relaxed) >= (trackingId << 1u) + uint64_t(access != DxvkAccess::Write);
     }
 
     /**
@@ -597,7 +602,7 @@ namespace dxvk {
      * Should be done when assigning new backing storage.
      */
     void resetTracking() {
-      m_trackId = 0u;
+      m_trackId.store(0u, std::memory_order_relaxed);
     }
 
     /**
@@ -607,7 +612,7 @@ namespace dxvk {
      *    resource via transform feedback or a storage descriptor.
      */
     bool hasGfxStores() const {
-      return m_hasGfxStores;
+      return m_hasGfxStores.load(std::memory_order_relaxed);
     }
 
     /**
@@ -618,7 +623,18 @@ namespace dxvk {
      * \returns \c true if side effects were already tracked.
      */
     bool trackGfxStores() {
-      return std::exchange(m_hasGfxStores, true);
+      return m_hasGfxStores.load(std::memory_order_relaxed)
+          || m_hasGfxStores.exchange(true, std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Queries last use
+     *
+     * \returns Allocator submission ID at the time
+     *    the GPU has last finished using the resource
+     */
+    uint64_t getLastUse() const {
+      return m_lastUse.load(std::memory_order_relaxed);
     }
 
     /**
@@ -643,12 +659,19 @@ namespace dxvk {
     /**
      * \brief Requests the resource to be made resident
      *
+     * Called whenever the GPU is done using the resource, so this also
+     * records the current submission ID for the residency manager.
      * If the resource has been demoted, its status will be changed back to
      * \c Resident so that it will not be evicted. Otherwise, if the resource
      * has already been evicted, it will be queued up to be streamed back into
      * video memory.
      */
     void requestResidency() {
+      uint64_t submissionId = m_allocator->getSubmissionId();
+
+      if (m_lastUse.load(std::memory_order_relaxed) != submissionId)
+        m_lastUse.store(submissionId, std::memory_order_relaxed);
+
       DxvkResourceResidency status = m_residency.load(std::memory_order_acquire);
 
       if (likely(status == DxvkResourceResidency::Resident))
@@ -724,12 +747,13 @@ namespace dxvk {
   private:
 
     std::atomic<uint64_t> m_useCount = { 0u };
-    uint64_t              m_trackId = { 0u };
+    std::atomic<uint64_t> m_trackId = { 0u };
     uint64_t              m_cookie = { 0u };
 
     std::atomic<DxvkResourceResidency> m_residency = { DxvkResourceResidency::Resident };
+    std::atomic<uint64_t> m_lastUse = { 0u };
 
-    bool                  m_hasGfxStores = false;
+    std::atomic<bool>     m_hasGfxStores = { false };
 
     void makeResourceResident();
 
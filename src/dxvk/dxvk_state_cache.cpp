@@ -0,0 +1,517 @@
+#include <version.h>
+
+#include "dxvk_device.h"
+#include "dxvk_pipemanager.h"
+#include "dxvk_shader_cache.h"
+#include "dxvk_state_cache.h"
+
+namespace dxvk {
+
+  bool DxvkStateCacheKey::eq(const DxvkStateCacheKey& other) const {
+    bool eq = true;
+
+    for (size_t i = 0; i < names.size() && eq; i++)
+      eq = names[i] == other.names[i];
+
+    return eq;
+  }
+
+
+  size_t DxvkStateCacheKey::hash() const {
+    DxvkHashState hash;
+
+    for (const auto& name : names)
+      hash.add(bit::fnv1a_hash(name.data(), name.size()));
+
+    return hash;
+  }
+
+
+  bool DxvkStateCacheEntry::eq(const DxvkStateCacheEntry& other) const {
+    return key.eq(other.key) && state.eq(other.state);
+  }
+
+
+  size_t DxvkStateCacheEntry::hash() const {
+    DxvkHashState hash;
+    hash.add(key.hash());
+    hash.add(state.hash());
+    return hash;
+  }
+
+
+  DxvkStateCache::DxvkStateCache(
+          DxvkDevice*               device,
+          DxvkPipelineManager*      pipeManager,
+          DxvkPipelineWorkers*      pipeWorkers)
+  : m_pipeManager(pipeManager),
+    m_pipeWorkers(pipeWorkers) {
+    if (env::getEnvVar("DXVK_STATE_CACHE") == "0" || !DxvkShader::getShaderDumpPath().empty())
+      return;
+
+    // Optimized pipelines are never compiled in this case,
+    // so there is no point in keeping a state cache around.
+    if (device->config().enableGraphicsPipelineLibrary == Tristate::True)
+      return;
+
+    auto paths = DxvkShaderCache::getDefaultFilePaths();
+
+    if (paths.directory.empty() || paths.stateFile.empty())
+      return;
+
+    m_filePath = paths.directory + env::PlatformDirSlash + paths.stateFile;
+
+    if (openCacheFile(m_filePath)) {
+      Logger::info(str::format("Found state cache file: ", m_filePath));
+      m_enable = true;
+    } else if (createCacheFile(m_filePath)) {
+      Logger::info(str::format("Created state cache file: ", m_filePath));
+      m_enable = true;
+    } else {
+      Logger::warn(str::format("Failed to create state cache file: ", m_filePath));
+    }
+  }
+
+
+  DxvkStateCache::~DxvkStateCache() {
+    this->stopWorkers();
+  }
+
+
+  void DxvkStateCache::addGraphicsPipeline(
+    const DxvkGraphicsPipelineShaders&    shaders,
+    const DxvkGraphicsPipelineStateInfo&  state) {
+    if (!m_enable)
+      return;
+
+    DxvkStateCacheEntry entry;
+    entry.state = state;
+
+    if (!getShaderKey(shaders, entry.key))
+      return;
+
+    const DxvkStateCacheEntry* newEntry = nullptr;
+
+    { std::lock_guard lock(m_entryLock);
+
+      if (m_entries.find(entry) != m_entries.end())
+        return;
+
+      newEntry = insertEntryLocked(entry);
+    }
+
+    std::lock_guard lock(m_writerLock);
+
+    if (m_stopped || m_writerFailed)
+      return;
+
+    m_writerQueue.push(newEntry);
+    m_writerCond.notify_one();
+
+    if (!m_writer.joinable())
+      m_writer = dxvk::thread([this] { runWriter(); });
+  }
+
+
+  void DxvkStateCache::registerShader(
+    const Rc<DxvkShader>&                 shader) {
+    if (!m_enable)
+      return;
+
+    std::string name = shader->debugName();
+
+    if (name.empty())
+      return;
+
+    small_vector<const DxvkStateCacheEntry*, 16> entries;
+
+    { std::lock_guard lock(m_entryLock);
+
+      // Remember the first shader object registered with a given
+      // name, any pipelines using it have been queued already.
+      if (!m_shaderCookies.emplace(name, shader->getCookie()).second)
+        return;
+
+      auto range = m_shaderEntries.equal_range(name);
+
+      for (auto i = range.first; i != range.second; i++)
+        entries.push_back(i->second);
+
+      // Only keep shaders alive that cached pipelines need
+      if (!entries.empty())
+        m_shaderMap.emplace(name, shader);
+    }
+
+    if (entries.empty())
+      return;
+
+    std::lock_guard lock(m_readerLock);
+
+    if (m_stopped)
+      return;
+
+    for (auto e : entries)
+      m_readerQueue.push(e);
+
+    m_readerCond.notify_one();
+
+    if (!m_reader.joinable())
+      m_reader = dxvk::thread([this] { runReader(); });
+  }
+
+
+  void DxvkStateCache::stopWorkers() {
+    m_stopped.store(true);
+
+    { std::lock_guard lock(m_readerLock);
+      m_readerCond.notify_one();
+    }
+
+    { std::lock_guard lock(m_writerLock);
+      m_writerQueue.push(nullptr);
+      m_writerCond.notify_one();
+    }
+
+    if (m_reader.joinable())
+      m_reader.join();
+
+    if (m_writer.joinable())
+      m_writer.join();
+  }
+
+
+  bool DxvkStateCache::openCacheFile(
+    const std::string&                    path) {
+    auto flags = util::FileFlags(
+      util::FileFlag::AllowRead,
+      util::FileFlag::AllowWrite,
+      util::FileFlag::Exclusive);
+
+    if (!m_file.open(path, flags))
+      return false;
+
+    return readCacheFile();
+  }
+
+
+  bool DxvkStateCache::createCacheFile(
+    const std::string&                    path) {
+    auto flags = util::FileFlags(
+      util::FileFlag::AllowWrite,
+      util::FileFlag::Truncate,
+      util::FileFlag::Exclusive);
+
+    if (!m_file.open(path, flags)) {
+      auto paths = DxvkShaderCache::getDefaultFilePaths();
+
+      if (!env::createDirectory(paths.directory))
+        return false;
+
+      if (!m_file.open(path, flags))
+        return false;
+    }
+
+    // Discard anything we may have read from an invalid file
+    m_shaderEntries.clear();
+    m_entries.clear();
+
+    return writeCacheHeader(getCurrentHeader());
+  }
+
+
+  bool DxvkStateCache::readCacheFile() {
+    Header expected = getCurrentHeader();
+    Header header;
+
+    size_t size = m_file.size();
+    size_t offset = 0u;
+
+    if (!readCacheHeader(offset, header)) {
+      Logger::warn("Failed to parse state cache header.");
+      return false;
+    }
+
+    if (header.magic != expected.magic || header.entrySize != expected.entrySize) {
+      Logger::warn("Invalid state cache header. Discarding old cache.");
+      return false;
+    }
+
+    if (header.versionString != expected.versionString) {
+      Logger::warn(str::format("State cache was created with DXVK version ", header.versionString,
+        ", but current version is ", expected.versionString, ". Discarding old cache."));
+      return false;
+    }
+
+    uint32_t entryCount = 0u;
+
+    while (offset < size) {
+      DxvkStateCacheEntry entry;
+      size_t entryOffset = offset;
+
+      if (!readCacheEntry(offset, entry)) {
+        // Entries are appended one at a time, so a truncated tail is
+        // most likely the result of the process getting killed while
+        // writing. Keep what we have and cut off the partial entry so
+        // that new entries get appended right after the valid ones.
+        Logger::warn(str::format("Failed to parse state cache entry at offset ", entryOffset, ", truncating file."));
+
+        if (!m_file.truncate(entryOffset)) {
+          Logger::warn("Failed to truncate state cache file.");
+          return false;
+        }
+
+        break;
+      }
+
+      std::lock_guard lock(m_entryLock);
+
+      if (m_entries.find(entry) == m_entries.end()) {
+        insertEntryLocked(entry);
+        entryCount += 1;
+      }
+    }
+
+    Logger::info(str::format("Read ", entryCount, " valid state cache entries"));
+    return true;
+  }
+
+
+  bool DxvkStateCache::readCacheHeader(
+          size_t&                         offset,
+          Header&                         header) {
+    if (!m_file.read(offset, header.magic.size(), header.magic.data()))
+      return false;
+
+    offset += header.magic.size();
+
+    if (!readString(offset, header.versionString))
+      return false;
+
+    if (!m_file.read(offset, sizeof(header.entrySize), &header.entrySize))
+      return false;
+
+    offset += sizeof(header.entrySize);
+    return true;
+  }
+
+
+  bool DxvkStateCache::readCacheEntry(
+          size_t&                         offset,
+          DxvkStateCacheEntry&            entry) {
+    for (auto& name : entry.key.names) {
+      if (!readString(offset, name))
+        return false;
+    }
+
+    if (!m_file.read(offset, sizeof(entry.state), &entry.state))
+      return false;
+
+    offset += sizeof(entry.state);
+    return true;
+  }
+
+
+  bool DxvkStateCache::writeCacheHeader(
+    const Header&                         header) {
+    return m_file.append(header.magic.size(), header.magic.data())
+        && writeString(header.versionString)
+        && m_file.append(sizeof(header.entrySize), &header.entrySize);
+  }
+
+
+  bool DxvkStateCache::writeCacheEntry(
+    const DxvkStateCacheEntry&            entry) {
+    bool status = true;
+
+    for (const auto& name : entry.key.names)
+      status = status && writeString(name);
+
+    return status && m_file.append(sizeof(entry.state), &entry.state);
+  }
+
+
+  const DxvkStateCacheEntry* DxvkStateCache::insertEntryLocked(
+    const DxvkStateCacheEntry&            entry) {
+    auto result = &(*m_entries.insert(entry).first);
+
+    for (const auto& name : result->key.names) {
+      if (!name.empty())
+        m_shaderEntries.emplace(name, result);
+    }
+
+    return result;
+  }
+
+
+  bool DxvkStateCache::getShaderKey(
+    const DxvkGraphicsPipelineShaders&    shaders,
+          DxvkStateCacheKey&              key) {
+    std::array<DxvkShader*, 5u> shaderPtrs = {
+      shaders.vs.ptr(), shaders.tcs.ptr(), shaders.tes.ptr(),
+      shaders.gs.ptr(), shaders.fs.ptr() };
+
+    for (size_t i = 0; i < shaderPtrs.size(); i++) {
+      if (shaderPtrs[i])
+        key.names[i] = shaderPtrs[i]->debugName();
+    }
+
+    // Only accept pipelines where all shaders have been registered with
+    // the cache, otherwise we would never be able to use the entry.
+    std::lock_guard lock(m_entryLock);
+
+    for (size_t i = 0; i < shaderPtrs.size(); i++) {
+      if (!shaderPtrs[i])
+        continue;
+
+      auto entry = m_shaderCookies.find(key.names[i]);
+
+      if (entry == m_shaderCookies.end() || entry->second != shaderPtrs[i]->getCookie())
+        return false;
+    }
+
+    return true;
+  }
+
+
+  bool DxvkStateCache::getPipelineShaders(
+    const DxvkStateCacheKey&              key,
+          DxvkGraphicsPipelineShaders&    shaders) {
+    std::array<Rc<DxvkShader>*, 5u> shaderPtrs = {
+      &shaders.vs, &shaders.tcs, &shaders.tes,
+      &shaders.gs, &shaders.fs };
+
+    std::lock_guard lock(m_entryLock);
+
+    for (size_t i = 0; i < shaderPtrs.size(); i++) {
+      if (key.names[i].empty())
+        continue;
+
+      auto entry = m_shaderMap.find(key.names[i]);
+
+      if (entry == m_shaderMap.end())
+        return false;
+
+      *shaderPtrs[i] = entry->second;
+    }
+
+    return true;
+  }
+
+
+  void DxvkStateCache::compilePipeline(
+    const DxvkStateCacheEntry&            entry) {
+    DxvkGraphicsPipelineShaders shaders;
+
+    // If any shader is still missing, the entry will
+    // get queued again once the last one gets registered.
+    if (!getPipelineShaders(entry.key, shaders))
+      return;
+
+    if (!shaders.validate()) {
+      Logger::warn("State cache: Shader stage mismatch for cached pipeline");
+      return;
+    }
+
+    auto pipeline = m_pipeManager->createGraphicsPipeline(shaders);
+
+    if (pipeline)
+      m_pipeWorkers->compileGraphicsPipeline(pipeline, entry.state, DxvkPipelinePriority::Low);
+  }
+
+
+  void DxvkStateCache::runReader() {
+    env::setThreadName("dxvk-state-reader");
+
+    while (true) {
+      const DxvkStateCacheEntry* entry = nullptr;
+
+      { std::unique_lock lock(m_readerLock);
+
+        m_readerCond.wait(lock, [this] {
+          return m_stopped || !m_readerQueue.empty();
+        });
+
+        if (m_stopped)
+          return;
+
+        entry = m_readerQueue.front();
+        m_readerQueue.pop();
+      }
+
+      compilePipeline(*entry);
+    }
+  }
+
+
+  void DxvkStateCache::runWriter() {
+    env::setThreadName("dxvk-state-writer");
+
+    while (true) {
+      const DxvkStateCacheEntry* entry = nullptr;
+
+      { std::unique_lock lock(m_writerLock);
+
+        m_writerCond.wait(lock, [this] {
+          return !m_writerQueue.empty();
+        });
+
+        entry = m_writerQueue.front();
+        m_writerQueue.pop();
+      }
+
+      if (!entry)
+        return;
+
+      if (!writeCacheEntry(*entry)) {
+        Logger::err(str::format("Failed to write state cache file: ", m_filePath));
+
+        // Stop accepting new entries, otherwise the
+        // queue would grow for the rest of the process
+        std::lock_guard lock(m_writerLock);
+        m_writerFailed = true;
+        m_writerQueue = { };
+        return;
+      }
+
+      m_file.flush();
+    }
+  }
+
+
+  bool DxvkStateCache::readString(
+          size_t&                         offset,
+          std::string&                    string) {
+    uint16_t len = 0u;
+
+    if (!m_file.read(offset, sizeof(len), &len))
+      return false;
+
+    offset += sizeof(len);
+    string.resize(len);
+
+    if (len && !m_file.read(offset, len, string.data()))
+      return false;
+
+    offset += len;
+    return true;
+  }
+
+
+  bool DxvkStateCache::writeString(
+    const std::string&                    string) {
+    uint16_t len = uint16_t(string.size());
+
+    return m_file.append(sizeof(len), &len)
+        && (!len || m_file.append(len, string.data()));
+  }
+
+
+  DxvkStateCache::Header DxvkStateCache::getCurrentHeader() {
+    Header header;
+    header.magic = { 'D', 'X', 'S', 'C' };
+    header.versionString = DXVK_VERSION;
+    header.entrySize = sizeof(DxvkGraphicsPipelineStateInfo);
+    return header;
+  }
+
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <array>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "../util/thread.h"
+#include "../util/util_file.h"
+#include "../util/util_small_vector.h"
+
+#include "dxvk_graphics.h"
+
+namespace dxvk {
+
+  class DxvkDevice;
+  class DxvkPipelineManager;
+  class DxvkPipelineWorkers;
+
+  /**
+   * \brief State cache shader key
+   *
+   * Identifies the shaders of a graphics pipeline by
+   * their debug names, which are derived from the
+   * shader hash and thus stable across runs. Unused
+   * stages are represented by empty strings.
+   */
+  struct DxvkStateCacheKey {
+    std::array<std::string, 5u> names;
+
+    bool eq(const DxvkStateCacheKey& other) const;
+
+    size_t hash() const;
+  };
+
+
+  /**
+   * \brief State cache entry
+   *
+   * Stores the shader key along with the pipeline
+   * state vector that the pipeline was used with.
+   */
+  struct DxvkStateCacheEntry {
+    DxvkStateCacheKey             key;
+    DxvkGraphicsPipelineStateInfo state;
+
+    bool eq(const DxvkStateCacheEntry& other) const;
+
+    size_t hash() const;
+  };
+
+
+  /**
+   * \brief Graphics pipeline state cache
+   *
+   * Append-only on-disk cache of graphics pipeline state vectors
+   * that could not be fast-linked from pipeline libraries. When
+   * all shaders for a cached pipeline have been registered, the
+   * optimized pipeline is queued for compilation at low priority
+   * so that it is ready by the time the application uses it.
+   */
+  class DxvkStateCache {
+
+  public:
+
+    DxvkStateCache(
+            DxvkDevice*               device,
+            DxvkPipelineManager*      pipeManager,
+            DxvkPipelineWorkers*      pipeWorkers);
+
+    ~DxvkStateCache();
+
+    /**
+     * \brief Adds a graphics pipeline to the cache
+     *
+     * If the pipeline state is not yet known, it will be written
+     * to the cache file asynchronously. Pipelines using shaders
+     * that were not registered with the cache are ignored.
+     * \param [in] shaders Shaders used by the pipeline
+     * \param [in] state Pipeline state vector
+     */
+    void addGraphicsPipeline(
+      const DxvkGraphicsPipelineShaders&    shaders,
+      const DxvkGraphicsPipelineStateInfo&  state);
+
+    /**
+     * \brief Registers a newly created shader
+     *
+     * Makes the shader available for cache look-ups and queues
+     * compilation of any cached pipeline that uses this shader
+     * and whose other shaders are already known.
+     * \param [in] shader Newly created shader
+     */
+    void registerShader(
+      const Rc<DxvkShader>&                 shader);
+
+    /**
+     * \brief Stops reader and writer threads
+     *
+     * Any pending work will be discarded.
+     */
+    void stopWorkers();
+
+  private:
+
+    struct Header {
+      std::array<char, 4u>  magic = { };
+      std::string           versionString = { };
+      uint32_t              entrySize = 0u;
+    };
+
+    DxvkPipelineManager*          m_pipeManager;
+    DxvkPipelineWorkers*          m_pipeWorkers;
+
+    bool                          m_enable = false;
+    std::atomic<bool>             m_stopped = { false };
+
+    std::string                   m_filePath;
+    util::File                    m_file;
+
+    dxvk::mutex                   m_entryLock;
+
+    std::unordered_set<
+      DxvkStateCacheEntry,
+      DxvkHash, DxvkEq>           m_entries;
+
+    std::unordered_multimap<
+      std::string,
+      const DxvkStateCacheEntry*> m_shaderEntries;
+
+    std::unordered_map<
+      std::string,
+      size_t>                     m_shaderCookies;
+
+    std::unordered_map<
+      std::string,
+      Rc<DxvkShader>>             m_shaderMap;
+
+    dxvk::mutex                   m_readerLock;
+    dxvk::condition_variable      m_readerCond;
+    std::queue<
+      const DxvkStateCacheEntry*> m_readerQueue;
+    dxvk::thread                  m_reader;
+
+    dxvk::mutex                   m_writerLock;
+    dxvk::condition_variable      m_writerCond;
+    std::queue<
+      const DxvkStateCacheEntry*> m_writerQueue;
+    bool                          m_writerFailed = false;
+    dxvk::thread                  m_writer;
+
+    bool openCacheFile(
+      const std::string&                    path);
+
+    bool createCacheFile(
+      const std::string&                    path);
+
+    bool readCacheFile();
+
+    bool readCacheHeader(
+            size_t&                         offset,
+            Header&                         header);
+
+    bool readCacheEntry(
+            size_t&                         offset,
+            DxvkStateCacheEntry&            entry);
+
+    bool writeCacheHeader(
+      const Header&                         header);
+
+    bool writeCacheEntry(
+      const DxvkStateCacheEntry&            entry);
+
+    const DxvkStateCacheEntry* insertEntryLocked(
+      const DxvkStateCacheEntry&            entry);
+
+    bool getShaderKey(
+      const DxvkGraphicsPipelineShaders&    shaders,
+            DxvkStateCacheKey&              key);
+
+    bool getPipelineShaders(
+      const DxvkStateCacheKey&              key,
+            DxvkGraphicsPipelineShaders&    shaders);
+
+    void compilePipeline(
+      const DxvkStateCacheEntry&            entry);
+
+    void runReader();
+
+    void runWriter();
+
+    bool readString(
+            size_t&                         offset,
+            std::string&                    string);
+
+    bool writeString(
+      const std::string&                    string);
+
+    static Header getCurrentHeader();
+
+  };
+
+}
@@ -30,12 +30,16 @@ namespace dxvk {
     CsSyncTicks,              ///< Time spent waiting on CS
     CsIdleTicks,              ///< CS thread idle time in microseconds
     CsChunkCount,             ///< Submitted CS chunks
+    CsEnqueueTicks,           ///< Time spent queueing CS chunks in microseconds
     DescriptorPoolCount,      ///< Descriptor pool count
     DescriptorSetCount,       ///< Descriptor sets allocated
     DescriptorHeapCount,      ///< Number of descriptor heaps created
     DescriptorHeapSize,       ///< Amount of descriptor memory allocated
     DescriptorHeapUsed,       ///< Amount of descriptor memory used
     DescriptorCopyBusyTicks,  ///< Descriptor copy busy time in microseconds
+    ShaderCacheHits,          ///< Shaders loaded from the shader cache
+    ShaderCacheMisses,        ///< Shader cache look-ups that failed
+    ShaderCacheTicks,         ///< Time spent in shader cache look-ups
 
     NumCounters               ///< Number of counters available
   };
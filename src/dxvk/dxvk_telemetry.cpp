@@ -0,0 +1,207 @@
+#include "dxvk_telemetry.h"
+
+#include "../util/log/log.h"
+
+#include "../util/util_env.h"
+#include "../util/util_string.h"
+
+namespace dxvk {
+
+  constexpr static std::array<char, 4u> TelemetryMagic = { 'D', 'X', 'T', 'L' };
+  constexpr static uint32_t TelemetryVersion = 2u;
+
+
+  DxvkTelemetryWriter::DxvkTelemetryWriter(
+    const std::string&                      path)
+  : m_startTime(high_resolution_clock::now()) {
+    // Allow reading so that other processes can open the
+    // file for reading while it is opened for writing
+    m_file = util::File(path, util::FileFlags(util::FileFlag::AllowRead,
+      util::FileFlag::AllowWrite, util::FileFlag::Truncate));
+
+    if (!m_file || !writeHeader(0u)) {
+      Logger::err(str::format("Telemetry: Failed to create file ", path));
+      m_file = util::File();
+      return;
+    }
+
+    Logger::info(str::format("Telemetry: Recording frame statistics to ", path));
+    m_thread = dxvk::thread([this] { runWriter(); });
+  }
+
+
+  DxvkTelemetryWriter::~DxvkTelemetryWriter() {
+    { std::lock_guard lock(m_mutex);
+      m_stopped = true;
+      m_cond.notify_one();
+    }
+
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+
+
+  void DxvkTelemetryWriter::record(DxvkTelemetryFrame frame) {
+    auto t = high_resolution_clock::now() - m_startTime;
+    frame.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+
+    std::lock_guard lock(m_mutex);
+
+    if (m_failed)
+      return;
+
+    frame.sequence = m_frameCount++;
+    frame.sequenceEnd = frame.sequence;
+
+    m_queue.push(frame);
+    m_cond.notify_one();
+  }
+
+
+  std::string DxvkTelemetryWriter::getFilePath() {
+    std::string path = env::getEnvVar("DXVK_TELEMETRY");
+
+    if (path.empty())
+      return path;
+
+    static std::atomic<uint32_t> s_fileIndex = { 0u };
+    uint32_t index = s_fileIndex.fetch_add(1u, std::memory_order_relaxed);
+
+    return str::format(path, env::PlatformDirSlash, env::getExeBaseName(), "_", index, ".dxvk-telemetry");
+  }
+
+
+  void DxvkTelemetryWriter::runWriter() {
+    env::setThreadName("dxvk-telemetry");
+
+    std::queue<DxvkTelemetryFrame> localQueue;
+    bool stop = false;
+
+    while (!stop) {
+      std::unique_lock lock(m_mutex);
+
+      m_cond.wait(lock, [this] {
+        return m_stopped || !m_queue.empty();
+      });
+
+      std::swap(localQueue, m_queue);
+      stop = m_stopped;
+
+      lock.unlock();
+
+      if (localQueue.empty())
+        continue;
+
+      uint64_t frameCount = 0u;
+
+      while (!localQueue.empty()) {
+        const auto& frame = localQueue.front();
+        frameCount = frame.sequence + 1u;
+
+        if (!writeFrame(frame)) {
+          Logger::err("Telemetry: Failed to write file, stopping");
+          stopWriter();
+          return;
+        }
+
+        localQueue.pop();
+      }
+
+      // Only publish the new frame count once all frames
+      // in the batch have been written to the file, and make
+      // sure that the data is visible to other processes.
+      if (!writeHeader(frameCount) || !m_file.flush()) {
+        Logger::err("Telemetry: Failed to write file, stopping");
+        stopWriter();
+        return;
+      }
+    }
+  }
+
+
+  void DxvkTelemetryWriter::stopWriter() {
+    // Stop accepting new frames, otherwise the
+    // queue would grow for the rest of the process
+    std::lock_guard lock(m_mutex);
+    m_failed = true;
+    m_queue = { };
+  }
+
+
+  bool DxvkTelemetryWriter::writeFrame(
+    const DxvkTelemetryFrame&               frame) {
+    size_t offset = sizeof(DxvkTelemetryHeader)
+      + sizeof(DxvkTelemetryFrame) * (frame.sequence % FrameCapacity);
+
+    return m_file.write(offset, sizeof(frame), &frame);
+  }
+
+
+  bool DxvkTelemetryWriter::writeHeader(
+          uint64_t                          frameCount) {
+    DxvkTelemetryHeader header = { };
+    header.magic = TelemetryMagic;
+    header.version = TelemetryVersion;
+    header.frameSize = sizeof(DxvkTelemetryFrame);
+    header.frameCapacity = FrameCapacity;
+    header.counterCount = uint32_t(DxvkStatCounter::NumCounters);
+    header.frameCount = frameCount;
+
+    return m_file.write(0u, sizeof(header), &header);
+  }
+
+
+
+
+  DxvkTelemetryReader::DxvkTelemetryReader() {
+
+  }
+
+
+  DxvkTelemetryReader::~DxvkTelemetryReader() {
+
+  }
+
+
+  bool DxvkTelemetryReader::open(const std::string& path) {
+    // Request write access as well since the writer may still
+    // have the file opened, which would otherwise fail on Windows
+    m_file = util::File(path, util::FileFlags(
+      util::FileFlag::AllowRead, util::FileFlag::AllowWrite));
+
+    if (!m_file || !refresh())
+      return false;
+
+    return m_header.magic == TelemetryMagic
+        && m_header.version == TelemetryVersion
+        && m_header.frameSize == sizeof(DxvkTelemetryFrame)
+        && m_header.counterCount == uint32_t(DxvkStatCounter::NumCounters)
+        && m_header.frameCapacity;
+  }
+
+
+  bool DxvkTelemetryReader::refresh() {
+    return m_file.read(0u, sizeof(m_header), &m_header);
+  }
+
+
+  bool DxvkTelemetryReader::readFrame(
+          uint64_t                          sequence,
+          DxvkTelemetryFrame&               frame) {
+    if (sequence >= m_header.frameCount)
+      return false;
+
+    size_t offset = sizeof(DxvkTelemetryHeader)
+      + sizeof(DxvkTelemetryFrame) * (sequence % m_header.frameCapacity);
+
+    if (!m_file.read(offset, sizeof(frame), &frame))
+      return false;
+
+    // If the writer has wrapped around in the meantime, the slot
+    // will contain a more recent frame. If the slot is being written
+    // while we read it, the two sequence numbers will not match.
+    return frame.sequence == sequence
+        && frame.sequenceEnd == sequence;
+  }
+
+}
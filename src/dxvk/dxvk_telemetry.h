@@ -0,0 +1,219 @@
+#pragma once
+
+#include <array>
+#include <queue>
+#include <string>
+
+#include "dxvk_memory.h"
+#include "dxvk_stats.h"
+
+#include "../util/thread.h"
+#include "../util/util_file.h"
+#include "../util/util_time.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Per-heap memory telemetry
+   */
+  struct DxvkTelemetryHeap {
+    /// Amount of memory allocated from the heap, in bytes
+    uint64_t allocated  = 0u;
+    /// Amount of allocated memory used by resources, in bytes
+    uint64_t used       = 0u;
+    /// Memory budget reported for the heap, in bytes
+    uint64_t budget     = 0u;
+  };
+
+
+  /**
+   * \brief Telemetry for a single frame
+   *
+   * Fixed-size record as stored in the telemetry file. Stat counters are
+   * stored as cumulative values in the order of \c DxvkStatCounter, so
+   * that per-frame deltas can be computed by the reader. Timing counters
+   * use microseconds unless noted otherwise in \c DxvkStatCounter, e.g.
+   * CS thread busy time is the frame time minus the CS idle time delta.
+   */
+  struct DxvkTelemetryFrame {
+    /// Sequence number of the record. Matches the number of frames
+    /// that were written before this one, and is used by readers to
+    /// detect whether a slot has been overwritten.
+    uint64_t sequence       = 0u;
+    /// Frame ID as passed to the presenter
+    uint64_t frameId        = 0u;
+    /// Time since the telemetry writer was created, in nanoseconds
+    uint64_t timestamp      = 0u;
+    /// Stat counters, indexed by \c DxvkStatCounter
+    std::array<uint64_t, uint32_t(DxvkStatCounter::NumCounters)> counters = { };
+    /// Frame latency reported by the latency tracker, in microseconds
+    uint64_t frameLatency   = 0u;
+    /// Latency sleep duration, in microseconds
+    uint64_t sleepDuration  = 0u;
+    /// Number of shared allocation cache requests
+    uint64_t cacheRequests  = 0u;
+    /// Number of shared allocation cache misses
+    uint64_t cacheMisses    = 0u;
+    /// Size of all shared allocation caches, in bytes
+    uint64_t cacheSize      = 0u;
+    /// Number of valid entries in \c heaps
+    uint32_t heapCount      = 0u;
+    uint32_t reserved       = 0u;
+    /// Memory statistics per heap
+    std::array<DxvkTelemetryHeap, VK_MAX_MEMORY_HEAPS> heaps = { };
+    /// Copy of the sequence number. Readers compare this to
+    /// \c sequence in order to detect partially written slots.
+    uint64_t sequenceEnd    = 0u;
+  };
+
+
+  /**
+   * \brief Telemetry file header
+   *
+   * The file consists of the header, followed by a ring of frame
+   * records. Frame \c n is stored in slot \c n \c % \c frameCapacity.
+   * The header is rewritten after every batch of frames, so that a
+   * reader can poll \c frameCount in order to find new frames.
+   */
+  struct DxvkTelemetryHeader {
+    std::array<char, 4u>  magic         = { };
+    uint32_t              version       = 0u;
+    uint32_t              frameSize     = 0u;
+    uint32_t              frameCapacity = 0u;
+    uint32_t              counterCount  = 0u;
+    uint32_t              reserved      = 0u;
+    uint64_t              frameCount    = 0u;
+  };
+
+
+  /**
+   * \brief Telemetry writer
+   *
+   * Writes per-frame stat counters to a ring file that other
+   * processes can read while the application is running. Frames
+   * are written to the file on a dedicated thread so that the
+   * thread submitting the present does not perform any I/O.
+   */
+  class DxvkTelemetryWriter {
+    constexpr static uint32_t FrameCapacity = 8192u;
+  public:
+
+    DxvkTelemetryWriter(
+      const std::string&                      path);
+
+    ~DxvkTelemetryWriter();
+
+    /**
+     * \brief Checks whether the telemetry file could be created
+     * \returns \c true if frames can be recorded
+     */
+    bool isValid() const {
+      return bool(m_file);
+    }
+
+    /**
+     * \brief Records frame
+     *
+     * Sets the sequence number and time stamp of
+     * the frame and queues it up for writing.
+     * \param [in] frame Frame telemetry
+     */
+    void record(DxvkTelemetryFrame frame);
+
+    /**
+     * \brief Queries telemetry file path
+     *
+     * Uses the \c DXVK_TELEMETRY environment variable as a
+     * directory and the executable name as file name. Each call
+     * returns a new file name with a process-wide index appended,
+     * so that multiple devices do not overwrite each other's file.
+     * \returns Telemetry file path, or empty string if disabled
+     */
+    static std::string getFilePath();
+
+  private:
+
+    util::File                        m_file;
+
+    dxvk::mutex                       m_mutex;
+    dxvk::condition_variable          m_cond;
+    std::queue<DxvkTelemetryFrame>    m_queue;
+    bool                              m_stopped = false;
+    bool                              m_failed  = false;
+
+    uint64_t                          m_frameCount = 0u;
+
+    high_resolution_clock::time_point m_startTime;
+
+    dxvk::thread                      m_thread;
+
+    void runWriter();
+
+    void stopWriter();
+
+    bool writeFrame(
+      const DxvkTelemetryFrame&               frame);
+
+    bool writeHeader(
+            uint64_t                          frameCount);
+
+  };
+
+
+  /**
+   * \brief Telemetry reader
+   */
+  class DxvkTelemetryReader {
+
+  public:
+
+    DxvkTelemetryReader();
+
+    ~DxvkTelemetryReader();
+
+    /**
+     * \brief Opens telemetry file and reads header
+     *
+     * \param [in] path Telemetry file path
+     * \returns \c true if the header is valid
+     */
+    bool open(const std::string& path);
+
+    /**
+     * \brief Re-reads header
+     *
+     * Used to find frames written since the last call.
+     * \returns \c true on success
+     */
+    bool refresh();
+
+    /**
+     * \brief Queries telemetry header
+     * \returns Telemetry header
+     */
+    const DxvkTelemetryHeader& header() const {
+      return m_header;
+    }
+
+    /**
+     * \brief Reads frame
+     *
+     * Fails if the frame has not been written yet, or if it
+     * has already been overwritten by a more recent frame.
+     * \param [in] sequence Sequence number of the frame
+     * \param [out] frame Frame telemetry
+     * \returns \c true if the frame could be read
+     */
+    bool readFrame(
+            uint64_t                          sequence,
+            DxvkTelemetryFrame&               frame);
+
+  private:
+
+    util::File            m_file;
+
+    DxvkTelemetryHeader   m_header;
+
+  };
+
+}
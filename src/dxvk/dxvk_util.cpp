@@ -3,7 +3,86 @@
 #include "dxvk_format.h"
 #include "dxvk_util.h"
 
+#include "../util/util_bit.h"
+
 namespace dxvk::util {
+
+  /**
+   * \brief Minimum size for non-temporal image data copies
+   *
+   * When packing data into mapped staging buffers that only the GPU
+   * will read, copies that would not fit into L2 anyway bypass the
+   * cache instead of evicting useful data and reading every destination
+   * cache line before overwriting it.
+   */
+  constexpr VkDeviceSize StreamingCopyThreshold = 256u << 10;
+
+
+  static void copyStreaming(
+          char*             dst,
+    const char*             src,
+          size_t            size) {
+#ifdef DXVK_ARCH_X86
+    // Non-temporal stores need an aligned destination
+    size_t head = std::min<size_t>((-reinterpret_cast<uintptr_t>(dst)) & 0xfu, size);
+    std::memcpy(dst, src, head);
+
+    dst += head;
+    src += head;
+    size -= head;
+
+    while (size >= 64u) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src +  0u));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16u));
+      __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32u));
+      __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48u));
+
+      _mm_stream_si128(reinterpret_cast<__m128i*>(dst +  0u), a);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16u), b);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32u), c);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48u), d);
+
+      dst += 64u;
+      src += 64u;
+      size -= 64u;
+    }
+
+    while (size >= 16u) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+      _mm_stream_si128(reinterpret_cast<__m128i*>(dst), a);
+
+      dst += 16u;
+      src += 16u;
+      size -= 16u;
+    }
+#endif
+
+    std::memcpy(dst, src, size);
+  }
+
+
+  static void copyStreamingFence() {
+#ifdef DXVK_ARCH_X86
+    // Non-temporal stores are weakly ordered, make sure they are
+    // visible before the data gets handed off to another thread
+    _mm_sfence();
+#endif
+  }
+
+
+  static void copyImageData(
+          void*             dst,
+    const void*             src,
+          size_t            size,
+          bool              streaming) {
+    if (streaming) {
+      copyStreaming(reinterpret_cast<char*>(dst),
+        reinterpret_cast<const char*>(src), size);
+    } else {
+      std::memcpy(dst, src, size);
+    }
+  }
+
   
   uint32_t computeMipLevelCount(VkExtent3D imageSize) {
     uint32_t maxDim = std::max(imageSize.width, imageSize.height);
@@ -25,7 +104,8 @@ namespace dxvk::util {
           VkExtent3D        blockCount,
           VkDeviceSize      blockSize,
           VkDeviceSize      pitchPerRow,
-          VkDeviceSize      pitchPerLayer) {
+          VkDeviceSize      pitchPerLayer,
+          bool              streaming) {
     auto dstData = reinterpret_cast<      char*>(dstBytes);
     auto srcData = reinterpret_cast<const char*>(srcBytes);
     
@@ -35,22 +115,27 @@ namespace dxvk::util {
     
     const bool directCopy = ((bytesPerRow   == pitchPerRow  ) || (blockCount.height == 1))
                          && ((bytesPerLayer == pitchPerLayer) || (blockCount.depth  == 1));
+
+    streaming &= bytesTotal >= StreamingCopyThreshold;
     
     if (directCopy) {
-      std::memcpy(dstData, srcData, bytesTotal);
+      copyImageData(dstData, srcData, bytesTotal, streaming);
     } else {
       for (uint32_t i = 0; i < blockCount.depth; i++) {
         for (uint32_t j = 0; j < blockCount.height; j++) {
-          std::memcpy(
+          copyImageData(
             dstData + j * bytesPerRow,
             srcData + j * pitchPerRow,
-            bytesPerRow);
+            bytesPerRow, streaming);
         }
         
         srcData += pitchPerLayer;
         dstData += bytesPerLayer;
       }
     }
+
+    if (streaming)
+      copyStreamingFence();
   }
   
   
@@ -65,10 +150,13 @@ namespace dxvk::util {
           VkExtent3D        imageExtent,
           uint32_t          imageLayers,
     const DxvkFormatInfo*   formatInfo,
-          VkImageAspectFlags aspectMask) {
+          VkImageAspectFlags aspectMask,
+          bool              streaming) {
     auto dstData = reinterpret_cast<      char*>(dstBytes);
     auto srcData = reinterpret_cast<const char*>(srcBytes);
 
+    bool needsFence = false;
+
     for (uint32_t k = 0; k < imageLayers; k++) {
       for (auto aspects = aspectMask; aspects; ) {
         auto aspect = vk::getNextAspect(aspects);
@@ -94,8 +182,11 @@ namespace dxvk::util {
         const bool directCopy = ((bytesPerRow   == srcRowPitch   && bytesPerRow   == dstRowPitch  ) || (blockCount.height == 1))
                              && ((bytesPerSlice == srcSlicePitch && bytesPerSlice == dstSlicePitch) || (blockCount.depth  == 1));
 
+        const bool streamAspect = streaming && bytesTotal >= StreamingCopyThreshold;
+        needsFence |= streamAspect;
+
         if (directCopy) {
-          std::memcpy(dstData, srcData, bytesTotal);
+          copyImageData(dstData, srcData, bytesTotal, streamAspect);
 
           switch (imageType) {
             case VK_IMAGE_TYPE_1D:
@@ -115,10 +206,10 @@ namespace dxvk::util {
         } else {
           for (uint32_t i = 0; i < blockCount.depth; i++) {
             for (uint32_t j = 0; j < blockCount.height; j++) {
-              std::memcpy(
+              copyImageData(
                 dstData + j * dstRowPitch,
                 srcData + j * srcRowPitch,
-                bytesPerRow);
+                bytesPerRow, streamAspect);
             }
 
             switch (imageType) {
@@ -140,6 +231,9 @@ namespace dxvk::util {
         }
       }
     }
+
+    if (needsFence)
+      copyStreamingFence();
   }
 
 
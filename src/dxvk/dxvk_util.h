@@ -150,6 +150,9 @@ namespace dxvk::util {
    * \param [in] blockSize Number of bytes per block
    * \param [in] pitchPerRow Number of bytes between rows
    * \param [in] pitchPerLayer Number of bytes between layers
+   * \param [in] streaming Whether to use non-temporal stores for
+   *    large copies. Only useful if the destination is a mapped
+   *    staging buffer that the CPU will not read back.
    */
   void packImageData(
           void*             dstBytes,
@@ -157,7 +160,8 @@ namespace dxvk::util {
           VkExtent3D        blockCount,
           VkDeviceSize      blockSize,
           VkDeviceSize      pitchPerRow,
-          VkDeviceSize      pitchPerLayer);
+          VkDeviceSize      pitchPerLayer,
+          bool              streaming = false);
   
   /**
    * \brief Repacks image data to a buffer
@@ -176,6 +180,8 @@ namespace dxvk::util {
    * \param [in] imageLayers Image layer count
    * \param [in] formatInfo Image format info
    * \param [in] aspectMask Image aspects to pack
+   * \param [in] streaming Whether to use non-temporal stores for
+   *    large copies, see above
    */
   void packImageData(
           void*             dstBytes,
@@ -188,7 +194,8 @@ namespace dxvk::util {
           VkExtent3D        imageExtent,
           uint32_t          imageLayers,
     const DxvkFormatInfo*   formatInfo,
-          VkImageAspectFlags aspectMask);
+          VkImageAspectFlags aspectMask,
+          bool              streaming = false);
   
   /**
    * \brief Computes minimum extent
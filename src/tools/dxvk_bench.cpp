@@ -0,0 +1,443 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../dxvk/dxvk_allocator.h"
+#include "../dxvk/dxvk_barrier.h"
+#include "../dxvk/dxvk_cs.h"
+#include "../dxvk/dxvk_format.h"
+#include "../dxvk/dxvk_hash.h"
+#include "../dxvk/dxvk_util.h"
+
+#include "../spirv/spirv_compression.h"
+
+#include "../util/config/config.h"
+
+#include "../util/util_lru.h"
+#include "../util/util_time.h"
+
+namespace dxvk::bench {
+
+  /// Number of heap allocations performed by the process. Counted
+  /// via replaced global allocation functions, see below.
+  std::atomic<uint64_t> g_allocCount = { 0u };
+
+  /// Sink for computed values so that the compiler
+  /// cannot optimize away the benchmarked code.
+  volatile size_t g_sink = 0u;
+
+
+  /**
+   * \brief Benchmark
+   *
+   * Each benchmark runs its body a number of times. The body itself
+   * returns the number of operations it performed, so that one run
+   * can batch many operations in order to reduce timer overhead.
+   */
+  struct Benchmark {
+    const char* name;
+    uint32_t    runs;
+    size_t    (*body)();
+  };
+
+
+  size_t benchPageAllocator() {
+    constexpr uint32_t AllocCount = 1024u;
+
+    static DxvkPageAllocator allocator;
+    static std::vector<std::pair<int64_t, uint64_t>> allocations;
+
+    if (!allocator.chunkCount()) {
+      for (uint32_t i = 0u; i < 4u; i++)
+        allocator.addChunk(DxvkPageAllocator::MaxChunkSize);
+
+      allocations.reserve(AllocCount);
+    }
+
+    // Mix of allocation sizes, freed in a different order than they
+    // were allocated in order to exercise free list merging
+    for (uint32_t i = 0u; i < AllocCount; i++) {
+      uint64_t size = DxvkPageAllocator::PageSize << (i % 4u);
+      allocations.push_back({ allocator.alloc(size, DxvkPageAllocator::PageSize), size });
+    }
+
+    for (uint32_t i = 0u; i < AllocCount; i += 2u)
+      allocator.free(allocations[i].first, allocations[i].second);
+
+    for (uint32_t i = 1u; i < AllocCount; i += 2u)
+      allocator.free(allocations[i].first, allocations[i].second);
+
+    allocations.clear();
+    return 2u * AllocCount;
+  }
+
+
+  size_t benchPoolAllocator() {
+    constexpr uint32_t AllocCount = 4096u;
+
+    static DxvkPageAllocator pageAllocator;
+    static DxvkPoolAllocator poolAllocator(pageAllocator);
+    static std::vector<std::pair<int64_t, uint64_t>> allocations;
+
+    if (!pageAllocator.chunkCount()) {
+      pageAllocator.addChunk(DxvkPageAllocator::MaxChunkSize);
+      allocations.reserve(AllocCount);
+    }
+
+    for (uint32_t i = 0u; i < AllocCount; i++) {
+      uint64_t size = DxvkPoolAllocator::MinSize << (i % 8u);
+      allocations.push_back({ poolAllocator.alloc(size), size });
+    }
+
+    for (uint32_t i = AllocCount; i; i--)
+      poolAllocator.free(allocations[i - 1u].first, allocations[i - 1u].second);
+
+    allocations.clear();
+    return 2u * AllocCount;
+  }
+
+
+  size_t benchBarrierTracker() {
+    constexpr uint32_t RangeCount = 1024u;
+
+    static DxvkBarrierTracker tracker;
+
+    // Emulate typical usage where a number of buffers get written
+    // to and subsequently read from, with some overlapping ranges.
+    for (uint32_t i = 0u; i < RangeCount; i++) {
+      DxvkAddressRange range;
+      range.resource = bit::uint48_t(i % 64u);
+      range.rangeStart = (i / 64u) * 256u;
+      range.rangeEnd = range.rangeStart + 383u;
+
+      tracker.insertRange(range, DxvkAccess::Write);
+    }
+
+    size_t found = 0u;
+
+    for (uint32_t i = 0u; i < RangeCount; i++) {
+      DxvkAddressRange range;
+      range.resource = bit::uint48_t(i % 128u);
+      range.rangeStart = (i / 128u) * 512u;
+      range.rangeEnd = range.rangeStart + 15u;
+
+      found += tracker.findRange(range, DxvkAccess::Write);
+    }
+
+    tracker.clear();
+
+    g_sink = found;
+    return 2u * RangeCount;
+  }
+
+
+  size_t benchCsChunk() {
+    static Rc<DxvkCsChunk> chunk = new DxvkCsChunk();
+
+    size_t value = 0u;
+    size_t count = 0u;
+
+    chunk->init(DxvkCsChunkFlag::SingleUse);
+
+    while (chunk->push([&value, cCount = count] (DxvkContext*) { value += cCount; }))
+      count += 1u;
+
+    // Context is not used by any of the commands
+    chunk->executeAll(nullptr);
+
+    g_sink = value;
+    return count;
+  }
+
+
+  size_t benchSpirvCompression() {
+    static std::vector<uint32_t> code;
+
+    if (code.empty()) {
+      // Generate a token stream that roughly resembles SPIR-V, i.e.
+      // an opcode token followed by a small number of mostly low IDs
+      // or literals, so that all encodings are hit with a realistic
+      // distribution.
+      std::mt19937 rng(0u);
+
+      code = { 0x07230203u, 0x00010600u, 0u, 4096u, 0u };
+
+      while (code.size() < 16384u) {
+        uint32_t argCount = 1u + rng() % 5u;
+        code.push_back((argCount + 1u) << 16 | (rng() % 400u));
+
+        for (uint32_t i = 0u; i < argCount; i++)
+          code.push_back(rng() % 8u ? rng() % 4096u : rng());
+      }
+    }
+
+    SpirvCodeBuffer buffer(uint32_t(code.size()), code.data());
+    SpirvCompressedBuffer compressed(buffer);
+
+    SpirvCodeBuffer decompressed = compressed.decompress();
+
+    if (decompressed.dwords() != code.size()) {
+      std::cerr << "SPIR-V round-trip failed" << std::endl;
+      std::exit(1);
+    }
+
+    g_sink = decompressed.dwords();
+    return 1u;
+  }
+
+
+  size_t benchHashState() {
+    constexpr uint32_t HashCount = 4096u;
+
+    DxvkHashState hash;
+
+    for (uint32_t i = 0u; i < HashCount; i++)
+      hash.add(size_t(i));
+
+    g_sink = hash;
+    return HashCount;
+  }
+
+
+  size_t benchLruList() {
+    constexpr uint32_t ValueCount = 1024u;
+
+    static lru_list<uint32_t> list;
+
+    for (uint32_t i = 0u; i < ValueCount; i++)
+      list.insert(i);
+
+    uint32_t touchCount = 0u;
+
+    for (uint32_t i = 0u; i < ValueCount; i += 3u, touchCount++)
+      list.touch(i);
+
+    // Evict half the list in LRU order, then remove the remainder
+    auto iter = list.leastRecentlyUsedIter();
+
+    for (uint32_t i = 0u; i < ValueCount / 2u; i++)
+      iter = list.remove(iter);
+
+    for (uint32_t i = 0u; i < ValueCount; i++)
+      list.remove(i);
+
+    return ValueCount + touchCount + ValueCount / 2u + ValueCount;
+  }
+
+
+  size_t benchConfigProfile() {
+    // Worst case at startup: no built-in profile matches, so
+    // every single pattern has to be compiled and evaluated.
+    Config config = Config::getAppConfig("C:\\Program Files\\Some Game\\bin\\x64\\NotAGame-Win64-Shipping.exe");
+
+    g_sink = config.getOption<int32_t>("dxgi.maxFrameRate", 0);
+    return 1u;
+  }
+
+
+  /**
+   * \brief Packs a full mip chain of a 2D image
+   *
+   * Source rows are padded to the given alignment in order to emulate
+   * typical mapped pitches, which forces a row-by-row repack unless the
+   * row size happens to match the pitch. Passing an alignment of 0 uses
+   * tightly packed source data. Uses non-temporal stores in
+   * order to emulate uploads to a mapped staging buffer.
+   */
+  size_t benchPackMipChain(
+          VkFormat              format,
+          VkExtent3D            extent,
+          VkDeviceSize          rowAlignment,
+          std::vector<char>&    src,
+          std::vector<char>&    dst) {
+    const DxvkFormatInfo* formatInfo = lookupFormatInfo(format);
+    uint32_t mipCount = util::computeMipLevelCount(extent);
+
+    if (src.empty()) {
+      VkDeviceSize srcSize = 0u;
+      VkDeviceSize dstSize = 0u;
+
+      for (uint32_t i = 0u; i < mipCount; i++) {
+        VkExtent3D blockCount = util::computeBlockCount(
+          util::computeMipLevelExtent(extent, i), formatInfo->blockSize);
+
+        VkDeviceSize rowSize = blockCount.width * formatInfo->elementSize;
+        VkDeviceSize rowPitch = rowAlignment ? align(rowSize, rowAlignment) : rowSize;
+
+        srcSize += blockCount.height * rowPitch;
+        dstSize += blockCount.height * rowSize;
+      }
+
+      src.resize(srcSize, 1);
+      dst.resize(dstSize);
+    }
+
+    VkDeviceSize srcOffset = 0u;
+    VkDeviceSize dstOffset = 0u;
+
+    for (uint32_t i = 0u; i < mipCount; i++) {
+      VkExtent3D mipExtent = util::computeMipLevelExtent(extent, i);
+      VkExtent3D blockCount = util::computeBlockCount(mipExtent, formatInfo->blockSize);
+
+      VkDeviceSize rowSize = blockCount.width * formatInfo->elementSize;
+      VkDeviceSize rowPitch = rowAlignment ? align(rowSize, rowAlignment) : rowSize;
+
+      util::packImageData(&dst[dstOffset], &src[srcOffset],
+        rowPitch, blockCount.height * rowPitch, 0, 0,
+        VK_IMAGE_TYPE_2D, mipExtent, 1, formatInfo, formatInfo->aspectMask, true);
+
+      srcOffset += blockCount.height * rowPitch;
+      dstOffset += blockCount.height * rowSize;
+    }
+
+    g_sink = size_t(dst[dstOffset - 1u]);
+    return 1u;
+  }
+
+
+  size_t benchPackRgba8Pitched() {
+    static std::vector<char> src, dst;
+    return benchPackMipChain(VK_FORMAT_R8G8B8A8_UNORM, { 1366u, 768u, 1u }, 256u, src, dst);
+  }
+
+
+  size_t benchPackRgba8Packed() {
+    static std::vector<char> src, dst;
+    return benchPackMipChain(VK_FORMAT_R8G8B8A8_UNORM, { 2048u, 2048u, 1u }, 0u, src, dst);
+  }
+
+
+  size_t benchPackBc1Pitched() {
+    static std::vector<char> src, dst;
+    return benchPackMipChain(VK_FORMAT_BC1_RGBA_UNORM_BLOCK, { 1366u, 768u, 1u }, 256u, src, dst);
+  }
+
+
+  size_t benchPackBc3Packed() {
+    static std::vector<char> src, dst;
+    return benchPackMipChain(VK_FORMAT_BC3_UNORM_BLOCK, { 1024u, 1024u, 1u }, 0u, src, dst);
+  }
+
+
+  static const std::vector<Benchmark> g_benchmarks = {
+    { "page_allocator",     2000u, &benchPageAllocator    },
+    { "pool_allocator",     2000u, &benchPoolAllocator    },
+    { "barrier_tracker",    2000u, &benchBarrierTracker   },
+    { "cs_chunk",          20000u, &benchCsChunk          },
+    { "spirv_compression",   500u, &benchSpirvCompression },
+    { "hash_state",        20000u, &benchHashState        },
+    { "lru_list",           1000u, &benchLruList          },
+    { "config_profile",      100u, &benchConfigProfile    },
+    { "pack_rgba8_pitched",  100u, &benchPackRgba8Pitched },
+    { "pack_rgba8_packed",   100u, &benchPackRgba8Packed  },
+    { "pack_bc1_pitched",    200u, &benchPackBc1Pitched   },
+    { "pack_bc3_packed",     500u, &benchPackBc3Packed    },
+  };
+
+
+  bool runBenchmark(const Benchmark& benchmark) {
+    // Warm up caches and let the benchmark perform
+    // any one-time initialization outside of the
+    // measured region.
+    benchmark.body();
+
+    size_t ops = 0u;
+
+    uint64_t allocsBefore = g_allocCount.load();
+    auto t0 = dxvk::high_resolution_clock::now();
+
+    for (uint32_t i = 0u; i < benchmark.runs; i++)
+      ops += benchmark.body();
+
+    auto t1 = dxvk::high_resolution_clock::now();
+    uint64_t allocs = g_allocCount.load() - allocsBefore;
+
+    if (!ops)
+      return false;
+
+    double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+
+    std::cout << std::left << std::setw(20) << benchmark.name << std::right
+              << std::setw(12) << ops << " ops"
+              << std::fixed << std::setprecision(2)
+              << std::setw(10) << (ns / double(ops)) << " ns/op"
+              << std::setprecision(3)
+              << std::setw(10) << (double(allocs) / double(ops)) << " allocs/op"
+              << std::endl;
+    return true;
+  }
+
+}
+
+
+void* operator new(size_t size) {
+  dxvk::bench::g_allocCount += 1u;
+
+  if (void* ptr = std::malloc(size ? size : 1u))
+    return ptr;
+
+  throw std::bad_alloc();
+}
+
+
+void* operator new(size_t size, std::align_val_t alignment) {
+  dxvk::bench::g_allocCount += 1u;
+
+  size_t align = size_t(alignment);
+  size = (std::max<size_t>(size, 1u) + align - 1u) & ~(align - 1u);
+
+#ifdef _WIN32
+  void* ptr = _aligned_malloc(size, align);
+#else
+  void* ptr = std::aligned_alloc(align, size);
+#endif
+
+  if (!ptr)
+    throw std::bad_alloc();
+
+  return ptr;
+}
+
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+
+void operator delete(void* ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  std::free(ptr);
+#endif
+}
+
+
+void operator delete(void* ptr, size_t, std::align_val_t alignment) noexcept {
+  operator delete(ptr, alignment);
+}
+
+
+int main(int argc, char** argv) {
+  std::string filter = argc > 1 ? argv[1] : "";
+
+  bool success = true;
+
+  for (const auto& benchmark : dxvk::bench::g_benchmarks) {
+    if (filter.empty() || std::string(benchmark.name).find(filter) != std::string::npos)
+      success &= dxvk::bench::runBenchmark(benchmark);
+  }
+
+  return success ? 0 : 1;
+}
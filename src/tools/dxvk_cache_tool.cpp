@@ -0,0 +1,141 @@
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "../dxvk/dxvk_shader_cache.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Derives binary file path from look-up table path
+   *
+   * \param [in] lutPath Path to the \c .dxvk.lut file
+   * \returns Path to the matching \c .dxvk.bin file,
+   *    or an empty string if the path is invalid.
+   */
+  std::string getBinPath(const std::string& lutPath) {
+    static const std::string lutSuffix = ".lut";
+
+    if (lutPath.size() <= lutSuffix.size()
+     || lutPath.compare(lutPath.size() - lutSuffix.size(), lutSuffix.size(), lutSuffix))
+      return std::string();
+
+    return lutPath.substr(0, lutPath.size() - lutSuffix.size()) + ".bin";
+  }
+
+
+  void printStats(const DxvkShaderCache::CompactStats& stats, bool compacted) {
+    std::cout << "Entries:    " << stats.entriesTotal << std::endl
+              << "  kept:     " << stats.entriesKept << std::endl
+              << "  replaced: " << stats.entriesDuplicate << std::endl
+              << "  corrupt:  " << stats.entriesCorrupt << std::endl
+              << "LUT size:   " << stats.lutSizeBefore;
+
+    if (compacted)
+      std::cout << " -> " << stats.lutSizeAfter;
+
+    std::cout << std::endl
+              << "Bin size:   " << stats.binSizeBefore;
+
+    if (compacted)
+      std::cout << " -> " << stats.binSizeAfter;
+
+    std::cout << std::endl
+              << "IR size:    " << stats.irSizeStored << " stored, "
+                                << stats.irSizeDecoded << " decoded" << std::endl;
+
+    if (stats.irDecodeTimeNs) {
+      double seconds = double(stats.irDecodeTimeNs) / 1.0e9;
+      double megabytes = double(stats.irSizeDecoded) / double(1u << 20);
+
+      std::cout << "IR decode:  " << std::fixed << std::setprecision(1)
+                << (megabytes / seconds) << " MB/s" << std::endl;
+    }
+  }
+
+
+  int verifyCache(const std::string& lutPath) {
+    std::string binPath = getBinPath(lutPath);
+
+    if (binPath.empty()) {
+      std::cerr << "Not a look-up table file: " << lutPath << std::endl;
+      return 1;
+    }
+
+    DxvkShaderCache::CompactStats stats;
+
+    if (!DxvkShaderCache::compactCacheFiles(lutPath, binPath, "", "", stats)) {
+      std::cerr << "Failed to parse cache: " << lutPath << std::endl;
+      return 1;
+    }
+
+    printStats(stats, false);
+    return stats.entriesCorrupt ? 2 : 0;
+  }
+
+
+  int compactCache(const std::string& srcLutPath, const std::string& dstLutPath) {
+    std::string srcBinPath = getBinPath(srcLutPath);
+    std::string dstBinPath = getBinPath(dstLutPath);
+
+    if (srcBinPath.empty() || dstBinPath.empty()) {
+      std::cerr << "Not a look-up table file: " << (srcBinPath.empty() ? srcLutPath : dstLutPath) << std::endl;
+      return 1;
+    }
+
+    // When compacting in place, write to temporary files first
+    // so that a failure does not destroy the existing cache.
+    std::error_code ec;
+    bool inPlace = std::filesystem::equivalent(srcLutPath, dstLutPath, ec);
+
+    std::string outLutPath = inPlace ? dstLutPath + ".tmp" : dstLutPath;
+    std::string outBinPath = inPlace ? dstBinPath + ".tmp" : dstBinPath;
+
+    DxvkShaderCache::CompactStats stats;
+
+    if (!DxvkShaderCache::compactCacheFiles(srcLutPath, srcBinPath, outLutPath, outBinPath, stats)) {
+      std::cerr << "Failed to compact cache: " << srcLutPath << std::endl;
+      return 1;
+    }
+
+    if (inPlace) {
+      // Remove the old look-up table before replacing the binary
+      // file so that an interrupted swap can never leave a look-up
+      // table next to a binary file it does not belong to. If the
+      // look-up table is missing, the runtime starts a new cache.
+      std::filesystem::remove(dstLutPath, ec);
+
+      if (!ec)
+        std::filesystem::rename(outBinPath, dstBinPath, ec);
+
+      if (!ec)
+        std::filesystem::rename(outLutPath, dstLutPath, ec);
+
+      if (ec) {
+        std::cerr << "Failed to replace cache files: " << ec.message() << std::endl;
+        return 1;
+      }
+    }
+
+    printStats(stats, true);
+    return 0;
+  }
+
+}
+
+
+int main(int argc, char** argv) {
+  std::string mode = argc > 1 ? argv[1] : "";
+
+  if (mode == "verify" && argc == 3)
+    return dxvk::verifyCache(argv[2]);
+
+  if (mode == "compact" && (argc == 3 || argc == 4))
+    return dxvk::compactCache(argv[2], argv[argc - 1]);
+
+  std::cerr << "Usage:" << std::endl
+            << "  " << argv[0] << " verify <file.dxvk.lut>" << std::endl
+            << "  " << argv[0] << " compact <file.dxvk.lut> [<output.dxvk.lut>]" << std::endl;
+  return 1;
+}
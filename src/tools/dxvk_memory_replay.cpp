@@ -0,0 +1,1252 @@
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../dxvk/dxvk_memory.h"
+#include "../dxvk/dxvk_memory_trace.h"
+#include "../dxvk/dxvk_sparse.h"
+
+#include "../util/util_bit.h"
+#include "../util/util_math.h"
+
+#include "../vulkan/vulkan_util.h"
+
+namespace dxvk::replay {
+
+  /// Interval between simulated submissions, in nanoseconds. The trace
+  /// does not record submissions, so assume one per frame at 60 Hz.
+  constexpr uint64_t SubmissionInterval = 16'666'667ull;
+
+  /// Relocation limits per submission, same as in DxvkContext
+  constexpr uint32_t      MaxRelocationsPerSubmission     = 128u;
+  constexpr VkDeviceSize  MaxRelocatedMemoryPerSubmission = 16u << 20;
+
+  /**
+   * \brief Heap layout to replay against
+   */
+  enum class Layout : uint32_t {
+    /// Memory layout of the device the trace was recorded on
+    Recorded,
+    /// Dedicated GPU with a 256 MiB BAR
+    Discrete,
+    /// Dedicated GPU with resizable BAR
+    ResizableBar,
+    /// Integrated GPU with a single memory heap
+    Unified,
+  };
+
+
+  struct Options {
+    std::string   path;
+    Layout        layout      = Layout::Recorded;
+    VkDeviceSize  vramSize    = 0u;
+    VkDeviceSize  sysmemSize  = 16ull << 30;
+    VkDeviceSize  maxBudget   = 0u;
+    bool          defrag      = true;
+  };
+
+
+  struct MockRequirements {
+    VkMemoryRequirements  memory            = { };
+    VkBool32              prefersDedicated  = VK_FALSE;
+    VkBool32              requiresDedicated = VK_FALSE;
+  };
+
+
+  struct MockMemory {
+    VkDeviceSize  size    = 0u;
+    uint32_t      heap    = 0u;
+    void*         mapPtr  = nullptr;
+  };
+
+
+  /**
+   * \brief Mock Vulkan device
+   *
+   * Backs the subset of device functions that the memory allocator
+   * uses. Memory objects only account for heap usage and fail once
+   * a heap is full, and resources report the memory requirements
+   * recorded in the trace. Only accessed from the replay thread.
+   */
+  struct MockDevice {
+    VkPhysicalDeviceMemoryProperties memory = { };
+
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heapUsage = { };
+
+    std::unordered_map<uint64_t, MockMemory>        memoryObjects;
+    std::unordered_map<uint64_t, MockRequirements>  resources;
+
+    MockRequirements  pending     = { };
+    bool              hasPending  = false;
+
+    uint64_t          nextHandle  = 0u;
+    uint64_t          currentTime = 0u;
+
+    uint64_t          allocateCount       = 0u;
+    uint64_t          allocateFailedCount = 0u;
+    uint64_t          freeCount           = 0u;
+  };
+
+  MockDevice g_mockDevice;
+
+
+  template<typename T>
+  T makeHandle(uint64_t id) {
+    static_assert(sizeof(T) == sizeof(id));
+
+    T handle;
+    std::memcpy(&handle, &id, sizeof(handle));
+    return handle;
+  }
+
+
+  MockRequirements getDefaultRequirements(VkDeviceSize size) {
+    MockRequirements result = { };
+    result.memory.size = align(size, 256u);
+    result.memory.alignment = 256u;
+    result.memory.memoryTypeBits = (1u << g_mockDevice.memory.memoryTypeCount) - 1u;
+    return result;
+  }
+
+
+  uint64_t createMockResource(VkDeviceSize size) {
+    uint64_t id = ++g_mockDevice.nextHandle;
+
+    // Requirements for replayed resources are set up by the
+    // caller, anything else is an allocator-internal buffer.
+    if (g_mockDevice.hasPending) {
+      g_mockDevice.resources.insert({ id, g_mockDevice.pending });
+      g_mockDevice.hasPending = false;
+    } else {
+      g_mockDevice.resources.insert({ id, getDefaultRequirements(size) });
+    }
+
+    return id;
+  }
+
+
+  void getMockRequirements(
+          uint64_t                  id,
+          VkMemoryRequirements2*    pMemoryRequirements) {
+    MockRequirements requirements = g_mockDevice.resources.at(id);
+    pMemoryRequirements->memoryRequirements = requirements.memory;
+
+    auto next = reinterpret_cast<VkBaseOutStructure*>(pMemoryRequirements->pNext);
+
+    for ( ; next; next = next->pNext) {
+      if (next->sType == VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS) {
+        auto dedicated = reinterpret_cast<VkMemoryDedicatedRequirements*>(next);
+        dedicated->prefersDedicatedAllocation = requirements.prefersDedicated;
+        dedicated->requiresDedicatedAllocation = requirements.requiresDedicated;
+      }
+    }
+  }
+
+
+  VkResult VKAPI_CALL mockAllocateMemory(
+          VkDevice                  device,
+    const VkMemoryAllocateInfo*     pAllocateInfo,
+    const VkAllocationCallbacks*    pAllocator,
+          VkDeviceMemory*           pMemory) {
+    auto& mock = g_mockDevice;
+
+    MockMemory memory = { };
+    memory.size = pAllocateInfo->allocationSize;
+    memory.heap = mock.memory.memoryTypes[pAllocateInfo->memoryTypeIndex].heapIndex;
+
+    if (mock.heapUsage[memory.heap] + memory.size > mock.memory.memoryHeaps[memory.heap].size) {
+      mock.allocateFailedCount += 1u;
+      return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+
+    uint64_t id = ++mock.nextHandle;
+
+    mock.heapUsage[memory.heap] += memory.size;
+    mock.memoryObjects.insert({ id, memory });
+    mock.allocateCount += 1u;
+
+    *pMemory = makeHandle<VkDeviceMemory>(id);
+    return VK_SUCCESS;
+  }
+
+
+  void VKAPI_CALL mockFreeMemory(
+          VkDevice                  device,
+          VkDeviceMemory            memory,
+    const VkAllocationCallbacks*    pAllocator) {
+    auto& mock = g_mockDevice;
+    auto entry = mock.memoryObjects.find(vk::getObjectHandle(memory));
+
+    if (entry == mock.memoryObjects.end())
+      return;
+
+    std::free(entry->second.mapPtr);
+
+    mock.heapUsage[entry->second.heap] -= entry->second.size;
+    mock.memoryObjects.erase(entry);
+    mock.freeCount += 1u;
+  }
+
+
+  VkResult VKAPI_CALL mockMapMemory(
+          VkDevice                  device,
+          VkDeviceMemory            memory,
+          VkDeviceSize              offset,
+          VkDeviceSize              size,
+          VkMemoryMapFlags          flags,
+          void**                    ppData) {
+    auto& object = g_mockDevice.memoryObjects.at(vk::getObjectHandle(memory));
+
+    // Pages are only committed once the allocator writes to them,
+    // which it does not do unless memory needs to be cleared.
+    if (!object.mapPtr)
+      object.mapPtr = std::malloc(object.size);
+
+    if (!object.mapPtr)
+      return VK_ERROR_MEMORY_MAP_FAILED;
+
+    *ppData = reinterpret_cast<char*>(object.mapPtr) + offset;
+    return VK_SUCCESS;
+  }
+
+
+  void VKAPI_CALL mockUnmapMemory(
+          VkDevice                  device,
+          VkDeviceMemory            memory) {
+    auto& object = g_mockDevice.memoryObjects.at(vk::getObjectHandle(memory));
+
+    std::free(object.mapPtr);
+    object.mapPtr = nullptr;
+  }
+
+
+  VkResult VKAPI_CALL mockCreateBuffer(
+          VkDevice                  device,
+    const VkBufferCreateInfo*       pCreateInfo,
+    const VkAllocationCallbacks*    pAllocator,
+          VkBuffer*                 pBuffer) {
+    *pBuffer = makeHandle<VkBuffer>(createMockResource(pCreateInfo->size));
+    return VK_SUCCESS;
+  }
+
+
+  void VKAPI_CALL mockDestroyBuffer(
+          VkDevice                  device,
+          VkBuffer                  buffer,
+    const VkAllocationCallbacks*    pAllocator) {
+    g_mockDevice.resources.erase(vk::getObjectHandle(buffer));
+  }
+
+
+  void VKAPI_CALL mockGetBufferMemoryRequirements2(
+          VkDevice                  device,
+    const VkBufferMemoryRequirementsInfo2* pInfo,
+          VkMemoryRequirements2*    pMemoryRequirements) {
+    getMockRequirements(vk::getObjectHandle(pInfo->buffer), pMemoryRequirements);
+  }
+
+
+  void VKAPI_CALL mockGetDeviceBufferMemoryRequirements(
+          VkDevice                  device,
+    const VkDeviceBufferMemoryRequirements* pInfo,
+          VkMemoryRequirements2*    pMemoryRequirements) {
+    pMemoryRequirements->memoryRequirements = getDefaultRequirements(pInfo->pCreateInfo->size).memory;
+  }
+
+
+  VkResult VKAPI_CALL mockBindBufferMemory(
+          VkDevice                  device,
+          VkBuffer                  buffer,
+          VkDeviceMemory            memory,
+          VkDeviceSize              memoryOffset) {
+    return VK_SUCCESS;
+  }
+
+
+  VkDeviceAddress VKAPI_CALL mockGetBufferDeviceAddress(
+          VkDevice                  device,
+    const VkBufferDeviceAddressInfo* pInfo) {
+    return vk::getObjectHandle(pInfo->buffer) << 32u;
+  }
+
+
+  VkResult VKAPI_CALL mockCreateImage(
+          VkDevice                  device,
+    const VkImageCreateInfo*        pCreateInfo,
+    const VkAllocationCallbacks*    pAllocator,
+          VkImage*                  pImage) {
+    *pImage = makeHandle<VkImage>(createMockResource(SparseMemoryPageSize));
+    return VK_SUCCESS;
+  }
+
+
+  void VKAPI_CALL mockDestroyImage(
+          VkDevice                  device,
+          VkImage                   image,
+    const VkAllocationCallbacks*    pAllocator) {
+    g_mockDevice.resources.erase(vk::getObjectHandle(image));
+  }
+
+
+  void VKAPI_CALL mockGetImageMemoryRequirements2(
+          VkDevice                  device,
+    const VkImageMemoryRequirementsInfo2* pInfo,
+          VkMemoryRequirements2*    pMemoryRequirements) {
+    getMockRequirements(vk::getObjectHandle(pInfo->image), pMemoryRequirements);
+  }
+
+
+  void VKAPI_CALL mockGetDeviceImageMemoryRequirements(
+          VkDevice                  device,
+    const VkDeviceImageMemoryRequirements* pInfo,
+          VkMemoryRequirements2*    pMemoryRequirements) {
+    pMemoryRequirements->memoryRequirements = getDefaultRequirements(SparseMemoryPageSize).memory;
+    pMemoryRequirements->memoryRequirements.alignment = SparseMemoryPageSize;
+  }
+
+
+  VkResult VKAPI_CALL mockBindImageMemory(
+          VkDevice                  device,
+          VkImage                   image,
+          VkDeviceMemory            memory,
+          VkDeviceSize              memoryOffset) {
+    return VK_SUCCESS;
+  }
+
+
+  PFN_vkVoidFunction VKAPI_CALL mockGetDeviceProcAddr(
+          VkDevice                  device,
+    const char*                     pName);
+
+
+  PFN_vkVoidFunction VKAPI_CALL mockGetInstanceProcAddr(
+          VkInstance                instance,
+    const char*                     pName) {
+    // Instance functions are never called, and the device
+    // loader queries vkGetDeviceProcAddr through here.
+    return mockGetDeviceProcAddr(VK_NULL_HANDLE, pName);
+  }
+
+
+  PFN_vkVoidFunction VKAPI_CALL mockGetDeviceProcAddr(
+          VkDevice                  device,
+    const char*                     pName) {
+    static const std::unordered_map<std::string, PFN_vkVoidFunction> s_functions = {
+      { "vkGetDeviceProcAddr",                  reinterpret_cast<PFN_vkVoidFunction>(&mockGetDeviceProcAddr) },
+      { "vkAllocateMemory",                     reinterpret_cast<PFN_vkVoidFunction>(&mockAllocateMemory) },
+      { "vkFreeMemory",                         reinterpret_cast<PFN_vkVoidFunction>(&mockFreeMemory) },
+      { "vkMapMemory",                          reinterpret_cast<PFN_vkVoidFunction>(&mockMapMemory) },
+      { "vkUnmapMemory",                        reinterpret_cast<PFN_vkVoidFunction>(&mockUnmapMemory) },
+      { "vkCreateBuffer",                       reinterpret_cast<PFN_vkVoidFunction>(&mockCreateBuffer) },
+      { "vkDestroyBuffer",                      reinterpret_cast<PFN_vkVoidFunction>(&mockDestroyBuffer) },
+      { "vkGetBufferMemoryRequirements2",       reinterpret_cast<PFN_vkVoidFunction>(&mockGetBufferMemoryRequirements2) },
+      { "vkGetDeviceBufferMemoryRequirements",  reinterpret_cast<PFN_vkVoidFunction>(&mockGetDeviceBufferMemoryRequirements) },
+      { "vkBindBufferMemory",                   reinterpret_cast<PFN_vkVoidFunction>(&mockBindBufferMemory) },
+      { "vkGetBufferDeviceAddress",             reinterpret_cast<PFN_vkVoidFunction>(&mockGetBufferDeviceAddress) },
+      { "vkCreateImage",                        reinterpret_cast<PFN_vkVoidFunction>(&mockCreateImage) },
+      { "vkDestroyImage",                       reinterpret_cast<PFN_vkVoidFunction>(&mockDestroyImage) },
+      { "vkGetImageMemoryRequirements2",        reinterpret_cast<PFN_vkVoidFunction>(&mockGetImageMemoryRequirements2) },
+      { "vkGetDeviceImageMemoryRequirements",   reinterpret_cast<PFN_vkVoidFunction>(&mockGetDeviceImageMemoryRequirements) },
+      { "vkBindImageMemory",                    reinterpret_cast<PFN_vkVoidFunction>(&mockBindImageMemory) },
+    };
+
+    auto entry = s_functions.find(pName);
+
+    if (entry == s_functions.end())
+      return nullptr;
+
+    return entry->second;
+  }
+
+
+  /**
+   * \brief Mock memory backend
+   *
+   * Runs the allocator against the mock device. Time is
+   * driven by trace timestamps rather than the system clock.
+   */
+  class MockMemoryBackend : public DxvkMemoryBackend {
+
+  public:
+
+    MockMemoryBackend(const DxvkMemoryDeviceProperties& properties)
+    : m_properties(properties) {
+      Rc<vk::LibraryFn> library = new vk::LibraryFn(&mockGetInstanceProcAddr);
+      Rc<vk::InstanceFn> instance = new vk::InstanceFn(library, false, VK_NULL_HANDLE);
+
+      m_vkd = new vk::DeviceFn(instance, false, VK_NULL_HANDLE);
+    }
+
+    Rc<vk::DeviceFn> vkd() const {
+      return m_vkd;
+    }
+
+    DxvkMemoryDeviceProperties getProperties() const {
+      return m_properties;
+    }
+
+    void getMemoryBudget(
+            VkPhysicalDeviceMemoryBudgetPropertiesEXT& budget) const {
+      for (uint32_t i = 0; i < m_properties.memory.memoryHeapCount; i++) {
+        budget.heapBudget[i] = m_properties.memory.memoryHeaps[i].size;
+        budget.heapUsage[i] = g_mockDevice.heapUsage[i];
+      }
+    }
+
+    void notifyMemoryStats(
+            uint32_t            heap,
+            int64_t             allocated,
+            int64_t             used) {
+
+    }
+
+    high_resolution_clock::time_point getCurrentTime() const {
+      // Offset the time so that the allocator never sees the
+      // zero time point, which it uses as an invalid value.
+      auto time = std::chrono::hours(1u) + std::chrono::nanoseconds(g_mockDevice.currentTime);
+      return high_resolution_clock::time_point(
+        std::chrono::duration_cast<high_resolution_clock::duration>(time));
+    }
+
+  private:
+
+    DxvkMemoryDeviceProperties  m_properties;
+    Rc<vk::DeviceFn>            m_vkd;
+
+  };
+
+
+  /**
+   * \brief Creates backing storage for a traced allocation
+   *
+   * Issues the same allocator call as the traced event. Memory type
+   * bits in the event must already refer to the replayed layout.
+   * \param [in] allocator Allocator
+   * \param [in] event Traced buffer or image event
+   * \param [in] mode Allocation modes
+   * \param [in] cookie Resource cookie, or 0
+   * \param [in] cache Allocation cache, if any
+   * \returns Allocation, or \c nullptr on failure
+   */
+  Rc<DxvkResourceAllocation> createStorage(
+          DxvkMemoryAllocator&        allocator,
+    const DxvkMemoryTraceEvent&       event,
+          DxvkAllocationModes         mode,
+          uint64_t                    cookie,
+          DxvkLocalAllocationCache*   cache) {
+    DxvkAllocationInfo allocationInfo = { };
+    allocationInfo.resourceCookie = cookie;
+    allocationInfo.properties = event.properties;
+    allocationInfo.mode = mode;
+
+    MockRequirements requirements = { };
+    requirements.memory.size = event.size;
+    requirements.memory.alignment = std::max<uint64_t>(event.alignment, 1u);
+    requirements.memory.memoryTypeBits = event.memoryTypeBits;
+    requirements.prefersDedicated = event.testFlag(DxvkMemoryTraceFlag::PreferDedicated);
+    requirements.requiresDedicated = event.testFlag(DxvkMemoryTraceFlag::RequireDedicated);
+
+    if (event.type == DxvkMemoryTraceEventType::Buffer) {
+      // Dedicated buffers are descriptor heaps, which must use the recorded
+      // requirements. Other buffers get requirements from the allocator.
+      if (requirements.requiresDedicated) {
+        g_mockDevice.pending = requirements;
+        g_mockDevice.hasPending = true;
+      }
+
+      VkBufferCreateInfo info = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+      info.size = event.size;
+      info.usage = event.usage;
+
+      auto allocation = allocator.createBufferResource(info, allocationInfo, cache);
+      g_mockDevice.hasPending = false;
+      return allocation;
+    } else {
+      g_mockDevice.pending = requirements;
+      g_mockDevice.hasPending = true;
+
+      VkImageCreateInfo info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+      info.imageType = VK_IMAGE_TYPE_2D;
+      info.format = VK_FORMAT_R8G8B8A8_UNORM;
+      info.extent = { 1u, 1u, 1u };
+      info.mipLevels = 1u;
+      info.arrayLayers = 1u;
+      info.samples = VK_SAMPLE_COUNT_1_BIT;
+      info.usage = event.usage;
+      info.tiling = event.testFlag(DxvkMemoryTraceFlag::OptimalTiling)
+        ? VK_IMAGE_TILING_OPTIMAL
+        : VK_IMAGE_TILING_LINEAR;
+
+      return allocator.createImageResource(info, allocationInfo, nullptr);
+    }
+  }
+
+
+  /**
+   * \brief Replayed resource
+   *
+   * Stands in for a buffer or image so that the allocator can
+   * defragment and evict it. Relocations re-create the backing
+   * storage with the parameters of the first traced allocation.
+   */
+  class ReplayResource : public DxvkPagedResource {
+
+  public:
+
+    ReplayResource(
+            DxvkMemoryAllocator&  allocator,
+      const DxvkMemoryTraceEvent& event)
+    : DxvkPagedResource(allocator), m_event(event) {
+      m_allocator->registerResource(this);
+    }
+
+    ~ReplayResource() {
+      m_allocator->unregisterResource(this);
+    }
+
+    /**
+     * \brief Queries trace ID of the current allocation
+     * \returns Allocation ID, or 0 if the resource is dead
+     */
+    uint64_t getCurrentId() const {
+      return m_currentId;
+    }
+
+    /**
+     * \brief Sets trace ID of the current allocation
+     * \param [in] id Allocation ID
+     */
+    void setCurrentId(uint64_t id) {
+      m_currentId = id;
+    }
+
+    /**
+     * \brief Creates backing storage
+     *
+     * \param [in] mode Allocation modes
+     * \param [in] cache Allocation cache, if any
+     * \returns New allocation
+     */
+    Rc<DxvkResourceAllocation> createStorage(
+            DxvkAllocationModes         mode,
+            DxvkLocalAllocationCache*   cache) {
+      return replay::createStorage(*m_allocator, m_event, mode, cookie(), cache);
+    }
+
+    /**
+     * \brief Updates residency for new storage
+     *
+     * Same logic as buffers and images use.
+     * \param [in] storage New backing storage
+     */
+    void assignStorage(const DxvkResourceAllocation& storage) {
+      if (!(m_event.properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+        auto common = m_event.properties & storage.getMemoryProperties();
+
+        updateResidencyStatus((common & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+          ? DxvkResourceResidency::Resident
+          : DxvkResourceResidency::Evicted);
+      }
+    }
+
+    DxvkSparsePageTable* getSparsePageTable() {
+      return nullptr;
+    }
+
+    Rc<DxvkResourceAllocation> relocateStorage(
+            DxvkAllocationModes         mode) {
+      // Mapped resources and descriptor heaps need a stable address
+      if (!m_currentId
+       || (m_event.properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+       || m_event.testFlag(DxvkMemoryTraceFlag::RequireDedicated))
+        return nullptr;
+
+      return createStorage(mode, nullptr);
+    }
+
+    void setDebugName(const char* name) {
+
+    }
+
+    const char* getDebugName() const {
+      return "";
+    }
+
+  private:
+
+    DxvkMemoryTraceEvent  m_event;
+    uint64_t              m_currentId = 0u;
+
+  };
+
+
+  struct Slot {
+    Rc<DxvkResourceAllocation>  allocation;
+    uint64_t                    cookie = 0u;
+  };
+
+
+  struct ResourceEntry {
+    Rc<ReplayResource>  resource;
+    uint32_t            slotCount = 0u;
+  };
+
+
+  struct Heap {
+    VkMemoryHeap  properties    = { };
+    VkDeviceSize  peakAllocated = 0u;
+    VkDeviceSize  peakUsed      = 0u;
+    VkDeviceSize  usedAtPeak    = 0u;
+  };
+
+
+  struct Stats {
+    uint64_t      eventCount          = 0u;
+    uint64_t      allocationCount     = 0u;
+    uint64_t      freeCount           = 0u;
+    uint64_t      failedCount         = 0u;
+    uint64_t      tracedFailedCount   = 0u;
+    uint64_t      tracedRelocations   = 0u;
+    uint64_t      fallbackCount       = 0u;
+    uint64_t      dedicatedCount      = 0u;
+    uint64_t      unknownFreeCount    = 0u;
+    uint64_t      submissionCount     = 0u;
+    uint64_t      callTimeNs          = 0u;
+    uint64_t      callTimeMaxNs       = 0u;
+    uint64_t      tracedTimeNs        = 0u;
+    uint64_t      tracedTimeMaxNs     = 0u;
+    uint64_t      defragMoves         = 0u;
+    VkDeviceSize  defragBytes         = 0u;
+    uint64_t      evictMoves          = 0u;
+    VkDeviceSize  evictBytes          = 0u;
+    uint64_t      residentMoves       = 0u;
+    VkDeviceSize  residentBytes       = 0u;
+    double        fragmentationSum    = 0.0;
+    uint64_t      fragmentationCount  = 0u;
+    uint64_t      duration            = 0u;
+  };
+
+
+  /**
+   * \brief Allocator replay
+   *
+   * Replays traced allocations against a \c DxvkMemoryAllocator
+   * running on a mock device, with time taken from the trace.
+   * Resources are not used after creation since the trace does
+   * not record resource usage, so eviction sees them as idle.
+   */
+  class Replayer {
+
+  public:
+
+    Replayer(
+      const DxvkMemoryTraceHeader&  header,
+      const Options&                options) {
+      VkPhysicalDeviceMemoryProperties recorded = header.memoryProperties;
+      VkPhysicalDeviceMemoryProperties layout = createLayout(recorded, options);
+
+      g_mockDevice.memory = layout;
+
+      // Treat the device as a dedicated GPU if there is any heap that
+      // is not device-local, same as the allocator on real devices.
+      bool discrete = false;
+
+      for (uint32_t i = 0; i < layout.memoryHeapCount; i++) {
+        m_heaps[i].properties = layout.memoryHeaps[i];
+        discrete |= !(layout.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+      }
+
+      m_heapCount = layout.memoryHeapCount;
+
+      DxvkMemoryDeviceProperties properties = { };
+      properties.memory = layout;
+      properties.bufferImageGranularity = header.granularity;
+      properties.maxMemoryBudget = options.maxBudget;
+      properties.enforceBudget = discrete;
+      properties.memoryBudget = true;
+      properties.sparseBinding = true;
+      properties.transformFeedback = true;
+      properties.descriptorBuffer = true;
+      properties.enableDefrag = options.defrag;
+      properties.measureLockTime = true;
+
+      m_allocator = std::make_unique<DxvkMemoryAllocator>(nullptr,
+        std::make_unique<MockMemoryBackend>(properties));
+
+      // Memory type bits in the trace refer to the recorded layout, so
+      // translate them to types with matching properties if necessary.
+      for (uint32_t i = 0; i < recorded.memoryTypeCount; i++) {
+        if (options.layout == Layout::Recorded) {
+          m_typeRemap[i] = 1u << i;
+        } else {
+          VkMemoryPropertyFlags mask = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+          VkMemoryPropertyFlags flags = recorded.memoryTypes[i].propertyFlags & mask;
+
+          if (!discrete)
+            flags &= ~VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+          for (uint32_t j = 0; j < layout.memoryTypeCount; j++) {
+            if ((layout.memoryTypes[j].propertyFlags & flags) == flags)
+              m_typeRemap[i] |= 1u << j;
+          }
+        }
+      }
+    }
+
+
+    ~Replayer() {
+      // Release everything that holds allocations
+      // before the allocator itself goes away
+      m_slots.clear();
+      m_resources.clear();
+      m_caches.clear();
+
+      m_allocator = nullptr;
+    }
+
+
+    void processEvent(const DxvkMemoryTraceEvent& event) {
+      m_stats.eventCount += 1u;
+      m_stats.duration = event.timestamp;
+
+      while (m_nextSubmission <= event.timestamp) {
+        g_mockDevice.currentTime = m_nextSubmission;
+        m_nextSubmission += SubmissionInterval;
+
+        submit();
+      }
+
+      g_mockDevice.currentTime = event.timestamp;
+
+      if (event.type == DxvkMemoryTraceEventType::Free) {
+        freeAllocation(event.id);
+      } else {
+        m_stats.tracedTimeNs += event.durationNs;
+        m_stats.tracedTimeMaxNs = std::max<uint64_t>(m_stats.tracedTimeMaxNs, event.durationNs);
+
+        // Failed allocations do not have an ID and will
+        // never be freed, so there is no point in them
+        if (event.testFlag(DxvkMemoryTraceFlag::Failed)) {
+          m_stats.tracedFailedCount += 1u;
+          return;
+        }
+
+        allocate(remapEvent(event));
+      }
+
+      updatePeakStats();
+    }
+
+
+    void printReport() {
+      auto mib = [] (VkDeviceSize size) {
+        return double(size) / double(1u << 20);
+      };
+
+      std::cout << std::fixed << std::setprecision(1)
+                << "Trace:        " << m_stats.eventCount << " events, "
+                << (double(m_stats.duration) / 1.0e9) << " s, "
+                << m_stats.submissionCount << " submissions" << std::endl
+                << "Allocations:  " << m_stats.allocationCount << " ("
+                << m_stats.dedicatedCount << " dedicated, "
+                << m_stats.fallbackCount << " fallback, "
+                << m_stats.failedCount << " failed, "
+                << m_stats.tracedFailedCount << " failed in trace)" << std::endl
+                << "Frees:        " << m_stats.freeCount << " ("
+                << m_stats.unknownFreeCount << " unknown)" << std::endl
+                << "Device memory: " << g_mockDevice.allocateCount << " allocated, "
+                << g_mockDevice.freeCount << " freed, "
+                << g_mockDevice.allocateFailedCount << " failed" << std::endl;
+
+      for (uint32_t i = 0; i < m_heapCount; i++) {
+        const auto& heap = m_heaps[i];
+
+        double fragmentation = heap.peakAllocated
+          ? 100.0 * double(heap.peakAllocated - heap.usedAtPeak) / double(heap.peakAllocated)
+          : 0.0;
+
+        std::cout << "Heap " << i << ":       " << mib(heap.properties.size) << " MiB"
+                  << ((heap.properties.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device)" : " (system)") << std::endl
+                  << "  peak committed: " << mib(heap.peakAllocated) << " MiB, "
+                  << fragmentation << "% unused at peak" << std::endl
+                  << "  peak used:      " << mib(heap.peakUsed) << " MiB" << std::endl;
+      }
+
+      double fragmentation = m_stats.fragmentationCount
+        ? 100.0 * m_stats.fragmentationSum / double(m_stats.fragmentationCount)
+        : 0.0;
+
+      DxvkSharedAllocationCacheStats cacheStats = m_allocator->getAllocationCacheStats();
+
+      std::cout << "Fragmentation:  " << fragmentation << "% unused on average" << std::endl
+                << "Defrag:         " << m_stats.defragMoves << " moves, "
+                << mib(m_stats.defragBytes) << " MiB moved" << std::endl
+                << "Eviction:       " << m_stats.evictMoves << " moves, "
+                << mib(m_stats.evictBytes) << " MiB evicted, "
+                << m_stats.residentMoves << " moves, "
+                << mib(m_stats.residentBytes) << " MiB made resident" << std::endl
+                << "Relocations:    " << m_stats.tracedRelocations << " in trace (not replayed)" << std::endl
+                << "Shared cache:   " << cacheStats.requestCount << " requests, "
+                << cacheStats.missCount << " misses, "
+                << mib(cacheStats.size) << " MiB cached" << std::endl;
+
+      DxvkMemoryAllocationStats allocationStats;
+      m_allocator->getAllocationStats(allocationStats);
+
+      uint64_t lockTimeNs = 0u;
+
+      std::cout << std::setprecision(0);
+
+      for (uint32_t i = 0; i < g_mockDevice.memory.memoryTypeCount; i++) {
+        const auto& type = allocationStats.memoryTypes[i];
+        lockTimeNs += type.lockTime;
+
+        if (type.lockTime) {
+          std::cout << "  type " << i << " lock:    "
+                    << (double(type.lockTime) / 1.0e3) << " us" << std::endl;
+        }
+      }
+
+      std::cout << "Lock time:      " << (double(lockTimeNs) / 1.0e3) << " us total (replay)" << std::endl
+                << "Call time:      " << (double(m_stats.callTimeNs) / 1.0e3) << " us total, "
+                << (double(m_stats.callTimeMaxNs) / 1.0e3) << " us max (replay)" << std::endl
+                << "                " << (double(m_stats.tracedTimeNs) / 1.0e3) << " us total, "
+                << (double(m_stats.tracedTimeMaxNs) / 1.0e3) << " us max (recorded)" << std::endl;
+    }
+
+  private:
+
+    std::unique_ptr<DxvkMemoryAllocator> m_allocator;
+
+    uint32_t      m_heapCount   = 0u;
+
+    std::array<Heap, VK_MAX_MEMORY_HEAPS> m_heaps = { };
+    std::array<uint32_t, VK_MAX_MEMORY_TYPES> m_typeRemap = { };
+
+    std::unordered_map<uint64_t, DxvkLocalAllocationCache> m_caches;
+    std::unordered_map<uint64_t, ResourceEntry> m_resources;
+    std::unordered_map<uint64_t, Slot>          m_slots;
+    std::unordered_set<uint64_t>                m_ignoredIds;
+
+    uint64_t      m_nextSubmission = 0u;
+
+    Stats         m_stats;
+
+
+    DxvkMemoryTraceEvent remapEvent(const DxvkMemoryTraceEvent& event) const {
+      DxvkMemoryTraceEvent result = event;
+      result.memoryTypeBits = 0u;
+
+      for (uint32_t i : bit::BitMask(event.memoryTypeBits))
+        result.memoryTypeBits |= m_typeRemap[i];
+
+      return result;
+    }
+
+
+    void allocate(const DxvkMemoryTraceEvent& event) {
+      DxvkAllocationModes mode = DxvkAllocationModes(event.mode);
+
+      auto resourceEntry = event.cookie
+        ? m_resources.find(event.cookie)
+        : m_resources.end();
+
+      // Only the allocator itself uses these modes when relocating
+      // resources, applications only ever set NoDedicated.
+      bool relocation = mode.any(
+        DxvkAllocationMode::NoFallback,
+        DxvkAllocationMode::NoAllocation,
+        DxvkAllocationMode::NoDeviceMemory);
+
+      if (relocation && resourceEntry != m_resources.end()) {
+        // The allocator relocated the resource while recording. The replayed
+        // allocator makes its own decisions, so only follow the resource to
+        // its new allocation ID and ignore the free of the old allocation.
+        auto& resource = resourceEntry->second.resource;
+        auto slot = m_slots.find(resource->getCurrentId());
+
+        if (slot != m_slots.end()) {
+          auto node = m_slots.extract(slot);
+          m_ignoredIds.insert(node.key());
+
+          node.key() = event.id;
+          m_slots.insert(std::move(node));
+        } else {
+          m_ignoredIds.insert(event.id);
+        }
+
+        resource->setCurrentId(event.id);
+
+        m_stats.tracedRelocations += 1u;
+        return;
+      }
+
+      Rc<ReplayResource> resource;
+
+      if (resourceEntry != m_resources.end()) {
+        resource = resourceEntry->second.resource;
+      } else if (event.cookie && event.type != DxvkMemoryTraceEventType::Memory
+              && !event.testFlag(DxvkMemoryTraceFlag::Sparse)) {
+        resource = new ReplayResource(*m_allocator, event);
+        resourceEntry = m_resources.insert({ event.cookie, ResourceEntry { resource, 0u } }).first;
+      }
+
+      auto t0 = high_resolution_clock::now();
+      auto allocation = createAllocation(event, resource.ptr());
+      auto t1 = high_resolution_clock::now();
+
+      uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+      m_stats.callTimeNs += ns;
+      m_stats.callTimeMaxNs = std::max(m_stats.callTimeMaxNs, ns);
+
+      if (!allocation) {
+        m_stats.failedCount += 1u;
+        m_ignoredIds.insert(event.id);
+
+        if (resource && !resourceEntry->second.slotCount)
+          m_resources.erase(resourceEntry);
+
+        return;
+      }
+
+      m_stats.allocationCount += 1u;
+
+      if (allocation->flags().test(DxvkAllocationFlag::OwnsMemory))
+        m_stats.dedicatedCount += 1u;
+
+      if ((event.properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+       && !(allocation->getMemoryProperties() & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+        m_stats.fallbackCount += 1u;
+
+      if (resource) {
+        resource->setCurrentId(event.id);
+        resource->assignStorage(*allocation);
+
+        resourceEntry->second.slotCount += 1u;
+      }
+
+      Slot slot = { };
+      slot.allocation = std::move(allocation);
+      slot.cookie = resource ? event.cookie : 0u;
+
+      m_slots.insert_or_assign(event.id, std::move(slot));
+    }
+
+
+    Rc<DxvkResourceAllocation> createAllocation(
+      const DxvkMemoryTraceEvent&       event,
+            ReplayResource*             resource) {
+      DxvkAllocationModes mode = DxvkAllocationModes(event.mode);
+
+      if (event.type == DxvkMemoryTraceEventType::Memory)
+        return m_allocator->createSparsePage();
+
+      if (event.testFlag(DxvkMemoryTraceFlag::Sparse)) {
+        // Page tables need a real device, so only allocate image
+        // metadata the same way the allocator does. Sparse pages
+        // themselves are traced as separate memory events.
+        VkMemoryRequirements requirements = { };
+        requirements.size = event.size;
+        requirements.alignment = SparseMemoryPageSize;
+        requirements.memoryTypeBits = event.memoryTypeBits;
+
+        if (!requirements.size)
+          return nullptr;
+
+        DxvkAllocationInfo allocationInfo = { };
+        allocationInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+        auto allocation = m_allocator->allocateMemory(requirements, allocationInfo);
+
+        if (!allocation) {
+          allocationInfo.properties = 0u;
+          allocation = m_allocator->allocateMemory(requirements, allocationInfo);
+        }
+
+        return allocation;
+      }
+
+      DxvkLocalAllocationCache* cache = nullptr;
+
+      if (event.type == DxvkMemoryTraceEventType::Buffer
+       && event.testFlag(DxvkMemoryTraceFlag::Cached))
+        cache = getAllocationCache(event.usage, event.properties);
+
+      if (resource)
+        return resource->createStorage(mode, cache);
+
+      return createStorage(*m_allocator, event, mode, 0u, cache);
+    }
+
+
+    void freeAllocation(uint64_t id) {
+      if (m_ignoredIds.erase(id))
+        return;
+
+      auto slot = m_slots.find(id);
+
+      if (slot == m_slots.end()) {
+        m_stats.unknownFreeCount += 1u;
+        return;
+      }
+
+      uint64_t cookie = slot->second.cookie;
+      m_slots.erase(slot);
+
+      m_stats.freeCount += 1u;
+
+      if (cookie) {
+        auto entry = m_resources.find(cookie);
+
+        if (!(--entry->second.slotCount)) {
+          // The relocation list may still reference the resource
+          entry->second.resource->setCurrentId(0u);
+          m_resources.erase(entry);
+        }
+      }
+    }
+
+
+    DxvkLocalAllocationCache* getAllocationCache(
+            VkBufferUsageFlags          usage,
+            VkMemoryPropertyFlags       properties) {
+      uint64_t key = (uint64_t(usage) << 32u) | uint64_t(properties);
+      auto entry = m_caches.find(key);
+
+      if (entry == m_caches.end()) {
+        // Contexts use a refill count of 1 for their caches
+        entry = m_caches.emplace(key, m_allocator->createAllocationCache(usage, properties, 1u)).first;
+      }
+
+      return &entry->second;
+    }
+
+
+    void submit() {
+      m_stats.submissionCount += 1u;
+
+      m_allocator->performTimedTasks();
+
+      // Relocate resources the same way the context does
+      auto relocations = m_allocator->pollRelocationList(
+        MaxRelocationsPerSubmission, MaxRelocatedMemoryPerSubmission);
+
+      for (const auto& e : relocations) {
+        auto resource = static_cast<ReplayResource*>(e.resource.ptr());
+        auto storage = resource->relocateStorage(e.mode);
+
+        if (!storage)
+          continue;
+
+        auto slot = m_slots.find(resource->getCurrentId());
+
+        if (slot == m_slots.end())
+          continue;
+
+        VkDeviceSize size = storage->getMemoryInfo().size;
+
+        if (e.mode.test(DxvkAllocationMode::NoDeviceMemory)) {
+          m_stats.evictMoves += 1u;
+          m_stats.evictBytes += size;
+        } else if (e.mode.test(DxvkAllocationMode::NoAllocation)) {
+          m_stats.defragMoves += 1u;
+          m_stats.defragBytes += size;
+        } else {
+          m_stats.residentMoves += 1u;
+          m_stats.residentBytes += size;
+        }
+
+        resource->assignStorage(*storage);
+        slot->second.allocation = std::move(storage);
+      }
+
+      VkDeviceSize allocated = 0u;
+      VkDeviceSize used = 0u;
+
+      for (uint32_t i = 0; i < m_heapCount; i++) {
+        DxvkMemoryStats stats = m_allocator->getMemoryStats(i);
+        allocated += stats.memoryAllocated;
+        used += stats.memoryUsed;
+      }
+
+      if (allocated) {
+        m_stats.fragmentationSum += double(allocated - used) / double(allocated);
+        m_stats.fragmentationCount += 1u;
+      }
+    }
+
+
+    void updatePeakStats() {
+      for (uint32_t i = 0; i < m_heapCount; i++) {
+        auto& heap = m_heaps[i];
+
+        DxvkMemoryStats stats = m_allocator->getMemoryStats(i);
+
+        if (stats.memoryAllocated > heap.peakAllocated) {
+          heap.peakAllocated = stats.memoryAllocated;
+          heap.usedAtPeak = stats.memoryUsed;
+        }
+
+        heap.peakUsed = std::max(heap.peakUsed, stats.memoryUsed);
+      }
+    }
+
+
+    static VkPhysicalDeviceMemoryProperties createLayout(
+      const VkPhysicalDeviceMemoryProperties& recorded,
+      const Options&                          options) {
+      constexpr VkMemoryPropertyFlags DeviceLocal = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+      constexpr VkMemoryPropertyFlags HostCoherent = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+      constexpr VkMemoryPropertyFlags HostCached = HostCoherent | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+      VkPhysicalDeviceMemoryProperties result = { };
+
+      auto addHeap = [&result] (VkDeviceSize size, VkMemoryHeapFlags flags) {
+        result.memoryHeaps[result.memoryHeapCount] = { size, flags };
+        return result.memoryHeapCount++;
+      };
+
+      auto addType = [&result] (VkMemoryPropertyFlags flags, uint32_t heap) {
+        result.memoryTypes[result.memoryTypeCount++] = { flags, heap };
+      };
+
+      VkDeviceSize vramSize = options.vramSize ? options.vramSize : (8ull << 30);
+
+      switch (options.layout) {
+        case Layout::Recorded: {
+          result = recorded;
+
+          // Override size of the primary device-local heap
+          if (options.vramSize) {
+            for (uint32_t i = 0; i < result.memoryTypeCount; i++) {
+              if (result.memoryTypes[i].propertyFlags & DeviceLocal) {
+                result.memoryHeaps[result.memoryTypes[i].heapIndex].size = options.vramSize;
+                break;
+              }
+            }
+          }
+        } break;
+
+        case Layout::Discrete: {
+          uint32_t vram = addHeap(vramSize, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+          uint32_t sysmem = addHeap(options.sysmemSize, 0u);
+          uint32_t bar = addHeap(256ull << 20, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+
+          addType(DeviceLocal, vram);
+          addType(HostCoherent, sysmem);
+          addType(HostCached, sysmem);
+          addType(DeviceLocal | HostCoherent, bar);
+        } break;
+
+        case Layout::ResizableBar: {
+          uint32_t vram = addHeap(vramSize, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+          uint32_t sysmem = addHeap(options.sysmemSize, 0u);
+
+          addType(DeviceLocal, vram);
+          addType(HostCoherent, sysmem);
+          addType(HostCached, sysmem);
+          addType(DeviceLocal | HostCoherent, vram);
+        } break;
+
+        case Layout::Unified: {
+          uint32_t heap = addHeap(options.sysmemSize, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+
+          addType(DeviceLocal, heap);
+          addType(DeviceLocal | HostCoherent, heap);
+          addType(DeviceLocal | HostCached, heap);
+        } break;
+      }
+
+      return result;
+    }
+
+  };
+
+
+  bool parseLayout(const std::string& name, Layout& layout) {
+    if (name == "recorded")
+      layout = Layout::Recorded;
+    else if (name == "discrete")
+      layout = Layout::Discrete;
+    else if (name == "rebar")
+      layout = Layout::ResizableBar;
+    else if (name == "unified")
+      layout = Layout::Unified;
+    else
+      return false;
+
+    return true;
+  }
+
+
+  bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+      std::string arg = argv[i];
+
+      if (arg == "--no-defrag") {
+        options.defrag = false;
+      } else if (i + 1 < argc && arg == "--layout") {
+        if (!parseLayout(argv[++i], options.layout))
+          return false;
+      } else if (i + 1 < argc && arg == "--vram") {
+        options.vramSize = VkDeviceSize(std::strtoull(argv[++i], nullptr, 10)) << 20;
+      } else if (i + 1 < argc && arg == "--sysmem") {
+        options.sysmemSize = VkDeviceSize(std::strtoull(argv[++i], nullptr, 10)) << 20;
+      } else if (i + 1 < argc && arg == "--budget") {
+        options.maxBudget = VkDeviceSize(std::strtoull(argv[++i], nullptr, 10)) << 20;
+      } else if (options.path.empty() && arg[0] != '-') {
+        options.path = arg;
+      } else {
+        return false;
+      }
+    }
+
+    return !options.path.empty();
+  }
+
+
+  int replayTrace(const Options& options) {
+    DxvkMemoryTraceReader reader;
+
+    if (!reader.open(options.path)) {
+      std::cerr << "Failed to open memory trace: " << options.path << std::endl;
+      return 1;
+    }
+
+    Replayer replayer(reader.header(), options);
+    DxvkMemoryTraceEvent event;
+
+    while (reader.readEvent(event))
+      replayer.processEvent(event);
+
+    replayer.printReport();
+    return 0;
+  }
+
+}
+
+
+int main(int argc, char** argv) {
+  dxvk::replay::Options options;
+
+  if (!dxvk::replay::parseOptions(argc, argv, options)) {
+    std::cerr << "Usage: " << argv[0] << " [options] <file.dxvk-memtrace>" << std::endl
+              << "  --layout <recorded|discrete|rebar|unified>" << std::endl
+              << "                     Heap layout to replay against" << std::endl
+              << "  --vram <MiB>       Size of the primary video memory heap" << std::endl
+              << "  --sysmem <MiB>     Size of the system memory heap" << std::endl
+              << "  --budget <MiB>     Maximum video memory budget" << std::endl
+              << "  --no-defrag        Disable defragmentation" << std::endl;
+    return 1;
+  }
+
+  return dxvk::replay::replayTrace(options);
+}
@@ -0,0 +1,156 @@
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+#include "../dxvk/dxvk_telemetry.h"
+
+namespace dxvk {
+
+  /// Column names for stat counters, in the order of \c DxvkStatCounter
+  static const char* const g_counterNames[] = {
+    "draw_calls",
+    "draws_merged",
+    "dispatch_calls",
+    "render_passes",
+    "barriers",
+    "pipelines_graphics",
+    "pipelines_library",
+    "pipelines_compute",
+    "pipeline_tasks_done",
+    "pipeline_tasks_total",
+    "submissions",
+    "presents",
+    "gpu_sync_count",
+    "gpu_sync_us",
+    "gpu_idle_us",
+    "cs_sync_count",
+    "cs_sync_us",
+    "cs_idle_us",
+    "cs_chunks",
+    "cs_enqueue_us",
+    "descriptor_pools",
+    "descriptor_sets",
+    "descriptor_heaps",
+    "descriptor_heap_size",
+    "descriptor_heap_used",
+    "descriptor_copy_busy_us",
+    "shader_cache_hits",
+    "shader_cache_misses",
+    "shader_cache_us",
+  };
+
+  static_assert(std::size(g_counterNames) == size_t(DxvkStatCounter::NumCounters));
+
+
+  void printCsvHeader(uint32_t heapCount) {
+    std::cout << "sequence,frame_id,timestamp_ns";
+
+    for (auto name : g_counterNames)
+      std::cout << "," << name;
+
+    std::cout << ",frame_latency_us,sleep_duration_us"
+              << ",cache_requests,cache_misses,cache_size";
+
+    for (uint32_t i = 0; i < heapCount; i++) {
+      std::cout << ",heap" << i << "_allocated"
+                << ",heap" << i << "_used"
+                << ",heap" << i << "_budget";
+    }
+
+    std::cout << std::endl;
+  }
+
+
+  void printCsvFrame(const DxvkTelemetryFrame& frame, uint32_t heapCount) {
+    std::cout << frame.sequence << "," << frame.frameId << "," << frame.timestamp;
+
+    for (auto value : frame.counters)
+      std::cout << "," << value;
+
+    std::cout << "," << frame.frameLatency << "," << frame.sleepDuration
+              << "," << frame.cacheRequests << "," << frame.cacheMisses << "," << frame.cacheSize;
+
+    for (uint32_t i = 0; i < heapCount; i++) {
+      const auto& heap = frame.heaps[i];
+
+      std::cout << "," << heap.allocated
+                << "," << heap.used
+                << "," << heap.budget;
+    }
+
+    std::cout << std::endl;
+  }
+
+
+  int exportCsv(const std::string& path, bool follow) {
+    DxvkTelemetryReader reader;
+
+    if (!reader.open(path)) {
+      std::cerr << "Failed to open telemetry file: " << path << std::endl;
+      return 1;
+    }
+
+    // Start at the oldest frame that is still in the ring
+    const auto& header = reader.header();
+
+    uint64_t sequence = header.frameCount > header.frameCapacity
+      ? header.frameCount - header.frameCapacity : 0u;
+
+    DxvkTelemetryFrame frame = { };
+
+    // Heap count is known once the first frame has been read,
+    // so defer writing the header until then.
+    uint32_t heapCount = 0u;
+    bool hasHeader = false;
+
+    while (true) {
+      while (sequence < header.frameCount) {
+        if (reader.readFrame(sequence, frame)) {
+          if (!hasHeader) {
+            heapCount = frame.heapCount;
+            hasHeader = true;
+
+            printCsvHeader(heapCount);
+          }
+
+          printCsvFrame(frame, heapCount);
+        } else {
+          // Frames below the published frame count only become unreadable
+          // once the writer wraps around and starts overwriting the slot
+          std::cerr << "Skipped overwritten frame " << sequence << std::endl;
+        }
+
+        sequence += 1u;
+      }
+
+      if (!follow)
+        return 0;
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+      if (!reader.refresh()) {
+        std::cerr << "Failed to read telemetry file: " << path << std::endl;
+        return 1;
+      }
+    }
+  }
+
+}
+
+
+int main(int argc, char** argv) {
+  std::string mode = argc > 1 ? argv[1] : "";
+
+  if (mode == "csv" && argc == 3)
+    return dxvk::exportCsv(argv[2], false);
+
+  if (mode == "follow" && argc == 3)
+    return dxvk::exportCsv(argv[2], true);
+
+  std::cerr << "Usage:" << std::endl
+            << "  " << argv[0] << " csv <file.dxvk-telemetry>" << std::endl
+            << "  " << argv[0] << " follow <file.dxvk-telemetry>" << std::endl;
+  return 1;
+}
@@ -2,10 +2,10 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
-#include <regex>
 #include <utility>
 
 #include "config.h"
+#include "config_pattern.h"
 
 #include "../log/log.h"
 
@@ -1512,18 +1512,18 @@ namespace dxvk {
 
 
   const Config* findProfile(const ProfileList& profiles, const std::string& appName) {
+    // Patterns are matched case-insensitively, lower-case the
+    // app name once rather than once per pattern and character
+    std::string lowerName = appName;
+
+    for (auto& ch : lowerName) {
+      if (ch >= 'A' && ch <= 'Z')
+        ch += 'a' - 'A';
+    }
+
     auto appConfig = std::find_if(profiles.begin(), profiles.end(),
-      [&appName] (const std::pair<const char*, Config>& pair) {
-        // With certain locales, regex parsing will simply crash. Using regex::imbue
-        // does not resolve this; only the global locale seems to matter here. Catch
-        // bad_alloc errors to work around this for now.
-        try {
-          std::regex expr(pair.first, std::regex::extended | std::regex::icase);
-          return std::regex_search(appName, expr);
-        } catch (const std::bad_alloc& e) {
-          Logger::err(str::format("Failed to parse regular expression: ", pair.first));
-          return false;
-        }
+      [&lowerName] (const std::pair<const char*, Config>& pair) {
+        return ConfigPattern(pair.first).search(lowerName);
       });
 
     return appConfig != profiles.end()
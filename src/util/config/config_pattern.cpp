@@ -0,0 +1,395 @@
+#include "config_pattern.h"
+
+#include "../log/log.h"
+
+#include "../util_string.h"
+
+namespace dxvk {
+
+  struct ConfigPattern::Node {
+    enum class Type : uint8_t {
+      Empty,
+      Char,
+      Any,
+      Class,
+      Begin,
+      End,
+      Concatenation,
+      Alternation,
+      Optional,
+      Star,
+      Plus,
+    };
+
+    Type              type  = Type::Empty;
+    uint8_t           ch    = 0u;
+    uint32_t          cls   = 0u;
+    std::vector<Node> children;
+  };
+
+
+  ConfigPattern::ConfigPattern() {
+
+  }
+
+
+  ConfigPattern::ConfigPattern(const char* pattern) {
+    const char* p = pattern;
+    Node root;
+
+    if (!parseAlternation(p, root) || *p) {
+      Logger::err(str::format("Failed to parse pattern: ", pattern));
+      return;
+    }
+
+    compile(root);
+    emit(OpCode::Match);
+  }
+
+
+  ConfigPattern::~ConfigPattern() {
+
+  }
+
+
+  bool ConfigPattern::search(const std::string& str) const {
+    if (m_program.empty())
+      return false;
+
+    // Each instruction is added to a thread list at most once per
+    // input position, tracked via a generation counter per pc.
+    std::vector<uint32_t> currList;
+    std::vector<uint32_t> nextList;
+    std::vector<uint32_t> mark(m_program.size(), 0u);
+
+    currList.reserve(m_program.size());
+    nextList.reserve(m_program.size());
+
+    uint32_t generation = 1u;
+    addThread(currList, mark, generation, 0u, str, 0u);
+
+    for (size_t pos = 0u; ; pos++) {
+      for (uint32_t pc : currList) {
+        if (m_program[pc].op == OpCode::Match)
+          return true;
+      }
+
+      if (pos == str.size())
+        return false;
+
+      uint8_t ch = uint8_t(str[pos]);
+
+      generation += 1u;
+      nextList.clear();
+
+      for (uint32_t pc : currList) {
+        const auto& inst = m_program[pc];
+
+        bool advance = (inst.op == OpCode::Any)
+                    || (inst.op == OpCode::Char && inst.ch == ch)
+                    || (inst.op == OpCode::Class && testClass(m_classes[inst.x], ch));
+
+        if (advance)
+          addThread(nextList, mark, generation, pc + 1u, str, pos + 1u);
+      }
+
+      // The pattern is not anchored, so a match
+      // can start at any position in the string
+      addThread(nextList, mark, generation, 0u, str, pos + 1u);
+
+      std::swap(currList, nextList);
+    }
+  }
+
+
+  bool ConfigPattern::parseAlternation(const char*& p, Node& node) {
+    Node branch;
+
+    if (!parseConcatenation(p, branch))
+      return false;
+
+    if (*p != '|') {
+      node = std::move(branch);
+      return true;
+    }
+
+    node.type = Node::Type::Alternation;
+    node.children.push_back(std::move(branch));
+
+    while (*p == '|') {
+      p += 1;
+
+      if (!parseConcatenation(p, node.children.emplace_back()))
+        return false;
+    }
+
+    return true;
+  }
+
+
+  bool ConfigPattern::parseConcatenation(const char*& p, Node& node) {
+    node.type = Node::Type::Concatenation;
+
+    while (*p && *p != '|' && *p != ')') {
+      if (!parseRepetition(p, node.children.emplace_back()))
+        return false;
+    }
+
+    return true;
+  }
+
+
+  bool ConfigPattern::parseRepetition(const char*& p, Node& node) {
+    if (!parseAtom(p, node))
+      return false;
+
+    while (*p == '?' || *p == '*' || *p == '+') {
+      Node child = std::move(node);
+
+      node = Node();
+      node.children.push_back(std::move(child));
+
+      switch (*(p++)) {
+        case '?': node.type = Node::Type::Optional; break;
+        case '*': node.type = Node::Type::Star; break;
+        case '+': node.type = Node::Type::Plus; break;
+      }
+    }
+
+    return true;
+  }
+
+
+  bool ConfigPattern::parseAtom(const char*& p, Node& node) {
+    switch (*p) {
+      case '(':
+        p += 1;
+
+        if (!parseAlternation(p, node) || *p != ')')
+          return false;
+
+        p += 1;
+        return true;
+
+      case '[':
+        p += 1;
+        return parseClass(p, node);
+
+      case '.':
+        p += 1;
+        node.type = Node::Type::Any;
+        return true;
+
+      case '^':
+        p += 1;
+        node.type = Node::Type::Begin;
+        return true;
+
+      case '$':
+        p += 1;
+        node.type = Node::Type::End;
+        return true;
+
+      case '\\':
+        p += 1;
+
+        if (!*p)
+          return false;
+
+        node.type = Node::Type::Char;
+        node.ch = toLower(uint8_t(*(p++)));
+        return true;
+
+      // Quantifiers without an operand, as well
+      // as bounded repetitions are not supported
+      case '?':
+      case '*':
+      case '+':
+      case '{':
+      case '\0':
+        return false;
+
+      default:
+        node.type = Node::Type::Char;
+        node.ch = toLower(uint8_t(*(p++)));
+        return true;
+    }
+  }
+
+
+  bool ConfigPattern::parseClass(const char*& p, Node& node) {
+    CharClass cls = { };
+
+    bool negate = *p == '^';
+
+    if (negate)
+      p += 1;
+
+    // A closing bracket is treated as a literal
+    // if it is the first character in the set
+    bool first = true;
+
+    while (*p != ']' || first) {
+      if (!*p)
+        return false;
+
+      uint8_t lo = uint8_t(*(p++));
+      uint8_t hi = lo;
+
+      if (p[0] == '-' && p[1] && p[1] != ']') {
+        hi = uint8_t(p[1]);
+        p += 2;
+      }
+
+      if (lo > hi)
+        return false;
+
+      for (uint32_t ch = lo; ch <= hi; ch++)
+        setClass(cls, toLower(uint8_t(ch)));
+
+      first = false;
+    }
+
+    p += 1;
+
+    if (negate) {
+      for (auto& mask : cls)
+        mask = ~mask;
+    }
+
+    node.type = Node::Type::Class;
+    node.cls = uint32_t(m_classes.size());
+
+    m_classes.push_back(cls);
+    return true;
+  }
+
+
+  void ConfigPattern::compile(const Node& node) {
+    switch (node.type) {
+      case Node::Type::Empty:
+        break;
+
+      case Node::Type::Char:
+        emit(OpCode::Char, node.ch);
+        break;
+
+      case Node::Type::Any:
+        emit(OpCode::Any);
+        break;
+
+      case Node::Type::Class:
+        emit(OpCode::Class, 0u, node.cls);
+        break;
+
+      case Node::Type::Begin:
+        emit(OpCode::AssertBegin);
+        break;
+
+      case Node::Type::End:
+        emit(OpCode::AssertEnd);
+        break;
+
+      case Node::Type::Concatenation:
+        for (const auto& child : node.children)
+          compile(child);
+        break;
+
+      case Node::Type::Alternation: {
+        std::vector<uint32_t> jumps;
+
+        for (size_t i = 0; i + 1u < node.children.size(); i++) {
+          uint32_t split = emit(OpCode::Split);
+          m_program[split].x = split + 1u;
+
+          compile(node.children[i]);
+          jumps.push_back(emit(OpCode::Jump));
+
+          m_program[split].y = uint32_t(m_program.size());
+        }
+
+        compile(node.children.back());
+
+        for (uint32_t jump : jumps)
+          m_program[jump].x = uint32_t(m_program.size());
+      } break;
+
+      case Node::Type::Optional: {
+        uint32_t split = emit(OpCode::Split);
+        m_program[split].x = split + 1u;
+
+        compile(node.children.front());
+        m_program[split].y = uint32_t(m_program.size());
+      } break;
+
+      case Node::Type::Star: {
+        uint32_t split = emit(OpCode::Split);
+        m_program[split].x = split + 1u;
+
+        compile(node.children.front());
+        emit(OpCode::Jump, 0u, split);
+
+        m_program[split].y = uint32_t(m_program.size());
+      } break;
+
+      case Node::Type::Plus: {
+        uint32_t start = uint32_t(m_program.size());
+        compile(node.children.front());
+
+        uint32_t split = emit(OpCode::Split, 0u, start);
+        m_program[split].y = split + 1u;
+      } break;
+    }
+  }
+
+
+  uint32_t ConfigPattern::emit(OpCode op, uint8_t ch, uint32_t x, uint32_t y) {
+    auto& inst = m_program.emplace_back();
+    inst.op = op;
+    inst.ch = ch;
+    inst.x = x;
+    inst.y = y;
+    return uint32_t(m_program.size() - 1u);
+  }
+
+
+  void ConfigPattern::addThread(
+          std::vector<uint32_t>&  list,
+          std::vector<uint32_t>&  mark,
+          uint32_t                generation,
+          uint32_t                pc,
+    const std::string&            str,
+          size_t                  pos) const {
+    if (mark[pc] == generation)
+      return;
+
+    mark[pc] = generation;
+
+    const auto& inst = m_program[pc];
+
+    switch (inst.op) {
+      case OpCode::Jump:
+        addThread(list, mark, generation, inst.x, str, pos);
+        break;
+
+      case OpCode::Split:
+        addThread(list, mark, generation, inst.x, str, pos);
+        addThread(list, mark, generation, inst.y, str, pos);
+        break;
+
+      case OpCode::AssertBegin:
+        if (pos == 0u)
+          addThread(list, mark, generation, pc + 1u, str, pos);
+        break;
+
+      case OpCode::AssertEnd:
+        if (pos == str.size())
+          addThread(list, mark, generation, pc + 1u, str, pos);
+        break;
+
+      default:
+        list.push_back(pc);
+    }
+  }
+
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief App profile pattern
+   *
+   * Compiled, case-insensitive matcher for the subset of POSIX
+   * extended regular expressions used by built-in app profiles:
+   * Literals, escaped characters, \c . wildcards, bracket
+   * expressions with ranges, groups with alternation, the
+   * \c ? \c * \c + quantifiers, and the \c ^ and \c $ anchors.
+   *
+   * Patterns are compiled into a small instruction list and
+   * matched by simulating all possible paths in lockstep, so
+   * matching runs in linear time with respect to the input
+   * length. Compiling a pattern does not allocate per input
+   * character and does not depend on the global locale.
+   */
+  class ConfigPattern {
+
+  public:
+
+    ConfigPattern();
+
+    /**
+     * \brief Compiles pattern
+     *
+     * If the pattern cannot be parsed, the
+     * resulting object will never match.
+     * \param [in] pattern Pattern string
+     */
+    explicit ConfigPattern(const char* pattern);
+
+    ~ConfigPattern();
+
+    /**
+     * \brief Checks whether pattern is valid
+     * \returns \c true if the pattern was compiled successfully
+     */
+    bool isValid() const {
+      return !m_program.empty();
+    }
+
+    /**
+     * \brief Searches string for a match
+     *
+     * Equivalent to \c std::regex_search, i.e. the pattern
+     * may match any substring of the input. The input is
+     * expected to be converted to lower case already.
+     * \param [in] str Lower-case input string
+     * \returns \c true if any substring matches
+     */
+    bool search(const std::string& str) const;
+
+  private:
+
+    enum class OpCode : uint8_t {
+      Char,
+      Any,
+      Class,
+      Split,
+      Jump,
+      AssertBegin,
+      AssertEnd,
+      Match,
+    };
+
+    struct Instruction {
+      OpCode    op  = OpCode::Match;
+      uint8_t   ch  = 0u;
+      uint32_t  x   = 0u;
+      uint32_t  y   = 0u;
+    };
+
+    using CharClass = std::array<uint64_t, 4>;
+
+    std::vector<Instruction>  m_program;
+    std::vector<CharClass>    m_classes;
+
+    struct Node;
+
+    bool parseAlternation(const char*& p, Node& node);
+
+    bool parseConcatenation(const char*& p, Node& node);
+
+    bool parseRepetition(const char*& p, Node& node);
+
+    bool parseAtom(const char*& p, Node& node);
+
+    bool parseClass(const char*& p, Node& node);
+
+    void compile(const Node& node);
+
+    uint32_t emit(OpCode op, uint8_t ch = 0u, uint32_t x = 0u, uint32_t y = 0u);
+
+    void addThread(
+            std::vector<uint32_t>&  list,
+            std::vector<uint32_t>&  mark,
+            uint32_t                generation,
+            uint32_t                pc,
+      const std::string&            str,
+            size_t                  pos) const;
+
+    static bool testClass(const CharClass& cls, uint8_t ch) {
+      return (cls[ch >> 6] >> (ch & 63)) & 1u;
+    }
+
+    static void setClass(CharClass& cls, uint8_t ch) {
+      cls[ch >> 6] |= uint64_t(1u) << (ch & 63);
+    }
+
+    static uint8_t toLower(uint8_t ch) {
+      return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+    }
+
+  };
+
+}
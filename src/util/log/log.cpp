@@ -3,6 +3,8 @@
 #include "log.h"
 
 #include "../util_env.h"
+#include "../util_likely.h"
+#include "../util_string.h"
 
 namespace dxvk {
   
@@ -12,112 +14,403 @@ namespace dxvk {
   }
   
   
-  Logger::~Logger() { }
+  Logger::~Logger() {
+    // During process shutdown, the writer thread has already
+    // been terminated and may have left locks in a bad state.
+    if (this_thread::isInModuleDetachment())
+      return;
+
+    { std::lock_guard lock(m_mutex);
+      m_stopped = true;
+      m_cond.notify_one();
+    }
+
+    // On Windows, the writer thread keeps the module loaded while
+    // it is running, so it must have exited if we get here.
+#ifndef _WIN32
+    if (m_thread.joinable())
+      m_thread.join();
+#endif
+
+    // Write out anything the writer thread did not get to
+    std::lock_guard writeLock(m_writeMutex);
+    std::unique_lock lock(m_mutex);
+
+    reportSuppressedLocked(high_resolution_clock::now(), true);
+
+    std::vector<std::string> pending = std::move(m_queue);
+    m_queue.clear();
+
+    lock.unlock();
+
+    writeLines(pending);
+  }
   
   
   void Logger::trace(const std::string& message) {
-    s_instance.emitMsg(LogLevel::Trace, message);
+    s_instance.emitMsg(LogLevel::Trace, message, LogSource());
   }
   
   
   void Logger::debug(const std::string& message) {
-    s_instance.emitMsg(LogLevel::Debug, message);
+    s_instance.emitMsg(LogLevel::Debug, message, LogSource());
   }
   
   
   void Logger::info(const std::string& message) {
-    s_instance.emitMsg(LogLevel::Info, message);
+    s_instance.emitMsg(LogLevel::Info, message, LogSource());
   }
   
   
-  void Logger::warn(const std::string& message) {
-    s_instance.emitMsg(LogLevel::Warn, message);
+  void Logger::warn(const std::string& message, const char* file, uint32_t line) {
+    s_instance.emitMsg(LogLevel::Warn, message, LogSource { file, line });
   }
   
   
-  void Logger::err(const std::string& message) {
-    s_instance.emitMsg(LogLevel::Error, message);
+  void Logger::err(const std::string& message, const char* file, uint32_t line) {
+    s_instance.emitMsg(LogLevel::Error, message, LogSource { file, line });
   }
   
   
-  void Logger::log(LogLevel level, const std::string& message) {
-    s_instance.emitMsg(level, message);
+  void Logger::log(LogLevel level, const std::string& message, const char* file, uint32_t line) {
+    s_instance.emitMsg(level, message, LogSource { file, line });
   }
   
   
-  void Logger::emitMsg(LogLevel level, const std::string& message) {
-    if (level >= m_minLevel) {
-      std::lock_guard<dxvk::mutex> lock(m_mutex);
-      
-      static std::array<const char*, 5> s_prefixes
-        = {{ "trace: ", "debug: ", "info:  ", "warn:  ", "err:   " }};
-      
-      const char* prefix = s_prefixes.at(static_cast<uint32_t>(level));
+  void Logger::emitMsg(LogLevel level, const std::string& message, LogSource source) {
+    if (level < m_minLevel)
+      return;
+
+    static std::array<const char*, 5> s_prefixes
+      = {{ "trace: ", "debug: ", "info:  ", "warn:  ", "err:   " }};
+
+    const char* prefix = s_prefixes.at(static_cast<uint32_t>(level));
+
+    std::string lines = formatMsg(prefix, message);
+
+    if (lines.empty())
+      return;
+
+    auto time = high_resolution_clock::now();
+
+    // Only suppress warnings and errors, which are the messages that
+    // tend to get spammed from hot paths. Info messages are commonly
+    // emitted in loops during initialization, and debug and trace
+    // messages are opt-in and expected to be verbose.
+    bool rateLimit = level >= LogLevel::Warn && source.file;
+
+    if (level >= LogLevel::Error) {
+      // Errors often precede a crash, so write them as well as any
+      // pending messages immediately rather than on the writer thread.
+      std::lock_guard writeLock(m_writeMutex);
+      std::unique_lock lock(m_mutex);
+
+      if (!std::exchange(m_initialized, true))
+        initializeLocked();
+
+      if (rateLimit && !checkRateLimitLocked(source, prefix, message, time))
+        return;
+
+      std::vector<std::string> pending = std::move(m_queue);
+      m_queue.clear();
+
+      lock.unlock();
+
+      pending.push_back(std::move(lines));
+      writeLines(pending);
+    } else {
+      std::unique_lock lock(m_mutex);
+
+      if (!std::exchange(m_initialized, true))
+        initializeLocked();
+
+      if (rateLimit && !checkRateLimitLocked(source, prefix, message, time))
+        return;
+
+      if (m_queue.size() >= MaxQueuedMessages) {
+        m_dropped += 1u;
+        return;
+      }
+
+      m_queue.push_back(std::move(lines));
+
+      // Once the logger is being destroyed or the module is being
+      // detached, writer threads can no longer be used safely, so
+      // write pending messages from the calling thread instead.
+      bool writeDirect = m_stopped || this_thread::isInModuleDetachment();
+
+      if (!writeDirect && !m_writerActive)
+        writeDirect = !startWriterLocked();
 
-      if (!std::exchange(m_initialized, true)) {
+      if (unlikely(writeDirect)) {
+        std::vector<std::string> pending = std::move(m_queue);
+        m_queue.clear();
+
+        lock.unlock();
+
+        std::lock_guard writeLock(m_writeMutex);
+        writeLines(pending);
+        return;
+      }
+
+      m_cond.notify_one();
+    }
+  }
+
+
+  void Logger::initializeLocked() {
+    // No messages can have been written at this point,
+    // so there is no need to lock the output streams.
 #ifdef _WIN32
-        HMODULE ntdll = GetModuleHandleA("ntdll.dll");
+    HMODULE ntdll = GetModuleHandleA("ntdll.dll");
 
-        if (ntdll)
-          m_wineLogOutput = reinterpret_cast<PFN_wineLogOutput>(GetProcAddress(ntdll, "__wine_dbg_output"));
+    if (ntdll)
+      m_wineLogOutput = reinterpret_cast<PFN_wineLogOutput>(GetProcAddress(ntdll, "__wine_dbg_output"));
 #endif
-        auto path = getFileName(m_fileName);
+    auto path = getFileName(m_fileName);
+
+    if (!path.empty())
+      m_fileStream = std::ofstream(str::topath(path.c_str()).c_str());
+  }
+
+
+  bool Logger::checkRateLimitLocked(
+          LogSource           source,
+          const char*         prefix,
+    const std::string&        message,
+          high_resolution_clock::time_point time) {
+    auto entry = m_rateLimit.find(source);
+
+    if (entry == m_rateLimit.end()) {
+      // If there are too many distinct call sites, simply
+      // don't rate-limit any new ones until some expire
+      if (m_rateLimit.size() < RateLimitEntries) {
+        auto& e = m_rateLimit[source];
+        e.windowStart = time;
+        e.prefix = prefix;
+        e.count = 1u;
+      }
 
-        if (!path.empty())
-          m_fileStream = std::ofstream(str::topath(path.c_str()).c_str());
+      return true;
+    }
+
+    auto& e = entry->second;
+
+    if (time - e.windowStart >= RateLimitInterval) {
+      if (e.suppressed) {
+        m_queue.push_back(formatMsg(e.prefix, str::format(
+          "Suppressed ", e.suppressed, " similar messages, last: ", e.message)));
       }
 
-      std::stringstream stream(message);
-      std::string line;
+      e.windowStart = time;
+      e.count = 0u;
+      e.suppressed = 0u;
+    }
+
+    if (++e.count <= RateLimitCount)
+      return true;
+
+    // Keep the most recent suppressed message around so that
+    // the report gives an idea of what was being suppressed
+    e.prefix = prefix;
+    e.message = message;
+    e.suppressed += 1u;
+    return false;
+  }
+
 
-      while (std::getline(stream, line, '\n')) {
-        std::stringstream outstream;
-        outstream << prefix << line << std::endl;
+  void Logger::reportSuppressedLocked(
+          high_resolution_clock::time_point time,
+          bool                force) {
+    for (auto i = m_rateLimit.begin(); i != m_rateLimit.end(); ) {
+      auto& e = i->second;
 
-        std::string adjusted = outstream.str();
+      if (force || time - e.windowStart >= RateLimitInterval) {
+        if (e.suppressed) {
+          m_queue.push_back(formatMsg(e.prefix, str::format(
+            "Suppressed ", e.suppressed, " similar messages, last: ", e.message)));
+        }
 
-        if (!adjusted.empty()) {
+        i = m_rateLimit.erase(i);
+      } else {
+        i++;
+      }
+    }
+
+    if (m_dropped) {
+      m_queue.push_back(formatMsg("warn:  ", str::format(
+        "Dropped ", m_dropped, " log messages")));
+      m_dropped = 0u;
+    }
+  }
+
+
+  bool Logger::startWriterLocked() {
 #ifdef _WIN32
-          if (m_wineLogOutput) {
-            // __wine_dbg_output tries to buffer lines up to 1020 characters
-            // including null terminator, and will cause a hang if we submit
-            // anything longer than that even in consecutive calls. Work
-            // around this by splitting long lines into multiple lines.
-            constexpr size_t MaxDebugBufferLength = 1018;
-
-            if (adjusted.size() <= MaxDebugBufferLength) {
-              m_wineLogOutput(adjusted.c_str());
-            } else {
-              std::array<char, MaxDebugBufferLength + 2u> buffer;
-
-              for (size_t i = 0; i < adjusted.size(); i += MaxDebugBufferLength) {
-                size_t size = std::min(adjusted.size() - i, MaxDebugBufferLength);
-
-                std::strncpy(buffer.data(), &adjusted[i], size);
-                if (buffer[size - 1u] != '\n')
-                  buffer[size++] = '\n';
-
-                buffer[size] = '\0';
-                m_wineLogOutput(buffer.data());
-              }
-            }
-          }
+    // The writer thread cannot be joined while the module gets unloaded,
+    // since thread exit needs the loader lock. Instead, hold a reference
+    // to the module while the thread is running, which the thread drops
+    // via FreeLibraryAndExitThread once it has nothing left to write.
+    HMODULE module = nullptr;
+
+    if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+        reinterpret_cast<LPCWSTR>(&s_instance), &module))
+      return false;
+
+    HANDLE thread = ::CreateThread(nullptr, 0,
+      &Logger::runWriterThread, module, 0, nullptr);
+
+    if (!thread) {
+      FreeLibrary(module);
+      return false;
+    }
 
-          // Don't log anything to stderr if we're not on wine. Usually games are
-          // compiled as gui apps anyway, and emitting anything to the standard
-          // output streams can crash certain games.
+    CloseHandle(thread);
 #else
-          // For native builds, logging to stderr should be fine.
-          std::cerr << adjusted;
+    // A previous writer thread may still be exiting
+    if (m_thread.joinable())
+      m_thread.join();
+
+    m_thread = dxvk::thread([this] { runWriter(); });
+#endif
+
+    m_writerActive = true;
+    return true;
+  }
+
+
+#ifdef _WIN32
+  DWORD WINAPI Logger::runWriterThread(void* module) {
+    s_instance.runWriter();
+
+    FreeLibraryAndExitThread(reinterpret_cast<HMODULE>(module), 0);
+  }
 #endif
+
+
+  void Logger::runWriter() {
+    env::setThreadName("dxvk-log");
+
+    std::vector<std::string> lines;
+    bool stop = false;
+
+    while (!stop) {
+      std::unique_lock lock(m_mutex);
+
+      auto pred = [this] {
+        return m_stopped || !m_queue.empty();
+      };
+
+      // Only wake up periodically if there are suppressed messages
+      // that may need to be reported, and exit if there is nothing
+      // to do for a while so that the module can be unloaded.
+      if (m_rateLimit.empty() && !m_dropped) {
+        if (!m_cond.wait_for(lock, WriterIdleTimeout, pred)) {
+          m_writerActive = false;
+          return;
         }
+      } else {
+        m_cond.wait_for(lock, RateLimitInterval, pred);
+      }
+
+      lock.unlock();
+
+      // Lock order must match error messages written
+      // from the calling thread in order to avoid
+      // reordering of messages
+      std::lock_guard writeLock(m_writeMutex);
+
+      lock.lock();
+
+      stop = m_stopped;
+
+      reportSuppressedLocked(high_resolution_clock::now(), stop);
+      std::swap(lines, m_queue);
 
-        if (m_fileStream) {
-          m_fileStream << adjusted;
-          m_fileStream.flush();
+      if (stop)
+        m_writerActive = false;
+
+      lock.unlock();
+
+      writeLines(lines);
+      lines.clear();
+    }
+  }
+
+
+  void Logger::writeLines(
+    const std::vector<std::string>& lines) {
+    for (const auto& adjusted : lines) {
+#ifdef _WIN32
+      if (m_wineLogOutput) {
+        // __wine_dbg_output tries to buffer lines up to 1020 characters
+        // including null terminator, and will cause a hang if we submit
+        // anything longer than that even in consecutive calls. Work
+        // around this by splitting long lines into multiple lines.
+        constexpr size_t MaxDebugBufferLength = 1018;
+
+        size_t lineStart = 0u;
+
+        while (lineStart < adjusted.size()) {
+          size_t lineEnd = adjusted.find('\n', lineStart) + 1u;
+          size_t lineSize = lineEnd - lineStart;
+
+          for (size_t i = 0; i < lineSize; i += MaxDebugBufferLength) {
+            std::array<char, MaxDebugBufferLength + 2u> buffer;
+            size_t size = std::min(lineSize - i, MaxDebugBufferLength);
+
+            std::strncpy(buffer.data(), &adjusted[lineStart + i], size);
+            if (buffer[size - 1u] != '\n')
+              buffer[size++] = '\n';
+
+            buffer[size] = '\0';
+            m_wineLogOutput(buffer.data());
+          }
+
+          lineStart = lineEnd;
         }
       }
+
+      // Don't log anything to stderr if we're not on wine. Usually games are
+      // compiled as gui apps anyway, and emitting anything to the standard
+      // output streams can crash certain games.
+#else
+      // For native builds, logging to stderr should be fine.
+      std::cerr << adjusted;
+#endif
+
+      if (m_fileStream)
+        m_fileStream << adjusted;
+    }
+
+    // Flush once per batch rather than once per line
+    if (m_fileStream && !lines.empty())
+      m_fileStream.flush();
+  }
+
+
+  std::string Logger::formatMsg(
+          const char*         prefix,
+    const std::string&        message) {
+    std::string result;
+    size_t lineStart = 0u;
+
+    // Prefix each line of the message, but skip the
+    // final empty line if the message ends in a newline
+    while (lineStart < message.size()) {
+      size_t lineEnd = message.find('\n', lineStart);
+
+      if (lineEnd == std::string::npos)
+        lineEnd = message.size();
+
+      result.append(prefix);
+      result.append(message, lineStart, lineEnd - lineStart);
+      result.push_back('\n');
+
+      lineStart = lineEnd + 1u;
     }
+
+    return result;
   }
   
   
@@ -4,8 +4,11 @@
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "../thread.h"
+#include "../util_time.h"
 
 namespace dxvk {
   
@@ -22,14 +25,60 @@ namespace dxvk {
   using PFN_wineLogOutput = int (__cdecl *)(const char *);
 #endif
 
+  /**
+   * \brief Log message call site
+   *
+   * Used as a key for rate limiting, so that messages
+   * emitted from the same place in the code are treated
+   * as repeats even if they contain varying data.
+   */
+  struct LogSource {
+    const char* file = nullptr;
+    uint32_t    line = 0u;
+
+    bool operator == (const LogSource& other) const {
+      return file == other.file && line == other.line;
+    }
+  };
+
+  struct LogSourceHash {
+    size_t operator () (const LogSource& source) const {
+      return std::hash<const void*>()(source.file) ^ (size_t(source.line) * 0x9e3779b9u);
+    }
+  };
+
   /**
    * \brief Logger
    * 
    * Logger for one DLL. Creates a text file and
    * writes all log messages to that file.
+   *
+   * Messages below the error level are written on a background
+   * thread so that slow output does not stall the calling thread.
+   * That thread exits when there is nothing left to write. Warnings
+   * and errors that are emitted frequently from the same call site
+   * get suppressed, and the number of suppressed messages is
+   * reported periodically.
    */
   class Logger {
-    
+    /// Number of messages to emit per call site and interval
+    constexpr static uint32_t RateLimitCount = 8u;
+    /// Maximum number of distinct call sites to track
+    constexpr static size_t RateLimitEntries = 256u;
+    /// Rate limiting interval
+    constexpr static auto RateLimitInterval = std::chrono::seconds(1);
+    /// Time after which an idle writer thread exits
+    constexpr static auto WriterIdleTimeout = std::chrono::seconds(5);
+    /// Maximum number of queued messages before messages get dropped
+    constexpr static size_t MaxQueuedMessages = 4096u;
+
+    struct RateLimitEntry {
+      high_resolution_clock::time_point windowStart;
+      const char* prefix      = nullptr;
+      uint32_t    count       = 0u;
+      uint32_t    suppressed  = 0u;
+      std::string message;
+    };
   public:
     
     Logger(const std::string& file_name);
@@ -38,9 +87,15 @@ namespace dxvk {
     static void trace(const std::string& message);
     static void debug(const std::string& message);
     static void info (const std::string& message);
-    static void warn (const std::string& message);
-    static void err  (const std::string& message);
-    static void log  (LogLevel level, const std::string& message);
+
+    static void warn (const std::string& message,
+      const char* file = __builtin_FILE(), uint32_t line = __builtin_LINE());
+
+    static void err  (const std::string& message,
+      const char* file = __builtin_FILE(), uint32_t line = __builtin_LINE());
+
+    static void log  (LogLevel level, const std::string& message,
+      const char* file = __builtin_FILE(), uint32_t line = __builtin_LINE());
     
     static LogLevel logLevel() {
       return s_instance.m_minLevel;
@@ -54,14 +109,55 @@ namespace dxvk {
     const std::string m_fileName;
     
     dxvk::mutex       m_mutex;
-    std::ofstream     m_fileStream;
+    dxvk::condition_variable m_cond;
 
     bool              m_initialized = false;
+    bool              m_stopped = false;
+    bool              m_writerActive = false;
+
+    std::vector<std::string> m_queue;
+    uint64_t          m_dropped = 0u;
+
+    std::unordered_map<LogSource, RateLimitEntry, LogSourceHash> m_rateLimit;
+
+    dxvk::mutex       m_writeMutex;
+    std::ofstream     m_fileStream;
 #ifdef _WIN32
     PFN_wineLogOutput m_wineLogOutput = nullptr;
 #endif
 
-    void emitMsg(LogLevel level, const std::string& message);
+#ifndef _WIN32
+    dxvk::thread      m_thread;
+#endif
+
+    void emitMsg(LogLevel level, const std::string& message, LogSource source);
+
+    void initializeLocked();
+
+    bool checkRateLimitLocked(
+            LogSource           source,
+            const char*         prefix,
+      const std::string&        message,
+            high_resolution_clock::time_point time);
+
+    void reportSuppressedLocked(
+            high_resolution_clock::time_point time,
+            bool                force);
+
+    bool startWriterLocked();
+
+    void runWriter();
+
+#ifdef _WIN32
+    static DWORD WINAPI runWriterThread(void* module);
+#endif
+
+    void writeLines(
+      const std::vector<std::string>& lines);
+
+    static std::string formatMsg(
+            const char*         prefix,
+      const std::string&        message);
     
     std::string getFileName(
       const std::string& base);
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "util_compress.h"
+
+namespace dxvk::util {
+
+  // The block format is a sequence of tokens, each of which consists of
+  // a literal run followed by a back-reference. The token byte stores
+  // the literal length in the upper four bits, and the match length
+  // minus the minimum match length in the lower four bits. A value of
+  // 15 means that the length continues in subsequent bytes, each byte
+  // being added to the length until a byte other than 255 is found.
+  // Literals are followed by a 16-bit little-endian match offset. The
+  // last token only contains literals and ends the block.
+  constexpr uint32_t MinMatchLength = 4u;
+  constexpr uint32_t MaxMatchOffset = 65535u;
+  constexpr uint32_t HashTableBits = 14u;
+
+
+  static uint32_t readU32(const uint8_t* data) {
+    uint32_t result;
+    std::memcpy(&result, data, sizeof(result));
+    return result;
+  }
+
+
+  static uint32_t hashU32(uint32_t value) {
+    return (value * 2654435761u) >> (32u - HashTableBits);
+  }
+
+
+  static void writeLength(std::vector<uint8_t>& dst, size_t length) {
+    while (length >= 255u) {
+      dst.push_back(255u);
+      length -= 255u;
+    }
+
+    dst.push_back(uint8_t(length));
+  }
+
+
+  static void writeSequence(
+          std::vector<uint8_t>& dst,
+    const uint8_t*              literals,
+          size_t                literalCount,
+          size_t                matchOffset,
+          size_t                matchLength) {
+    size_t matchCode = matchLength ? matchLength - MinMatchLength : 0u;
+
+    uint8_t token = uint8_t(std::min<size_t>(literalCount, 15u) << 4)
+                  | uint8_t(std::min<size_t>(matchCode, 15u));
+
+    dst.push_back(token);
+
+    if (literalCount >= 15u)
+      writeLength(dst, literalCount - 15u);
+
+    dst.insert(dst.end(), literals, literals + literalCount);
+
+    if (matchLength) {
+      dst.push_back(uint8_t(matchOffset));
+      dst.push_back(uint8_t(matchOffset >> 8));
+
+      if (matchCode >= 15u)
+        writeLength(dst, matchCode - 15u);
+    }
+  }
+
+
+  static bool readLength(
+    const uint8_t*&             src,
+    const uint8_t*              srcEnd,
+          size_t&               length) {
+    uint8_t byte;
+
+    do {
+      if (src == srcEnd)
+        return false;
+
+      byte = *(src++);
+      length += byte;
+    } while (byte == 255u);
+
+    return true;
+  }
+
+
+  void compressBlock(
+    const void*                 src,
+          size_t                srcSize,
+          std::vector<uint8_t>& dst) {
+    auto data = reinterpret_cast<const uint8_t*>(src);
+
+    dst.clear();
+    dst.reserve(srcSize + srcSize / 255u + 16u);
+
+    // Positions are stored with an offset of one so
+    // that zero can be used to mark empty entries
+    std::array<uint32_t, 1u << HashTableBits> table = { };
+
+    size_t pos = 0u;
+    size_t anchor = 0u;
+
+    while (pos + MinMatchLength <= srcSize) {
+      uint32_t value = readU32(&data[pos]);
+      uint32_t hash = hashU32(value);
+
+      size_t ref = table[hash];
+      table[hash] = uint32_t(pos + 1u);
+
+      if (ref && pos + 1u - ref <= MaxMatchOffset && readU32(&data[ref - 1u]) == value) {
+        ref -= 1u;
+
+        size_t length = MinMatchLength;
+
+        while (pos + length < srcSize && data[ref + length] == data[pos + length])
+          length += 1u;
+
+        writeSequence(dst, &data[anchor], pos - anchor, pos - ref, length);
+
+        pos += length;
+        anchor = pos;
+      } else {
+        // Skip ahead faster in data that does not compress well
+        pos += 1u + ((pos - anchor) >> 6u);
+      }
+    }
+
+    writeSequence(dst, &data[anchor], srcSize - anchor, 0u, 0u);
+  }
+
+
+  bool decompressBlock(
+    const void*                 src,
+          size_t                srcSize,
+          void*                 dst,
+          size_t                dstSize) {
+    auto srcPtr = reinterpret_cast<const uint8_t*>(src);
+    auto srcEnd = srcPtr + srcSize;
+
+    auto dstBegin = reinterpret_cast<uint8_t*>(dst);
+    auto dstPtr = dstBegin;
+    auto dstEnd = dstBegin + dstSize;
+
+    while (srcPtr < srcEnd) {
+      uint8_t token = *(srcPtr++);
+
+      // Copy literals
+      size_t literalCount = token >> 4u;
+
+      if (literalCount == 15u && !readLength(srcPtr, srcEnd, literalCount))
+        return false;
+
+      if (literalCount > size_t(srcEnd - srcPtr) || literalCount > size_t(dstEnd - dstPtr))
+        return false;
+
+      std::memcpy(dstPtr, srcPtr, literalCount);
+
+      srcPtr += literalCount;
+      dstPtr += literalCount;
+
+      // The last token does not have a match
+      if (srcPtr == srcEnd)
+        break;
+
+      if (srcEnd - srcPtr < 2)
+        return false;
+
+      size_t matchOffset = size_t(srcPtr[0]) | (size_t(srcPtr[1]) << 8u);
+      srcPtr += 2;
+
+      if (!matchOffset || matchOffset > size_t(dstPtr - dstBegin))
+        return false;
+
+      size_t matchLength = token & 0xfu;
+
+      if (matchLength == 15u && !readLength(srcPtr, srcEnd, matchLength))
+        return false;
+
+      matchLength += MinMatchLength;
+
+      if (matchLength > size_t(dstEnd - dstPtr))
+        return false;
+
+      const uint8_t* matchPtr = dstPtr - matchOffset;
+
+      if (matchOffset >= matchLength) {
+        std::memcpy(dstPtr, matchPtr, matchLength);
+        dstPtr += matchLength;
+      } else {
+        // Overlapping copy, needs to be done byte by byte
+        for (size_t i = 0; i < matchLength; i++)
+          *(dstPtr++) = *(matchPtr++);
+      }
+    }
+
+    return dstPtr == dstEnd;
+  }
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dxvk::util {
+
+  /**
+   * \brief Compresses a block of data
+   *
+   * Uses a simple LZ77-style byte-oriented block format that is
+   * similar to LZ4. Compression is fast and only looks for a single
+   * match candidate per position, while decompression is mostly
+   * a sequence of plain memory copies.
+   * \param [in] src Source data
+   * \param [in] srcSize Source data size, in bytes
+   * \param [out] dst Compressed data. Will be overwritten.
+   */
+  void compressBlock(
+    const void*                 src,
+          size_t                srcSize,
+          std::vector<uint8_t>& dst);
+
+  /**
+   * \brief Decompresses a block of data
+   *
+   * All reads and writes are bounds-checked, so this is
+   * safe to call on corrupted data.
+   * \param [in] src Compressed data
+   * \param [in] srcSize Compressed data size, in bytes
+   * \param [out] dst Output buffer
+   * \param [in] dstSize Exact size of the uncompressed data
+   * \returns \c true if the data was decoded successfully and
+   *    the decompressed size matches \c dstSize exactly.
+   */
+  bool decompressBlock(
+    const void*                 src,
+          size_t                srcSize,
+          void*                 dst,
+          size_t                dstSize);
+
+}
@@ -1,5 +1,13 @@
+#include <cstring>
 #include <fstream>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "./com/com_include.h"
 
 #include "./log/log.h"
@@ -51,31 +59,53 @@ namespace dxvk::util {
 
       if (!m_file)
         m_file = INVALID_HANDLE_VALUE;
+
+      if (m_file != INVALID_HANDLE_VALUE && flags.test(FileFlag::MapRead))
+        createMapping();
     }
 
     ~Win32File() {
+      destroyMapping();
+
       CloseHandle(m_file);
     }
 
     bool read(size_t offset, size_t size, void* data) {
-      if (!seek(offset, FILE_BEGIN))
-        return false;
+      if (auto src = getMappedData(offset, size)) {
+        std::memcpy(data, src, size);
+        return true;
+      }
 
-      return read(size, data);
+      return readAt(offset, size, data);
     }
 
     bool write(size_t offset, size_t size, const void* data) {
-      if (!seek(offset, FILE_BEGIN))
-        return false;
-
-      return write(size, data);
+      return writeAt(offset, size, data);
     }
 
     bool append(size_t size, const void* data) {
-      if (!seek(0, FILE_END))
+      return writeAt(AppendOffset, size, data);
+    }
+
+    bool truncate(size_t size) {
+      if (m_file == INVALID_HANDLE_VALUE)
         return false;
 
-      return write(size, data);
+      // Files with a mapped view cannot be truncated
+      destroyMapping();
+
+      LARGE_INTEGER offset = { };
+      offset.QuadPart = size;
+
+      // Other I/O uses explicit offsets, so moving
+      // the file pointer here does not affect it.
+      bool success = SetFilePointerEx(m_file, offset, nullptr, FILE_BEGIN)
+        && SetEndOfFile(m_file);
+
+      if (m_flags.test(FileFlag::MapRead))
+        createMapping();
+
+      return success;
     }
 
     size_t size() {
@@ -98,48 +128,98 @@ namespace dxvk::util {
       return FlushFileBuffers(m_file);
     }
 
+    const void* getMappedData(size_t offset, size_t size) const {
+      if (!m_mappedData || offset > m_mappedSize || size > m_mappedSize - offset)
+        return nullptr;
+
+      return reinterpret_cast<const char*>(m_mappedData) + offset;
+    }
+
   private:
 
     FileFlags m_flags = { };
     HANDLE    m_file  = INVALID_HANDLE_VALUE;
 
-    bool seek(size_t offset, DWORD method) {
-      if (!m_file)
-        return false;
+    HANDLE    m_mapping     = nullptr;
+    void*     m_mappedData  = nullptr;
+    size_t    m_mappedSize  = 0u;
+
+    void createMapping() {
+      size_t fileSize = size();
+
+      // Mapping an empty file is not allowed
+      if (!fileSize)
+        return;
+
+      m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+      if (!m_mapping)
+        return;
+
+      m_mappedData = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, fileSize);
+
+      if (m_mappedData)
+        m_mappedSize = fileSize;
+    }
+
+    void destroyMapping() {
+      if (m_mappedData)
+        UnmapViewOfFile(m_mappedData);
 
-      LARGE_INTEGER address = { };
-      address.QuadPart = offset;
+      if (m_mapping)
+        CloseHandle(m_mapping);
 
-      return SetFilePointerEx(m_file, address, nullptr, method);
+      m_mapping = nullptr;
+      m_mappedData = nullptr;
+      m_mappedSize = 0u;
     }
 
-    bool read(size_t size, void* data) {
+    // Passing an offset of all ones to WriteFile
+    // will append data to the end of the file.
+    static constexpr uint64_t AppendOffset = ~0ull;
+
+    // All I/O uses explicit offsets rather than the file pointer,
+    // so that reads can safely run concurrently with appends.
+    static OVERLAPPED getOverlapped(uint64_t offset) {
+      OVERLAPPED overlapped = { };
+      overlapped.Offset = DWORD(offset);
+      overlapped.OffsetHigh = DWORD(offset >> 32);
+      return overlapped;
+    }
+
+    bool readAt(uint64_t offset, size_t size, void* data) {
       auto buffer = reinterpret_cast<char*>(data);
 
       while (size) {
+        OVERLAPPED overlapped = getOverlapped(offset);
         DWORD read = 0u;
 
-        if (!ReadFile(m_file, buffer, size, &read, nullptr) || !read)
+        if (!ReadFile(m_file, buffer, size, &read, &overlapped) || !read)
           return false;
 
         buffer += read;
+        offset += read;
         size -= read;
       }
 
       return true;
     }
 
-    bool write(size_t size, const void* data) {
+    bool writeAt(uint64_t offset, size_t size, const void* data) {
       auto buffer = reinterpret_cast<const char*>(data);
 
       while (size) {
+        OVERLAPPED overlapped = getOverlapped(offset);
         DWORD written = 0u;
 
-        if (!WriteFile(m_file, buffer, size, &written, nullptr) || !written)
+        if (!WriteFile(m_file, buffer, size, &written, &overlapped) || !written)
           return false;
 
         buffer += written;
         size -= written;
+
+        if (offset != AppendOffset)
+          offset += written;
       }
 
       return true;
@@ -154,7 +234,8 @@ namespace dxvk::util {
 
   public:
 
-    StlFile(const std::string& path, FileFlags flags) {
+    StlFile(const std::string& path, FileFlags flags)
+    : m_flags(flags), m_path(path) {
       std::ios_base::openmode mode = std::ios_base::binary;
 
       if (flags.test(FileFlag::AllowRead))
@@ -167,20 +248,49 @@ namespace dxvk::util {
         mode |= std::ios_base::trunc;
 
       m_file.open(path, mode);
+
+      // Use a separate descriptor for reads so that they do not
+      // depend on the stream position. Note that this means that
+      // data appended through the stream is only visible to reads
+      // after it has been flushed.
+      if (m_file.is_open() && flags.test(FileFlag::AllowRead)) {
+        m_readFd = ::open(path.c_str(), O_RDONLY);
+
+        if (m_readFd >= 0 && flags.test(FileFlag::MapRead))
+          createMapping();
+      }
     }
 
     ~StlFile() {
+      destroyMapping();
 
+      if (m_readFd >= 0)
+        ::close(m_readFd);
     }
 
     bool read(size_t offset, size_t size, void* data) {
-      if (!status())
-        return false;
+      if (auto src = getMappedData(offset, size)) {
+        std::memcpy(data, src, size);
+        return true;
+      }
 
-      if (!m_file.seekg(offset, std::ios_base::beg))
+      if (m_readFd < 0)
         return false;
 
-      return bool(m_file.read(reinterpret_cast<char*>(data), size));
+      auto buffer = reinterpret_cast<char*>(data);
+
+      while (size) {
+        ssize_t result = pread(m_readFd, buffer, size, off_t(offset));
+
+        if (result <= 0)
+          return false;
+
+        buffer += result;
+        offset += result;
+        size -= result;
+      }
+
+      return true;
     }
 
     bool write(size_t offset, size_t size, const void* data) {
@@ -203,6 +313,21 @@ namespace dxvk::util {
       return bool(m_file.write(reinterpret_cast<const char*>(data), size));
     }
 
+    bool truncate(size_t size) {
+      if (!status() || !m_file.flush())
+        return false;
+
+      // Accessing mapped pages past the end of the file is not allowed
+      destroyMapping();
+
+      bool success = !::truncate(m_path.c_str(), off_t(size));
+
+      if (m_readFd >= 0 && m_flags.test(FileFlag::MapRead))
+        createMapping();
+
+      return success;
+    }
+
     size_t size() {
       if (status()) {
         if (m_flags.test(FileFlag::AllowWrite)) {
@@ -229,11 +354,46 @@ namespace dxvk::util {
       return true;
     }
 
+    const void* getMappedData(size_t offset, size_t size) const {
+      if (!m_mappedData || offset > m_mappedSize || size > m_mappedSize - offset)
+        return nullptr;
+
+      return reinterpret_cast<const char*>(m_mappedData) + offset;
+    }
+
   private:
 
     FileFlags     m_flags = { };
+    std::string   m_path;
     std::fstream  m_file;
 
+    int           m_readFd = -1;
+
+    void*         m_mappedData = nullptr;
+    size_t        m_mappedSize = 0u;
+
+    void createMapping() {
+      struct stat st = { };
+
+      if (fstat(m_readFd, &st) || st.st_size <= 0)
+        return;
+
+      void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, m_readFd, 0);
+
+      if (data != MAP_FAILED) {
+        m_mappedData = data;
+        m_mappedSize = size_t(st.st_size);
+      }
+    }
+
+    void destroyMapping() {
+      if (m_mappedData)
+        munmap(m_mappedData, m_mappedSize);
+
+      m_mappedData = nullptr;
+      m_mappedSize = 0u;
+    }
+
   };
 
   using FileImpl = StlFile;
@@ -289,6 +449,10 @@ namespace dxvk::util {
     return m_impl && m_impl->append(size, data);
   }
 
+  bool File::truncate(size_t size) {
+    return m_impl && m_impl->truncate(size);
+  }
+
   size_t File::size() {
     if (!m_impl)
       return 0u;
@@ -300,6 +464,13 @@ namespace dxvk::util {
     return m_impl && m_impl->flush();
   }
 
+  const void* File::getMappedData(size_t offset, size_t size) const {
+    if (!m_impl)
+      return nullptr;
+
+    return m_impl->getMappedData(offset, size);
+  }
+
   File::operator bool () const {
     return m_impl && m_impl->status();
   }
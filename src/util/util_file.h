@@ -19,6 +19,7 @@ namespace dxvk::util {
     AllowWrite      = 1,
     Truncate        = 2,
     Exclusive       = 3,
+    MapRead         = 4,
   };
 
   using FileFlags = Flags<FileFlag>;
@@ -39,12 +40,16 @@ namespace dxvk::util {
 
     virtual bool append(size_t size, const void* data) = 0;
 
+    virtual bool truncate(size_t size) = 0;
+
     virtual size_t size() = 0;
 
     virtual bool status() const = 0;
 
     virtual bool flush() = 0;
 
+    virtual const void* getMappedData(size_t offset, size_t size) const = 0;
+
     force_inline void incRef() {
       m_refCount.fetch_add(1u, std::memory_order_acquire);
     }
@@ -66,7 +71,17 @@ namespace dxvk::util {
    *
    * Provides a basic API for exclusive file I/O, which is
    * not (yet) available in the cpp standard library.
-   * Note that this file API is not thread-safe.
+   * Note that writes to the same file are not thread-safe.
+   *
+   * Reads use positional I/O and do not depend on any file
+   * pointer, so they may be performed from multiple threads
+   * concurrently, even while data is being appended. Data
+   * written to the file is only guaranteed to be visible
+   * to reads after the file has been flushed.
+   *
+   * If the file is opened with \c FileFlag::MapRead, the file
+   * contents that exist at the time of opening are mapped into
+   * memory, and reads from that region are plain copies.
    */
   class File {
 
@@ -90,10 +105,32 @@ namespace dxvk::util {
 
     bool append(size_t size, const void* data);
 
+    /**
+     * \brief Truncates the file
+     *
+     * Discards all data past the given size. If the file
+     * is mapped, the mapping is recreated, so any pointers
+     * previously returned by \ref getMappedData become
+     * invalid. Must not be called concurrently with reads.
+     * \param [in] size New file size
+     * \returns \c true on success
+     */
+    bool truncate(size_t size);
+
     size_t size();
 
     bool flush();
 
+    /**
+     * \brief Queries pointer to mapped file data
+     *
+     * \param [in] offset Offset into the file
+     * \param [in] size Number of bytes to access
+     * \returns Pointer to mapped data, or \c nullptr if the file
+     *    was not mapped or the range exceeds the mapped region.
+     */
+    const void* getMappedData(size_t offset, size_t size) const;
+
     explicit operator bool () const;
 
   private:
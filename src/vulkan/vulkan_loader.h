@@ -414,6 +414,11 @@ namespace dxvk::vk {
     VULKAN_FN(vkSetHdrMetadataEXT);
     #endif
 
+    #ifdef VK_EXT_host_image_copy
+    VULKAN_FN(vkCopyMemoryToImageEXT);
+    VULKAN_FN(vkTransitionImageLayoutEXT);
+    #endif
+
     #ifdef VK_EXT_pageable_device_local_memory
     VULKAN_FN(vkSetDeviceMemoryPriorityEXT);
     #endif
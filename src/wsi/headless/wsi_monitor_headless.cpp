@@ -0,0 +1,105 @@
+#if defined(DXVK_WSI_HEADLESS)
+
+#include "../wsi_monitor.h"
+
+#include "wsi_platform_headless.h"
+
+#include "../../util/util_string.h"
+#include "../../util/log/log.h"
+
+#include <cstring>
+#include <string>
+
+namespace dxvk::wsi {
+
+  HMONITOR HeadlessWsiDriver::getDefaultMonitor() {
+    return getHeadlessMonitor();
+  }
+
+
+  HMONITOR HeadlessWsiDriver::enumMonitors(uint32_t index) {
+    return index ? nullptr : getHeadlessMonitor();
+  }
+
+
+  HMONITOR HeadlessWsiDriver::enumMonitors(const LUID *adapterLUID[], uint32_t numLUIDs, uint32_t index) {
+    return enumMonitors(index);
+  }
+
+
+  bool HeadlessWsiDriver::getDisplayName(
+          HMONITOR         hMonitor,
+          WCHAR            (&Name)[32]) {
+    if (hMonitor != getHeadlessMonitor())
+      return false;
+
+    std::wstring name = LR"(\\.\DISPLAY1)";
+
+    std::memset(Name, 0, sizeof(Name));
+    name.copy(Name, name.length(), 0);
+
+    return true;
+  }
+
+
+  bool HeadlessWsiDriver::getDesktopCoordinates(
+          HMONITOR         hMonitor,
+          RECT*            pRect) {
+    if (hMonitor != getHeadlessMonitor())
+      return false;
+
+    std::lock_guard lock(m_mutex);
+
+    pRect->left   = 0;
+    pRect->top    = 0;
+    pRect->right  = LONG(m_currentMode.width);
+    pRect->bottom = LONG(m_currentMode.height);
+
+    return true;
+  }
+
+
+  bool HeadlessWsiDriver::getDisplayMode(
+          HMONITOR         hMonitor,
+          uint32_t         ModeNumber,
+          WsiMode*         pMode) {
+    if (hMonitor != getHeadlessMonitor() || ModeNumber)
+      return false;
+
+    // Only expose the configured mode, so that applications
+    // do not pick a different resolution on their own.
+    *pMode = m_desktopMode;
+    return true;
+  }
+
+
+  bool HeadlessWsiDriver::getCurrentDisplayMode(
+          HMONITOR         hMonitor,
+          WsiMode*         pMode) {
+    if (hMonitor != getHeadlessMonitor())
+      return false;
+
+    std::lock_guard lock(m_mutex);
+    *pMode = m_currentMode;
+    return true;
+  }
+
+
+  bool HeadlessWsiDriver::getDesktopDisplayMode(
+          HMONITOR         hMonitor,
+          WsiMode*         pMode) {
+    if (hMonitor != getHeadlessMonitor())
+      return false;
+
+    *pMode = m_desktopMode;
+    return true;
+  }
+
+
+  std::vector<uint8_t> HeadlessWsiDriver::getMonitorEdid(HMONITOR hMonitor) {
+    return {};
+  }
+
+}
+
+#endif
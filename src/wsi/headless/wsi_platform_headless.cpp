@@ -0,0 +1,74 @@
+#if defined(DXVK_WSI_HEADLESS)
+
+#include <cstdio>
+
+#include "wsi_platform_headless.h"
+#include "../../util/util_env.h"
+#include "../../util/util_error.h"
+#include "../../util/util_string.h"
+#include "../../util/log/log.h"
+
+namespace dxvk::wsi {
+
+  HeadlessWsiDriver::HeadlessWsiDriver() {
+    m_desktopMode = parseMode(env::getEnvVar("DXVK_HEADLESS_MODE"));
+    m_currentMode = m_desktopMode;
+
+    Logger::info(str::format("Headless WSI: Using mode ",
+      m_desktopMode.width, "x", m_desktopMode.height, "@",
+      m_desktopMode.refreshRate.numerator / m_desktopMode.refreshRate.denominator));
+  }
+
+  HeadlessWsiDriver::~HeadlessWsiDriver() {
+
+  }
+
+  std::vector<const char *> HeadlessWsiDriver::getInstanceExtensions() {
+    return { VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME };
+  }
+
+  WsiMode HeadlessWsiDriver::parseMode(const std::string& str) {
+    uint32_t width = 1280u;
+    uint32_t height = 720u;
+    uint32_t refreshRate = 60u;
+
+    // Expected format is WxH or WxH@R, e.g. 1920x1080@144
+    if (!str.empty()) {
+      int count = std::sscanf(str.c_str(), "%ux%u@%u", &width, &height, &refreshRate);
+
+      if (count < 2 || !width || !height || !refreshRate) {
+        Logger::warn(str::format("Headless WSI: Invalid mode: ", str));
+
+        width = 1280u;
+        height = 720u;
+        refreshRate = 60u;
+      }
+    }
+
+    WsiMode mode = { };
+    mode.width = width;
+    mode.height = height;
+    mode.refreshRate = WsiRational { refreshRate, 1u };
+    mode.bitsPerPixel = 32u;
+    mode.interlaced = false;
+    return mode;
+  }
+
+  static bool createHeadlessWsiDriver(WsiDriver **driver) {
+    try {
+      *driver = new HeadlessWsiDriver();
+    } catch (const DxvkError& e) {
+      Logger::err(str::format(e.message()));
+      return false;
+    }
+    return true;
+  }
+
+  WsiBootstrap HeadlessWSI = {
+    "Headless",
+    createHeadlessWsiDriver
+  };
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "../wsi_platform.h"
+
+#include "../../util/thread.h"
+
+namespace dxvk::wsi {
+
+  /**
+   * \brief Headless WSI driver
+   *
+   * Does not require a display server. Window handles are opaque
+   * to this driver, surfaces are created via VK_EXT_headless_surface
+   * and there is a single virtual monitor whose mode can be set via
+   * the \c DXVK_HEADLESS_MODE environment variable.
+   */
+  class HeadlessWsiDriver : public WsiDriver {
+  private:
+    WsiMode m_desktopMode = { };
+    WsiMode m_currentMode = { };
+
+    dxvk::mutex m_mutex;
+    std::unordered_map<HWND, VkExtent2D> m_windowSizes;
+
+    static WsiMode parseMode(const std::string& str);
+  public:
+    HeadlessWsiDriver();
+    ~HeadlessWsiDriver();
+
+    // Platform
+    virtual std::vector<const char *> getInstanceExtensions();
+
+    // Monitor
+    virtual HMONITOR getDefaultMonitor();
+
+    virtual HMONITOR enumMonitors(uint32_t index);
+
+    virtual HMONITOR enumMonitors(const LUID *adapterLUID[], uint32_t numLUIDs, uint32_t index);
+
+    virtual bool getDisplayName(
+            HMONITOR         hMonitor,
+            WCHAR            (&Name)[32]);
+
+    virtual bool getDesktopCoordinates(
+            HMONITOR         hMonitor,
+            RECT*            pRect);
+
+    virtual bool getDisplayMode(
+            HMONITOR         hMonitor,
+            uint32_t         modeNumber,
+            WsiMode*         pMode);
+
+    virtual bool getCurrentDisplayMode(
+            HMONITOR         hMonitor,
+            WsiMode*         pMode);
+
+    virtual bool getDesktopDisplayMode(
+            HMONITOR         hMonitor,
+            WsiMode*         pMode);
+
+    virtual WsiEdidData getMonitorEdid(HMONITOR hMonitor);
+
+    // Window
+
+    virtual void getWindowSize(
+            HWND      hWindow,
+            uint32_t* pWidth,
+            uint32_t* pWeight);
+
+    virtual void resizeWindow(
+            HWND             hWindow,
+            DxvkWindowState* pState,
+            uint32_t         width,
+            uint32_t         weight);
+
+    virtual void saveWindowState(
+            HWND             hWindow,
+            DxvkWindowState* pState,
+            bool             saveStyle);
+
+    virtual void restoreWindowState(
+            HWND             hWindow,
+            DxvkWindowState* pState,
+            bool             restoreCoordinates);
+
+    virtual bool setWindowMode(
+            HMONITOR         hMonitor,
+            HWND             hWindow,
+            DxvkWindowState* pState,
+      const WsiMode&         mode);
+
+    virtual bool enterFullscreenMode(
+            HMONITOR         hMonitor,
+            HWND             hWindow,
+            DxvkWindowState* pState,
+            [[maybe_unused]]
+            bool             modeSwitch);
+
+    virtual bool leaveFullscreenMode(
+            HWND             hWindow,
+            DxvkWindowState* pState);
+
+    virtual bool restoreDisplayMode();
+
+    virtual HMONITOR getWindowMonitor(HWND hWindow);
+
+    virtual bool isWindow(HWND hWindow);
+
+    virtual bool isMinimized(HWND hWindow);
+
+    virtual bool isOccluded(HWND hWindow);
+
+    virtual void updateFullscreenWindow(
+            HMONITOR hMonitor,
+            HWND     hWindow,
+            bool     forceTopmost);
+
+    virtual VkResult createSurface(
+            HWND                hWindow,
+            PFN_vkGetInstanceProcAddr pfnVkGetInstanceProcAddr,
+            VkInstance          instance,
+            VkSurfaceKHR*       pSurface);
+  };
+
+  /**
+   * \brief Handle of the virtual monitor
+   */
+  inline HMONITOR getHeadlessMonitor() {
+    return reinterpret_cast<HMONITOR>(uintptr_t(1u));
+  }
+
+}
@@ -0,0 +1,148 @@
+#if defined(DXVK_WSI_HEADLESS)
+
+#include "../wsi_window.h"
+
+#include "wsi_platform_headless.h"
+
+#include "../../util/util_string.h"
+#include "../../util/log/log.h"
+
+namespace dxvk::wsi {
+
+  void HeadlessWsiDriver::getWindowSize(
+        HWND      hWindow,
+        uint32_t* pWidth,
+        uint32_t* pHeight) {
+    std::lock_guard lock(m_mutex);
+
+    // Windows that were never resized cover the entire virtual monitor
+    VkExtent2D size = { m_currentMode.width, m_currentMode.height };
+
+    auto entry = m_windowSizes.find(hWindow);
+
+    if (entry != m_windowSizes.end())
+      size = entry->second;
+
+    if (pWidth)
+      *pWidth = size.width;
+
+    if (pHeight)
+      *pHeight = size.height;
+  }
+
+
+  void HeadlessWsiDriver::resizeWindow(
+          HWND             hWindow,
+          DxvkWindowState* pState,
+          uint32_t         Width,
+          uint32_t         Height) {
+    std::lock_guard lock(m_mutex);
+    m_windowSizes[hWindow] = VkExtent2D { Width, Height };
+  }
+
+
+  void HeadlessWsiDriver::saveWindowState(
+            HWND             hWindow,
+            DxvkWindowState* pState,
+            bool             saveStyle) {
+  }
+
+
+  void HeadlessWsiDriver::restoreWindowState(
+            HWND             hWindow,
+            DxvkWindowState* pState,
+            bool             restoreCoordinates) {
+  }
+
+
+  bool HeadlessWsiDriver::setWindowMode(
+          HMONITOR         hMonitor,
+          HWND             hWindow,
+          DxvkWindowState* pState,
+    const WsiMode&         pMode) {
+    if (hMonitor != getHeadlessMonitor())
+      return false;
+
+    std::lock_guard lock(m_mutex);
+    m_currentMode = pMode;
+    return true;
+  }
+
+
+  bool HeadlessWsiDriver::enterFullscreenMode(
+          HMONITOR         hMonitor,
+          HWND             hWindow,
+          DxvkWindowState* pState,
+          bool             ModeSwitch) {
+    if (hMonitor != getHeadlessMonitor())
+      return false;
+
+    std::lock_guard lock(m_mutex);
+    m_windowSizes[hWindow] = VkExtent2D { m_currentMode.width, m_currentMode.height };
+    return true;
+  }
+
+
+  bool HeadlessWsiDriver::leaveFullscreenMode(
+          HWND             hWindow,
+          DxvkWindowState* pState) {
+    return true;
+  }
+
+
+  bool HeadlessWsiDriver::restoreDisplayMode() {
+    std::lock_guard lock(m_mutex);
+    m_currentMode = m_desktopMode;
+    return true;
+  }
+
+
+  HMONITOR HeadlessWsiDriver::getWindowMonitor(HWND hWindow) {
+    return getHeadlessMonitor();
+  }
+
+
+  bool HeadlessWsiDriver::isWindow(HWND hWindow) {
+    // Window handles are opaque, accept anything non-null
+    return hWindow != nullptr;
+  }
+
+
+  bool HeadlessWsiDriver::isMinimized(HWND hWindow) {
+    return false;
+  }
+
+
+  bool HeadlessWsiDriver::isOccluded(HWND hWindow) {
+    return false;
+  }
+
+
+  void HeadlessWsiDriver::updateFullscreenWindow(
+          HMONITOR hMonitor,
+          HWND     hWindow,
+          bool     forceTopmost) {
+    // Nothing to do without a window system
+  }
+
+
+  VkResult HeadlessWsiDriver::createSurface(
+          HWND                      hWindow,
+          PFN_vkGetInstanceProcAddr pfnVkGetInstanceProcAddr,
+          VkInstance                instance,
+          VkSurfaceKHR*             pSurface) {
+    auto pfnVkCreateHeadlessSurfaceEXT = reinterpret_cast<PFN_vkCreateHeadlessSurfaceEXT>(
+      pfnVkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT"));
+
+    if (!pfnVkCreateHeadlessSurfaceEXT) {
+      Logger::err("Headless WSI: vkCreateHeadlessSurfaceEXT not supported");
+      return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    VkHeadlessSurfaceCreateInfoEXT info = { VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT };
+    return pfnVkCreateHeadlessSurfaceEXT(instance, &info, nullptr, pSurface);
+  }
+
+}
+
+#endif
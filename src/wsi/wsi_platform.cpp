@@ -20,6 +20,9 @@ namespace dxvk::wsi {
 #endif
 #if defined(DXVK_WSI_GLFW)
     &GlfwWSI,
+#endif
+#if defined(DXVK_WSI_HEADLESS)
+    &HeadlessWSI,
 #endif
   };
 
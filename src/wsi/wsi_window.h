@@ -29,6 +29,9 @@ namespace dxvk::wsi {
 #endif
 #if defined(DXVK_WSI_GLFW)
     // Nothing to store
+#endif
+#if defined(DXVK_WSI_HEADLESS)
+    // Nothing to store
 #endif
   };
 